@@ -0,0 +1,326 @@
+//=============================================================================
+// AsyncLog.cpp
+//=============================================================================
+
+#include "AsyncLog.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+static_assert((LOG_RING_SLOTS & (LOG_RING_SLOTS - 1)) == 0, "LOG_RING_SLOTS must be a power of two");
+
+static const int  WRITE_BUFFER_BYTES = 64 * 1024;
+static const int  IDLE_WAIT_MS       = 10;
+
+struct LogSlot
+{
+   unsigned char  channel;
+   unsigned short length;
+   char           text[LOG_LINE_MAX];
+};
+
+// head is written only by the owning thread, tail only by the writer.
+struct LogRing
+{
+   std::atomic<unsigned long long> head;
+   std::atomic<unsigned long long> tail;
+   std::atomic<unsigned long long> dropped;  // since the writer last looked
+   LogSlot                         slots[LOG_RING_SLOTS];
+};
+
+static const char* const LOG_FILE_NAMES[LOG_CHANNEL_COUNT] = { "error.txt", "log.txt", "output.txt" };
+static const char* const LOG_FILE_MODES[LOG_CHANNEL_COUNT] = { "a", "a", "w" };
+
+class AsyncLogWriter
+{
+public:
+   AsyncLogWriter();
+   ~AsyncLogWriter();
+
+   LogRing* threadRing();
+   void     wake() { mWake.notify_one(); }
+   void     flush();
+   void     countDropped() { mDropped.fetch_add(1, std::memory_order_relaxed); }
+   unsigned long long dropped() const { return mDropped.load(std::memory_order_relaxed); }
+   bool     isOpen(int channel) const { return mFiles[channel] != 0; }
+
+private:
+   // Prevent copying
+   AsyncLogWriter(const AsyncLogWriter& rhs);
+   AsyncLogWriter& operator=(const AsyncLogWriter& rhs);
+
+   void run();
+   bool drain();
+   void append(int channel, const char* text, int length);
+   void writeOut(int channel);
+
+   std::atomic<LogRing*>           mRings[LOG_MAX_THREADS];
+   std::atomic<int>                mRingCount;
+   std::atomic<unsigned long long> mDropped;
+
+   FILE*  mFiles[LOG_CHANNEL_COUNT];
+   char   mBuffers[LOG_CHANNEL_COUNT][WRITE_BUFFER_BYTES];
+   int    mUsed[LOG_CHANNEL_COUNT];
+
+   std::mutex              mMutex;
+   std::condition_variable mWake;
+   std::condition_variable mFlushed;
+   bool                    mStop;
+   unsigned long long      mFlushRequests;
+   unsigned long long      mFlushesDone;
+   std::thread             mThread;
+};
+
+// Set once the writer is gone (static destruction), after which logging
+// calls drop their messages instead of touching it.
+static std::atomic<bool> gLogShutdown(false);
+
+static thread_local LogRing* tRing = 0;
+
+static AsyncLogWriter& writer()
+{
+   static AsyncLogWriter w;
+   return w;
+}
+
+AsyncLogWriter::AsyncLogWriter()
+: mRingCount(0), mDropped(0), mStop(false), mFlushRequests(0), mFlushesDone(0)
+{
+   for (int i = 0; i < LOG_MAX_THREADS; i++)
+      mRings[i].store(0, std::memory_order_relaxed);
+   for (int c = 0; c < LOG_CHANNEL_COUNT; c++)
+   {
+      mFiles[c] = fopen(LOG_FILE_NAMES[c], LOG_FILE_MODES[c]);
+      mUsed[c]  = 0;
+   }
+   mThread = std::thread(&AsyncLogWriter::run, this);
+}
+
+AsyncLogWriter::~AsyncLogWriter()
+{
+   {
+      std::lock_guard<std::mutex> lock(mMutex);
+      mStop = true;
+   }
+   mWake.notify_one();
+   mThread.join();
+   gLogShutdown.store(true, std::memory_order_release);
+
+   for (int c = 0; c < LOG_CHANNEL_COUNT; c++)
+      if (mFiles[c])
+         fclose(mFiles[c]);
+   for (int i = 0; i < LOG_MAX_THREADS; i++)
+      delete mRings[i].load(std::memory_order_acquire);
+}
+
+LogRing* AsyncLogWriter::threadRing()
+{
+   if (tRing)
+      return tRing;
+
+   int i = mRingCount.load(std::memory_order_relaxed);
+   do
+   {
+      if (i >= LOG_MAX_THREADS)
+         return 0;
+   } while (!mRingCount.compare_exchange_weak(i, i + 1, std::memory_order_relaxed));
+
+   tRing = new LogRing();
+   mRings[i].store(tRing, std::memory_order_release);
+   return tRing;
+}
+
+void AsyncLogWriter::flush()
+{
+   std::unique_lock<std::mutex> lock(mMutex);
+   unsigned long long ticket = ++mFlushRequests;
+   mWake.notify_one();
+   while (mFlushesDone < ticket && !mStop)
+      mFlushed.wait(lock);
+}
+
+//===============================================================
+// Writer thread
+
+void AsyncLogWriter::append(int channel, const char* text, int length)
+{
+   if (!mFiles[channel])
+   {
+      countDropped();
+      return;
+   }
+   if (mUsed[channel] + length + 1 > WRITE_BUFFER_BYTES)
+      writeOut(channel);
+   memcpy(mBuffers[channel] + mUsed[channel], text, length);
+   mUsed[channel] += length;
+   mBuffers[channel][mUsed[channel]++] = '\n';
+}
+
+void AsyncLogWriter::writeOut(int channel)
+{
+   if (mUsed[channel] > 0)
+      fwrite(mBuffers[channel], 1, mUsed[channel], mFiles[channel]);
+   mUsed[channel] = 0;
+}
+
+// Moves everything queued so far into the files, one fflush per file.
+// Returns whether there was anything.
+bool AsyncLogWriter::drain()
+{
+   bool any = false;
+   unsigned long long dropped = 0;
+   int rings = mRingCount.load(std::memory_order_acquire);
+   for (int r = 0; r < rings && r < LOG_MAX_THREADS; r++)
+   {
+      LogRing* ring = mRings[r].load(std::memory_order_acquire);
+      if (!ring)
+         continue;
+
+      unsigned long long head = ring->head.load(std::memory_order_acquire);
+      unsigned long long tail = ring->tail.load(std::memory_order_relaxed);
+      for (; tail < head; tail++)
+      {
+         const LogSlot& s = ring->slots[tail & (LOG_RING_SLOTS - 1)];
+         append(s.channel, s.text, s.length);
+         any = true;
+      }
+      ring->tail.store(tail, std::memory_order_release);
+
+      dropped += ring->dropped.exchange(0, std::memory_order_relaxed);
+   }
+
+   if (dropped > 0)
+   {
+      mDropped.fetch_add(dropped, std::memory_order_relaxed);
+      char note[64];
+      int n = sprintf(note, "AsyncLog: %llu messages dropped", dropped);
+      append(LOG_CHANNEL_LOG, note, n);
+      any = true;
+   }
+
+   for (int c = 0; c < LOG_CHANNEL_COUNT; c++)
+   {
+      if (mUsed[c] > 0)
+      {
+         writeOut(c);
+         fflush(mFiles[c]);
+      }
+   }
+   return any;
+}
+
+void AsyncLogWriter::run()
+{
+   std::unique_lock<std::mutex> lock(mMutex);
+   for (;;)
+   {
+      unsigned long long requests = mFlushRequests;
+      bool stop = mStop;
+
+      lock.unlock();
+      while (drain())
+         ;
+      lock.lock();
+
+      mFlushesDone = requests;
+      mFlushed.notify_all();
+      if (stop)
+         break;
+
+      if (mFlushRequests == mFlushesDone && !mStop)
+         mWake.wait_for(lock, std::chrono::milliseconds(IDLE_WAIT_MS));
+   }
+}
+
+//===============================================================
+// Logging calls
+
+// The slot the calling thread's next message goes in, or 0 (and the drop
+// counted) if there is no room.  commit() hands it to the writer.
+static LogSlot* reserve(LogRing*& ring)
+{
+   if (gLogShutdown.load(std::memory_order_acquire))
+      return 0;
+
+   AsyncLogWriter& w = writer();
+   ring = w.threadRing();
+   if (!ring)
+   {
+      w.countDropped();
+      return 0;
+   }
+
+   unsigned long long head = ring->head.load(std::memory_order_relaxed);
+   unsigned long long tail = ring->tail.load(std::memory_order_acquire);
+   if (head - tail >= (unsigned long long)LOG_RING_SLOTS)
+   {
+      ring->dropped.fetch_add(1, std::memory_order_relaxed);
+      return 0;
+   }
+   return &ring->slots[head & (LOG_RING_SLOTS - 1)];
+}
+
+static void commit(LogRing* ring, LogSlot* s, LogChannel channel, int length)
+{
+   s->channel = (unsigned char)channel;
+   s->length  = (unsigned short)(length < 0 ? 0 : length < LOG_LINE_MAX ? length : LOG_LINE_MAX - 1);
+
+   unsigned long long head = ring->head.load(std::memory_order_relaxed);
+   unsigned long long tail = ring->tail.load(std::memory_order_relaxed);
+   ring->head.store(head + 1, std::memory_order_release);
+
+   // Don't wait out the writer's idle sleep once the ring is half full.
+   if (head + 1 - tail >= (unsigned long long)LOG_RING_SLOTS / 2)
+      writer().wake();
+}
+
+bool asyncLog(LogChannel channel, const char* text)
+{
+   LogRing* ring;
+   LogSlot* s = reserve(ring);
+   if (!s)
+      return false;
+
+   int n = (int)strlen(text);
+   if (n > LOG_LINE_MAX - 1)
+      n = LOG_LINE_MAX - 1;
+   memcpy(s->text, text, n);
+   commit(ring, s, channel, n);
+   return true;
+}
+
+bool asyncLogf(LogChannel channel, const char* format, ...)
+{
+   LogRing* ring;
+   LogSlot* s = reserve(ring);
+   if (!s)
+      return false;
+
+   va_list args;
+   va_start(args, format);
+   int n = vsnprintf(s->text, LOG_LINE_MAX, format, args);
+   va_end(args);
+   commit(ring, s, channel, n);
+   return true;
+}
+
+bool asyncLogChannelOpen(LogChannel channel)
+{
+   return !gLogShutdown.load(std::memory_order_acquire) && writer().isOpen(channel);
+}
+
+void asyncLogFlush()
+{
+   if (!gLogShutdown.load(std::memory_order_acquire))
+      writer().flush();
+}
+
+unsigned long long asyncLogDropped()
+{
+   return gLogShutdown.load(std::memory_order_acquire) ? 0 : writer().dropped();
+}
@@ -0,0 +1,48 @@
+//=============================================================================
+// AsyncLog.h
+//
+// The logging behind PrintUtils.  A logging call formats its message
+// straight into a slot of the calling thread's ring (single producer, the
+// writer thread the single consumer) and returns; one background thread
+// drains every ring and writes the lines to error.txt, log.txt and
+// output.txt in batches, flushing once per batch instead of once per line.
+//
+// Logging never blocks and never allocates after a thread's first message.
+// When a thread's ring is full the message is dropped and counted, and the
+// writer notes the count in log.txt.  Lines from one thread stay in order;
+// lines from different threads are interleaved as the writer finds them.
+//=============================================================================
+
+#ifndef ASYNC_LOG_H
+#define ASYNC_LOG_H
+
+enum LogChannel
+{
+   LOG_CHANNEL_ERROR,    // error.txt, appended
+   LOG_CHANNEL_LOG,      // log.txt, appended
+   LOG_CHANNEL_OUTPUT,   // output.txt, truncated at startup
+   LOG_CHANNEL_COUNT
+};
+
+// Bytes of text per message, terminator included; longer ones are cut.
+const int LOG_LINE_MAX    = 248;
+// Messages each thread can have waiting for the writer.
+const int LOG_RING_SLOTS  = 1024;
+// Threads that can log.
+const int LOG_MAX_THREADS = 64;
+
+// Queue one line (the writer adds the newline).  false if it was dropped.
+bool asyncLog(LogChannel channel, const char* text);
+bool asyncLogf(LogChannel channel, const char* format, ...);
+
+// Whether the channel's file could be opened.  The first logging call of
+// the process starts the writer; calling this does too.
+bool asyncLogChannelOpen(LogChannel channel);
+
+// Blocks until every line queued before the call is written and flushed.
+void asyncLogFlush();
+
+// Messages dropped because a ring was full or a file could not be opened.
+unsigned long long asyncLogDropped();
+
+#endif // ASYNC_LOG_H
@@ -0,0 +1,74 @@
+//=============================================================================
+// AtlasPack.cpp
+//
+// Packs sprite .bmp files into one atlas offline, writing <out>.bmp and the
+// <out>.atlas index that TextureAtlas::load() reads.  D3DRenderer loads
+// "sprites" when it is present and packs the sprites itself when it is not.
+// Builds on any platform:
+//
+//    g++ -O2 -std=c++11 AtlasPack.cpp TextureAtlas.cpp BmpImage.cpp -o AtlasPack
+//
+// usage: AtlasPack [-o out] [-max size] image.bmp ...
+//        AtlasPack -o sprites ball.bmp pad.bmp pad_0.bmp
+//=============================================================================
+
+#include "TextureAtlas.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int main(int argc, char* argv[])
+{
+   const char* out     = "sprites";
+   int         maxSize = 2048;
+
+   TextureAtlas atlas;
+   int images = 0;
+   for (int i = 1; i < argc; i++)
+   {
+      if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+         out = argv[++i];
+      else if (strcmp(argv[i], "-max") == 0 && i + 1 < argc)
+         maxSize = atoi(argv[++i]);
+      else if (argv[i][0] == '-')
+      {
+         fprintf(stderr, "unknown option %s\n", argv[i]);
+         return 1;
+      }
+      else if (!atlas.addFile(argv[i]))
+      {
+         fprintf(stderr, "cannot add %s: unreadable, or its name is taken\n", argv[i]);
+         return 1;
+      }
+      else
+         images++;
+   }
+   if (images == 0)
+   {
+      fprintf(stderr, "usage: AtlasPack [-o out] [-max size] image.bmp ...\n");
+      return 1;
+   }
+
+   if (!atlas.pack(maxSize))
+   {
+      fprintf(stderr, "the images do not fit in %dx%d\n", maxSize, maxSize);
+      return 1;
+   }
+   if (!atlas.save(out))
+   {
+      fprintf(stderr, "cannot write %s.bmp / %s.atlas\n", out, out);
+      return 1;
+   }
+
+   int used = 0;
+   for (int i = 0; i < atlas.regionCount(); i++)
+   {
+      const AtlasRegion& r = atlas.region(i);
+      used += r.width * r.height;
+      printf("%-16s %4d %4d %4dx%-4d uv (%.4f, %.4f) - (%.4f, %.4f)\n",
+             r.name, r.x, r.y, r.width, r.height, r.u0, r.v0, r.u1, r.v1);
+   }
+   printf("%s.bmp: %dx%d, %.0f%% used by images\n", out, atlas.width(), atlas.height(),
+          100.0 * used / (atlas.width() * atlas.height()));
+   return 0;
+}
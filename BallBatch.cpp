@@ -0,0 +1,405 @@
+//=============================================================================
+// BallBatch.cpp
+//=============================================================================
+
+#include "BallBatch.h"
+#include <math.h>
+#include <stdlib.h>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define BALL_BATCH_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define BATCH_TARGET_AVX2
+#else
+#define BATCH_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+// Balls are padded to this many lanes so every kernel runs whole vectors.
+static const int BATCH_LANES   = 8;
+static const int BATCH_ALIGN   = 32;
+
+static const float WALL_NUDGE  = 10.0f;  // the nudges the game used before swept collision
+static const float PAD_NUDGE   = 20.0f;
+static const float RETIRED     = -1.0f;
+
+// Everything a kernel needs besides the arrays, flattened once per step.
+struct BatchParams
+{
+   float top, bottom, left, right;
+   float p1Left, p1Top, p1Right, p1Bottom;
+   float p2Left, p2Top, p2Right, p2Bottom;
+   float dt;
+};
+
+static float* allocLanes(int n)
+{
+#if defined(_MSC_VER)
+   return (float*)_aligned_malloc(n * sizeof(float), BATCH_ALIGN);
+#else
+   void* p = 0;
+   if (posix_memalign(&p, BATCH_ALIGN, n * sizeof(float)) != 0)
+      return 0;
+   return (float*)p;
+#endif
+}
+
+static void freeLanes(float* p)
+{
+#if defined(_MSC_VER)
+   _aligned_free(p);
+#else
+   free(p);
+#endif
+}
+
+BallBatch::BallBatch()
+: x(0), y(0), vx(0), vy(0), life(0), mSize(0), mCapacity(0)
+{
+}
+
+BallBatch::~BallBatch()
+{
+   release();
+}
+
+void BallBatch::release()
+{
+   freeLanes(x);
+   freeLanes(y);
+   freeLanes(vx);
+   freeLanes(vy);
+   freeLanes(life);
+   x = y = vx = vy = life = 0;
+   mSize = mCapacity = 0;
+}
+
+void BallBatch::resize(int n)
+{
+   release();
+
+   mSize     = n;
+   mCapacity = (n + BATCH_LANES - 1) / BATCH_LANES * BATCH_LANES;
+   x    = allocLanes(mCapacity);
+   y    = allocLanes(mCapacity);
+   vx   = allocLanes(mCapacity);
+   vy   = allocLanes(mCapacity);
+   life = allocLanes(mCapacity);
+
+   for (int i = 0; i < mCapacity; i++)
+   {
+      x[i] = y[i] = vx[i] = vy[i] = 0.0f;
+      life[i] = RETIRED;
+   }
+}
+
+void BallBatch::setBall(int i, const BallInfo& ball)
+{
+   x[i]    = ball.pos.x;
+   y[i]    = ball.pos.y;
+   vx[i]   = -sinf(ball.rotation) * ball.speed;
+   vy[i]   =  cosf(ball.rotation) * ball.speed;
+   life[i] = ball.life;
+}
+
+BallInfo BallBatch::getBall(int i) const
+{
+   BallInfo ball;
+   ball.pos.x    = x[i];
+   ball.pos.y    = y[i];
+   ball.speed    = sqrtf(vx[i] * vx[i] + vy[i] * vy[i]);
+   ball.rotation = atan2f(-vx[i], vy[i]);
+   if (ball.rotation < 0.0f)
+      ball.rotation += 2 * SIM_PI;
+   ball.life     = life[i];
+   return ball;
+}
+
+int BallBatch::countAlive() const
+{
+   int alive = 0;
+   for (int i = 0; i < mSize; i++)
+      if (life[i] >= 0.0f)
+         alive++;
+   return alive;
+}
+
+//===============================================================
+// Kernels.  All three must produce the same result; the SIMD ones
+// turn every branch of the scalar kernel into a lane mask.
+
+static void stepScalar(BallBatch& b, int n, const BatchParams& p)
+{
+   for (int i = 0; i < n; i++)
+   {
+      if (b.life[i] < 0.0f)
+         continue;
+
+      if (b.y[i] > p.top)
+      {
+         b.vy[i] = -b.vy[i];
+         b.y[i] -= WALL_NUDGE;
+      }
+      else if (b.y[i] < p.bottom)
+      {
+         b.vy[i] = -b.vy[i];
+         b.y[i] += WALL_NUDGE;
+      }
+
+      if (b.x[i] < p.left || b.x[i] > p.right)
+      {
+         b.life[i] = RETIRED;
+         b.vx[i] = b.vy[i] = 0.0f;
+         continue;
+      }
+
+      if (b.x[i] > p.p1Left && b.y[i] < p.p1Top && b.x[i] < p.p1Right && b.y[i] > p.p1Bottom)
+      {
+         b.vx[i] = -b.vx[i];
+         b.x[i] += PAD_NUDGE;
+      }
+      if (b.x[i] > p.p2Left && b.y[i] < p.p2Top && b.x[i] < p.p2Right && b.y[i] > p.p2Bottom)
+      {
+         b.vx[i] = -b.vx[i];
+         b.x[i] -= PAD_NUDGE;
+      }
+
+      b.x[i]    += b.vx[i] * p.dt;
+      b.y[i]    += b.vy[i] * p.dt;
+      b.life[i] += p.dt;
+   }
+}
+
+#if defined(BALL_BATCH_X86)
+
+static void stepSSE(BallBatch& b, int n, const BatchParams& p)
+{
+   const __m128 sign    = _mm_set1_ps(-0.0f);
+   const __m128 zero    = _mm_setzero_ps();
+   const __m128 retired = _mm_set1_ps(RETIRED);
+   const __m128 wallNudge = _mm_set1_ps(WALL_NUDGE);
+   const __m128 padNudge  = _mm_set1_ps(PAD_NUDGE);
+   const __m128 dt      = _mm_set1_ps(p.dt);
+   const __m128 top     = _mm_set1_ps(p.top),    bottom   = _mm_set1_ps(p.bottom);
+   const __m128 left    = _mm_set1_ps(p.left),   right    = _mm_set1_ps(p.right);
+   const __m128 p1Left  = _mm_set1_ps(p.p1Left), p1Top    = _mm_set1_ps(p.p1Top);
+   const __m128 p1Right = _mm_set1_ps(p.p1Right), p1Bottom = _mm_set1_ps(p.p1Bottom);
+   const __m128 p2Left  = _mm_set1_ps(p.p2Left), p2Top    = _mm_set1_ps(p.p2Top);
+   const __m128 p2Right = _mm_set1_ps(p.p2Right), p2Bottom = _mm_set1_ps(p.p2Bottom);
+
+   for (int i = 0; i < n; i += 4)
+   {
+      __m128 x    = _mm_load_ps(b.x + i);
+      __m128 y    = _mm_load_ps(b.y + i);
+      __m128 vx   = _mm_load_ps(b.vx + i);
+      __m128 vy   = _mm_load_ps(b.vy + i);
+      __m128 life = _mm_load_ps(b.life + i);
+
+      __m128 alive = _mm_cmpge_ps(life, zero);
+
+      // Walls: flip vy and nudge back into the field.
+      __m128 hitTop    = _mm_and_ps(alive, _mm_cmpgt_ps(y, top));
+      __m128 hitBottom = _mm_andnot_ps(hitTop, _mm_and_ps(alive, _mm_cmplt_ps(y, bottom)));
+      vy = _mm_xor_ps(vy, _mm_and_ps(_mm_or_ps(hitTop, hitBottom), sign));
+      y  = _mm_sub_ps(y, _mm_and_ps(hitTop, wallNudge));
+      y  = _mm_add_ps(y, _mm_and_ps(hitBottom, wallNudge));
+
+      // Goals: retire the ball and stop it.
+      __m128 goal = _mm_and_ps(alive, _mm_or_ps(_mm_cmplt_ps(x, left), _mm_cmpgt_ps(x, right)));
+      alive = _mm_andnot_ps(goal, alive);
+      life  = _mm_or_ps(_mm_andnot_ps(goal, life), _mm_and_ps(goal, retired));
+      vx    = _mm_and_ps(alive, vx);
+      vy    = _mm_and_ps(alive, vy);
+
+      // Pads: flip vx and nudge away from the pad.
+      __m128 hit1 = _mm_and_ps(_mm_and_ps(alive, _mm_cmpgt_ps(x, p1Left)),
+                    _mm_and_ps(_mm_and_ps(_mm_cmplt_ps(y, p1Top), _mm_cmplt_ps(x, p1Right)),
+                               _mm_cmpgt_ps(y, p1Bottom)));
+      vx = _mm_xor_ps(vx, _mm_and_ps(hit1, sign));
+      x  = _mm_add_ps(x, _mm_and_ps(hit1, padNudge));
+
+      __m128 hit2 = _mm_and_ps(_mm_and_ps(alive, _mm_cmpgt_ps(x, p2Left)),
+                    _mm_and_ps(_mm_and_ps(_mm_cmplt_ps(y, p2Top), _mm_cmplt_ps(x, p2Right)),
+                               _mm_cmpgt_ps(y, p2Bottom)));
+      vx = _mm_xor_ps(vx, _mm_and_ps(hit2, sign));
+      x  = _mm_sub_ps(x, _mm_and_ps(hit2, padNudge));
+
+      // Move.  Retired balls have zero velocity, so only life needs a mask.
+      x    = _mm_add_ps(x, _mm_mul_ps(vx, dt));
+      y    = _mm_add_ps(y, _mm_mul_ps(vy, dt));
+      life = _mm_add_ps(life, _mm_and_ps(alive, dt));
+
+      _mm_store_ps(b.x + i, x);
+      _mm_store_ps(b.y + i, y);
+      _mm_store_ps(b.vx + i, vx);
+      _mm_store_ps(b.vy + i, vy);
+      _mm_store_ps(b.life + i, life);
+   }
+}
+
+BATCH_TARGET_AVX2
+static void stepAVX2(BallBatch& b, int n, const BatchParams& p)
+{
+   const __m256 sign    = _mm256_set1_ps(-0.0f);
+   const __m256 zero    = _mm256_setzero_ps();
+   const __m256 retired = _mm256_set1_ps(RETIRED);
+   const __m256 wallNudge = _mm256_set1_ps(WALL_NUDGE);
+   const __m256 padNudge  = _mm256_set1_ps(PAD_NUDGE);
+   const __m256 dt      = _mm256_set1_ps(p.dt);
+   const __m256 top     = _mm256_set1_ps(p.top),    bottom   = _mm256_set1_ps(p.bottom);
+   const __m256 left    = _mm256_set1_ps(p.left),   right    = _mm256_set1_ps(p.right);
+   const __m256 p1Left  = _mm256_set1_ps(p.p1Left), p1Top    = _mm256_set1_ps(p.p1Top);
+   const __m256 p1Right = _mm256_set1_ps(p.p1Right), p1Bottom = _mm256_set1_ps(p.p1Bottom);
+   const __m256 p2Left  = _mm256_set1_ps(p.p2Left), p2Top    = _mm256_set1_ps(p.p2Top);
+   const __m256 p2Right = _mm256_set1_ps(p.p2Right), p2Bottom = _mm256_set1_ps(p.p2Bottom);
+
+   for (int i = 0; i < n; i += 8)
+   {
+      __m256 x    = _mm256_load_ps(b.x + i);
+      __m256 y    = _mm256_load_ps(b.y + i);
+      __m256 vx   = _mm256_load_ps(b.vx + i);
+      __m256 vy   = _mm256_load_ps(b.vy + i);
+      __m256 life = _mm256_load_ps(b.life + i);
+
+      __m256 alive = _mm256_cmp_ps(life, zero, _CMP_GE_OQ);
+
+      // Walls: flip vy and nudge back into the field.
+      __m256 hitTop    = _mm256_and_ps(alive, _mm256_cmp_ps(y, top, _CMP_GT_OQ));
+      __m256 hitBottom = _mm256_andnot_ps(hitTop, _mm256_and_ps(alive, _mm256_cmp_ps(y, bottom, _CMP_LT_OQ)));
+      vy = _mm256_xor_ps(vy, _mm256_and_ps(_mm256_or_ps(hitTop, hitBottom), sign));
+      y  = _mm256_sub_ps(y, _mm256_and_ps(hitTop, wallNudge));
+      y  = _mm256_add_ps(y, _mm256_and_ps(hitBottom, wallNudge));
+
+      // Goals: retire the ball and stop it.
+      __m256 goal = _mm256_and_ps(alive, _mm256_or_ps(_mm256_cmp_ps(x, left, _CMP_LT_OQ),
+                                                      _mm256_cmp_ps(x, right, _CMP_GT_OQ)));
+      alive = _mm256_andnot_ps(goal, alive);
+      life  = _mm256_blendv_ps(life, retired, goal);
+      vx    = _mm256_and_ps(alive, vx);
+      vy    = _mm256_and_ps(alive, vy);
+
+      // Pads: flip vx and nudge away from the pad.
+      __m256 hit1 = _mm256_and_ps(_mm256_and_ps(alive, _mm256_cmp_ps(x, p1Left, _CMP_GT_OQ)),
+                    _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(y, p1Top, _CMP_LT_OQ),
+                                                _mm256_cmp_ps(x, p1Right, _CMP_LT_OQ)),
+                                  _mm256_cmp_ps(y, p1Bottom, _CMP_GT_OQ)));
+      vx = _mm256_xor_ps(vx, _mm256_and_ps(hit1, sign));
+      x  = _mm256_add_ps(x, _mm256_and_ps(hit1, padNudge));
+
+      __m256 hit2 = _mm256_and_ps(_mm256_and_ps(alive, _mm256_cmp_ps(x, p2Left, _CMP_GT_OQ)),
+                    _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(y, p2Top, _CMP_LT_OQ),
+                                                _mm256_cmp_ps(x, p2Right, _CMP_LT_OQ)),
+                                  _mm256_cmp_ps(y, p2Bottom, _CMP_GT_OQ)));
+      vx = _mm256_xor_ps(vx, _mm256_and_ps(hit2, sign));
+      x  = _mm256_sub_ps(x, _mm256_and_ps(hit2, padNudge));
+
+      // Move.  Retired balls have zero velocity, so only life needs a mask.
+      x    = _mm256_add_ps(x, _mm256_mul_ps(vx, dt));
+      y    = _mm256_add_ps(y, _mm256_mul_ps(vy, dt));
+      life = _mm256_add_ps(life, _mm256_and_ps(alive, dt));
+
+      _mm256_store_ps(b.x + i, x);
+      _mm256_store_ps(b.y + i, y);
+      _mm256_store_ps(b.vx + i, vx);
+      _mm256_store_ps(b.vy + i, vy);
+      _mm256_store_ps(b.life + i, life);
+   }
+}
+
+static bool cpuHasAVX2()
+{
+#if defined(_MSC_VER)
+   int info[4];
+   __cpuid(info, 0);
+   if (info[0] < 7)
+      return false;
+
+   // The OS must save the YMM registers (OSXSAVE + XCR0) as well.
+   __cpuid(info, 1);
+   bool osxsave = (info[2] & (1 << 27)) != 0;
+   bool avx     = (info[2] & (1 << 28)) != 0;
+   if (!osxsave || !avx || (_xgetbv(0) & 6) != 6)
+      return false;
+
+   __cpuidex(info, 7, 0);
+   return (info[1] & (1 << 5)) != 0;
+#else
+   __builtin_cpu_init();
+   return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+
+#endif // BALL_BATCH_X86
+
+bool BallBatch::isKernelSupported(BatchKernel kernel)
+{
+   switch (kernel)
+   {
+   case BATCH_KERNEL_SCALAR:
+      return true;
+#if defined(BALL_BATCH_X86)
+   case BATCH_KERNEL_SSE:
+      return true;
+   case BATCH_KERNEL_AVX2:
+   {
+      static const bool hasAVX2 = cpuHasAVX2();
+      return hasAVX2;
+   }
+#endif
+   default:
+      return false;
+   }
+}
+
+BatchKernel BallBatch::bestKernel()
+{
+   if (isKernelSupported(BATCH_KERNEL_AVX2)) return BATCH_KERNEL_AVX2;
+   if (isKernelSupported(BATCH_KERNEL_SSE))  return BATCH_KERNEL_SSE;
+   return BATCH_KERNEL_SCALAR;
+}
+
+const char* BallBatch::kernelName(BatchKernel kernel)
+{
+   switch (kernel)
+   {
+   case BATCH_KERNEL_SCALAR: return "scalar";
+   case BATCH_KERNEL_SSE:    return "sse";
+   case BATCH_KERNEL_AVX2:   return "avx2";
+   }
+   return "unknown";
+}
+
+void BallBatch::step(const PadInfo& pad1, const PadInfo& pad2, const SimRect& field, float dt)
+{
+   static const BatchKernel kernel = bestKernel();
+   stepWith(kernel, pad1, pad2, field, dt);
+}
+
+void BallBatch::stepWith(BatchKernel kernel, const PadInfo& pad1, const PadInfo& pad2,
+                         const SimRect& field, float dt)
+{
+   BatchParams p;
+   p.top      = field.top    - BALL_RADIUS;
+   p.bottom   = field.bottom + BALL_RADIUS;
+   p.left     = field.left;
+   p.right    = field.right;
+   p.p1Left   = pad1.bound1.x - BALL_RADIUS;  p.p1Top    = pad1.bound1.y + BALL_RADIUS;
+   p.p1Right  = pad1.bound2.x + BALL_RADIUS;  p.p1Bottom = pad1.bound2.y - BALL_RADIUS;
+   p.p2Left   = pad2.bound1.x - BALL_RADIUS;  p.p2Top    = pad2.bound1.y + BALL_RADIUS;
+   p.p2Right  = pad2.bound2.x + BALL_RADIUS;  p.p2Bottom = pad2.bound2.y - BALL_RADIUS;
+   p.dt       = dt;
+
+   if (!isKernelSupported(kernel))
+      kernel = BATCH_KERNEL_SCALAR;
+
+   switch (kernel)
+   {
+#if defined(BALL_BATCH_X86)
+   case BATCH_KERNEL_AVX2: stepAVX2(*this, mCapacity, p); break;
+   case BATCH_KERNEL_SSE:  stepSSE(*this, mCapacity, p);  break;
+#endif
+   default:                stepScalar(*this, mSize, p);   break;
+   }
+}
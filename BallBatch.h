@@ -0,0 +1,75 @@
+//=============================================================================
+// BallBatch.h
+//
+// Steps many independent balls at once.  The balls are stored as a structure
+// of arrays (x, y, vx, vy, life) so the SSE and AVX2 kernels can advance 4
+// or 8 of them per instruction.  Unlike pongUpdateBall(), collisions are
+// tested discretely on the ball centre after each step: walls (inset by
+// BALL_RADIUS) reflect vy with a 10 unit nudge, pads (grown by BALL_RADIUS)
+// reflect vx with a 20 unit nudge.  That is exact enough for balls at
+// BALL_SPEED and small steps, and keeps the kernels branch free.
+// A ball that leaves the field through a side is retired (life < 0) instead
+// of being served again, and stays frozen from then on.
+//
+// Direction is kept as a velocity vector, so sinf/cosf of the rotation are
+// only evaluated once in setBall() rather than every step.
+//=============================================================================
+
+#ifndef BALL_BATCH_H
+#define BALL_BATCH_H
+
+#include "PongSim.h"
+
+enum BatchKernel
+{
+   BATCH_KERNEL_SCALAR,
+   BATCH_KERNEL_SSE,
+   BATCH_KERNEL_AVX2
+};
+
+class BallBatch
+{
+public:
+   BallBatch();
+   ~BallBatch();
+
+   // Discards all balls and makes room for n retired ones.
+   void resize(int n);
+   int  size() const { return mSize; }
+
+   void     setBall(int i, const BallInfo& ball);
+   BallInfo getBall(int i) const;
+   bool     isAlive(int i) const { return life[i] >= 0.0f; }
+   int      countAlive() const;
+
+   // Advances every ball by dt against the two pads with the fastest
+   // kernel this CPU supports.
+   void step(const PadInfo& pad1, const PadInfo& pad2, const SimRect& field, float dt);
+   void stepWith(BatchKernel kernel, const PadInfo& pad1, const PadInfo& pad2,
+                 const SimRect& field, float dt);
+
+   static bool        isKernelSupported(BatchKernel kernel);
+   static BatchKernel bestKernel();
+   static const char* kernelName(BatchKernel kernel);
+
+public:
+   // Arrays are 32 byte aligned and padded to a multiple of 8 with
+   // retired balls, so the kernels never need a scalar tail loop.
+   float* x;
+   float* y;
+   float* vx;
+   float* vy;
+   float* life;  // seconds in play, negative once the ball is retired
+
+private:
+   // Prevent copying
+   BallBatch(const BallBatch& rhs);
+   BallBatch& operator=(const BallBatch& rhs);
+
+   void release();
+
+   int mSize;
+   int mCapacity;
+};
+
+#endif // BALL_BATCH_H
@@ -0,0 +1,493 @@
+//=============================================================================
+// BmpImage.cpp
+//=============================================================================
+
+#include "BmpImage.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define BMP_IMAGE_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define PIXEL_TARGET_SSSE3
+#define PIXEL_TARGET_AVX2
+#else
+#define PIXEL_TARGET_SSSE3 __attribute__((target("ssse3")))
+#define PIXEL_TARGET_AVX2  __attribute__((target("avx2")))
+#endif
+#endif
+
+static const int TEXEL_ALIGN = 16;  // bytes, one SSE register
+
+// Cache file layout: this header, then width * height texels.  It is only
+// ever read back on the machine that wrote it, so it is stored in native
+// byte order.  64 bytes keeps the texels 16 byte aligned in the mapping.
+struct TexCacheHeader
+{
+   char               magic[4];   // "PTEX"
+   unsigned int       version;
+   int                width;
+   int                height;
+   unsigned long long srcSize;    // of the BMP it was converted from
+   long long          srcTime;
+   unsigned int       reserved[8];
+};
+
+static const unsigned int TEX_CACHE_VERSION = 1;
+
+//===============================================================
+// File mapping
+
+bool mapFile(const char* path, MappedFile& f)
+{
+   f.data = 0;
+   f.size = 0;
+#if defined(_WIN32)
+   f.file = f.mapping = 0;
+
+   HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING,
+                             FILE_ATTRIBUTE_NORMAL, 0);
+   if (file == INVALID_HANDLE_VALUE)
+      return false;
+   LARGE_INTEGER size;
+   if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+   {
+      CloseHandle(file);
+      return false;
+   }
+   HANDLE mapping = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+   void* data = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : 0;
+   if (!data)
+   {
+      if (mapping) CloseHandle(mapping);
+      CloseHandle(file);
+      return false;
+   }
+   f.file    = file;
+   f.mapping = mapping;
+   f.data    = (const unsigned char*)data;
+   f.size    = (size_t)size.QuadPart;
+#else
+   int fd = open(path, O_RDONLY);
+   if (fd < 0)
+      return false;
+   struct stat st;
+   if (fstat(fd, &st) != 0 || st.st_size == 0)
+   {
+      close(fd);
+      return false;
+   }
+   void* data = mmap(0, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+   close(fd);  // the mapping keeps the file
+   if (data == MAP_FAILED)
+      return false;
+   f.data = (const unsigned char*)data;
+   f.size = (size_t)st.st_size;
+#endif
+   return true;
+}
+
+void unmapFile(MappedFile& f)
+{
+   if (!f.data)
+      return;
+#if defined(_WIN32)
+   UnmapViewOfFile(f.data);
+   CloseHandle((HANDLE)f.mapping);
+   CloseHandle((HANDLE)f.file);
+   f.file = f.mapping = 0;
+#else
+   munmap((void*)f.data, f.size);
+#endif
+   f.data = 0;
+   f.size = 0;
+}
+
+static bool statFile(const char* path, unsigned long long& size, long long& time)
+{
+   struct stat st;
+   if (stat(path, &st) != 0)
+      return false;
+   size = (unsigned long long)st.st_size;
+   time = (long long)st.st_mtime;
+   return true;
+}
+
+static unsigned int* allocTexels(int n)
+{
+#if defined(_MSC_VER)
+   return (unsigned int*)_aligned_malloc(n * sizeof(unsigned int), TEXEL_ALIGN);
+#else
+   void* p = 0;
+   if (posix_memalign(&p, TEXEL_ALIGN, n * sizeof(unsigned int)) != 0)
+      return 0;
+   return (unsigned int*)p;
+#endif
+}
+
+static void freeTexels(unsigned int* p)
+{
+#if defined(_MSC_VER)
+   _aligned_free(p);
+#else
+   free(p);
+#endif
+}
+
+//===============================================================
+// BGR -> BGRA kernels
+
+static void convertScalar(unsigned int* dst, const unsigned char* src, int n)
+{
+   for (int i = 0; i < n; i++, src += 3)
+      dst[i] = src[0] | (src[1] << 8) | (src[2] << 16) | 0xff000000;
+}
+
+#if defined(BMP_IMAGE_X86)
+
+// 16 pixels (48 bytes, three registers) per iteration.  Each output
+// register takes four 3-byte pixels, lined up with alignr, spread to four
+// bytes by the shuffle and given alpha by the or.
+PIXEL_TARGET_SSSE3
+static void convertSSSE3(unsigned int* dst, const unsigned char* src, int n)
+{
+   const __m128i spread = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+   const __m128i alpha  = _mm_set1_epi32((int)0xff000000);
+
+   int i = 0;
+   for (; i + 16 <= n; i += 16, src += 48)
+   {
+      __m128i a = _mm_loadu_si128((const __m128i*)src);
+      __m128i b = _mm_loadu_si128((const __m128i*)(src + 16));
+      __m128i c = _mm_loadu_si128((const __m128i*)(src + 32));
+
+      __m128i p0 = _mm_shuffle_epi8(a, spread);
+      __m128i p1 = _mm_shuffle_epi8(_mm_alignr_epi8(b, a, 12), spread);
+      __m128i p2 = _mm_shuffle_epi8(_mm_alignr_epi8(c, b, 8), spread);
+      __m128i p3 = _mm_shuffle_epi8(_mm_srli_si128(c, 4), spread);
+
+      _mm_storeu_si128((__m128i*)(dst + i),      _mm_or_si128(p0, alpha));
+      _mm_storeu_si128((__m128i*)(dst + i + 4),  _mm_or_si128(p1, alpha));
+      _mm_storeu_si128((__m128i*)(dst + i + 8),  _mm_or_si128(p2, alpha));
+      _mm_storeu_si128((__m128i*)(dst + i + 12), _mm_or_si128(p3, alpha));
+   }
+   convertScalar(dst + i, src, n - i);
+}
+
+// 16 pixels per iteration, 8 per register.  A 32 byte load holds 24 bytes
+// of pixels; the permute moves pixels 4-7 into the high lane, then the
+// same in-lane shuffle as SSSE3 spreads both halves.  The second load
+// reads 8 bytes past the pixels, so the loop stops while at least 19
+// pixels remain.
+PIXEL_TARGET_AVX2
+static void convertAVX2(unsigned int* dst, const unsigned char* src, int n)
+{
+   const __m256i lanes  = _mm256_setr_epi32(0, 1, 2, 3, 3, 4, 5, 6);
+   const __m256i spread = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+                                           0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+   const __m256i alpha  = _mm256_set1_epi32((int)0xff000000);
+
+   int i = 0;
+   for (; i + 19 <= n; i += 16, src += 48)
+   {
+      __m256i v0 = _mm256_loadu_si256((const __m256i*)src);
+      __m256i v1 = _mm256_loadu_si256((const __m256i*)(src + 24));
+      v0 = _mm256_shuffle_epi8(_mm256_permutevar8x32_epi32(v0, lanes), spread);
+      v1 = _mm256_shuffle_epi8(_mm256_permutevar8x32_epi32(v1, lanes), spread);
+      _mm256_storeu_si256((__m256i*)(dst + i),     _mm256_or_si256(v0, alpha));
+      _mm256_storeu_si256((__m256i*)(dst + i + 8), _mm256_or_si256(v1, alpha));
+   }
+   convertScalar(dst + i, src, n - i);
+}
+
+#if defined(_MSC_VER)
+static bool cpuHas(int leaf, int reg, int bit)
+{
+   int info[4];
+   __cpuid(info, 0);
+   if (info[0] < leaf)
+      return false;
+   __cpuidex(info, leaf, 0);
+   return (info[reg] & (1 << bit)) != 0;
+}
+#endif
+
+static bool cpuHasSSSE3()
+{
+#if defined(_MSC_VER)
+   return cpuHas(1, 2, 9);
+#else
+   __builtin_cpu_init();
+   return __builtin_cpu_supports("ssse3") != 0;
+#endif
+}
+
+static bool cpuHasAVX2()
+{
+#if defined(_MSC_VER)
+   // The OS must save the YMM registers (OSXSAVE + XCR0) as well.
+   if (!cpuHas(1, 2, 27) || !cpuHas(1, 2, 28) || (_xgetbv(0) & 6) != 6)
+      return false;
+   return cpuHas(7, 1, 5);
+#else
+   __builtin_cpu_init();
+   return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+
+#endif // BMP_IMAGE_X86
+
+bool BmpImage::isKernelSupported(PixelKernel kernel)
+{
+   switch (kernel)
+   {
+   case PIXEL_KERNEL_SCALAR:
+      return true;
+#if defined(BMP_IMAGE_X86)
+   case PIXEL_KERNEL_SSSE3:
+   {
+      static const bool hasSSSE3 = cpuHasSSSE3();
+      return hasSSSE3;
+   }
+   case PIXEL_KERNEL_AVX2:
+   {
+      static const bool hasAVX2 = cpuHasAVX2();
+      return hasAVX2;
+   }
+#endif
+   default:
+      return false;
+   }
+}
+
+PixelKernel BmpImage::bestKernel()
+{
+   if (isKernelSupported(PIXEL_KERNEL_AVX2))  return PIXEL_KERNEL_AVX2;
+   if (isKernelSupported(PIXEL_KERNEL_SSSE3)) return PIXEL_KERNEL_SSSE3;
+   return PIXEL_KERNEL_SCALAR;
+}
+
+const char* BmpImage::kernelName(PixelKernel kernel)
+{
+   switch (kernel)
+   {
+   case PIXEL_KERNEL_SCALAR: return "scalar";
+   case PIXEL_KERNEL_SSSE3:  return "ssse3";
+   case PIXEL_KERNEL_AVX2:   return "avx2";
+   }
+   return "unknown";
+}
+
+void BmpImage::convertBgr(PixelKernel kernel, unsigned int* dst, const unsigned char* src, int n)
+{
+   if (!isKernelSupported(kernel))
+      kernel = PIXEL_KERNEL_SCALAR;
+
+   switch (kernel)
+   {
+#if defined(BMP_IMAGE_X86)
+   case PIXEL_KERNEL_AVX2:  convertAVX2(dst, src, n);   break;
+   case PIXEL_KERNEL_SSSE3: convertSSSE3(dst, src, n);  break;
+#endif
+   default:                 convertScalar(dst, src, n); break;
+   }
+}
+
+//===============================================================
+// Loading
+
+static unsigned int readU32(const unsigned char* p) { return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24); }
+static unsigned int readU16(const unsigned char* p) { return p[0] | (p[1] << 8); }
+static void writeU32(unsigned char* p, unsigned int v) { p[0] = (unsigned char)v; p[1] = (unsigned char)(v >> 8); p[2] = (unsigned char)(v >> 16); p[3] = (unsigned char)(v >> 24); }
+static void writeU16(unsigned char* p, unsigned int v) { p[0] = (unsigned char)v; p[1] = (unsigned char)(v >> 8); }
+
+bool writeBmp(const char* path, const unsigned int* texels, int width, int height, int pitch)
+{
+   FILE* f = fopen(path, "wb");
+   if (!f)
+      return false;
+
+   unsigned char header[54];
+   memset(header, 0, sizeof(header));
+   unsigned int imageSize = width * height * 4;
+   header[0] = 'B'; header[1] = 'M';
+   writeU32(header + 2,  54 + imageSize);
+   writeU32(header + 10, 54);
+   writeU32(header + 14, 40);
+   writeU32(header + 18, width);
+   writeU32(header + 22, height);
+   writeU16(header + 26, 1);
+   writeU16(header + 28, 32);
+   writeU32(header + 34, imageSize);
+
+   bool ok = fwrite(header, 1, sizeof(header), f) == sizeof(header);
+   for (int y = height - 1; ok && y >= 0; y--)
+      ok = fwrite(texels + (size_t)y * pitch, 4, width, f) == (size_t)width;
+   ok = fclose(f) == 0 && ok;
+   return ok;
+}
+
+BmpImage::BmpImage()
+: mWidth(0), mHeight(0), mTexels(0), mOwned(0), mFromCache(false)
+{
+   mCache.data = 0;
+   mCache.size = 0;
+}
+
+BmpImage::~BmpImage()
+{
+   release();
+}
+
+void BmpImage::release()
+{
+   freeTexels(mOwned);
+   unmapFile(mCache);
+   mOwned     = 0;
+   mTexels    = 0;
+   mWidth     = mHeight = 0;
+   mFromCache = false;
+}
+
+bool BmpImage::load(const char* path, bool useCache)
+{
+   release();
+
+   unsigned long long srcSize = 0;
+   long long srcTime = 0;
+   if (!statFile(path, srcSize, srcTime))
+      return false;
+
+   char cachePath[1024];
+   useCache = useCache && strlen(path) + 5 < sizeof(cachePath);
+   if (useCache)
+   {
+      sprintf(cachePath, "%s.tex", path);
+      if (loadCache(cachePath, srcSize, srcTime))
+         return true;
+   }
+
+   if (!loadBmp(path))
+      return false;
+   if (useCache)
+      writeCache(cachePath, srcSize, srcTime);
+   return true;
+}
+
+bool BmpImage::loadCache(const char* cachePath, unsigned long long srcSize, long long srcTime)
+{
+   if (!mapFile(cachePath, mCache))
+      return false;
+
+   const TexCacheHeader* h = (const TexCacheHeader*)mCache.data;
+   bool ok = mCache.size >= sizeof(TexCacheHeader) &&
+             memcmp(h->magic, "PTEX", 4) == 0 && h->version == TEX_CACHE_VERSION &&
+             h->srcSize == srcSize && h->srcTime == srcTime &&
+             h->width > 0 && h->height > 0 && h->width <= BMP_MAX_SIDE && h->height <= BMP_MAX_SIDE &&
+             mCache.size == sizeof(TexCacheHeader) + (size_t)h->width * h->height * 4;
+   if (!ok)
+   {
+      unmapFile(mCache);
+      return false;
+   }
+
+   mWidth     = h->width;
+   mHeight    = h->height;
+   mTexels    = (const unsigned int*)(mCache.data + sizeof(TexCacheHeader));
+   mFromCache = true;
+   return true;
+}
+
+// Reads an uncompressed 24 or 32-bit BMP straight out of its mapping.
+// 24-bit images get alpha 255, 32-bit ones keep theirs.
+bool BmpImage::loadBmp(const char* path)
+{
+   MappedFile f;
+   if (!mapFile(path, f))
+      return false;
+
+   const unsigned char* file = f.data;
+   bool ok = f.size >= 54 && file[0] == 'B' && file[1] == 'M';
+   if (ok)
+   {
+      unsigned int offset = readU32(file + 10);
+      int  width       = (int)readU32(file + 18);
+      int  height      = (int)readU32(file + 22);
+      int  bpp         = readU16(file + 28);
+      bool bottomUp    = height > 0;
+      // Sizes come from the file: bound them before any multiplying.
+      ok = width > 0 && width <= BMP_MAX_SIDE && height != 0 &&
+           height >= -BMP_MAX_SIDE && height <= BMP_MAX_SIDE;
+      if (ok && height < 0) height = -height;
+      unsigned long long rowBytes = (((unsigned long long)width * bpp / 8) + 3) & ~3ull;
+
+      ok = ok && readU32(file + 30) == 0 && (bpp == 24 || bpp == 32) &&
+           (unsigned long long)offset + rowBytes * height <= f.size;
+      if (ok)
+      {
+         mOwned = allocTexels(width * height);
+         ok = mOwned != 0;
+      }
+      if (ok)
+      {
+         PixelKernel kernel = bestKernel();
+         for (int y = 0; y < height; y++)
+         {
+            const unsigned char* src = file + offset + (size_t)rowBytes * (bottomUp ? height - 1 - y : y);
+            unsigned int* dst = mOwned + (size_t)y * width;
+            if (bpp == 32)
+               memcpy(dst, src, width * 4);
+            else
+               convertBgr(kernel, dst, src, width);
+         }
+         mWidth  = width;
+         mHeight = height;
+         mTexels = mOwned;
+      }
+   }
+   unmapFile(f);
+   return ok;
+}
+
+// Written to a temporary name and renamed over the old cache, so a reader
+// never maps a half written file.
+void BmpImage::writeCache(const char* cachePath, unsigned long long srcSize, long long srcTime) const
+{
+   char tmpPath[1040];
+   sprintf(tmpPath, "%s.tmp", cachePath);
+   FILE* f = fopen(tmpPath, "wb");
+   if (!f)
+      return;
+
+   TexCacheHeader h;
+   memset(&h, 0, sizeof(h));
+   memcpy(h.magic, "PTEX", 4);
+   h.version = TEX_CACHE_VERSION;
+   h.width   = mWidth;
+   h.height  = mHeight;
+   h.srcSize = srcSize;
+   h.srcTime = srcTime;
+
+   size_t n = (size_t)mWidth * mHeight;
+   bool ok = fwrite(&h, sizeof(h), 1, f) == 1 && fwrite(mTexels, 4, n, f) == n;
+   ok = fclose(f) == 0 && ok;
+#if defined(_WIN32)
+   if (ok)
+      remove(cachePath);  // rename() does not replace on Windows
+#endif
+   if (!ok || rename(tmpPath, cachePath) != 0)
+      remove(tmpPath);
+}
@@ -0,0 +1,90 @@
+//=============================================================================
+// BmpImage.h
+//
+// Loads the game's .bmp textures as 32-bit texels, B G R A in memory
+// (0xAARRGGBB), top row first: what both renderers upload or sample.
+//
+// The BMP is memory mapped and parsed in place; each row goes straight from
+// the mapping through a BGR -> BGRA kernel (SSSE3 or AVX2 shuffles, or a
+// scalar fallback) into the texel buffer, with alpha 255 for 24-bit images
+// as D3DXCreateTextureFromFile gives.  The converted texels are then written
+// to a cache file beside the BMP (<name>.bmp.tex).  Later loads map the
+// cache and use the texels where they lie in the mapping, with no copy and
+// no conversion, as long as the BMP's size and modification time still
+// match the ones recorded in the cache.
+//=============================================================================
+
+#ifndef BMP_IMAGE_H
+#define BMP_IMAGE_H
+
+#include <stddef.h>
+
+enum PixelKernel
+{
+   PIXEL_KERNEL_SCALAR,
+   PIXEL_KERNEL_SSSE3,
+   PIXEL_KERNEL_AVX2
+};
+
+// A read-only view of a whole file.
+struct MappedFile
+{
+   const unsigned char* data;
+   size_t               size;
+#if defined(_WIN32)
+   void*                file;     // HANDLEs, kept as void* to keep
+   void*                mapping;  // windows.h out of this header
+#endif
+};
+
+bool mapFile(const char* path, MappedFile& f);
+void unmapFile(MappedFile& f);
+
+// Writes width x height texels, rows pitch texels apart, as a 32-bit BMP.
+bool writeBmp(const char* path, const unsigned int* texels, int width, int height, int pitch);
+
+const int BMP_MAX_SIDE = 16384;  // pixels; wider or taller images are refused
+
+class BmpImage
+{
+public:
+   BmpImage();
+   ~BmpImage();
+
+   // Loads an uncompressed 24 or 32-bit BMP.  With useCache the cache file
+   // is tried first, and written after a conversion; a cache that cannot be
+   // written (read-only directory, say) is skipped silently.
+   bool load(const char* path, bool useCache = true);
+   void release();
+
+   int                 width()     const { return mWidth; }
+   int                 height()    const { return mHeight; }
+   const unsigned int* texels()    const { return mTexels; }
+   bool                fromCache() const { return mFromCache; }
+
+   // Converts n 24-bit B G R pixels into 0xffRRGGBB texels.
+   static void convertBgr(PixelKernel kernel, unsigned int* dst, const unsigned char* src, int n);
+
+   static bool        isKernelSupported(PixelKernel kernel);
+   static PixelKernel bestKernel();
+   static const char* kernelName(PixelKernel kernel);
+
+private:
+   // Prevent copying
+   BmpImage(const BmpImage& rhs);
+   BmpImage& operator=(const BmpImage& rhs);
+
+   bool loadCache(const char* cachePath, unsigned long long srcSize, long long srcTime);
+   bool loadBmp(const char* path);
+   void writeCache(const char* cachePath, unsigned long long srcSize, long long srcTime) const;
+
+private:
+   int                 mWidth;
+   int                 mHeight;
+   const unsigned int* mTexels;    // into mOwned or mCache
+   unsigned int*       mOwned;
+   MappedFile          mCache;
+   bool                mFromCache;
+};
+
+#endif // BMP_IMAGE_H
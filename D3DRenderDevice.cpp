@@ -0,0 +1,25 @@
+//=============================================================================
+// D3DRenderDevice.cpp
+//=============================================================================
+
+#include "D3DRenderDevice.h"
+
+long D3DRenderDevice::setRenderState(unsigned int state, unsigned int value)
+{
+   return mDevice->SetRenderState((D3DRENDERSTATETYPE)state, value);
+}
+
+long D3DRenderDevice::setSamplerState(unsigned int sampler, unsigned int type, unsigned int value)
+{
+   return mDevice->SetSamplerState(sampler, (D3DSAMPLERSTATETYPE)type, value);
+}
+
+long D3DRenderDevice::setTextureStageState(unsigned int stage, unsigned int type, unsigned int value)
+{
+   return mDevice->SetTextureStageState(stage, (D3DTEXTURESTAGESTATETYPE)type, value);
+}
+
+long D3DRenderDevice::setTransform(unsigned int transform, const float* matrix)
+{
+   return mDevice->SetTransform((D3DTRANSFORMSTATETYPE)transform, (const D3DMATRIX*)matrix);
+}
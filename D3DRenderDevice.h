@@ -0,0 +1,32 @@
+//=============================================================================
+// D3DRenderDevice.h
+//
+// The RenderDevice a RenderStateCache forwards to in the game: each call
+// goes straight to the IDirect3DDevice9.
+//=============================================================================
+
+#ifndef D3D_RENDER_DEVICE_H
+#define D3D_RENDER_DEVICE_H
+
+#include "d3dUtil.h"
+#include "RenderStateCache.h"
+
+class D3DRenderDevice : public RenderDevice
+{
+public:
+   explicit D3DRenderDevice(IDirect3DDevice9* device) : mDevice(device) {}
+
+   long setRenderState(unsigned int state, unsigned int value);
+   long setSamplerState(unsigned int sampler, unsigned int type, unsigned int value);
+   long setTextureStageState(unsigned int stage, unsigned int type, unsigned int value);
+   long setTransform(unsigned int transform, const float* matrix);
+
+private:
+   // Prevent copying
+   D3DRenderDevice(const D3DRenderDevice& rhs);
+   D3DRenderDevice& operator=(const D3DRenderDevice& rhs);
+
+   IDirect3DDevice9* mDevice;
+};
+
+#endif // D3D_RENDER_DEVICE_H
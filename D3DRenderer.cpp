@@ -0,0 +1,294 @@
+//=============================================================================
+// D3DRenderer.cpp
+//=============================================================================
+
+#include "D3DRenderer.h"
+#include "BmpImage.h"
+#include "TextureAtlas.h"
+#include "FrameProfiler.h"
+#include "RenderStateCache.h"
+#include <stdio.h>
+#include <string.h>
+#include <tchar.h> // _T, _tcscpy
+
+D3DRenderer::D3DRenderer()
+{
+   // sprite:
+   HR(D3DXCreateSprite(gd3dDevice, &mSprite));
+   // font:
+   D3DXFONT_DESC fontDesc;
+   fontDesc.Height          = 18;
+   fontDesc.Width           = 0;
+   fontDesc.Weight          = 0;
+   fontDesc.MipLevels       = 1;
+   fontDesc.Italic          = false;
+   fontDesc.CharSet         = DEFAULT_CHARSET;
+   fontDesc.OutputPrecision = OUT_DEFAULT_PRECIS;
+   fontDesc.Quality         = DEFAULT_QUALITY;
+   fontDesc.PitchAndFamily  = DEFAULT_PITCH | FF_DONTCARE;
+#pragma warning(disable: 4996)
+   _tcscpy(fontDesc.FaceName, _T("Times New Roman"));
+#pragma warning(default: 4996)
+   HR(D3DXCreateFontIndirect(gd3dDevice, &fontDesc, &mFont));
+
+   // load textures:
+   mBkgdTex   = createTexture("bkgd1.bmp");
+   mSpriteTex = createSpriteAtlas();
+
+   // set background data:
+   mBkgdCenter = D3DXVECTOR3(256.0f, 256.0f, 0.0f);
+
+   // set ball and pad sprite data:
+   mBallCenter = D3DXVECTOR3(32.0f, 32.0f, 0.0f);
+   mPadCenter  = D3DXVECTOR3(64.0f, 64.0f, 0.0f);
+}
+
+D3DRenderer::~D3DRenderer()
+{
+   ReleaseCOM(mSprite);
+   ReleaseCOM(mFont);
+   ReleaseCOM(mBkgdTex);
+   ReleaseCOM(mSpriteTex);
+}
+
+// Same result as D3DXCreateTextureFromFile (a managed A8R8G8B8 texture
+// with a full mip chain), but the texels come from BmpImage, which maps
+// its converted cache instead of decoding the BMP on every launch.
+IDirect3DTexture9* D3DRenderer::createTexture(const char* path)
+{
+   BmpImage image;
+   if (!image.load(path))
+   {
+      // Let D3DX report the missing or unreadable file as it always has.
+      IDirect3DTexture9* tex = 0;
+      HR(D3DXCreateTextureFromFile(gd3dDevice, path, &tex));
+      return tex;
+   }
+
+   IDirect3DTexture9* tex = 0;
+   HR(D3DXCreateTexture(gd3dDevice, image.width(), image.height(), 0, 0,
+                        D3DFMT_A8R8G8B8, D3DPOOL_MANAGED, &tex));
+
+   D3DLOCKED_RECT lr;
+   HR(tex->LockRect(0, &lr, 0, 0));
+   for (int y = 0; y < image.height(); y++)
+      memcpy((char*)lr.pBits + y * lr.Pitch, image.texels() + y * image.width(), image.width() * 4);
+   HR(tex->UnlockRect(0));
+
+   HR(D3DXFilterTexture(tex, 0, 0, D3DX_DEFAULT));
+   return tex;
+}
+
+// The ball, pad and pad variants share one texture so they can be drawn in
+// a single sprite batch.  An atlas packed offline by AtlasPack ("sprites")
+// is used when present; otherwise the .bmp files are packed here.
+IDirect3DTexture9* D3DRenderer::createSpriteAtlas()
+{
+   TextureAtlas atlas;
+   if (!atlas.load("sprites"))
+   {
+      atlas.addFile("ball.bmp");
+      atlas.addFile("pad.bmp");
+      atlas.addFile("pad_0.bmp");
+      atlas.pack();
+   }
+
+   const AtlasRegion* ball = atlas.find("ball");
+   const AtlasRegion* pad  = atlas.find("pad");
+   if (!ball || !pad)
+   {
+      MessageBox(0, "Cannot load ball.bmp and pad.bmp", 0, 0);
+      PostQuitMessage(0);
+      SetRect(&mBallRect, 0, 0, 0, 0);
+      SetRect(&mPadRect, 0, 0, 0, 0);
+      return 0;
+   }
+   SetRect(&mBallRect, ball->x, ball->y, ball->x + ball->width, ball->y + ball->height);
+   SetRect(&mPadRect,  pad->x,  pad->y,  pad->x + pad->width,   pad->y + pad->height);
+
+   // Only as many mip levels as the gutters keep clean.
+   IDirect3DTexture9* tex = 0;
+   HR(D3DXCreateTexture(gd3dDevice, atlas.width(), atlas.height(), ATLAS_MIP_LEVELS, 0,
+                        D3DFMT_A8R8G8B8, D3DPOOL_MANAGED, &tex));
+
+   D3DLOCKED_RECT lr;
+   HR(tex->LockRect(0, &lr, 0, 0));
+   for (int y = 0; y < atlas.height(); y++)
+      memcpy((char*)lr.pBits + y * lr.Pitch, atlas.texels() + y * atlas.width(), atlas.width() * 4);
+   HR(tex->UnlockRect(0));
+
+   HR(D3DXFilterTexture(tex, 0, 0, D3DX_DEFAULT));
+   return tex;
+}
+
+void D3DRenderer::onLostDevice()
+{
+   HR(mSprite->OnLostDevice());
+   HR(mFont->OnLostDevice());
+}
+
+void D3DRenderer::onResetDevice()
+{
+   HR(mSprite->OnResetDevice());
+   HR(mFont->OnResetDevice());
+
+   // This code sets texture filters, which helps to smooth out distortions
+   // when you scale a texture.
+   HR(gd3dStates->setSamplerState(0, D3DSAMP_MAGFILTER, D3DTEXF_LINEAR));
+   HR(gd3dStates->setSamplerState(0, D3DSAMP_MINFILTER, D3DTEXF_LINEAR));
+   HR(gd3dStates->setSamplerState(0, D3DSAMP_MIPFILTER, D3DTEXF_LINEAR));
+
+   // This line of code disables Direct3D lighting.
+   HR(gd3dStates->setRenderState(D3DRS_LIGHTING, false));
+
+   // The following code specifies an alpha test and reference value.
+   HR(gd3dStates->setRenderState(D3DRS_ALPHAREF, 10));
+   HR(gd3dStates->setRenderState(D3DRS_ALPHAFUNC, D3DCMP_GREATER));
+
+   // The following code is used to setup alpha blending.
+   HR(gd3dStates->setTextureStageState(0, D3DTSS_ALPHAARG1, D3DTA_TEXTURE));
+   HR(gd3dStates->setTextureStageState(0, D3DTSS_ALPHAOP, D3DTOP_SELECTARG1));
+   HR(gd3dStates->setRenderState(D3DRS_SRCBLEND, D3DBLEND_SRCALPHA));
+   HR(gd3dStates->setRenderState(D3DRS_DESTBLEND, D3DBLEND_INVSRCALPHA));
+
+   // Sprites are mirrored upright by their world transform (see
+   // drawSprites()), which makes their triangles wind the other way.
+   HR(gd3dStates->setRenderState(D3DRS_CULLMODE, D3DCULL_NONE));
+
+   // Indicates that we are using 2D texture coordinates.
+   HR(gd3dStates->setTextureStageState(0, D3DTSS_TEXTURETRANSFORMFLAGS, D3DTTFF_COUNT2));
+}
+
+void D3DRenderer::setCameraZ(float z)
+{
+   // Camera on the Z axis looking at the origin.
+   D3DXMATRIX V;
+   D3DXVECTOR3 pos(0.0f, 0.0f, z); //-1000.0f
+   D3DXVECTOR3 up(0.0f, 1.0f, 0.0f);
+   D3DXVECTOR3 target(0.0f, 0.0f, 0.0f);
+   D3DXMatrixLookAtLH(&V, &pos, &target, &up);
+   HR(gd3dStates->setTransform(D3DTS_VIEW, V));
+}
+
+void D3DRenderer::drawScene(const PongState& s)
+{
+   HR(mSprite->Begin(D3DXSPRITE_OBJECTSPACE | D3DXSPRITE_DONOTMODIFY_RENDERSTATE));
+   recordBkgd();
+   recordSprites(s);
+   {
+      PROFILE_SCOPE("submitSprites");
+      mQueue.submit(*this);
+   }
+   drawScore(s);
+   HR(mSprite->End());
+}
+
+void D3DRenderer::recordBkgd()
+{
+   // The background sprite scaled 20x, its texture tiled ten times over
+   // the sprite surface.
+   RenderCommand c;
+   c.sprite    = SPRITE_BKGD;
+   c.x         = 0.0f;
+   c.y         = 0.0f;
+   c.rotation  = 0.0f;
+   c.scaleX    = 20.0f;
+   c.scaleY    = 20.0f;
+   c.texRepeat = 10.0f;
+   mQueue.add(RENDER_LAYER_BACKGROUND, RENDER_BLEND_OPAQUE, TEX_BKGD, c);
+}
+
+void D3DRenderer::recordSprites(const PongState& s)
+{
+   // One blend mode for both pads and the ball, so they share a batch: the
+   // alpha test keeps the pads' cut-out edges, blending gives the ball its
+   // soft ones.  Pad alpha is only ever 0 or 255, so blending leaves the
+   // pads as they were; the ball loses only the texels with alpha 10 or less.
+   //
+   // Images are stored top row first but the world is y up, so every
+   // sprite is mirrored in y.  Flipping the texture coordinates instead
+   // would flip the whole atlas, not each sprite within it.
+   RenderCommand c;
+   c.rotation  = 0.0f;
+   c.scaleX    = 1.0f;
+   c.scaleY    = -1.0f;
+   c.texRepeat = 1.0f;
+
+   c.sprite = SPRITE_PAD;
+   c.x      = s.pad1.pos.x;
+   c.y      = s.pad1.pos.y;
+   mQueue.add(RENDER_LAYER_SPRITES, RENDER_BLEND_ALPHA_TEST_ALPHA, TEX_SPRITES, c);
+
+   // Pad2 is the same image turned to face the field.
+   c.x        = s.pad2.pos.x;
+   c.y        = s.pad2.pos.y;
+   c.rotation = D3DX_PI;
+   mQueue.add(RENDER_LAYER_SPRITES, RENDER_BLEND_ALPHA_TEST_ALPHA, TEX_SPRITES, c);
+
+   c.sprite   = SPRITE_BALL;
+   c.x        = s.ball.pos.x;
+   c.y        = s.ball.pos.y;
+   c.rotation = 0.0f;
+   mQueue.add(RENDER_LAYER_SPRITES, RENDER_BLEND_ALPHA_TEST_ALPHA, TEX_SPRITES, c);
+}
+
+void D3DRenderer::setBlend(RenderBlend blend)
+{
+   bool test  = blend == RENDER_BLEND_ALPHA_TEST || blend == RENDER_BLEND_ALPHA_TEST_ALPHA;
+   bool alpha = blend == RENDER_BLEND_ALPHA      || blend == RENDER_BLEND_ALPHA_TEST_ALPHA;
+   HR(gd3dStates->setRenderState(D3DRS_ALPHATESTENABLE, test));
+   HR(gd3dStates->setRenderState(D3DRS_ALPHABLENDENABLE, alpha));
+}
+
+void D3DRenderer::setTexRepeat(float repeat)
+{
+   // A texture coordinate scaling transform tiles the texture repeat
+   // times in each dimension; 1 is back to untransformed coordinates.
+   D3DXMATRIX texScaling;
+   if (repeat == 1.0f)
+      D3DXMatrixIdentity(&texScaling);
+   else
+      D3DXMatrixScaling(&texScaling, repeat, repeat, 0.0f);
+   HR(gd3dStates->setTransform(D3DTS_TEXTURE0, texScaling));
+}
+
+void D3DRenderer::draw(int texture, const RenderCommand& c)
+{
+   (void)texture;  // each sprite knows its texture
+   D3DXMATRIX S, R, T;
+   D3DXMatrixScaling(&S, c.scaleX, c.scaleY, 1.0f);
+   D3DXMatrixRotationZ(&R, c.rotation);
+   D3DXMatrixTranslation(&T, c.x, c.y, 0.0f);
+   HR(mSprite->SetTransform(&(S*R*T)));
+
+   switch (c.sprite)
+   {
+   case SPRITE_BKGD:
+      HR(mSprite->Draw(mBkgdTex, 0, &mBkgdCenter, 0, D3DCOLOR_XRGB(255, 255, 255)));
+      break;
+   case SPRITE_BALL:
+      HR(mSprite->Draw(mSpriteTex, &mBallRect, &mBallCenter, 0, D3DCOLOR_XRGB(255, 255, 255)));
+      break;
+   case SPRITE_PAD:
+      HR(mSprite->Draw(mSpriteTex, &mPadRect, &mPadCenter, 0, D3DCOLOR_XRGB(255, 255, 255)));
+      break;
+   }
+}
+
+void D3DRenderer::flush()
+{
+   HR(mSprite->Flush());
+}
+
+void D3DRenderer::drawScore(const PongState& s)
+{
+   PROFILE_SCOPE("drawScore");
+   // Make static so memory is not allocated every frame.
+   static char buffer[256];
+#pragma warning(disable: 4996)
+   sprintf(buffer, "Player 1 score:  %d\n"
+                   "Player 2 score:  %d", s.player1Score, s.player2Score);
+#pragma warning(default: 4996)
+   RECT R = {5, 5, 0, 0};
+   HR(mFont->DrawText(0, buffer, -1, &R, DT_NOCLIP, D3DCOLOR_XRGB(0,0,0)));
+}
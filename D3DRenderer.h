@@ -0,0 +1,74 @@
+//=============================================================================
+// D3DRenderer.h
+//
+// The game's original ID3DXSprite drawing, moved out of PongDemo behind
+// PongRenderer.  The caller owns the frame (Clear, BeginScene, EndScene,
+// Present); drawScene() only issues the sprite and text draws.
+//
+// The sprites go through a RenderQueue: drawScene() records the background,
+// pads and ball as commands, and the queue sorts them and calls back into
+// the RenderBackend half of this class, which changes render states and
+// flushes the sprite only where the sorted commands need it.
+//=============================================================================
+
+#ifndef D3D_RENDERER_H
+#define D3D_RENDERER_H
+
+#include "d3dUtil.h"
+#include "PongRenderer.h"
+#include "RenderQueue.h"
+
+class D3DRenderer : public PongRenderer, private RenderBackend
+{
+public:
+   D3DRenderer();
+   ~D3DRenderer();
+
+   void onLostDevice();
+   void onResetDevice();
+
+   void drawScene(const PongState& s);
+   void setCameraZ(float z);
+
+   // What the last frame's sprites took, and what they would have taken
+   // drawn one at a time.
+   const RenderQueueStats& queueStats() const { return mQueue.stats(); }
+
+private:
+   // Prevent copying
+   D3DRenderer(const D3DRenderer& rhs);
+   D3DRenderer& operator=(const D3DRenderer& rhs);
+
+   IDirect3DTexture9* createTexture(const char* path);
+   IDirect3DTexture9* createSpriteAtlas();
+
+   void recordBkgd();
+   void recordSprites(const PongState& s);
+   void drawScore(const PongState& s);
+
+   // RenderBackend
+   void setBlend(RenderBlend blend);
+   void setTexRepeat(float repeat);
+   void draw(int texture, const RenderCommand& c);
+   void flush();
+
+   enum Texture { TEX_BKGD, TEX_SPRITES };
+   enum Sprite  { SPRITE_BKGD, SPRITE_BALL, SPRITE_PAD };
+
+private:
+   ID3DXSprite* mSprite; // http://msdn.microsoft.com/en-us/library/windows/desktop/bb174249%28v=vs.85%29.aspx
+   ID3DXFont*   mFont;
+
+   IDirect3DTexture9* mBkgdTex;
+   D3DXVECTOR3        mBkgdCenter;
+
+   IDirect3DTexture9* mSpriteTex;  // atlas of the ball and pads
+   RECT               mBallRect;
+   D3DXVECTOR3        mBallCenter;
+   RECT               mPadRect;
+   D3DXVECTOR3        mPadCenter;
+
+   RenderQueue        mQueue;
+};
+
+#endif // D3D_RENDERER_H
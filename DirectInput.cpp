@@ -8,6 +8,9 @@
 
 DirectInput* gDInput = 0;
 
+// Keyboard events DirectInput keeps between polls.
+static const DWORD KEYBOARD_BUFFER_SIZE = 64;
+
 DirectInput::DirectInput(DWORD keyboardCoopFlags, DWORD mouseCoopFlags)
 {
 	ZeroMemory(mKeyboardState, sizeof(mKeyboardState));
@@ -19,6 +22,14 @@ DirectInput::DirectInput(DWORD keyboardCoopFlags, DWORD mouseCoopFlags)
 	HR(mDInput->CreateDevice(GUID_SysKeyboard, &mKeyboard, 0));
 	HR(mKeyboard->SetDataFormat(&c_dfDIKeyboard));
 	HR(mKeyboard->SetCooperativeLevel(gd3dApp->getMainWnd(), keyboardCoopFlags));
+
+	DIPROPDWORD buffer;
+	buffer.diph.dwSize       = sizeof(DIPROPDWORD);
+	buffer.diph.dwHeaderSize = sizeof(DIPROPHEADER);
+	buffer.diph.dwObj        = 0;
+	buffer.diph.dwHow        = DIPH_DEVICE;
+	buffer.dwData            = KEYBOARD_BUFFER_SIZE;
+	HR(mKeyboard->SetProperty(DIPROP_BUFFERSIZE, &buffer.diph));
 	HR(mKeyboard->Acquire());
 
 	HR(mDInput->CreateDevice(GUID_SysMouse, &mMouse, 0));
@@ -38,6 +49,8 @@ DirectInput::~DirectInput()
 
 void DirectInput::poll()
 {
+	std::lock_guard<std::mutex> lock(mLock);
+
 	// Poll keyboard.
 	HRESULT hr = mKeyboard->GetDeviceState(sizeof(mKeyboardState), (void**)&mKeyboardState); 
 	if( FAILED(hr) )
@@ -84,4 +97,52 @@ float DirectInput::mouseDY()
 float DirectInput::mouseDZ()
 {
 	return (float)mMouseState.lZ;
-}
\ No newline at end of file
+}
+
+int DirectInput::keyboardEvents(DIDEVICEOBJECTDATA* data, int max)
+{
+	std::lock_guard<std::mutex> lock(mLock);
+	DWORD count = (DWORD)max;
+	HRESULT hr = mKeyboard->GetDeviceData(sizeof(DIDEVICEOBJECTDATA), data, &count, 0);
+	if( FAILED(hr) )
+	{
+		// Keyboard lost; what was buffered is gone with it.
+		mKeyboard->Acquire();
+		return 0;
+	}
+	// DI_BUFFEROVERFLOW still returns the events that were kept.
+	return (int)count;
+}
+
+DirectInputSource::DirectInputSource(DirectInput& input)
+: mInput(input)
+{
+	ZeroMemory(mBindings, sizeof(mBindings));
+}
+
+void DirectInputSource::bind(unsigned char key, unsigned int button)
+{
+	mBindings[key] = button;
+}
+
+void DirectInputSource::pump(InputQueue& queue, long long now)
+{
+	DIDEVICEOBJECTDATA data[KEYBOARD_BUFFER_SIZE];
+	int count = mInput.keyboardEvents(data, KEYBOARD_BUFFER_SIZE);
+	DWORD tickNow = GetTickCount();
+
+	for(int i = 0; i < count; ++i)
+	{
+		unsigned int button = mBindings[data[i].dwOfs & 0xff];
+		if( !button )
+			continue;
+
+		InputEvent e;
+		e.time   = now - (long long)(DWORD)(tickNow - data[i].dwTimeStamp) * 1000;
+		e.button = button;
+		e.down   = (data[i].dwData & 0x80) != 0;
+		if( e.time > now )
+			e.time = now;
+		queue.push(e);
+	}
+}
@@ -3,6 +3,11 @@
 //
 // Wraps initialization of immediate mode Direct Input, and provides 
 // information for querying the state of the keyboard and mouse.
+//
+// The keyboard is also buffered, so DirectInputSource can turn every key
+// press and release, with its time, into InputQueue events.  poll() and
+// keyboardEvents() may be called from different threads (the main thread
+// and a SimThread); the device calls are serialized.
 //=============================================================================
 
 #ifndef DIRECT_INPUT_H
@@ -10,6 +15,8 @@
 
 #define DIRECTINPUT_VERSION 0x0800
 #include <dinput.h>
+#include "InputQueue.h"
+#include <mutex>
 
 class DirectInput
 {
@@ -24,12 +31,17 @@ public:
 	float mouseDY();
 	float mouseDZ();
 
+	// Copies up to max buffered keyboard events, oldest first, and
+	// returns how many.  Events not read by the next call are kept.
+	int keyboardEvents(DIDEVICEOBJECTDATA* data, int max);
+
 private:
 	// Make private to prevent copying of members of this class.
 	DirectInput(const DirectInput& rhs);
 	DirectInput& operator=(const DirectInput& rhs);
 		
 private:
+	std::mutex           mLock;  // around the device calls
 	IDirectInput8*       mDInput;
 
 	IDirectInputDevice8* mKeyboard;
@@ -41,5 +53,22 @@ private:
 
 extern DirectInput* gDInput;
 
+// Key presses and releases from DirectInput's keyboard buffer, as events
+// for the keys bound to PongButtons.  DirectInput stamps events in
+// milliseconds of GetTickCount(); pump() moves them onto the caller's
+// clock by their age.
+class DirectInputSource : public InputSource
+{
+public:
+	DirectInputSource(DirectInput& input);
+
+	void bind(unsigned char key, unsigned int button);
+	void pump(InputQueue& queue, long long now);
+
+private:
+	DirectInput& mInput;
+	unsigned int mBindings[256];
+};
+
 
 #endif // DIRECT_INPUT_H
\ No newline at end of file
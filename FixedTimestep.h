@@ -0,0 +1,65 @@
+//=============================================================================
+// FixedTimestep.h
+//
+// Accumulator that turns variable frame times into a whole number of fixed
+// simulation ticks.  Time that the simulation could not catch up with within
+// maxTicksPerFrame is dropped, so one long hitch slows the game down for a
+// frame instead of sending it into a spiral of ever longer catch-up frames.
+//=============================================================================
+
+#ifndef FIXED_TIMESTEP_H
+#define FIXED_TIMESTEP_H
+
+class FixedTimestep
+{
+public:
+   FixedTimestep(float tickRate = 120.0f, int maxTicksPerFrame = 8)
+   : mAccumulator(0.0), mDroppedTicks(0)
+   {
+      setTickRate(tickRate, maxTicksPerFrame);
+   }
+
+   void setTickRate(float tickRate, int maxTicksPerFrame)
+   {
+      mTickRate         = tickRate;
+      mTickDt           = 1.0 / tickRate;
+      mMaxTicksPerFrame = maxTicksPerFrame;
+   }
+
+   // Adds one frame's worth of real time and returns how many ticks
+   // of tickDt() the caller should simulate now.
+   int advance(double frameDt)
+   {
+      mAccumulator += frameDt;
+      int ticks = (int)(mAccumulator / mTickDt);
+      if (ticks > mMaxTicksPerFrame)
+      {
+         mDroppedTicks += ticks - mMaxTicksPerFrame;
+         mAccumulator  -= mTickDt * (ticks - mMaxTicksPerFrame);
+         ticks = mMaxTicksPerFrame;
+      }
+      mAccumulator -= mTickDt * ticks;
+      return ticks;
+   }
+
+   // How far the real clock is into the next tick, in [0, 1).  Renderers
+   // blend the previous and current simulation state by this much.
+   float alpha() const
+   {
+      float a = (float)(mAccumulator / mTickDt);
+      return a < 0.0f ? 0.0f : a;
+   }
+
+   float        tickRate()     const { return mTickRate; }
+   float        tickDt()       const { return (float)mTickDt; }
+   unsigned int droppedTicks() const { return mDroppedTicks; }
+
+private:
+   float        mTickRate;
+   double       mTickDt;
+   int          mMaxTicksPerFrame;
+   double       mAccumulator;  // real seconds not yet simulated
+   unsigned int mDroppedTicks; // ticks given up to avoid spiralling
+};
+
+#endif // FIXED_TIMESTEP_H
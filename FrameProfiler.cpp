@@ -0,0 +1,247 @@
+//=============================================================================
+// FrameProfiler.cpp
+//=============================================================================
+
+#include "FrameProfiler.h"
+#include <atomic>
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+static_assert((PROFILE_RING_SIZE & (PROFILE_RING_SIZE - 1)) == 0, "PROFILE_RING_SIZE must be a power of two");
+
+// Slots are atomics so a reader racing the owner reads stale or new values,
+// never undefined ones; relaxed loads and stores of them are plain moves.
+struct ProfileSlot
+{
+   std::atomic<const char*> name;
+   std::atomic<long long>   begin;
+   std::atomic<long long>   end;
+   std::atomic<int>         depth;
+};
+
+struct ProfileRing
+{
+   std::atomic<unsigned long long> head;        // events ever recorded
+   std::atomic<const char*>        threadName;
+   ProfileSlot                     slots[PROFILE_RING_SIZE];
+};
+
+// Rings are never freed, so a thread's events can still be exported after
+// it exits.
+static std::atomic<ProfileRing*> gRings[PROFILE_MAX_THREADS];
+static std::atomic<int>          gRingCount(0);
+
+static thread_local ProfileRing* tRing      = 0;
+static thread_local bool         tRingFull  = false;  // no ring left for this thread
+static thread_local int          tDepth     = 0;
+
+static ProfileRing* threadRing()
+{
+   if (tRing || tRingFull)
+      return tRing;
+
+   int i = gRingCount.load(std::memory_order_relaxed);
+   do
+   {
+      if (i >= PROFILE_MAX_THREADS)
+      {
+         tRingFull = true;
+         return 0;
+      }
+   } while (!gRingCount.compare_exchange_weak(i, i + 1, std::memory_order_relaxed));
+
+   tRing = new ProfileRing();
+   gRings[i].store(tRing, std::memory_order_release);
+   return tRing;
+}
+
+long long profileNow()
+{
+   return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void profileSetThreadName(const char* name)
+{
+   ProfileRing* ring = threadRing();
+   if (ring)
+      ring->threadName.store(name, std::memory_order_release);
+}
+
+//===============================================================
+// Recording
+
+// The owner publishes head = n only after slot n - 1 is written, and the
+// release fence keeps the slot writes for event n after that publication
+// (as in a seqlock).  A reader that saw any part of event n therefore
+// sees head >= n when it rechecks.
+static void record(ProfileRing* ring, const char* name, long long begin, long long end, int depth)
+{
+   unsigned long long n = ring->head.load(std::memory_order_relaxed);
+   std::atomic_thread_fence(std::memory_order_release);
+
+   ProfileSlot& s = ring->slots[n & (PROFILE_RING_SIZE - 1)];
+   s.name.store(name, std::memory_order_relaxed);
+   s.begin.store(begin, std::memory_order_relaxed);
+   s.end.store(end, std::memory_order_relaxed);
+   s.depth.store(depth, std::memory_order_relaxed);
+
+   ring->head.store(n + 1, std::memory_order_release);
+}
+
+ProfileScope::ProfileScope(const char* name)
+: mName(name), mBegin(profileNow())
+{
+   tDepth++;
+}
+
+ProfileScope::~ProfileScope()
+{
+   long long end = profileNow();
+   tDepth--;
+   ProfileRing* ring = threadRing();
+   if (ring)
+      record(ring, mName, mBegin, end, tDepth);
+}
+
+//===============================================================
+// Reading
+
+int profileThreadCount()
+{
+   int n = gRingCount.load(std::memory_order_acquire);
+   return n < PROFILE_MAX_THREADS ? n : PROFILE_MAX_THREADS;
+}
+
+static const char* threadName(int thread)
+{
+   ProfileRing* ring = gRings[thread].load(std::memory_order_acquire);
+   return ring ? ring->threadName.load(std::memory_order_acquire) : 0;
+}
+
+int profileCollect(int thread, ProfileEvent* out, int max)
+{
+   if (thread < 0 || thread >= profileThreadCount() || max <= 0)
+      return 0;
+   ProfileRing* ring = gRings[thread].load(std::memory_order_acquire);
+   if (!ring)  // counted, but its owner has not stored it yet
+      return 0;
+
+   unsigned long long head  = ring->head.load(std::memory_order_acquire);
+   unsigned long long first = head > (unsigned long long)PROFILE_RING_SIZE ? head - PROFILE_RING_SIZE : 0;
+   if (head - first > (unsigned long long)max)
+      first = head - max;
+
+   int count = 0;
+   for (unsigned long long i = first; i < head; i++)
+   {
+      const ProfileSlot& s = ring->slots[i & (PROFILE_RING_SIZE - 1)];
+      ProfileEvent& e = out[count++];
+      e.name  = s.name.load(std::memory_order_relaxed);
+      e.begin = s.begin.load(std::memory_order_relaxed);
+      e.end   = s.end.load(std::memory_order_relaxed);
+      e.depth = s.depth.load(std::memory_order_relaxed);
+   }
+
+   // Events the owner may have overwritten while we copied are dropped.
+   std::atomic_thread_fence(std::memory_order_acquire);
+   unsigned long long now  = ring->head.load(std::memory_order_relaxed);
+   unsigned long long keep = now >= (unsigned long long)PROFILE_RING_SIZE ? now - PROFILE_RING_SIZE + 1 : 0;
+   if (keep > first)
+   {
+      int skip = keep - first < (unsigned long long)count ? (int)(keep - first) : count;
+      memmove(out, out + skip, (count - skip) * sizeof(ProfileEvent));
+      count -= skip;
+   }
+   return count;
+}
+
+int profileTotals(long long since, ProfileTotal* out, int max)
+{
+   std::vector<ProfileEvent> events(PROFILE_RING_SIZE);
+   int totals = 0;
+   for (int t = 0; t < profileThreadCount(); t++)
+   {
+      int n = profileCollect(t, &events[0], PROFILE_RING_SIZE);
+      for (int i = 0; i < n; i++)
+      {
+         const ProfileEvent& e = events[i];
+         if (e.end < since)
+            continue;
+
+         int k = 0;
+         while (k < totals && out[k].name != e.name)
+            k++;
+         if (k == totals)
+         {
+            if (totals == max)
+               continue;
+            out[k].name  = e.name;
+            out[k].depth = e.depth;
+            out[k].calls = 0;
+            out[k].ms    = 0.0;
+            totals++;
+         }
+         if (e.depth < out[k].depth)
+            out[k].depth = e.depth;
+         out[k].calls++;
+         out[k].ms += (e.end - e.begin) * 1e-6;
+      }
+   }
+   return totals;
+}
+
+//===============================================================
+// Chrome trace export
+//
+// {"traceEvents": [...]} with one complete ("X") event per scope and a
+// thread_name metadata ("M") event per named thread; times are in
+// microseconds from the earliest event.  Names are string literals from
+// PROFILE_SCOPE and are written without escaping.
+
+bool profileExportChromeTrace(const char* path)
+{
+   int threads = profileThreadCount();
+   std::vector< std::vector<ProfileEvent> > events(threads);
+   long long epoch = 0;
+   bool haveEpoch = false;
+   for (int t = 0; t < threads; t++)
+   {
+      events[t].resize(PROFILE_RING_SIZE);
+      events[t].resize(profileCollect(t, &events[t][0], PROFILE_RING_SIZE));
+      for (size_t i = 0; i < events[t].size(); i++)
+      {
+         if (!haveEpoch || events[t][i].begin < epoch)
+            epoch = events[t][i].begin;
+         haveEpoch = true;
+      }
+   }
+
+   FILE* f = fopen(path, "w");
+   if (!f)
+      return false;
+
+   fprintf(f, "{\"traceEvents\":[\n");
+   const char* sep = "";
+   for (int t = 0; t < threads; t++)
+   {
+      const char* name = threadName(t);
+      if (name)
+      {
+         fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                 sep, t + 1, name);
+         sep = ",\n";
+      }
+      for (size_t i = 0; i < events[t].size(); i++)
+      {
+         const ProfileEvent& e = events[t][i];
+         fprintf(f, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                 sep, e.name, t + 1, (e.begin - epoch) * 1e-3, (e.end - e.begin) * 1e-3);
+         sep = ",\n";
+      }
+   }
+   fprintf(f, "\n],\"displayTimeUnit\":\"ms\"}\n");
+   return fclose(f) == 0;
+}
@@ -0,0 +1,85 @@
+//=============================================================================
+// FrameProfiler.h
+//
+// Hierarchical scoped timers.  PROFILE_SCOPE("name") times the rest of the
+// enclosing block and, when it closes, records one event (name, begin, end,
+// nesting depth) into the calling thread's ring.  Each thread owns its ring
+// and is its only writer, so recording takes no lock and no allocation; a
+// full ring overwrites its oldest events, so it always holds the most
+// recent few seconds.  Any thread may read the rings at any time: a reader
+// copies the slots, then rechecks the write position and drops whatever the
+// owner may have overwritten while it copied.
+//
+// The events can be written out in the Chrome trace format (load the file
+// in chrome://tracing or ui.perfetto.dev) or summed per name, which is what
+// GfxStats shows.
+//
+// Timers only exist in builds that define PONG_PROFILE (the game does);
+// elsewhere PROFILE_SCOPE compiles to nothing, so the headless tools that
+// share PongSim pay nothing for it.
+//=============================================================================
+
+#ifndef FRAME_PROFILER_H
+#define FRAME_PROFILER_H
+
+// Events each thread keeps, and threads that can record.
+const int PROFILE_RING_SIZE   = 16384;
+const int PROFILE_MAX_THREADS = 64;
+
+struct ProfileEvent
+{
+   const char* name;   // a string literal: compared by pointer
+   long long   begin;  // nanoseconds, profileNow()
+   long long   end;
+   int         depth;  // 0 for outermost scopes
+};
+
+// Time spent in one scope name over an interval.
+struct ProfileTotal
+{
+   const char* name;
+   int         depth;  // the smallest depth it was seen at
+   int         calls;
+   double      ms;
+};
+
+long long profileNow();
+
+// Names the calling thread in exported traces.
+void profileSetThreadName(const char* name);
+
+// Copies thread t's events, oldest first, into out; returns how many.
+int profileThreadCount();
+int profileCollect(int thread, ProfileEvent* out, int max);
+
+// Sums every thread's events that ended at or after since into at most
+// max totals, in order of first appearance.  Returns the count.
+int profileTotals(long long since, ProfileTotal* out, int max);
+
+// Writes every thread's events as a Chrome trace (JSON object format).
+bool profileExportChromeTrace(const char* path);
+
+class ProfileScope
+{
+public:
+   explicit ProfileScope(const char* name);
+   ~ProfileScope();
+
+private:
+   // Prevent copying
+   ProfileScope(const ProfileScope& rhs);
+   ProfileScope& operator=(const ProfileScope& rhs);
+
+   const char* mName;
+   long long   mBegin;
+};
+
+#if defined(PONG_PROFILE)
+#define PROFILE_JOIN2(a, b) a##b
+#define PROFILE_JOIN(a, b)  PROFILE_JOIN2(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_JOIN(profileScope, __LINE__)(name)
+#else
+#define PROFILE_SCOPE(name) ((void)0)
+#endif
+
+#endif // FRAME_PROFILER_H
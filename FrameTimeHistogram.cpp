@@ -0,0 +1,146 @@
+//=============================================================================
+// FrameTimeHistogram.cpp
+//=============================================================================
+
+#include "FrameTimeHistogram.h"
+#include <string.h>
+
+static const unsigned int LINEAR_LIMIT = 64;          // exact below this
+static const int          SUB_BITS     = 5;           // 32 buckets per octave
+static const unsigned int MAX_US       = (1u << 30) - 1;
+static const unsigned int SLICE_US     = 1000000;
+
+int FrameTimeHistogram::bucketOf(unsigned int us)
+{
+   if (us < LINEAR_LIMIT)
+      return (int)us;
+   if (us > MAX_US)
+      us = MAX_US;
+
+   int octave = 6;  // us >= 2^6
+   while (us >> (octave + 1))
+      octave++;
+   int sub = (int)(us >> (octave - SUB_BITS)) & ((1 << SUB_BITS) - 1);
+   return LINEAR_LIMIT + ((octave - 6) << SUB_BITS) + sub;
+}
+
+unsigned int FrameTimeHistogram::bucketLow(int bucket)
+{
+   if (bucket < (int)LINEAR_LIMIT)
+      return (unsigned int)bucket;
+   int octave = 6 + ((bucket - LINEAR_LIMIT) >> SUB_BITS);
+   int sub    = (bucket - LINEAR_LIMIT) & ((1 << SUB_BITS) - 1);
+   return (unsigned int)((1 << SUB_BITS) + sub) << (octave - SUB_BITS);
+}
+
+unsigned int FrameTimeHistogram::bucketHigh(int bucket)
+{
+   if (bucket < (int)LINEAR_LIMIT)
+      return (unsigned int)bucket;
+   int octave = 6 + ((bucket - LINEAR_LIMIT) >> SUB_BITS);
+   return bucketLow(bucket) + (1u << (octave - SUB_BITS)) - 1;
+}
+
+FrameTimeHistogram::FrameTimeHistogram(float budgetMs)
+{
+   setBudget(budgetMs);
+   reset();
+}
+
+void FrameTimeHistogram::clearSlice(Slice& s)
+{
+   memset(&s, 0, sizeof(s));
+}
+
+void FrameTimeHistogram::reset()
+{
+   for (int i = 0; i <= MAX_WINDOW_SECONDS; i++)
+      clearSlice(mSlices[i]);
+   mCurrent       = 0;
+   mFilled        = 0;
+   mSliceUs       = 0;
+   mTotalFrames   = 0;
+   mTotalStutters = 0;
+}
+
+void FrameTimeHistogram::record(float dt)
+{
+   float f = dt * 1e6f + 0.5f;
+   unsigned int us = f <= 0.0f ? 0 : f >= (float)MAX_US ? MAX_US : (unsigned int)f;
+
+   Slice& s = mSlices[mCurrent];
+   s.counts[bucketOf(us)]++;
+   s.frames++;
+   s.totalUs += us;
+   if (us > s.max)
+      s.max = us;
+   mTotalFrames++;
+   if (us > mBudgetUs)
+   {
+      s.stutters++;
+      mTotalStutters++;
+   }
+
+   // A slice closes once it holds a second of frames.
+   mSliceUs += us;
+   if (mSliceUs >= SLICE_US)
+   {
+      mCurrent = (mCurrent + 1) % (MAX_WINDOW_SECONDS + 1);
+      clearSlice(mSlices[mCurrent]);
+      if (mFilled < MAX_WINDOW_SECONDS)
+         mFilled++;
+      mSliceUs = 0;
+   }
+}
+
+FrameTimeStats FrameTimeHistogram::window(int seconds) const
+{
+   if (seconds < 1) seconds = 1;
+   if (seconds > mFilled) seconds = mFilled;
+
+   // Merged on the stack; nothing is allocated.
+   unsigned int counts[FRAME_TIME_BUCKETS];
+   memset(counts, 0, sizeof(counts));
+   unsigned long long frames = 0, totalUs = 0;
+   unsigned int maxUs = 0, stutters = 0;
+   for (int i = 0; i <= seconds; i++)
+   {
+      const Slice& s = mSlices[(mCurrent - i + MAX_WINDOW_SECONDS + 1) % (MAX_WINDOW_SECONDS + 1)];
+      if (s.frames == 0)
+         continue;
+      for (int b = 0; b < FRAME_TIME_BUCKETS; b++)
+         counts[b] += s.counts[b];
+      frames   += s.frames;
+      totalUs  += s.totalUs;
+      stutters += s.stutters;
+      if (s.max > maxUs)
+         maxUs = s.max;
+   }
+
+   FrameTimeStats st;
+   memset(&st, 0, sizeof(st));
+   st.frames   = (int)frames;
+   st.stutters = (int)stutters;
+   st.seconds  = totalUs * 1e-6f;
+   st.max      = maxUs * 1e-3f;
+   if (frames == 0)
+      return st;
+   st.mean = (float)(totalUs / (double)frames) * 1e-3f;
+
+   // Each percentile is the top of the bucket holding that rank (never
+   // above the true max), so it errs slow, never fast.
+   const double ranks[4] = { 0.50, 0.90, 0.99, 0.999 };
+   float* out[4] = { &st.p50, &st.p90, &st.p99, &st.p999 };
+   unsigned long long seen = 0;
+   int b = 0;
+   for (int p = 0; p < 4; p++)
+   {
+      unsigned long long rank = (unsigned long long)(ranks[p] * frames + 0.999999);
+      if (rank < 1) rank = 1;
+      while (b < FRAME_TIME_BUCKETS && seen + counts[b] < rank)
+         seen += counts[b++];
+      unsigned int us = b < FRAME_TIME_BUCKETS ? bucketHigh(b) : maxUs;
+      *out[p] = (us < maxUs ? us : maxUs) * 1e-3f;
+   }
+   return st;
+}
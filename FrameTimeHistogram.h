@@ -0,0 +1,81 @@
+//=============================================================================
+// FrameTimeHistogram.h
+//
+// Frame times as an HDR-style histogram rather than a once-a-second FPS
+// average, so single slow frames stay visible.  Times are counted in
+// microseconds into log-linear buckets: exact below 64 us, then 32 buckets
+// per power of two, so any reported value is within about 3% of the real
+// one, from 1 us up to about 18 minutes, in 832 counters.
+//
+// Frames are kept in one-second slices (by the recorded frame times, not
+// a clock) for the last MAX_WINDOW_SECONDS; a window merges the most
+// recent slices and reports p50, p90, p99, p99.9 and the exact max.  A
+// frame longer than the budget counts as a stutter.  All storage is fixed
+// size: record() never allocates and does no more than a few shifts and
+// adds.
+//=============================================================================
+
+#ifndef FRAME_TIME_HISTOGRAM_H
+#define FRAME_TIME_HISTOGRAM_H
+
+const int FRAME_TIME_BUCKETS  = 832;
+const int MAX_WINDOW_SECONDS  = 60;
+
+// One window's statistics; times in milliseconds.
+struct FrameTimeStats
+{
+   int   frames;
+   float seconds;   // frame time covered, slightly over the window size
+   float mean;
+   float p50, p90, p99, p999;
+   float max;
+   int   stutters;  // frames over budget
+};
+
+class FrameTimeHistogram
+{
+public:
+   explicit FrameTimeHistogram(float budgetMs = 1000.0f / 60.0f);
+
+   // Counts one frame that took dt seconds.
+   void record(float dt);
+   void reset();
+
+   void  setBudget(float ms) { mBudgetUs = (unsigned int)(ms * 1000.0f); }
+   float budget() const      { return mBudgetUs / 1000.0f; }
+
+   // The last `seconds` whole slices plus the one being filled.
+   FrameTimeStats window(int seconds) const;
+
+   // Since construction or reset().
+   long long totalFrames() const   { return mTotalFrames; }
+   long long totalStutters() const { return mTotalStutters; }
+
+   // The bucket a time in microseconds falls in, and the smallest and
+   // largest times that bucket holds.
+   static int          bucketOf(unsigned int us);
+   static unsigned int bucketLow(int bucket);
+   static unsigned int bucketHigh(int bucket);
+
+private:
+   struct Slice
+   {
+      unsigned int       counts[FRAME_TIME_BUCKETS];
+      unsigned int       frames;
+      unsigned int       stutters;
+      unsigned int       max;      // us
+      unsigned long long totalUs;
+   };
+
+   void clearSlice(Slice& s);
+
+   Slice        mSlices[MAX_WINDOW_SECONDS + 1];
+   int          mCurrent;          // slice being filled
+   int          mFilled;           // whole slices behind it
+   unsigned int mSliceUs;          // frame time in the current slice
+   unsigned int mBudgetUs;
+   long long    mTotalFrames;
+   long long    mTotalStutters;
+};
+
+#endif // FRAME_TIME_HISTOGRAM_H
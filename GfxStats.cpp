@@ -8,7 +8,9 @@
 #include <tchar.h>
 
 GfxStats::GfxStats()
-: mFont(0), mFPS(0.0f), mMilliSecPerFrame(0.0f), mNumTris(0), mNumVertices(0)
+: mFont(0), mFPS(0.0f), mMilliSecPerFrame(0.0f), mNumTris(0), mNumVertices(0),
+  mHasSimTiming(false), mNumFrames(0.0f), mTimeElapsed(0.0f),
+  mNumScopes(0), mScopeFrames(0.0f), mScopesSince(profileNow())
 {
 	D3DXFONT_DESC fontDesc;
 	fontDesc.Height          = 18;
@@ -25,6 +27,10 @@ GfxStats::GfxStats()
 #pragma warning(default: 4996)
 
 	HR(D3DXCreateFontIndirect(gd3dDevice, &fontDesc, &mFont));
+
+	ZeroMemory(&mQueueStats, sizeof(mQueueStats));
+	ZeroMemory(&mDeviceStateStats, sizeof(mDeviceStateStats));
+	ZeroMemory(&mSimTiming, sizeof(mSimTiming));
 }
 
 GfxStats::~GfxStats()
@@ -72,49 +78,112 @@ void GfxStats::setVertexCount(DWORD n)
 	mNumVertices = n;
 }
 
+void GfxStats::setQueueStats(const RenderQueueStats& s)
+{
+	mQueueStats = s;
+}
+
+void GfxStats::setDeviceStateStats(const RenderStateStats& s)
+{
+	mDeviceStateStats = s;
+}
+
+void GfxStats::setSimTiming(const SimTiming& t)
+{
+	mSimTiming    = t;
+	mHasSimTiming = true;
+}
+
 void GfxStats::update(float dt)
 {
-	// Make static so that their values persist accross function calls.
-	static float numFrames   = 0.0f;
-	static float timeElapsed = 0.0f;
+	// Every frame counts in the histogram, so no stutter is averaged away.
+	mFrameTimes.record(dt);
 
 	// Increment the frame count.
-	numFrames += 1.0f;
+	mNumFrames += 1.0f;
 
 	// Accumulate how much time has passed.
-	timeElapsed += dt;
+	mTimeElapsed += dt;
 
 	// Has one second passed?--we compute the frame statistics once 
 	// per second.  Note that the time between frames can vary so 
 	// these stats are averages over a second.
-	if( timeElapsed >= 1.0f )
+	if( mTimeElapsed >= 1.0f )
 	{
-		// Frames Per Second = numFrames / timeElapsed,
-		// but timeElapsed approx. equals 1.0, so 
-		// frames per second = numFrames.
+		// Frames Per Second = mNumFrames / mTimeElapsed,
+		// but mTimeElapsed approx. equals 1.0, so 
+		// frames per second = mNumFrames.
 
-		mFPS = numFrames;
+		mFPS = mNumFrames;
 
 		// Average time, in miliseconds, it took to render a single frame.
 		mMilliSecPerFrame = 1000.0f / mFPS;
 
+		// Where that time went, per profiler scope.
+		long long now = profileNow();
+		mNumScopes    = profileTotals(mScopesSince, mScopes, MAX_SCOPES);
+		mScopeFrames  = mNumFrames;
+		mScopesSince  = now;
+
 		// Reset time counter and frame count to prepare for computing
 		// the average stats over the next second.
-		timeElapsed = 0.0f;
-		numFrames   = 0.0f;
+		mTimeElapsed = 0.0f;
+		mNumFrames   = 0.0f;
 	}
 }
 
 void GfxStats::display()
 {
 	// Make static so memory is not allocated every frame.
-	static char buffer[256];
+	static char buffer[2048];
 #pragma warning(disable: 4996)
-	sprintf(buffer, "Frames Per Second = %.2f\n"
-		             "Milliseconds Per Frame = %.4f\n"
-		             "Triangle Count = %d\n"
-		             "Vertex Count = %d", mFPS, mMilliSecPerFrame, mNumTris, mNumVertices);
+	int n = sprintf(buffer, "Frames Per Second = %.2f\n"
+		                     "Milliseconds Per Frame = %.4f\n"
+		                     "Triangle Count = %d\n"
+		                     "Vertex Count = %d", mFPS, mMilliSecPerFrame, mNumTris, mNumVertices);
+
+	const RenderQueueStats& q = mQueueStats;
+	n += sprintf(buffer + n, "\nState Changes = %d (%d saved), Batches = %d (%d saved)",
+	             q.stateChanges, q.naiveStateChanges - q.stateChanges,
+	             q.batches, q.naiveBatches - q.batches);
+
+	DWORD calls = 0, forwarded = 0;
+	for(int k = 0; k < RS_KIND_COUNT; ++k)
+	{
+		calls     += mDeviceStateStats.calls[k];
+		forwarded += mDeviceStateStats.forwarded[k];
+	}
+	n += sprintf(buffer + n, "\nDevice State Calls = %d (%d filtered)", calls, calls - forwarded);
+
+	// Frame time percentiles over the last 1 and 10 seconds.
+	const int windows[2] = { 1, 10 };
+	for(int i = 0; i < 2; ++i)
+	{
+		FrameTimeStats w = mFrameTimes.window(windows[i]);
+		n += sprintf(buffer + n, "\n%2ds: p50 %.2f  p90 %.2f  p99 %.2f  p99.9 %.2f  max %.2f ms, %d over %.1f ms",
+		             windows[i], w.p50, w.p90, w.p99, w.p999, w.max, w.stutters, mFrameTimes.budget());
+	}
+
+	// The simulation thread's ticks should be a period apart whatever
+	// the frames do.
+	if(mHasSimTiming)
+	{
+		const FrameTimeStats& ti = mSimTiming.tickIntervals;
+		const FrameTimeStats& in = mSimTiming.inputLatency;
+		n += sprintf(buffer + n, "\nSim Ticks: p50 %.2f  p99 %.2f  max %.2f ms, %u dropped"
+		             "\nInput Latency: p50 %.2f  p99 %.2f  max %.2f ms",
+		             ti.p50, ti.p99, ti.max, mSimTiming.droppedTicks, in.p50, in.p99, in.max);
+	}
+
+	// One line per scope, indented by nesting depth, in ms per frame.
+	for(int i = 0; i < mNumScopes && mScopeFrames > 0.0f; ++i)
+	{
+		const ProfileTotal& t = mScopes[i];
+		n += sprintf(buffer + n, "\n%*s%.24s = %.3f ms (%.1f calls)", 3 * t.depth, "",
+		             t.name, t.ms / mScopeFrames, t.calls / mScopeFrames);
+	}
 #pragma warning(default: 4996)
-	RECT R = {5, 5, 0, 0};
+	// Below the score text.
+	RECT R = {5, 45, 0, 0};
 	HR(mFont->DrawText(0, buffer, -1, &R, DT_NOCLIP, D3DCOLOR_XRGB(0,0,0)));
 }
\ No newline at end of file
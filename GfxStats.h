@@ -3,12 +3,28 @@
 //
 // Class used for keeping track of and displaying the frames rendered
 // per second, milliseconds per frame, and vertex and triangle counts.
+//
+// Every frame time also goes into a FrameTimeHistogram, so the overlay and
+// callers can see percentiles, the worst frame and stutters over the last
+// 1 and 10 seconds instead of only the average.  It also shows where each
+// frame's milliseconds go: once per second the FrameProfiler scopes
+// recorded over that second are summed per name and averaged per frame.
+// The renderer's RenderQueue counts are shown beside the triangle count:
+// state changes and batches made, and how many sorting saved; then the
+// device state calls made that frame and how many the RenderStateCache
+// filtered out.  With a SimThread, its tick intervals and input latency
+// are shown too.
 //=============================================================================
 
 #ifndef GFX_STATS_H
 #define GFX_STATS_H
 
 #include <d3dx9.h>
+#include "FrameProfiler.h"
+#include "FrameTimeHistogram.h"
+#include "RenderQueue.h"
+#include "RenderStateCache.h"
+#include "SimThread.h"
 
 class GfxStats
 {
@@ -26,10 +42,15 @@ public:
 
 	void setTriCount(DWORD n);
 	void setVertexCount(DWORD n);
+	void setQueueStats(const RenderQueueStats& s);
+	void setDeviceStateStats(const RenderStateStats& s);
+	void setSimTiming(const SimTiming& t);
 
 	void update(float dt);
 	void display();
 
+	const FrameTimeHistogram& frameTimes() const { return mFrameTimes; }
+
 private:
 	// Prevent copying
 	GfxStats(const GfxStats& rhs);
@@ -41,5 +62,21 @@ private:
 	float mMilliSecPerFrame;
 	DWORD mNumTris;
 	DWORD mNumVertices;
+	RenderQueueStats mQueueStats;
+	RenderStateStats mDeviceStateStats;
+	SimTiming        mSimTiming;
+	bool             mHasSimTiming;
+
+	float mNumFrames;   // in the current second
+	float mTimeElapsed;
+
+	FrameTimeHistogram mFrameTimes;
+
+	// Profiler scopes over the last whole second.
+	static const int MAX_SCOPES = 16;
+	ProfileTotal mScopes[MAX_SCOPES];
+	int          mNumScopes;
+	float        mScopeFrames;
+	long long    mScopesSince;
 };
 #endif // GFX_STATS_H
\ No newline at end of file
@@ -0,0 +1,141 @@
+//=============================================================================
+// HeadlessPong.cpp
+//
+// Runs Pong matches without a window, device or input, as fast as the CPU
+// allows, and reports simulation throughput.  Both pads are driven by
+// pongTrackingInput(), see PongMatch.h, or with -ai pad2 by the predictive
+// PongAI with that reaction delay in seconds.
+//
+// With -input, one game is played from a ScriptedInputSource script
+// instead (see InputQueue.h), fed through an InputQueue tick by tick as the
+// game feeds key presses, until a second after the script's last event.
+// -record saves that game as a replay for ReplayPlayer.  Builds on any
+// platform, e.g.:
+//
+//    g++ -O2 -std=c++11 HeadlessPong.cpp PongMatch.cpp PongAI.cpp PongSim.cpp PongCollision.cpp
+//        InputQueue.cpp Replay.cpp -o HeadlessPong
+//
+// usage: HeadlessPong [-matches n] [-points n] [-tickrate hz] [-seed n]
+//                     [-ai seconds] [-aierror units]
+//        HeadlessPong -input script.txt [-record out.replay] [-tickrate hz] [-seed n]
+//=============================================================================
+
+#include "PongMatch.h"
+#include "InputQueue.h"
+#include "Replay.h"
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int playScript(const char* path, const char* recordPath, float tickRate, unsigned int seed)
+{
+   ScriptedInputSource script;
+   int badLine = 0;
+   if (!script.load(path, &badLine))
+   {
+      if (badLine)
+         fprintf(stderr, "%s:%d: expected \"seconds button up|down\"\n", path, badLine);
+      else
+         fprintf(stderr, "cannot read %s\n", path);
+      return 1;
+   }
+
+   PongState s;
+   pongInit(s, seed);
+   InputQueue queue;
+   float dt = 1.0f / tickRate;
+
+   ReplayWriter replay;
+   if (recordPath && !replay.open(recordPath, seed, dt, s.rallyTimeout))
+   {
+      fprintf(stderr, "cannot write %s\n", recordPath);
+      return 1;
+   }
+
+   long long end = script.endTime() + 1000000;
+   unsigned int padHits = 0, goals = 0;
+   for (unsigned int tick = 0; ; tick++)
+   {
+      long long tickStart = (long long)(tick * 1e6 / tickRate);
+      long long tickEnd   = (long long)((tick + 1) * 1e6 / tickRate);
+      if (tickStart >= end)
+         break;
+      script.pump(queue, tickEnd);
+      PongTimedInput in = queue.consume(tickStart, tickEnd, dt);
+      unsigned int events = pongStepTimed(s, in, dt);
+      replay.tick(in, s);
+      if (events & (EVT_PAD1_HIT | EVT_PAD2_HIT)) padHits++;
+      if (events & (EVT_GOAL_P1 | EVT_GOAL_P2))   goals++;
+   }
+
+   printf("ticks:          %u (%.1f Hz)\n", s.tick, tickRate);
+   printf("score:          %d - %d (%u goals, %u pad hits)\n", s.player1Score, s.player2Score, goals, padHits);
+   printf("ball:           %.3f %.3f\n", s.ball.pos.x, s.ball.pos.y);
+   printf("pads:           %.3f %.3f\n", s.pad1.pos.y, s.pad2.pos.y);
+   return 0;
+}
+
+int main(int argc, char* argv[])
+{
+   const char*  inputScript = 0;
+   const char*  recordPath  = 0;
+   int          numMatches  = 1000;
+   int          pointsToWin = 11;
+   float        tickRate    = 120.0f;
+   unsigned int seed        = 1;
+   float        aiReaction  = -1.0f;
+   float        aiError     = 40.0f;
+
+   for (int i = 1; i + 1 < argc; i += 2)
+   {
+      if      (strcmp(argv[i], "-matches")  == 0) numMatches  = atoi(argv[i + 1]);
+      else if (strcmp(argv[i], "-points")   == 0) pointsToWin = atoi(argv[i + 1]);
+      else if (strcmp(argv[i], "-tickrate") == 0) tickRate    = (float)atof(argv[i + 1]);
+      else if (strcmp(argv[i], "-seed")     == 0) seed        = (unsigned int)strtoul(argv[i + 1], 0, 10);
+      else if (strcmp(argv[i], "-ai")       == 0) aiReaction  = (float)atof(argv[i + 1]);
+      else if (strcmp(argv[i], "-aierror")  == 0) aiError     = (float)atof(argv[i + 1]);
+      else if (strcmp(argv[i], "-input")    == 0) inputScript = argv[i + 1];
+      else if (strcmp(argv[i], "-record")   == 0) recordPath  = argv[i + 1];
+      else
+      {
+         fprintf(stderr, "unknown option %s\n", argv[i]);
+         return 1;
+      }
+   }
+
+   if (inputScript)
+      return playScript(inputScript, recordPath, tickRate, seed);
+
+   MatchConfig config;
+   config.pointsToWin = pointsToWin;
+   config.dt          = 1.0f / tickRate;
+   config.maxTicks    = (unsigned int)(tickRate * 60.0f * 60.0f); // one hour of play
+   config.pad2Reaction = aiReaction;
+   config.pad2AimError = aiError;
+
+   unsigned long long ticks = 0, rallies = 0, padHits = 0;
+   int p1Wins = 0, p2Wins = 0;
+
+   std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+   for (int m = 0; m < numMatches; m++)
+   {
+      config.seed = seed + (unsigned int)m;
+      MatchResult result = pongPlayMatch(config);
+      ticks   += result.ticks;
+      rallies += result.rallies;
+      padHits += result.padHits;
+      if (result.player1Score > result.player2Score) p1Wins++;
+      else if (result.player2Score > result.player1Score) p2Wins++;
+   }
+   double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+   printf("matches:        %d (p1 %d, p2 %d)\n", numMatches, p1Wins, p2Wins);
+   printf("ticks:          %llu (%.1f Hz, %.1f simulated hours)\n",
+          ticks, tickRate, ticks / tickRate / 3600.0);
+   printf("rallies:        %llu (%.2f pad hits per rally)\n",
+          rallies, rallies ? (double)padHits / rallies : 0.0);
+   printf("wall time:      %.3f s\n", seconds);
+   printf("ticks/sec:      %.0f\n", seconds > 0.0 ? ticks / seconds : 0.0);
+   return 0;
+}
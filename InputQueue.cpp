@@ -0,0 +1,193 @@
+//=============================================================================
+// InputQueue.cpp
+//=============================================================================
+
+#include "InputQueue.h"
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//===============================================================
+// InputQueue
+
+InputQueue::InputQueue()
+{
+   clear();
+   mDropped = 0;
+}
+
+void InputQueue::clear()
+{
+   mHead  = 0;
+   mCount = 0;
+   mHeld  = 0;
+}
+
+bool InputQueue::push(const InputEvent& e)
+{
+   if (mCount == INPUT_QUEUE_SIZE)
+   {
+      mDropped++;
+      return false;
+   }
+
+   InputEvent& slot = mEvents[(mHead + mCount) % INPUT_QUEUE_SIZE];
+   slot = e;
+   if (mCount > 0)
+   {
+      const InputEvent& last = mEvents[(mHead + mCount - 1) % INPUT_QUEUE_SIZE];
+      if (slot.time < last.time)
+         slot.time = last.time;
+   }
+   mCount++;
+   return true;
+}
+
+PongTimedInput InputQueue::consume(long long tickStart, long long tickEnd, float dt)
+{
+   long long heldUs[PONG_BUTTON_COUNT] = { 0 };
+   unsigned int seen = mHeld;
+   long long t = tickStart;
+
+   while (mCount > 0 && mEvents[mHead].time < tickEnd)
+   {
+      const InputEvent& e = mEvents[mHead];
+      long long at = e.time > t ? e.time : t;
+      for (int i = 0; i < PONG_BUTTON_COUNT; i++)
+         if (mHeld & (1u << i))
+            heldUs[i] += at - t;
+      t = at;
+
+      if (e.down)
+      {
+         mHeld |= e.button;
+         seen  |= e.button;
+      }
+      else
+         mHeld &= ~e.button;
+
+      mHead = (mHead + 1) % INPUT_QUEUE_SIZE;
+      mCount--;
+   }
+
+   PongTimedInput in;
+   in.input.buttons = seen;
+   long long span = tickEnd - tickStart;
+   for (int i = 0; i < PONG_BUTTON_COUNT; i++)
+   {
+      if (mHeld & (1u << i))
+         heldUs[i] += tickEnd - t;
+      // A button held throughout gets exactly dt, so steady input steps
+      // the simulation exactly as pongStep() would.
+      if (span <= 0 || heldUs[i] >= span)
+         in.held[i] = heldUs[i] > 0 || (seen & (1u << i)) ? dt : 0.0f;
+      else
+         in.held[i] = dt * (float)((double)heldUs[i] / (double)span);
+   }
+   return in;
+}
+
+//===============================================================
+// ScriptedInputSource
+
+static const char* const BUTTON_NAMES[PONG_BUTTON_COUNT] =
+{
+   "pad1_up", "pad1_down", "pad2_up", "pad2_down", "reset", "rot_ccw", "rot_cw"
+};
+
+unsigned int inputButtonByName(const char* name)
+{
+   for (int i = 0; i < PONG_BUTTON_COUNT; i++)
+      if (strcmp(name, BUTTON_NAMES[i]) == 0)
+         return 1u << i;
+   return 0;
+}
+
+static bool earlier(const InputEvent& a, const InputEvent& b)
+{
+   return a.time < b.time;
+}
+
+ScriptedInputSource::ScriptedInputSource()
+: mNext(0), mSorted(true)
+{
+}
+
+void ScriptedInputSource::add(long long time, unsigned int button, bool down)
+{
+   InputEvent e = { time, button, down };
+   mEvents.push_back(e);
+   mSorted = false;
+}
+
+void ScriptedInputSource::press(long long time, long long duration, unsigned int button)
+{
+   add(time, button, true);
+   add(time + duration, button, false);
+}
+
+void ScriptedInputSource::sort()
+{
+   if (mSorted)
+      return;
+   std::stable_sort(mEvents.begin(), mEvents.end(), earlier);
+   mSorted = true;
+}
+
+long long ScriptedInputSource::endTime() const
+{
+   long long end = 0;
+   for (size_t i = 0; i < mEvents.size(); i++)
+      if (mEvents[i].time > end)
+         end = mEvents[i].time;
+   return end;
+}
+
+bool ScriptedInputSource::load(const char* path, int* badLine)
+{
+   FILE* f = fopen(path, "r");
+   if (!f)
+   {
+      if (badLine)
+         *badLine = 0;
+      return false;
+   }
+
+   char line[256];
+   int  number = 0;
+   bool ok = true;
+   while (ok && fgets(line, sizeof(line), f))
+   {
+      number++;
+      char* p = line;
+      while (*p == ' ' || *p == '\t')
+         p++;
+      if (*p == '#' || *p == '\n' || *p == '\r' || *p == '\0')
+         continue;
+
+      double seconds;
+      char   name[32], action[8];
+      unsigned int button = 0;
+      ok = sscanf(p, "%lf %31s %7s", &seconds, name, action) == 3 &&
+           seconds >= 0.0 && (button = inputButtonByName(name)) != 0 &&
+           (strcmp(action, "down") == 0 || strcmp(action, "up") == 0);
+      if (ok)
+         add((long long)(seconds * 1e6 + 0.5), button, action[0] == 'd');
+      else if (badLine)
+         *badLine = number;
+   }
+   fclose(f);
+   return ok;
+}
+
+void ScriptedInputSource::pump(InputQueue& queue, long long now)
+{
+   sort();
+   while (mNext < mEvents.size() && mEvents[mNext].time <= now)
+   {
+      if (!queue.push(mEvents[mNext]))
+         break;  // try again on the next pump
+      mNext++;
+   }
+}
@@ -0,0 +1,109 @@
+//=============================================================================
+// InputQueue.h
+//
+// Input as timestamped press and release events instead of a once-a-frame
+// snapshot of which keys are down, so a press shorter than a frame is not
+// lost and a tick sees when within it each button went down or up.
+//
+// An InputSource turns raw input into events: DirectInputSource (see
+// DirectInput.h) reads DirectInput's buffered keyboard data, and
+// ScriptedInputSource plays back events it was given or loaded from a text
+// file, so headless runs can be fed input on any platform.  Events go into
+// an InputQueue; each simulation tick then consumes the events up to its
+// end as a PongTimedInput for pongStepTimed().
+//
+// Times are in microseconds on the caller's clock.  A source only needs to
+// agree with the tick times it is consumed against.
+//=============================================================================
+
+#ifndef INPUT_QUEUE_H
+#define INPUT_QUEUE_H
+
+#include "PongSim.h"
+#include <stddef.h>
+#include <vector>
+
+struct InputEvent
+{
+   long long    time;    // microseconds
+   unsigned int button;  // one PongButton
+   bool         down;    // pressed, or released
+};
+
+const int INPUT_QUEUE_SIZE = 256;  // events waiting to be consumed
+
+class InputQueue
+{
+public:
+   InputQueue();
+
+   // Events must arrive in time order; one older than the newest queued
+   // event is moved up to it.  false (and counted) when the queue is full.
+   bool push(const InputEvent& e);
+
+   // Takes every event before tickEnd and returns the input for the tick
+   // [tickStart, tickEnd), which is dt seconds of simulation.  Events from
+   // before tickStart (late ones, or ones in ticks that were dropped) count
+   // as happening at tickStart.
+   PongTimedInput consume(long long tickStart, long long tickEnd, float dt);
+
+   // Buttons down after the last consumed event.
+   unsigned int held() const { return mHeld; }
+
+   int          size()    const { return mCount; }
+   // The i-th oldest waiting event, 0 <= i < size().
+   const InputEvent& event(int i) const { return mEvents[(mHead + i) % INPUT_QUEUE_SIZE]; }
+   unsigned int dropped() const { return mDropped; }
+   void         clear();
+
+private:
+   InputEvent   mEvents[INPUT_QUEUE_SIZE];
+   int          mHead;     // oldest event
+   int          mCount;
+   unsigned int mHeld;
+   unsigned int mDropped;
+};
+
+class InputSource
+{
+public:
+   virtual ~InputSource() {}
+
+   // Pushes every event that happened up to now into queue.
+   virtual void pump(InputQueue& queue, long long now) = 0;
+};
+
+// Plays back a fixed list of events as time reaches them.
+class ScriptedInputSource : public InputSource
+{
+public:
+   ScriptedInputSource();
+
+   // Events may be added in any order.
+   void add(long long time, unsigned int button, bool down);
+   void press(long long time, long long duration, unsigned int button);
+
+   // Reads a script: one event per line, "seconds button up|down", with
+   // buttons named pad1_up, pad1_down, pad2_up, pad2_down, reset, rot_ccw
+   // and rot_cw.  Blank lines and lines starting with # are skipped.
+   // Returns false, with the bad line in *badLine, if a line is malformed.
+   bool load(const char* path, int* badLine = 0);
+
+   void pump(InputQueue& queue, long long now);
+
+   void      rewind()         { mNext = 0; }
+   bool      finished() const { return mNext >= mEvents.size(); }
+   long long endTime() const;  // of the last event
+
+private:
+   void sort();
+
+   std::vector<InputEvent> mEvents;
+   size_t                  mNext;
+   bool                    mSorted;
+};
+
+// The PongButton named as in scripts, or 0.
+unsigned int inputButtonByName(const char* name);
+
+#endif // INPUT_QUEUE_H
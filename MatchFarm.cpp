@@ -0,0 +1,256 @@
+//=============================================================================
+// MatchFarm.cpp
+//
+// Plays thousands of independent headless matches on every core and reports
+// how throughput scales from 1 to N threads.  Matches are scheduled as ranges
+// on per-thread work-stealing deques: a worker splits its range in half,
+// keeps the lower half and pushes the upper half for others to steal, down
+// to -grain matches per job.  Each match writes its MatchResult into its own
+// slot of a preallocated array, so collecting results needs no lock.
+//
+//    g++ -O2 -std=c++11 -pthread MatchFarm.cpp PongMatch.cpp PongAI.cpp PongSim.cpp
+//        PongCollision.cpp -o MatchFarm
+//
+// usage: MatchFarm [-matches n] [-threads n] [-grain n] [-points n]
+//                  [-tickrate hz] [-seed n] [-ai seconds] [-aierror units]
+//
+// -ai plays pad2 with the predictive PongAI at that reaction delay instead
+// of the tracking bot.
+//=============================================================================
+
+#include "PongMatch.h"
+#include "WorkStealingQueue.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// A job is the half-open match range [begin, end) packed into 64 bits.
+typedef unsigned long long Job;
+
+static Job makeJob(unsigned int begin, unsigned int end)
+{
+   return ((Job)begin << 32) | end;
+}
+
+struct Worker
+{
+   WorkStealingQueue<Job> queue;
+   unsigned int           rng;      // victim selection
+   unsigned int           steals;
+   char                   pad[64];  // keep neighbours' counters off our line
+};
+
+struct Farm
+{
+   MatchConfig               config;   // seed is the seed of match 0
+   unsigned int              grain;
+   std::vector<MatchResult>  results;
+   Worker*                   workers;
+   int                       numWorkers;
+   std::atomic<unsigned int> remaining;
+};
+
+static void runJob(Farm& farm, Worker& self, Job job)
+{
+   unsigned int begin = (unsigned int)(job >> 32);
+   unsigned int end   = (unsigned int)job;
+
+   // Split off the upper half while the range is big enough.  If our
+   // deque is full we simply play the rest ourselves.
+   while (end - begin > farm.grain)
+   {
+      unsigned int mid = begin + (end - begin) / 2;
+      if (!self.queue.push(makeJob(mid, end)))
+         break;
+      end = mid;
+   }
+
+   MatchConfig config = farm.config;
+   for (unsigned int m = begin; m < end; m++)
+   {
+      config.seed = farm.config.seed + m;
+      farm.results[m] = pongPlayMatch(config);
+   }
+   farm.remaining.fetch_sub(end - begin, std::memory_order_release);
+}
+
+static bool trySteal(Farm& farm, Worker& self, Job& job)
+{
+   for (int attempt = 0; attempt < farm.numWorkers; attempt++)
+   {
+      Worker& victim = farm.workers[simRandom(self.rng) % farm.numWorkers];
+      if (&victim != &self && victim.queue.steal(job))
+      {
+         self.steals++;
+         return true;
+      }
+   }
+   return false;
+}
+
+static void workerMain(Farm& farm, int index)
+{
+   Worker& self = farm.workers[index];
+   while (farm.remaining.load(std::memory_order_acquire) > 0)
+   {
+      Job job;
+      if (self.queue.pop(job) || trySteal(farm, self, job))
+         runJob(farm, self, job);
+      else
+         std::this_thread::yield();
+   }
+}
+
+// Plays every match with numThreads workers; returns wall seconds.
+static double runFarm(Farm& farm, unsigned int numMatches, int numThreads, unsigned int& steals)
+{
+   farm.results.assign(numMatches, MatchResult());
+   farm.numWorkers = numThreads;
+   farm.workers    = new Worker[numThreads];
+   for (int i = 0; i < numThreads; i++)
+   {
+      farm.workers[i].rng    = 0x9E3779B9u * (i + 1);
+      farm.workers[i].steals = 0;
+   }
+   farm.remaining.store(numMatches);
+
+   // All the work starts on worker 0; the others steal it from there.
+   farm.workers[0].queue.push(makeJob(0, numMatches));
+
+   std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+   std::vector<std::thread> threads;
+   for (int i = 1; i < numThreads; i++)
+      threads.push_back(std::thread(workerMain, std::ref(farm), i));
+   workerMain(farm, 0);
+   for (size_t i = 0; i < threads.size(); i++)
+      threads[i].join();
+   double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+   steals = 0;
+   for (int i = 0; i < numThreads; i++)
+      steals += farm.workers[i].steals;
+   delete [] farm.workers;
+   farm.workers = 0;
+   return seconds;
+}
+
+static void printSummary(const std::vector<MatchResult>& results)
+{
+   unsigned long long ticks = 0, rallies = 0, padHits = 0;
+   unsigned long long lengths[RALLY_BUCKETS] = { 0 };
+   unsigned int longest = 0;
+   int p1Wins = 0, p2Wins = 0;
+
+   for (size_t m = 0; m < results.size(); m++)
+   {
+      const MatchResult& r = results[m];
+      ticks   += r.ticks;
+      rallies += r.rallies;
+      padHits += r.padHits;
+      if (r.longestRally > longest) longest = r.longestRally;
+      if (r.player1Score > r.player2Score) p1Wins++;
+      else if (r.player2Score > r.player1Score) p2Wins++;
+      for (int b = 0; b < RALLY_BUCKETS; b++)
+         lengths[b] += r.rallyLengths[b];
+   }
+
+   printf("matches:        %u (p1 %d, p2 %d)\n", (unsigned int)results.size(), p1Wins, p2Wins);
+   printf("ticks:          %llu\n", ticks);
+   printf("rallies:        %llu (%.2f pad hits per rally, longest %u)\n",
+          rallies, rallies ? (double)padHits / rallies : 0.0, longest);
+   printf("rally length:  ");
+   for (int b = 0; b < RALLY_BUCKETS; b++)
+      printf(" %s%d:%.1f%%", b == RALLY_BUCKETS - 1 ? ">=" : "", b,
+             rallies ? 100.0 * lengths[b] / rallies : 0.0);
+   printf("\n\n");
+}
+
+int main(int argc, char* argv[])
+{
+   unsigned int numMatches  = 4000;
+   int          maxThreads  = (int)std::thread::hardware_concurrency();
+   unsigned int grain       = 4;
+   int          pointsToWin = 11;
+   float        tickRate    = 120.0f;
+   unsigned int seed        = 1;
+   float        aiReaction  = -1.0f;
+   float        aiError     = 40.0f;
+
+   for (int i = 1; i + 1 < argc; i += 2)
+   {
+      if      (strcmp(argv[i], "-matches")  == 0) numMatches  = (unsigned int)strtoul(argv[i + 1], 0, 10);
+      else if (strcmp(argv[i], "-threads")  == 0) maxThreads  = atoi(argv[i + 1]);
+      else if (strcmp(argv[i], "-grain")    == 0) grain       = (unsigned int)strtoul(argv[i + 1], 0, 10);
+      else if (strcmp(argv[i], "-points")   == 0) pointsToWin = atoi(argv[i + 1]);
+      else if (strcmp(argv[i], "-tickrate") == 0) tickRate    = (float)atof(argv[i + 1]);
+      else if (strcmp(argv[i], "-seed")     == 0) seed        = (unsigned int)strtoul(argv[i + 1], 0, 10);
+      else if (strcmp(argv[i], "-ai")       == 0) aiReaction  = (float)atof(argv[i + 1]);
+      else if (strcmp(argv[i], "-aierror")  == 0) aiError     = (float)atof(argv[i + 1]);
+      else
+      {
+         fprintf(stderr, "unknown option %s\n", argv[i]);
+         return 1;
+      }
+   }
+   if (numMatches < 1 || tickRate <= 0.0f)
+   {
+      fprintf(stderr, "-matches and -tickrate must be positive\n");
+      return 1;
+   }
+   if (maxThreads < 1) maxThreads = 1;
+   if (grain < 1)      grain = 1;
+
+   Farm farm;
+   farm.config.seed        = seed;
+   farm.config.pointsToWin = pointsToWin;
+   farm.config.dt          = 1.0f / tickRate;
+   farm.config.maxTicks    = (unsigned int)(tickRate * 60.0f * 60.0f);
+   farm.config.pad2Reaction = aiReaction;
+   farm.config.pad2AimError = aiError;
+   farm.grain              = grain;
+   farm.workers            = 0;
+
+   // 1, 2, 4, ... threads, always ending with maxThreads.
+   std::vector<int> threadCounts;
+   for (int t = 1; t < maxThreads; t *= 2)
+      threadCounts.push_back(t);
+   threadCounts.push_back(maxThreads);
+
+   std::vector<MatchResult> reference;
+   double baseRate = 0.0;
+
+   printf("%8s %10s %14s %14s %8s %8s %8s\n",
+          "threads", "seconds", "matches/sec", "ticks/sec", "speedup", "eff", "steals");
+   for (size_t i = 0; i < threadCounts.size(); i++)
+   {
+      unsigned int steals = 0;
+      double seconds = runFarm(farm, numMatches, threadCounts[i], steals);
+
+      unsigned long long ticks = 0;
+      for (size_t m = 0; m < farm.results.size(); m++)
+         ticks += farm.results[m].ticks;
+
+      double rate = numMatches / seconds;
+      if (i == 0)
+      {
+         baseRate  = rate;
+         reference = farm.results;
+      }
+      else if (memcmp(&reference[0], &farm.results[0], numMatches * sizeof(MatchResult)) != 0)
+      {
+         fprintf(stderr, "results with %d threads differ from 1 thread\n", threadCounts[i]);
+         return 1;
+      }
+
+      printf("%8d %10.3f %14.1f %14.0f %7.2fx %7.0f%% %8u\n", threadCounts[i], seconds, rate,
+             ticks / seconds, rate / baseRate, 100.0 * rate / baseRate / threadCounts[i], steals);
+   }
+   printf("\n");
+
+   printSummary(reference);
+   return 0;
+}
@@ -9,79 +9,25 @@
 #include "DirectInput.h"
 #include <crtdbg.h>
 #include "GfxStats.h"
+#include "PongSim.h"
+#include "D3DRenderer.h"
+#include "RenderStateCache.h"
+#include "FrameProfiler.h"
+#include "Telemetry.h"
+#include "InputQueue.h"
+#include "Replay.h"
+#include "PongAI.h"
+#include "SimThread.h"
+#include <atomic>
 #include <list>
+#include <string.h>
 #include <time.h> // time(NULL)
-#include <tchar.h> // _T, _tcscpy
 
 
-static float r_angle;
+// Telemetry channels.
+const int TELEMETRY_FRAME_US = 0;
 
-class BallInfo
-{
-public:
-   BallInfo() : BALL_SPEED(300), BALL_MAX_SPEED(1000), BALL_ACCEL(200), BALL_DRAG(100) { }
-	D3DXVECTOR3 pos;
-   float speed;
-	float rotation;
-	float life;
-
-	const float BALL_SPEED;
-	const float BALL_MAX_SPEED;
-	const float BALL_ACCEL;
-	const float BALL_DRAG; 
-};
-
-
-class PadInfo
-{
-public:
-   PadInfo() : PAD_SPEED(300.0f)
-   {
-      pos = D3DXVECTOR3(0.0f, 0.0f, 0.0f); 
-      center = D3DXVECTOR3(0.0f, 0.0f, 0.0f);
-      rotation = 0.0f; 
-      energy = 0.0f;
-   }
-
-   D3DXVECTOR3 pos;
-   D3DXVECTOR3 center;
-
-   float rotation;         // rotation of pad image in radians.
-   float energy;           // not yet implemented
-   const float PAD_SPEED;  // speed
-
-public:
-   D3DXVECTOR3 bound1; // set upper-right rectangle corner
-   D3DXVECTOR3 bound2; // set lower-left rectangle corner
-
-   // input: bounding increment.
-   //        increment must be positive value.
-   // pre:   pos.x and pos.y must be set to valid 2d position.
-   // post:  boundNW and boundSE are set to rectangle enclosing pad object.
-   void setBoundingBox(const D3DXVECTOR3& inc1)
-   {
-      bound1.x = pos.x - inc1.x; bound1.y = pos.y + inc1.y; bound1.z = 0.0f;
-      bound2.x = pos.x + inc1.x; bound2.y = pos.y - inc1.y; bound2.z = 0.0f;
-   }
-
-   bool checkCollision(const D3DXVECTOR3& object)
-   {
-      if (object.x > bound1.x && object.y < bound1.y &&
-          object.x < bound2.x && object.y > bound2.y)
-         return true;
-
-      return false;
-   }
-
-   void updateBoundingBox(const float& incr)
-   {
-      bound1.y += incr;
-      bound2.y += incr;
-   }
-};
-
-
-class PongDemo : public D3DApp
+class PongDemo : public D3DApp, public SimThreadClient
 {
 public:
 	PongDemo(HINSTANCE hInstance, std::string winCaption, D3DDEVTYPE devType, DWORD requestedVP);
@@ -90,42 +36,57 @@ public:
 	bool checkDeviceCaps();
 	void onLostDevice();
 	void onResetDevice();
+	void updateFrame(float dt);
 	void updateScene(float dt);
 	void drawScene();
 
+   // Where pad and ball keys come from; not owned.
+   void setInputSource(InputSource* source) { mInputSource = source; }
+
+   // Ticks on a SimThread instead of in the frame loop, so Present()
+   // cannot hold them up.  Call after setInputSource().
+   void useSimThread();
+
+   // SimThreadClient; on the simulation thread.
+   void simTick(const PongTimedInput& in, float dt);
+   void simSnapshot(SimSnapshot& out);
+
 	// Helper functions.
-	void updateBall(float dt);
-   void updatePad(float dt);
    void updateCamera(float dt); // update Z axis
-	void drawBkgd();
-	void drawPad();
-	void drawBall();
-   void drawScore();
+   void step(const PongTimedInput& in, float dt); // one tick, either thread
 
 private:
 	GfxStats* mGfxStats;
 	
-	ID3DXSprite* mSprite; // http://msdn.microsoft.com/en-us/library/windows/desktop/bb174249%28v=vs.85%29.aspx
    ID3DXLine*   mLine;
-   ID3DXFont*   mFont;
+   D3DRenderer* mRenderer; // background, pads, ball and score
 
-   float mCameraPosZ;
-   RECT field;
-   int player1Score;
-   int player2Score;
+   TelemetryWriter* mTelemetry; // every tick and frame time, to telemetry.tel
+   ReplayWriter*    mReplay;    // every tick's input, to last.replay
 
-	IDirect3DTexture9* mBkgdTex;
-	D3DXVECTOR3 mBkgdCenter;
-
-	IDirect3DTexture9* mBallTex;
-	D3DXVECTOR3 mBallCenter;
+   float mCameraPosZ;
 
-	IDirect3DTexture9* mPadTex;
+   bool mShowStats;    // F3 toggles the GfxStats and profiler overlay
+   bool mStatsKeyDown;
+   bool mTraceKeyDown; // F12 writes frame_trace.json
+   std::atomic<bool> mPad2AI; // F2 hands pad2 to the computer
+   bool mAIKeyDown;
+   PongAI mAI;
+
+   InputSource* mInputSource; // pumped once per frame
+   InputQueue   mInputQueue;  // consumed tick by tick, see updateScene
+   PongState mPrevState; // state before the last tick, for interpolation
+   PongState mDrawState; // what drawScene shows this frame
+
+   // Threaded mode, or 0.  The simulation thread then owns mState,
+   // mPrevState, mAI, mTelemetry and mReplay, pumps mInputSource into
+   // its own queue, and is handed each frame time through mFrameUs
+   // (-1 once written) for the telemetry.
+   SimThread*             mSimulation;
+   std::atomic<long long> mFrameUs;
 
 public:
-   BallInfo ball;
-   PadInfo pad1;
-   PadInfo pad2;
+   PongState mState; // everything the simulation owns, see PongSim.h
 };
 
 
@@ -142,6 +103,23 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance, PSTR cmdLine, in
 	DirectInput di(DISCL_NONEXCLUSIVE | DISCL_FOREGROUND, DISCL_NONEXCLUSIVE | DISCL_FOREGROUND);
 	gDInput = &di;
 
+	DirectInputSource keys(di);
+	// Ball debugging keys.
+	keys.bind(DIK_R, BTN_BALL_RESET);
+	keys.bind(DIK_T, BTN_BALL_ROT_CCW);
+	keys.bind(DIK_G, BTN_BALL_ROT_CW);
+	// Pad1:
+	keys.bind(DIK_W, BTN_PAD1_UP);
+	keys.bind(DIK_S, BTN_PAD1_DOWN);
+	// Pad2:
+	keys.bind(DIK_NUMPAD8, BTN_PAD2_UP);
+	keys.bind(DIK_NUMPAD5, BTN_PAD2_DOWN);
+	app.setInputSource(&keys);
+
+	// -threaded runs the simulation on its own thread.
+	if(strstr(cmdLine, "-threaded"))
+		app.useSimThread();
+
 	return gd3dApp->run();
 }
 
@@ -154,79 +132,64 @@ PongDemo::PongDemo(HINSTANCE hInstance, std::string winCaption, D3DDEVTYPE devTy
 		PostQuitMessage(0);
 	}
 
-   // seed random number generator
-   srand((unsigned int) time(NULL));
    // create contained GfxStats dynamic object:
    mGfxStats = new GfxStats();
 
    // line:
    HR(D3DXCreateLine(gd3dDevice, &mLine));
-   // sprite:
-	HR(D3DXCreateSprite(gd3dDevice, &mSprite));
-   // font:
-	D3DXFONT_DESC fontDesc;
-	fontDesc.Height          = 18;
-   fontDesc.Width           = 0;
-   fontDesc.Weight          = 0;
-   fontDesc.MipLevels       = 1;
-   fontDesc.Italic          = false;
-   fontDesc.CharSet         = DEFAULT_CHARSET;
-   fontDesc.OutputPrecision = OUT_DEFAULT_PRECIS;
-   fontDesc.Quality         = DEFAULT_QUALITY;
-   fontDesc.PitchAndFamily  = DEFAULT_PITCH | FF_DONTCARE;
-#pragma warning(disable: 4996)
-   _tcscpy(fontDesc.FaceName, _T("Times New Roman"));
-#pragma warning(default: 4996)
-	HR(D3DXCreateFontIndirect(gd3dDevice, &fontDesc, &mFont));
+   // sprites, font and textures:
+   mRenderer = new D3DRenderer();
+
+   // Binary telemetry; TelemetryDump turns it into CSV.
+   mTelemetry = new TelemetryWriter();
+   if(mTelemetry->open("telemetry.tel"))
+      mTelemetry->name(TELEMETRY_FRAME_US, "frame_us");
+   else
+      OutputDebugString("cannot write telemetry.tel\n");
 
    // set camera height:
    mCameraPosZ = -1000.f;
-   // initialize player scores:
-   player1Score = 0; player2Score = 0;
-
-   // load textures:
-	HR(D3DXCreateTextureFromFile(gd3dDevice, "bkgd1.bmp", &mBkgdTex));
-	HR(D3DXCreateTextureFromFile(gd3dDevice, "ball.bmp",  &mBallTex));
-	HR(D3DXCreateTextureFromFile(gd3dDevice, "pad.bmp",   &mPadTex));
-
-   // set background data:
-	mBkgdCenter = D3DXVECTOR3(256.0f, 256.0f, 0.0f);
-
-   // set field dimensions:
-   /*RECT R;
-   GetClientRect(mhMainWnd, &R);*/
-   field.top    =  400; //   R.bottom / 2; 
-   field.bottom = -400; // -(R.bottom / 2); 
-   field.right  =  550; //   R.right / 2; 
-   field.left   = -550; // -(R.right / 2);
-
-   // set ball data:
-	mBallCenter = D3DXVECTOR3(32.0f, 32.0f, 0.0f);
-   ball.pos.x = 0.0f; ball.pos.y = 0.0f; ball.pos.z = 0;
-   ball.rotation = D3DXToRadian(200);
-   r_angle = ball.rotation;
-
-   // set pads data:
-   pad1.center = D3DXVECTOR3(64.0f, 64.0f, 0.0f);
-	pad2.center = D3DXVECTOR3(64.0f, 64.0f, 0.0f);
-   pad1.pos.x = (float) field.left;  pad1.pos.y = 0.0f; pad1.pos.z = 0.0f;
-   pad2.pos.x = (float) field.right; pad2.pos.y = 0.0f; pad2.pos.z = 0.0f;
-   pad2.rotation = D3DX_PI;
-   pad1.setBoundingBox(D3DXVECTOR3(50.0f, 70.0f, 0.0f));
-   pad2.setBoundingBox(D3DXVECTOR3(50.0f, 70.0f, 0.0f));
+
+   mShowStats   = false;
+   mStatsKeyDown = mTraceKeyDown = false;
+   mPad2AI = mAIKeyDown = false;
+   pongAIInit(mAI, 0.15f, 30.0f, (unsigned int) time(NULL));
+
+   // set field, ball, pads and scores; serves are seeded from the clock:
+   unsigned int seed = (unsigned int) time(NULL);
+   pongInit(mState, seed);
+   mPrevState = mDrawState = mState;
+   mInputSource = 0;
+   mSimulation  = 0;
+   mFrameUs     = -1;
+
+   // Simulate at 120 Hz whatever the frame rate, catching up at most
+   // a tenth of a second after a hitch.
+   enableFixedTimestep(true, 120.0f, 12);
+
+   // The seed and every tick's input replay the match exactly, which
+   // needs the fixed timestep; ReplayPlayer re-simulates it.
+   mReplay = new ReplayWriter();
+   if(!mReplay->open("last.replay", seed, mTimestep.tickDt(), mState.rallyTimeout))
+      OutputDebugString("cannot write last.replay\n");
 
 	onResetDevice();
 }
 
 PongDemo::~PongDemo()
 {
+   delete mSimulation;
 	delete mGfxStats;
-	ReleaseCOM(mSprite);
+   delete mRenderer;
+   delete mTelemetry;
+   delete mReplay;
    ReleaseCOM(mLine);
-   ReleaseCOM(mFont);
-	ReleaseCOM(mBkgdTex);
-	ReleaseCOM(mBallTex);
-	ReleaseCOM(mPadTex);
+}
+
+void PongDemo::useSimThread()
+{
+   mSimulation = new SimThread(*this, mInputSource, mTimestep.tickRate(), 12);
+   enableThreadedSimulation(mSimulation);
 }
 
 bool PongDemo::checkDeviceCaps()
@@ -237,27 +200,22 @@ bool PongDemo::checkDeviceCaps()
 
 void PongDemo::onLostDevice()
 {
+	// Reset() puts every state back to its default.
+	gd3dStates->onLostDevice();
 	mGfxStats->onLostDevice();
-	HR(mSprite->OnLostDevice());
+   mRenderer->onLostDevice();
    HR(mLine->OnLostDevice());
-   HR(mFont->OnLostDevice());
 }
 
 void PongDemo::onResetDevice()
 {
 	// Call the onResetDevice of other objects.
 	mGfxStats->onResetDevice();
-	HR(mSprite->OnResetDevice());
+   mRenderer->onResetDevice();
    HR(mLine->OnResetDevice());
-   HR(mFont->OnResetDevice());
 
 	// Sets up the camera 1000 units back looking at the origin.
-	D3DXMATRIX V;
-	D3DXVECTOR3 pos(0.0f, 0.0f, mCameraPosZ); //-1000.0f
-	D3DXVECTOR3 up(0.0f, 1.0f, 0.0f);
-	D3DXVECTOR3 target(0.0f, 0.0f, 0.0f);
-	D3DXMatrixLookAtLH(&V, &pos, &target, &up);
-	HR(gd3dDevice->SetTransform(D3DTS_VIEW, &V));
+   mRenderer->setCameraZ(mCameraPosZ); //-1000.0f
 
 	// The following code defines the volume of space the camera sees.
 	D3DXMATRIX P;
@@ -266,192 +224,99 @@ void PongDemo::onResetDevice()
 	float width  = (float)R.right;
 	float height = (float)R.bottom;
 	D3DXMatrixPerspectiveFovLH(&P, D3DX_PI*0.25f, width/height, 1.0f, 5000.0f);
-	HR(gd3dDevice->SetTransform(D3DTS_PROJECTION, &P));
-
-	// This code sets texture filters, which helps to smooth out distortions
-	// when you scale a texture.  
-	HR(gd3dDevice->SetSamplerState(0, D3DSAMP_MAGFILTER, D3DTEXF_LINEAR));
-	HR(gd3dDevice->SetSamplerState(0, D3DSAMP_MINFILTER, D3DTEXF_LINEAR));
-	HR(gd3dDevice->SetSamplerState(0, D3DSAMP_MIPFILTER, D3DTEXF_LINEAR));
-
-	// This line of code disables Direct3D lighting.
-	HR(gd3dDevice->SetRenderState(D3DRS_LIGHTING, false));
-	
-	// The following code specifies an alpha test and reference value.
-	HR(gd3dDevice->SetRenderState(D3DRS_ALPHAREF, 10));
-	HR(gd3dDevice->SetRenderState(D3DRS_ALPHAFUNC, D3DCMP_GREATER));
-
-	// The following code is used to setup alpha blending.
-	HR(gd3dDevice->SetTextureStageState(0, D3DTSS_ALPHAARG1, D3DTA_TEXTURE));
-	HR(gd3dDevice->SetTextureStageState(0, D3DTSS_ALPHAOP, D3DTOP_SELECTARG1));
-	HR(gd3dDevice->SetRenderState(D3DRS_SRCBLEND, D3DBLEND_SRCALPHA));
-	HR(gd3dDevice->SetRenderState(D3DRS_DESTBLEND, D3DBLEND_INVSRCALPHA));
-
-	// Indicates that we are using 2D texture coordinates.
-	HR(gd3dDevice->SetTextureStageState(0, D3DTSS_TEXTURETRANSFORMFLAGS, D3DTTFF_COUNT2));
+	HR(gd3dStates->setTransform(D3DTS_PROJECTION, P));
 }
 
-void PongDemo::updateScene(float dt)
+void PongDemo::updateFrame(float dt)
 {
 	// Two triangles for each sprite--two for background,
-	// two for ship, and two for each bullet.  Similarly,
+	// two for each pad, and two for the ball.  Similarly,
 	// 4 vertices for each sprite.
-	/*mGfxStats->setTriCount(0);
-	mGfxStats->setVertexCount(0);
-	mGfxStats->update(dt);*/
+	mGfxStats->setTriCount(8);
+	mGfxStats->setVertexCount(16);
+	mGfxStats->update(dt);
+	// The telemetry writer belongs to whichever thread ticks.  A frame
+	// the simulation thread has not picked up by the next is not logged.
+	if(mSimulation)
+		mFrameUs.store((long long)(dt * 1e6f));
+	else
+		mTelemetry->counter(TELEMETRY_FRAME_US, (long long)(dt * 1e6f));
 
 	// Get snapshot of input devices.
 	gDInput->poll();
+   if(mInputSource && !mSimulation)
+      mInputSource->pump(mInputQueue, (long long)(mFrameTime * 1e6));
 
-	// Update game objects.
-   updateCamera(dt);
-	updateBall(dt);
-   updatePad(dt);
-}
+   // Profiler keys act once per press.
+   bool statsKey = gDInput->keyDown(DIK_F3);
+   if(statsKey && !mStatsKeyDown)
+      mShowStats = !mShowStats;
+   mStatsKeyDown = statsKey;
 
-void PongDemo::updateBall(float dt)
-{
-   if(gDInput->keyDown(DIK_R))
-   {
-      ball.rotation = r_angle;
-      ball.pos.x = ball.pos.y = ball.pos.z = 0.0f;
-   }
-   if(gDInput->keyDown(DIK_T))
-      ball.rotation -= D3DX_PI * dt;//D3DXToRadian(1);
-   if(gDInput->keyDown(DIK_G))
-      ball.rotation += D3DX_PI * dt;
+   bool aiKey = gDInput->keyDown(DIK_F2);
+   if(aiKey && !mAIKeyDown)
+      mPad2AI = !mPad2AI;
+   mAIKeyDown = aiKey;
 
-   // check upper and lower bounds for collision, upper first:
-   if (ball.pos.y > field.top)
-   {
-      if (ball.rotation >= D3DX_PI)
-      {
-         ball.rotation = D3DX_PI + (2 * D3DX_PI - ball.rotation);
-      }
-      else 
-         if (ball.rotation < D3DX_PI)
-         {
-            ball.rotation += D3DX_PI - ball.rotation * 2;
-         }
-      ball.pos.y -= 10;
-   }
-   // now check for lower bound:
-   else if (ball.pos.y < field.bottom)
-   {
-      if (ball.rotation <= D3DX_PI)
-      {
-         ball.rotation = D3DX_PI - ball.rotation;
-      }
-      else if (ball.rotation > D3DX_PI)
-      {
-         float temp = ball.rotation - D3DX_PI;
-         ball.rotation = (2 * D3DX_PI) - temp;
-      }
-      ball.pos.y += 10;
-   }
+   bool traceKey = gDInput->keyDown(DIK_F12);
+   if(traceKey && !mTraceKeyDown && !profileExportChromeTrace("frame_trace.json"))
+      OutputDebugString("cannot write frame_trace.json\n");
+   mTraceKeyDown = traceKey;
 
-   // check for left collision:
-   if (ball.pos.x < field.left)
-   {
-      //ball.rotation = 2 * D3DX_PI - ball.rotation;
-      player2Score++;
-      //Sleep(500);
-      ball.pos.x = ball.pos.y = 0;
-      int angleDegree = rand() % 360;
-      ball.rotation = D3DXToRadian(angleDegree);
-   }
-   else if (ball.pos.x > field.right)
-   {
-      player1Score++;
-      //Sleep(500);
-      ball.pos.x = ball.pos.y = 0;
-      int angleDegree = rand() % 360;
-      ball.rotation = D3DXToRadian(angleDegree);
-   }
+   updateCamera(dt);
+}
 
-   // check for pads collision:
-   if (pad1.checkCollision(ball.pos))
-   {
-      ball.rotation = (2 * D3DX_PI) - ball.rotation;
-      ball.pos.x += 20;
-      //debugging:
-      /*ball.pos.x = ball.pos.y = 0.0f;
-      ball.rotation += D3DXToRadian(5.0f);*/
-   }
-   if (pad2.checkCollision(ball.pos))
-   {
-      ball.rotation = ((2 * D3DX_PI) - ball.rotation);
-      ball.pos.x -= 20;
-   }
+void PongDemo::updateScene(float dt)
+{
+   PROFILE_SCOPE("updateScene");
+   // Every key press and release up to the end of this tick, with when
+   // in the tick it happened.
+   long long tickEnd = (long long)(mTickTime * 1e6);
+   step(mInputQueue.consume(tickEnd - (long long)(dt * 1e6), tickEnd, dt), dt);
+}
 
-	D3DXVECTOR3 dir(-sinf(ball.rotation), cosf(ball.rotation), 0.0f);
-   ball.pos += dir * ball.BALL_SPEED * dt;
+void PongDemo::simTick(const PongTimedInput& in, float dt)
+{
+   long long frameUs = mFrameUs.exchange(-1);
+   if(frameUs >= 0)
+      mTelemetry->counter(TELEMETRY_FRAME_US, frameUs);
+   step(in, dt);
 }
 
-void PongDemo::updatePad(float dt)
+void PongDemo::simSnapshot(SimSnapshot& out)
 {
-   // Pad1:
-	// Check input.
-   if(gDInput->keyDown(DIK_W))	
-   {
-      if (pad1.pos.y < field.top)
-      {
-         float old = pad1.pos.y;              // store old value
-         pad1.pos.y += pad1.PAD_SPEED * dt;   // increment pad
-         float difference = pad1.pos.y - old; // incremented value - old value
-         pad1.updateBoundingBox(difference);  // update bounding box
-      }
-   }
-   if(gDInput->keyDown(DIK_S))
-   {
-      if (pad1.pos.y > field.bottom)
-      {
-         float old = pad1.pos.y;             // store old value
-         pad1.pos.y -= pad1.PAD_SPEED * dt;  // decrement pad
-         float difference = abs(abs(pad1.pos.y) - abs(old));  // decremented value - old value
-         pad1.updateBoundingBox(-difference);   // update bounding box
-      }
-   }
+   out.prev  = mPrevState;
+   out.state = mState;
+}
 
-   // Pad2:
-	// Check input.
-   if(gDInput->keyDown(DIK_NUMPAD8))
-   {
-      if (pad2.pos.y < field.top)
-      {
-         float old = pad2.pos.y;              // store old value
-         pad2.pos.y += pad2.PAD_SPEED * dt;   // increment pad
-         float difference = pad2.pos.y - old; // incremented value - old value
-         pad2.updateBoundingBox(difference);  // update bounding box
-      }
-   }
-	if(gDInput->keyDown(DIK_NUMPAD5))
+void PongDemo::step(const PongTimedInput& timed, float dt)
+{
+	// Update game objects.
+   mPrevState = mState;
+   PongTimedInput in = timed;
+   if(mPad2AI)
    {
-      if (pad2.pos.y > field.bottom)
-      {
-         float old = pad2.pos.y;              // store old value
-         pad2.pos.y -= pad2.PAD_SPEED * dt;   // decrement pad
-         float difference = abs(abs(pad2.pos.y) - abs(old));  // incremented value - old value
-         pad2.updateBoundingBox(-difference); // update bounding box
-      }
+      // The AI's buttons replace the keypad's and are held all tick.
+      unsigned int ai = pongAIInput(mAI, mState, 2, dt);
+      in.input.buttons = (in.input.buttons & ~(BTN_PAD2_UP | BTN_PAD2_DOWN)) | ai;
+      in.held[pongButtonIndex(BTN_PAD2_UP)]   = (ai & BTN_PAD2_UP)   ? dt : 0.0f;
+      in.held[pongButtonIndex(BTN_PAD2_DOWN)] = (ai & BTN_PAD2_DOWN) ? dt : 0.0f;
    }
+   unsigned int events = pongStepTimed(mState, in, dt);
+   mTelemetry->frame(mState, events);
+   mReplay->tick(in, mState);
 }
 
 void PongDemo::updateCamera(float dt)
 {
    float z = gDInput->mouseDZ();
    mCameraPosZ += z;
-
-	D3DXMATRIX V;
-	D3DXVECTOR3 pos(0.0f, 0.0f, mCameraPosZ); //-1000.0f
-	D3DXVECTOR3 up(0.0f, 1.0f, 0.0f);
-	D3DXVECTOR3 target(0.0f, 0.0f, 0.0f);
-	D3DXMatrixLookAtLH(&V, &pos, &target, &up);
-	HR(gd3dDevice->SetTransform(D3DTS_VIEW, &V));
+   mRenderer->setCameraZ(mCameraPosZ);
 }
 
 void PongDemo::drawScene()
 {
+   PROFILE_SCOPE("drawScene");
 	// Clear the backbuffer and depth buffer.
 	HR(gd3dDevice->Clear(0, 0, D3DCLEAR_TARGET | D3DCLEAR_ZBUFFER, 0xffffffff, 1.0f, 0));
 	HR(gd3dDevice->BeginScene());
@@ -469,83 +334,27 @@ void PongDemo::drawScene()
    HR(mLine->End());*/
    // end draw lines.
 
-	HR(mSprite->Begin(D3DXSPRITE_OBJECTSPACE | D3DXSPRITE_DONOTMODIFY_RENDERSTATE));
-	drawBkgd();
-	drawPad();	
-	drawBall();
-	//mGfxStats->display();
-   drawScore();
+	// Draw between the last two ticks to hide the fixed timestep.
+	if(mSimulation)
+	{
+		// The simulation thread's newest ticks, blended by its clock.
+		const SimSnapshot& snap = mSimulation->latest();
+		mDrawState = pongLerp(snap.prev, snap.state, mSimulation->alpha(snap));
+		mGfxStats->setSimTiming(snap.timing);
+	}
+	else
+		mDrawState = pongLerp(mPrevState, mState, mRenderAlpha);
+
+	mRenderer->drawScene(mDrawState);
+	mGfxStats->setQueueStats(mRenderer->queueStats());
+	// Every state call since the last frame's, camera included.
+	mGfxStats->setDeviceStateStats(gd3dStates->stats());
+	gd3dStates->resetStats();
+	if(mShowStats)
+		mGfxStats->display();
 
-	HR(mSprite->End());
 	HR(gd3dDevice->EndScene());
 	// Present the backbuffer.
+	PROFILE_SCOPE("Present");
 	HR(gd3dDevice->Present(0, 0, 0, 0));
 }
-
-void PongDemo::drawBkgd()
-{
-	// Set a texture coordinate scaling transform.  Here we scale the texture 
-	// coordinates by 10 in each dimension. This tiles the texture 
-	// ten times over the sprite surface.
-	D3DXMATRIX texScaling;
-	D3DXMatrixScaling(&texScaling, 10.0f, 10.0f, 0.0f);
-	HR(gd3dDevice->SetTransform(D3DTS_TEXTURE0, &texScaling));
-
-	D3DXMATRIX T, S;
-	D3DXMatrixScaling(&S, 20.0f, 20.0f, 0.0f);
-	HR(mSprite->SetTransform(&S));
-
-	// Draw the background sprite.
-	HR(mSprite->Draw(mBkgdTex, 0, &mBkgdCenter, 0, D3DCOLOR_XRGB(255, 255, 255)));
-	HR(mSprite->Flush());
-
-	// Restore defaults texture coordinate scaling transform.
-	D3DXMatrixScaling(&texScaling, 1.0f, -1.0f, 0.0f);
-	HR(gd3dDevice->SetTransform(D3DTS_TEXTURE0, &texScaling));
-}
-
-void PongDemo::drawPad()
-{
-	// Turn on the alpha test.
-	HR(gd3dDevice->SetRenderState(D3DRS_ALPHATESTENABLE, true));
-
-	// Set orientation.
-	D3DXMATRIX T, R;
-   
-   D3DXMatrixTranslation(&T, pad1.pos.x, pad1.pos.y, pad1.pos.z);
-	HR(mSprite->SetTransform(&T));
-   HR(mSprite->Draw(mPadTex, 0, &pad1.center, 0, D3DCOLOR_XRGB(255, 255, 255)));
-	
-   D3DXMatrixTranslation(&T, pad2.pos.x, pad2.pos.y, pad2.pos.z);
-   D3DXMatrixRotationZ(&R, pad2.rotation);
-   HR(mSprite->SetTransform(&(R*T)));
-   HR(mSprite->Draw(mPadTex, 0, &pad2.center, 0, D3DCOLOR_XRGB(255, 255, 255)));
-   
-   HR(mSprite->Flush());
-
-	// Turn off the alpha test.
-	HR(gd3dDevice->SetRenderState(D3DRS_ALPHATESTENABLE, false));
-}
-
-void PongDemo::drawBall()
-{
-	HR(gd3dDevice->SetRenderState(D3DRS_ALPHABLENDENABLE, true));
-	D3DXMATRIX T;
-	D3DXMatrixTranslation(&T, ball.pos.x, ball.pos.y, ball.pos.z);
-	HR(mSprite->SetTransform(&T));
-	HR(mSprite->Draw(mBallTex, 0, &mBallCenter, 0, D3DCOLOR_XRGB(255, 255, 255)));
-	HR(mSprite->Flush());
-	HR(gd3dDevice->SetRenderState(D3DRS_ALPHABLENDENABLE, false));
-}
-
-void PongDemo::drawScore()
-{
-	// Make static so memory is not allocated every frame.
-	static char buffer[256];
-#pragma warning(disable: 4996)
-	sprintf(buffer, "Player 1 score:  %d\n"
-                   "Player 2 score:  %d", player1Score, player2Score);
-#pragma warning(default: 4996)
-	RECT R = {5, 5, 0, 0};
-	HR(mFont->DrawText(0, buffer, -1, &R, DT_NOCLIP, D3DCOLOR_XRGB(0,0,0)));
-}
\ No newline at end of file
@@ -0,0 +1,83 @@
+//=============================================================================
+// PongAI.cpp
+//=============================================================================
+
+#include "PongAI.h"
+#include "PongCollision.h"
+#include <math.h>
+
+bool pongPredictIntercept(const PongState& s, const PadInfo& pad, float& y, float& time)
+{
+   SimVec2 vel = pongBallVelocity(s.ball);
+   bool leftPad = pad.pos.x < 0.5f * (s.field.left + s.field.right);
+   if (leftPad ? vel.x >= 0.0f : vel.x <= 0.0f)
+      return false;
+
+   // The ball centre touches the pad's inner face one radius out.
+   float faceX = leftPad ? pad.bound2.x + BALL_RADIUS : pad.bound1.x - BALL_RADIUS;
+   time = (faceX - s.ball.pos.x) / vel.x;
+   if (time < 0.0f)
+      time = 0.0f;
+
+   // Unfold the wall bounces: in a mirrored copy of the band the ball
+   // flies straight, and folding its height back lands it where it would
+   // have bounced to.
+   float lo = s.field.bottom + BALL_RADIUS;
+   float band = s.field.top - BALL_RADIUS - lo;
+   float u = fmodf(s.ball.pos.y + vel.y * time - lo, 2.0f * band);
+   if (u < 0.0f)
+      u += 2.0f * band;
+   if (u > band)
+      u = 2.0f * band - u;
+   y = lo + u;
+   return true;
+}
+
+void pongAIInit(PongAI& ai, float reactionDelay, float aimError, unsigned int seed)
+{
+   ai.reactionDelay = reactionDelay;
+   ai.aimError      = aimError;
+   ai.rng           = seed ? seed : 0x9E3779B9u;
+   ai.noticed       = 0.0f;
+   ai.offset        = 0.0f;
+   ai.targetY       = 0.0f;
+   ai.lastLife      = 0.0f;
+   ai.heading       = 0;
+   ai.planned       = false;
+}
+
+unsigned int pongAIInput(PongAI& ai, const PongState& s, int pad, float dt)
+{
+   const PadInfo& p = pad == 1 ? s.pad1 : s.pad2;
+   SimVec2 vel = pongBallVelocity(s.ball);
+   int heading = (pad == 1 ? vel.x < 0.0f : vel.x > 0.0f) ? 1 : -1;
+
+   // A new approach: react to it only after the delay, with a new aim.
+   if (heading != ai.heading || s.ball.life < ai.lastLife)
+   {
+      ai.heading = heading;
+      ai.noticed = 0.0f;
+      ai.planned = false;
+      ai.offset  = ((simRandom(ai.rng) >> 8) * (1.0f / 16777216.0f) * 2.0f - 1.0f) * ai.aimError;
+   }
+   ai.lastLife = s.ball.life;
+   ai.noticed += dt;
+   if (ai.noticed >= ai.reactionDelay)
+      ai.planned = true;
+
+   // Until then it carries on towards its old target.
+   if (ai.planned)
+   {
+      float y, time;
+      if (heading > 0 && pongPredictIntercept(s, p, y, time))
+         ai.targetY = y + ai.offset;
+      else
+         ai.targetY = 0.5f * (s.field.top + s.field.bottom);
+   }
+
+   // Stop within half a tick's movement so the pad does not dither.
+   float deadZone = 0.5f * PAD_SPEED * dt;
+   if (ai.targetY > p.pos.y + deadZone) return pad == 1 ? BTN_PAD1_UP : BTN_PAD2_UP;
+   if (ai.targetY < p.pos.y - deadZone) return pad == 1 ? BTN_PAD1_DOWN : BTN_PAD2_DOWN;
+   return 0;
+}
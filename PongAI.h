@@ -0,0 +1,49 @@
+//=============================================================================
+// PongAI.h
+//
+// A computer opponent that plays where the ball is going rather than where
+// it is.  Between pad hits the ball flies in a straight line and bounces
+// off the walls by mirroring its vertical velocity, so the height at which
+// it reaches a pad is the straight-line height folded back into the band
+// the ball centre can occupy, [bottom + BALL_RADIUS, top - BALL_RADIUS]:
+// one division and one fmodf however many bounces are in between.
+//
+// Like a player, the AI takes reactionDelay seconds to notice that the ball
+// has turned towards it (or been served) before it moves, then aims a
+// random amount up to aimError off the intercept; a miss needs aimError
+// above PAD_HALF_HEIGHT + BALL_RADIUS.  While the ball heads away it drifts
+// back to the middle.  A PongAI is a small POD, one per pad, so batched
+// simulations can keep one beside each PongState; every decision is O(1).
+//=============================================================================
+
+#ifndef PONG_AI_H
+#define PONG_AI_H
+
+#include "PongSim.h"
+
+// The height the ball centre will be at when it reaches pad's face, and
+// in how many seconds.  false if the ball is not heading for that pad.
+bool pongPredictIntercept(const PongState& s, const PadInfo& pad, float& y, float& time);
+
+struct PongAI
+{
+   // Tuning.
+   float        reactionDelay;  // seconds
+   float        aimError;       // units either side of the intercept
+
+   // What it is doing.
+   unsigned int rng;
+   float        noticed;        // seconds since the ball last turned or was served
+   float        offset;         // aim error picked for this approach
+   float        targetY;
+   float        lastLife;
+   int          heading;        // +1 towards this pad, -1 away
+   bool         planned;
+};
+
+void pongAIInit(PongAI& ai, float reactionDelay, float aimError, unsigned int seed);
+
+// The buttons for pad (1 or 2) this tick.
+unsigned int pongAIInput(PongAI& ai, const PongState& s, int pad, float dt);
+
+#endif // PONG_AI_H
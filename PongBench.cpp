@@ -0,0 +1,1692 @@
+//=============================================================================
+// PongBench.cpp
+//
+// Performance benchmarks for the headless parts of the game.  Every case is
+// self-contained; run them all or pick some by name.  Builds on any platform:
+//
+//    g++ -O2 -std=c++11 PongBench.cpp PongSim.cpp PongCollision.cpp PongFastForward.cpp
+//        PongMatch.cpp BallBatch.cpp SoftwareRenderer.cpp BmpImage.cpp
+//        FrameTimeHistogram.cpp Telemetry.cpp Replay.cpp PongRollback.cpp PongNet.cpp
+//        PongSnapshot.cpp PongAI.cpp PongVecEnv.cpp RenderQueue.cpp RenderStateCache.cpp
+//        InputQueue.cpp SimThread.cpp FrameProfiler.cpp -pthread -o PongBench
+//
+// The render and bmpload cases load the game's .bmp files from the current
+// directory, and leave their .bmp.tex caches there.  The bmpload, telemetry
+// and replayseek cases write and delete bench.* files there.
+//
+// usage: PongBench [case ...]
+//=============================================================================
+
+#include "PongSim.h"
+#include "PongCollision.h"
+#include "PongFastForward.h"
+#include "PongMatch.h"
+#include "BallBatch.h"
+#include "SoftwareRenderer.h"
+#include "BmpImage.h"
+#include "FrameTimeHistogram.h"
+#include "Telemetry.h"
+#include "Replay.h"
+#include "PongRollback.h"
+#include "PongNet.h"
+#include "PongSnapshot.h"
+#include "PongAI.h"
+#include "PongVecEnv.h"
+#include "RenderQueue.h"
+#include "RenderStateCache.h"
+#include "InputQueue.h"
+#include "FixedTimestep.h"
+#include "SimThread.h"
+#include "TripleBuffer.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+#if defined(__linux__)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+static double nowSeconds()
+{
+   return std::chrono::duration<double>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Serves n balls from random points in the middle of the field.
+static void fillBatch(BallBatch& batch, int n, unsigned int seed)
+{
+   batch.resize(n);
+   unsigned int rng = seed;
+   for (int i = 0; i < n; i++)
+   {
+      BallInfo ball;
+      ball.pos.x    = (float)(simRandom(rng) % 800) - 400.0f;
+      ball.pos.y    = (float)(simRandom(rng) % 600) - 300.0f;
+      ball.speed    = BALL_SPEED;
+      ball.rotation = (simRandom(rng) % 360) * (SIM_PI / 180.0f);
+      ball.life     = 0.0f;
+      batch.setBall(i, ball);
+   }
+}
+
+//===============================================================
+// ballbatch: balls/sec of every BallBatch kernel as N grows.
+
+static void benchBallBatch()
+{
+   PongState s;
+   pongInit(s, 1);
+   const float dt = 1.0f / 120.0f;
+
+   // The kernels must agree before their speed means anything.
+   {
+      BallBatch reference, other;
+      for (int k = BATCH_KERNEL_SSE; k <= BATCH_KERNEL_AVX2; k++)
+      {
+         if (!BallBatch::isKernelSupported((BatchKernel)k))
+            continue;
+         fillBatch(reference, 1000, 7);
+         fillBatch(other, 1000, 7);
+         for (int step = 0; step < 2000; step++)
+         {
+            reference.stepWith(BATCH_KERNEL_SCALAR, s.pad1, s.pad2, s.field, dt);
+            other.stepWith((BatchKernel)k, s.pad1, s.pad2, s.field, dt);
+         }
+         bool same = memcmp(reference.x, other.x, 1000 * sizeof(float)) == 0 &&
+                     memcmp(reference.y, other.y, 1000 * sizeof(float)) == 0 &&
+                     memcmp(reference.life, other.life, 1000 * sizeof(float)) == 0;
+         printf("  %-6s matches scalar: %s\n", BallBatch::kernelName((BatchKernel)k), same ? "yes" : "NO");
+      }
+   }
+
+   printf("  %10s %8s %14s %10s\n", "balls", "kernel", "balls/sec", "ns/ball");
+   for (int n = 1024; n <= 4 * 1024 * 1024; n *= 4)
+   {
+      for (int k = BATCH_KERNEL_SCALAR; k <= BATCH_KERNEL_AVX2; k++)
+      {
+         BatchKernel kernel = (BatchKernel)k;
+         if (!BallBatch::isKernelSupported(kernel))
+            continue;
+
+         // Run for at least a quarter of a second.  The batch is served
+         // again every 64 steps (untimed) so that most balls stay in play;
+         // retired lanes would flatter the scalar kernel, which skips them.
+         BallBatch batch;
+         long long steps = 0;
+         double elapsed = 0.0;
+         do
+         {
+            fillBatch(batch, n, 7 + (unsigned int)steps);
+            double start = nowSeconds();
+            for (int i = 0; i < 64; i++)
+               batch.stepWith(kernel, s.pad1, s.pad2, s.field, dt);
+            elapsed += nowSeconds() - start;
+            steps += 64;
+         } while (elapsed < 0.25);
+
+         double ballsPerSec = (double)n * steps / elapsed;
+         printf("  %10d %8s %14.0f %10.3f\n", n, BallBatch::kernelName(kernel),
+                ballsPerSec, 1e9 / ballsPerSec);
+      }
+   }
+}
+
+//===============================================================
+// sweep: cost of a swept pongUpdateBall() tick as the ball gets faster,
+// and whether the old centre test would have let it through a pad.
+
+// Fires the ball straight at pad2 from x = -100 and reports whether its
+// centre point ever lands inside the pad when it is moved by speed * dt at
+// a time, which is all the old updateBall() tested.
+static bool centreTestCatches(const PongState& s, float speed, float dt)
+{
+   float x = -100.0f, y = s.pad2.pos.y;
+   float step = speed * dt;
+   while (x < s.field.right)
+   {
+      x += step;
+      SimVec2 p = { x, y };
+      if (s.pad2.checkCollision(p))
+         return true;
+   }
+   return false;
+}
+
+// Keeps the timed calls from being optimised away.
+static volatile unsigned int gEventSink;
+
+static void benchSweep()
+{
+   const float speeds[] = { BALL_SPEED, BALL_MAX_SPEED, 5000.0f, 20000.0f };
+   const float dts[]    = { 1.0f / 120.0f, 1.0f / 10.0f };
+
+   printf("  %8s %6s %12s %10s %12s %12s\n",
+          "speed", "dt", "ticks/sec", "ns/tick", "centre test", "swept");
+   for (int d = 0; d < 2; d++)
+   {
+      for (int v = 0; v < 4; v++)
+      {
+         float speed = speeds[v], dt = dts[d];
+
+         // Tunnelling: does a ball aimed at the middle of pad2 get
+         // bounced back before it reaches the right side?
+         PongState s;
+         pongInit(s, 1);
+         s.ball.pos.x = -100.0f;
+         s.ball.pos.y = s.pad2.pos.y;
+         s.ball.speed = speed;
+         s.ball.rotation = 1.5f * SIM_PI;
+         PongInput none = { 0 };
+         bool swept = false;
+         for (int i = 0; i < 1000; i++)
+         {
+            unsigned int events = pongUpdateBall(s, none, dt);
+            if (events & EVT_PAD2_HIT) { swept = true;  break; }
+            if (events & EVT_GOAL_P1)  { swept = false; break; }
+         }
+         bool centre = centreTestCatches(s, speed, dt);
+
+         // Cost: keep the ball in play at this speed, off walls and pads
+         // and through goals, which is several contacts a tick at the top.
+         pongInit(s, 1);
+         s.ball.speed = speed;
+         s.ball.rotation = 1.5f * SIM_PI + 0.3f;
+         long long ticks = 0;
+         double start = nowSeconds(), elapsed;
+         do
+         {
+            for (int i = 0; i < 4096; i++)
+            {
+               gEventSink += pongUpdateBall(s, none, dt);
+               s.ball.speed = speed;
+            }
+            ticks += 4096;
+            elapsed = nowSeconds() - start;
+         } while (elapsed < 0.25);
+
+         printf("  %8.0f %6.3f %12.0f %10.1f %12s %12s\n", speed, dt,
+                ticks / elapsed, 1e9 * elapsed / ticks,
+                centre ? "hit" : "TUNNELS", swept ? "hit" : "TUNNELS");
+      }
+   }
+}
+
+//===============================================================
+// fastforward: whole matches of the tracking bot, stepped per tick by
+// pongPlayMatch() and jumped from event to event by pongFastForward().
+
+static void benchFastForward()
+{
+   const int matches = 200;
+   const int points  = 11;
+
+   MatchConfig config;
+   config.pointsToWin = points;
+   config.dt          = 1.0f / 120.0f;
+   config.maxTicks    = 0xFFFFFFFF;
+   config.pad2Reaction = -1.0f;
+   config.pad2AimError = 0.0f;
+
+   long long ticks = 0, tickRallies = 0;
+   int p1Wins = 0;
+   double start = nowSeconds();
+   for (int m = 0; m < matches; m++)
+   {
+      config.seed = 1 + m;
+      MatchResult r = pongPlayMatch(config);
+      ticks += r.ticks;
+      tickRallies += r.rallies;
+      p1Wins += r.player1Score > r.player2Score;
+   }
+   double stepped = nowSeconds() - start;
+
+   // Same bot, same rally timeout as pongPlayMatch().
+   TrackingPolicy bot;
+   bot.reactionDistance = 300.0f;
+   bot.aimError         = 90.0f;
+   long long contacts = 0, samples = 0, rallies = 0;
+   double simulated = 0.0;
+   int ffP1Wins = 0;
+   start = nowSeconds();
+   for (int m = 0; m < matches; m++)
+   {
+      PongState s;
+      pongInit(s, 1 + m);
+      s.rallyTimeout = 30.0f;
+      while (s.player1Score < points && s.player2Score < points)
+      {
+         FastForwardResult r = pongFastForward(s, 1.0e6f, pongTrackingPolicy, &bot,
+                                               EVT_GOAL_P1 | EVT_GOAL_P2);
+         contacts  += r.contacts;
+         samples   += r.samples;
+         simulated += r.time;
+         rallies++;
+      }
+      ffP1Wins += s.player1Score > s.player2Score;
+   }
+   double jumped = nowSeconds() - start;
+
+   printf("  %-12s %10s %12s %14s %10s\n", "mode", "wall ms", "p1 wins", "work/rally", "speedup");
+   printf("  %-12s %10.1f %8d/%-3d %9.0f ticks %10s\n", "per tick", stepped * 1e3,
+          p1Wins, matches, (double)ticks / tickRallies, "1.0x");
+   printf("  %-12s %10.1f %8d/%-3d %7.1f events %9.1fx\n", "fastforward", jumped * 1e3,
+          ffP1Wins, matches, (double)(contacts + samples) / rallies, stepped / jumped);
+   printf("  %.1f simulated hours, %.1f contacts and %.1f policy samples per rally\n",
+          simulated / 3600.0, (double)contacts / rallies, (double)samples / rallies);
+}
+
+//===============================================================
+// render: SoftwareRenderer frames/sec per kernel and resolution, and the
+// blend and alpha test span kernels on their own.
+
+static void benchRender()
+{
+   // Both kernels must draw the same frame.
+   {
+      SoftwareRenderer a(800, 600), b(800, 600);
+      if (!a.loadTextures("") || !b.loadTextures(""))
+         return;
+      PongState s;
+      pongInit(s, 1);
+      s.ball.pos.x = 103.0f;
+      s.ball.pos.y = -41.5f;
+      a.setKernel(RASTER_KERNEL_SCALAR);
+      for (int k = RASTER_KERNEL_SSE2; k <= RASTER_KERNEL_SSE2; k++)
+      {
+         if (!SoftwareRenderer::isKernelSupported((RasterKernel)k))
+            continue;
+         b.setKernel((RasterKernel)k);
+         a.drawScene(s);
+         b.drawScene(s);
+         bool same = memcmp(a.pixels(), b.pixels(), a.pitch() * a.height() * sizeof(unsigned int)) == 0;
+         printf("  %-6s matches scalar: %s\n", SoftwareRenderer::kernelName((RasterKernel)k), same ? "yes" : "NO");
+      }
+   }
+
+   // Whole frames of a match in progress, one tick per frame.
+   const int sizes[][2] = { { 640, 480 }, { 800, 600 }, { 1280, 720 }, { 1920, 1080 } };
+   printf("  %10s %8s %10s %10s\n", "size", "kernel", "fps", "ms/frame");
+   for (int z = 0; z < 4; z++)
+   {
+      for (int k = RASTER_KERNEL_SCALAR; k <= RASTER_KERNEL_SSE2; k++)
+      {
+         RasterKernel kernel = (RasterKernel)k;
+         if (!SoftwareRenderer::isKernelSupported(kernel))
+            continue;
+
+         SoftwareRenderer renderer(sizes[z][0], sizes[z][1]);
+         renderer.loadTextures("");
+         renderer.setKernel(kernel);
+         PongState s;
+         pongInit(s, 1);
+         s.rallyTimeout = 30.0f;
+
+         long long frames = 0;
+         double start = nowSeconds(), elapsed;
+         do
+         {
+            pongStep(s, pongTrackingInput(s, 300.0f, 90.0f), 1.0f / 120.0f);
+            renderer.drawScene(s);
+            frames++;
+            elapsed = nowSeconds() - start;
+         } while (elapsed < 0.25);
+
+         char size[32];
+         sprintf(size, "%dx%d", sizes[z][0], sizes[z][1]);
+         printf("  %10s %8s %10.1f %10.3f\n", size, SoftwareRenderer::kernelName(kernel),
+                frames / elapsed, 1e3 * elapsed / frames);
+      }
+   }
+
+   // The span kernels over a screenful of pixels with varied alpha.
+   const int n = 1920 * 1080;
+   unsigned int* src = new unsigned int[n];
+   unsigned int* dst = new unsigned int[n];
+   unsigned int rng = 5;
+   for (int i = 0; i < n; i++)
+      src[i] = simRandom(rng);
+
+   printf("  %10s %8s %10s\n", "span", "kernel", "Mpixels/s");
+   for (int op = 0; op < 2; op++)
+   {
+      for (int k = RASTER_KERNEL_SCALAR; k <= RASTER_KERNEL_SSE2; k++)
+      {
+         RasterKernel kernel = (RasterKernel)k;
+         if (!SoftwareRenderer::isKernelSupported(kernel))
+            continue;
+
+         long long pixels = 0;
+         double start = nowSeconds(), elapsed;
+         do
+         {
+            if (op == 0) SoftwareRenderer::blendSpan(kernel, dst, src, n);
+            else         SoftwareRenderer::alphaTestSpan(kernel, dst, src, n, 10);
+            pixels += n;
+            elapsed = nowSeconds() - start;
+         } while (elapsed < 0.25);
+
+         printf("  %10s %8s %10.0f\n", op == 0 ? "blend" : "alphatest",
+                SoftwareRenderer::kernelName(kernel), pixels / elapsed / 1e6);
+      }
+   }
+   delete[] src;
+   delete[] dst;
+}
+
+//===============================================================
+// bmpload: startup cost of the game's three textures, decoded the old way
+// (fread and a per-pixel loop), converted from the mapped BMP, and mapped
+// from the cache; plus the BGR -> BGRA kernels on their own.  First,
+// crafted headers whose sizes overflow must be refused.
+
+static const char* const gTextureFiles[] = { "bkgd1.bmp", "ball.bmp", "pad.bmp" };
+
+// What loading cost before BmpImage: read the whole file, then convert
+// pixel by pixel.  Returns a checksum of the texels, 0 on failure.
+static unsigned int loadStdio(const char* path)
+{
+   FILE* f = fopen(path, "rb");
+   if (!f)
+      return 0;
+   fseek(f, 0, SEEK_END);
+   long size = ftell(f);
+   fseek(f, 0, SEEK_SET);
+   unsigned char* file = (unsigned char*)malloc(size);
+   bool ok = size >= 54 && fread(file, 1, size, f) == (size_t)size;
+   fclose(f);
+
+   unsigned int sum = 0;
+   if (ok)
+   {
+      int offset = file[10] | (file[11] << 8) | (file[12] << 16);
+      int width  = file[18] | (file[19] << 8);
+      int height = file[22] | (file[23] << 8);
+      int bytes  = file[28] / 8;
+      int rowBytes = (width * bytes + 3) & ~3;
+      unsigned int* texels = (unsigned int*)malloc(width * height * 4);
+      for (int y = 0; y < height; y++)
+      {
+         const unsigned char* src = file + offset + rowBytes * (height - 1 - y);
+         for (int x = 0; x < width; x++, src += bytes)
+            texels[y * width + x] = src[0] | (src[1] << 8) | (src[2] << 16) |
+                                    (bytes == 4 ? (unsigned int)src[3] << 24 : 0xff000000);
+      }
+      for (int i = 0; i < width * height; i++)
+         sum += texels[i];
+      free(texels);
+   }
+   free(file);
+   return sum;
+}
+
+// Touches every texel, so a mapped cache pays for its page faults here.
+static unsigned int texelSum(const BmpImage& image)
+{
+   unsigned int sum = 0;
+   for (int i = 0; i < image.width() * image.height(); i++)
+      sum += image.texels()[i];
+   return sum;
+}
+
+// Drops the file's pages from the OS cache, so the next load reads the
+// disk.  Only done on Linux; elsewhere the "evicted" rows match the others.
+static void evictFile(const char* path)
+{
+#if defined(__linux__)
+   int fd = open(path, O_RDONLY);
+   if (fd >= 0)
+   {
+      fdatasync(fd);
+      posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+      close(fd);
+   }
+#else
+   (void)path;
+#endif
+}
+
+static void removeCaches()
+{
+   for (int i = 0; i < 3; i++)
+   {
+      char cachePath[64];
+      sprintf(cachePath, "%s.tex", gTextureFiles[i]);
+      remove(cachePath);
+   }
+}
+
+enum LoadMode { LOAD_STDIO, LOAD_CONVERT, LOAD_FIRST, LOAD_CACHED };
+
+// Milliseconds to load all three textures once in the given mode.
+static double startupMs(LoadMode mode, bool evict, unsigned int& sum)
+{
+   if (mode == LOAD_FIRST)
+      removeCaches();
+   if (evict)
+   {
+      for (int i = 0; i < 3; i++)
+      {
+         char cachePath[64];
+         sprintf(cachePath, "%s.tex", gTextureFiles[i]);
+         evictFile(gTextureFiles[i]);
+         evictFile(cachePath);
+      }
+   }
+
+   sum = 0;
+   double start = nowSeconds();
+   for (int i = 0; i < 3; i++)
+   {
+      if (mode == LOAD_STDIO)
+      {
+         sum += loadStdio(gTextureFiles[i]);
+         continue;
+      }
+      BmpImage image;
+      image.load(gTextureFiles[i], mode != LOAD_CONVERT);
+      sum += texelSum(image);
+   }
+   return 1e3 * (nowSeconds() - start);
+}
+
+// A 118-byte BMP with the given header sizes and zeroed pixel data.
+static bool writeCraftedBmp(const char* path, unsigned int width, unsigned int height, int bpp)
+{
+   unsigned char file[118];
+   memset(file, 0, sizeof(file));
+   file[0] = 'B';
+   file[1] = 'M';
+   file[2] = sizeof(file);
+   file[10] = 54;
+   file[14] = 40;
+   for (int i = 0; i < 4; i++)
+   {
+      file[18 + i] = (unsigned char)(width >> (8 * i));
+      file[22 + i] = (unsigned char)(height >> (8 * i));
+   }
+   file[26] = 1;
+   file[28] = (unsigned char)bpp;
+   FILE* f = fopen(path, "wb");
+   if (!f)
+      return false;
+   bool ok = fwrite(file, 1, sizeof(file), f) == sizeof(file);
+   return fclose(f) == 0 && ok;
+}
+
+static void benchBmpLoad()
+{
+   struct Crafted { const char* what; unsigned int width, height; int bpp; bool valid; };
+   const Crafted crafted[] =
+   {
+      { "row size overflows int",  0x08000001u, 1,           32, false },
+      { "24-bit row overflows",    0x40000000u, 1,           24, false },
+      { "height INT_MIN",          1,           0x80000000u, 32, false },
+      { "wider than BMP_MAX_SIDE", BMP_MAX_SIDE + 1, 1,      32, false },
+      { "4x4, fits the file",      4,           4,           32, true  },
+   };
+   for (size_t i = 0; i < sizeof(crafted) / sizeof(crafted[0]); i++)
+   {
+      const Crafted& c = crafted[i];
+      BmpImage image;
+      bool loaded = writeCraftedBmp("bench.bmp", c.width, c.height, c.bpp) && image.load("bench.bmp", false);
+      printf("  crafted %-24s %s%s\n", c.what, loaded ? "loaded" : "refused",
+             loaded == c.valid ? "" : "  WRONG");
+   }
+   remove("bench.bmp");
+
+   unsigned int reference = 0;
+   if (startupMs(LOAD_STDIO, false, reference), reference == 0)
+   {
+      printf("  cannot read the .bmp files from the current directory\n");
+      return;
+   }
+
+   const char* names[] = { "stdio + per-pixel", "map + convert", "first launch", "cached" };
+   printf("  %-18s %14s %14s\n", "3 textures", "ms (in cache)", "ms (evicted)");
+   for (int m = LOAD_STDIO; m <= LOAD_CACHED; m++)
+   {
+      // Best of several runs; the first launch rebuilds the caches each time.
+      double best[2] = { 1e9, 1e9 };
+      bool same = true;
+      for (int evict = 0; evict < 2; evict++)
+      {
+         for (int run = 0; run < 20; run++)
+         {
+            unsigned int sum;
+            double ms = startupMs((LoadMode)m, evict != 0, sum);
+            if (ms < best[evict]) best[evict] = ms;
+            same = same && sum == reference;
+         }
+      }
+      printf("  %-18s %14.3f %14.3f%s\n", names[m], best[0], best[1], same ? "" : "  TEXELS DIFFER");
+   }
+
+   // The conversion kernels over the background's 512x512 pixels.
+   const int n = 512 * 512;
+   unsigned char* src = new unsigned char[n * 3];
+   unsigned int*  dst = new unsigned int[n];
+   for (int i = 0; i < n * 3; i++)
+      src[i] = (unsigned char)(i * 7);
+
+   printf("  %10s %10s\n", "kernel", "Mpixels/s");
+   for (int k = PIXEL_KERNEL_SCALAR; k <= PIXEL_KERNEL_AVX2; k++)
+   {
+      PixelKernel kernel = (PixelKernel)k;
+      if (!BmpImage::isKernelSupported(kernel))
+         continue;
+
+      long long pixels = 0;
+      double start = nowSeconds(), elapsed;
+      do
+      {
+         BmpImage::convertBgr(kernel, dst, src, n);
+         pixels += n;
+         elapsed = nowSeconds() - start;
+      } while (elapsed < 0.25);
+      printf("  %10s %10.0f\n", BmpImage::kernelName(kernel), pixels / elapsed / 1e6);
+   }
+   delete[] src;
+   delete[] dst;
+}
+
+//===============================================================
+// frametimes: FrameTimeHistogram record and query cost, and what it
+// reports for a frame time pattern with known stutters.
+
+static void benchFrameTimes()
+{
+   // 60 Hz with +-1 ms jitter, every 97th frame 35 ms and every 1009th
+   // frame 120 ms; only those two count against a 25 ms budget.
+   const int frames = 4000000;
+   float* dts = new float[4096];
+   unsigned int rng = 9;
+   for (int i = 0; i < 4096; i++)
+      dts[i] = (1000.0f / 60.0f + (simRandom(rng) % 2001) / 1000.0f - 1.0f) * 1e-3f;
+
+   FrameTimeHistogram h(25.0f);
+   double start = nowSeconds();
+   for (int i = 0; i < frames; i++)
+      h.record(i % 1009 == 0 ? 0.120f : i % 97 == 0 ? 0.035f : dts[i & 4095]);
+   double recordNs = 1e9 * (nowSeconds() - start) / frames;
+
+   const int windows[3] = { 1, 10, 60 };
+   printf("  record: %.1f ns/frame, %lld stutters in %lld frames\n",
+          recordNs, h.totalStutters(), h.totalFrames());
+   printf("  %6s %10s %7s %7s %7s %7s %7s %9s\n",
+          "window", "query us", "p50", "p90", "p99", "p99.9", "max", "stutters");
+   for (int w = 0; w < 3; w++)
+   {
+      FrameTimeStats st;
+      int queries = 0;
+      start = nowSeconds();
+      do
+      {
+         st = h.window(windows[w]);
+         queries++;
+      } while (nowSeconds() - start < 0.1);
+      double queryUs = 1e6 * (nowSeconds() - start) / queries;
+      printf("  %5ds %10.2f %7.2f %7.2f %7.2f %7.2f %7.2f %9d\n", windows[w], queryUs,
+             st.p50, st.p90, st.p99, st.p999, st.max, st.stutters);
+   }
+   delete[] dts;
+}
+
+// Logs every tick of tracking bot matches as TEL_FRAME records and as the
+// text lines PrintUtils would have written, then decodes the binary file.
+static void benchTelemetry()
+{
+   const int ticks = 1000000;
+   PongState* states = new PongState[4096];
+   unsigned int* events = new unsigned int[4096];
+   PongState s;
+   pongInit(s, 5);
+   s.rallyTimeout = 30.0f;
+   for (int i = 0; i < 4096; i++)
+   {
+      events[i] = pongStep(s, pongTrackingInput(s, 400.0f, 30.0f), 1.0f / 120.0f);
+      states[i] = s;
+   }
+
+   TelemetryWriter w;
+   if (!w.open("bench.tel"))
+   {
+      printf("  cannot write bench.tel\n");
+      delete[] states;
+      delete[] events;
+      return;
+   }
+   double start = nowSeconds();
+   for (int i = 0; i < ticks; i++)
+   {
+      w.setTime(i * 8333LL);
+      w.frame(states[i & 4095], events[i & 4095]);
+   }
+   w.close();
+   double binaryNs = 1e9 * (nowSeconds() - start) / ticks;
+   double binaryBytes = (double)w.bytes() / ticks;
+
+   FILE* text = fopen("bench.txt", "w");
+   long long textBytes = 0;
+   start = nowSeconds();
+   for (int i = 0; text && i < ticks; i++)
+   {
+      const PongState& t = states[i & 4095];
+      char line[256];
+      int n = snprintf(line, sizeof(line), "%u %g %g %g %g %g %g %d %d %u\n", t.tick,
+                       t.ball.pos.x, t.ball.pos.y, t.ball.speed, t.ball.rotation,
+                       t.pad1.pos.y, t.pad2.pos.y, t.player1Score, t.player2Score, events[i & 4095]);
+      fwrite(line, 1, n, text);
+      textBytes += n;
+   }
+   if (text)
+      fclose(text);
+   double textNs = 1e9 * (nowSeconds() - start) / ticks;
+
+   TelemetryReader r;
+   TelemetryReader::Record rec;
+   int decoded = 0, mismatches = 0;
+   start = nowSeconds();
+   if (r.open("bench.tel"))
+   {
+      while (r.next(rec))
+      {
+         const PongState& t = states[decoded & 4095];
+         if (rec.frame.ballX != t.ball.pos.x || rec.frame.pad2Y != t.pad2.pos.y ||
+             rec.frame.player1Score != t.player1Score || rec.time != decoded * 8333LL)
+            mismatches++;
+         decoded++;
+      }
+   }
+   double decodeNs = 1e9 * (nowSeconds() - start) / (decoded ? decoded : 1);
+   r.close();
+   remove("bench.tel");
+   remove("bench.txt");
+
+   printf("  %-10s %10s %12s\n", "format", "ns/frame", "bytes/frame");
+   printf("  %-10s %10.1f %12.1f\n", "binary", binaryNs, binaryBytes);
+   printf("  %-10s %10.1f %12.1f\n", "text", textNs, (double)textBytes / ticks);
+   printf("  decode: %.1f ns/frame, %d of %d frames read back, %d mismatches\n",
+          decodeNs, decoded, ticks, mismatches);
+   delete[] states;
+   delete[] events;
+}
+
+// Records tracking bot play of growing length, with and without keyframes,
+// and times seeks to random ticks in each.
+static void benchReplaySeek()
+{
+   const float       dt         = 1.0f / 120.0f;
+   const int         minutes[3] = { 1, 10, 60 };
+   const int         seeks      = 200;
+   const char* const names[2]   = { "bench_key.replay", "bench_nokey.replay" };
+
+   printf("  %7s %9s %14s %14s\n", "minutes", "KB", "keyframes us", "from start us");
+   for (int m = 0; m < 3; m++)
+   {
+      unsigned int ticks = (unsigned int)(minutes[m] * 60 * 120);
+      double seekUs[2];
+      long   size = 0;
+      for (int k = 0; k < 2; k++)
+      {
+         ReplayWriter w;
+         PongState s;
+         pongInit(s, 11);
+         s.rallyTimeout = 30.0f;
+         if (!w.open(names[k], 11, dt, s.rallyTimeout, 1, k == 0 ? REPLAY_KEYFRAME_INTERVAL : 0))
+         {
+            printf("  cannot write %s\n", names[k]);
+            return;
+         }
+         for (unsigned int t = 0; t < ticks; t++)
+         {
+            PongTimedInput in = pongTimedInput(pongTrackingInput(s, 300.0f, 90.0f), dt);
+            pongStepTimed(s, in, dt);
+            w.tick(in, s);
+         }
+         w.close();
+
+         ReplayReader r;
+         r.open(names[k]);
+         unsigned int rng = 5;
+         double start = nowSeconds();
+         for (int i = 0; i < seeks; i++)
+            r.seek(simRandom(rng) % ticks, s);
+         seekUs[k] = 1e6 * (nowSeconds() - start) / seeks;
+         r.close();
+
+         if (k == 0)
+         {
+            FILE* f = fopen(names[k], "rb");
+            if (f)
+            {
+               fseek(f, 0, SEEK_END);
+               size = ftell(f);
+               fclose(f);
+            }
+         }
+         remove(names[k]);
+      }
+      printf("  %7d %9.0f %14.1f %14.1f\n", minutes[m], size / 1024.0, seekUs[0], seekUs[1]);
+   }
+}
+
+// The tracking bot's input for one player, as rollback input.
+static PongTimedInput botInput(const PongState& s, int player, float dt)
+{
+   PongInput in = pongTrackingInput(s, 300.0f, 90.0f);
+   in.buttons &= PLAYER_BUTTONS[player];
+   return pongTimedInput(in, dt);
+}
+
+// Rollback cost by depth, then two peers playing each other with their
+// inputs arriving some ticks late, checked against a plain simulation of
+// the same inputs.
+static void benchRollback()
+{
+   const float dt = 1.0f / 120.0f;
+   PongState s;
+   pongInit(s, 21);
+   s.rallyTimeout = 30.0f;
+
+   PongRollback rb;
+   rb.reset(s, dt, 0);
+   for (int t = 0; t < ROLLBACK_FRAMES; t++)
+      rb.advance(botInput(rb.state(), 0, dt));
+
+   const int depths[4] = { 1, 8, 32, ROLLBACK_FRAMES - 1 };
+   printf("  %6s %14s %14s\n", "depth", "us/rollback", "frames/ms");
+   for (int d = 0; d < 4; d++)
+   {
+      unsigned int before = rb.resimulated();
+      int rollbacks = 0;
+      double start = nowSeconds();
+      do
+      {
+         for (int i = 0; i < 100; i++)
+            rb.rollback(rb.tick() - depths[d]);
+         rollbacks += 100;
+      } while (nowSeconds() - start < 0.1);
+      double seconds = nowSeconds() - start;
+      printf("  %6d %14.2f %14.0f\n", depths[d], 1e6 * seconds / rollbacks,
+             (rb.resimulated() - before) / (seconds * 1000.0));
+   }
+
+   const int ticks = 120 * 60 * 10;
+   const int latencies[3] = { 4, 12, 30 };
+   PongTimedInput* inputs[2] = { new PongTimedInput[ticks], new PongTimedInput[ticks] };
+   printf("  %8s %10s %14s %12s %8s\n", "latency", "rollbacks", "resim/tick", "ticks/sec", "agree");
+   for (int l = 0; l < 3; l++)
+   {
+      int latency = latencies[l];
+      PongRollback peers[2];
+      peers[0].reset(s, dt, 0);
+      peers[1].reset(s, dt, 1);
+
+      double start = nowSeconds();
+      for (int t = 0; t < ticks + latency; t++)
+      {
+         for (int p = 0; p < 2 && t < ticks; p++)
+         {
+            inputs[p][t] = botInput(peers[p].state(), p, dt);
+            peers[p].advance(inputs[p][t]);
+         }
+         int arrived = t - latency;
+         if (arrived >= 0)
+         {
+            peers[0].confirmRemote(arrived, inputs[1][arrived]);
+            peers[1].confirmRemote(arrived, inputs[0][arrived]);
+         }
+      }
+      double seconds = nowSeconds() - start;
+
+      PongState reference = s;
+      for (int t = 0; t < ticks; t++)
+         pongStepTimed(reference, pongMergeInputs(inputs[0][t], inputs[1][t]), dt);
+      bool agree = pongChecksum(peers[0].state()) == pongChecksum(reference) &&
+                   pongChecksum(peers[1].state()) == pongChecksum(reference);
+
+      printf("  %5d tk %10u %14.2f %12.0f %8s\n", latency, peers[0].rollbacks() + peers[1].rollbacks(),
+             (peers[0].resimulated() + peers[1].resimulated()) / (2.0 * ticks),
+             2.0 * ticks / seconds, agree ? "yes" : "NO");
+   }
+   delete[] inputs[0];
+   delete[] inputs[1];
+}
+
+// A bot match watched by many spectators that acknowledge 1 to 4 ticks
+// late, a few of them with nothing acknowledged yet.  Compares one shared
+// delta encode per baseline with a NetState per spectator, and checks one
+// spectator decodes every tick exactly.
+static void benchSnapshot()
+{
+   const int   ticks      = 120 * 60 * 2;
+   const float dt         = 1.0f / 120.0f;
+   const int   counts[3]  = { 1, 100, 1000 };
+
+   printf("  %10s %12s %12s %12s %12s %12s\n", "spectators", "encodes/tick",
+          "bytes/pkt", "us/tick", "state us", "state bytes");
+   for (int c = 0; c < 3; c++)
+   {
+      int spectators = counts[c];
+      PongState s;
+      pongInit(s, 5);
+      s.rallyTimeout = 30.0f;
+
+      SnapshotBroadcaster broadcaster;
+      SnapshotHistory received;
+      unsigned long long bytes = 0;
+      unsigned int ack = 0, mismatches = 0;
+      unsigned char sink = 0;
+      double snapshotSeconds = 0.0, stateSeconds = 0.0;
+
+      for (int t = 0; t < ticks; t++)
+      {
+         pongStep(s, pongTrackingInput(s, 300.0f, 90.0f), dt);
+
+         double start = nowSeconds();
+         broadcaster.push(s);
+         for (int i = 0; i < spectators; i++)
+         {
+            unsigned int lag = 1 + ((i * 2654435761u + s.tick) >> 28) % 4;
+            unsigned int spectatorAck = i % 50 == 49 || s.tick <= lag ? 0 : s.tick - lag;
+            if (i == 0)
+               spectatorAck = ack;
+            int length;
+            const unsigned char* packet = broadcaster.packet(spectatorAck, length);
+            bytes += length;
+            sink ^= packet[0];
+            if (i == 0)
+            {
+               PongSnapshot q;
+               if (snapshotDecode(packet, length, received, q) &&
+                   memcmp(&q, &broadcaster.current(), sizeof(q)) == 0)
+               {
+                  received.add(q);
+                  ack = q.tick;
+               }
+               else
+                  mismatches++;
+            }
+         }
+         snapshotSeconds += nowSeconds() - start;
+
+         // What sending every spectator the players' NetState costs.
+         start = nowSeconds();
+         for (int i = 0; i < spectators; i++)
+         {
+            unsigned char out[NET_MAX_MESSAGE];
+            NetState m = netStateOf(0, s, false);
+            m.echoUs = i;
+            sink ^= out[netWrite(m, out) - 1];
+         }
+         stateSeconds += nowSeconds() - start;
+      }
+
+      unsigned char state[NET_MAX_MESSAGE];
+      printf("  %10d %12.2f %12.2f %12.2f %12.2f %12d%s\n", spectators,
+             (double)broadcaster.encodes() / ticks, (double)bytes / broadcaster.packets(),
+             1e6 * snapshotSeconds / ticks, 1e6 * stateSeconds / ticks,
+             netWrite(netStateOf(0, s, false), state), mismatches ? "  DECODE MISMATCH" : "");
+      if (sink == 0x5A)
+         printf(" ");
+   }
+
+   // How far a quantized state is from the real one.
+   PongState s, view;
+   pongInit(s, 5);
+   pongInit(view, 5);
+   float worst = 0.0f;
+   for (int t = 0; t < 120 * 60; t++)
+   {
+      pongStep(s, pongTrackingInput(s, 300.0f, 90.0f), dt);
+      PongSnapshot q;
+      snapshotQuantize(s, q);
+      snapshotApply(q, view);
+      float errs[4] = { view.ball.pos.x - s.ball.pos.x, view.ball.pos.y - s.ball.pos.y,
+                        view.pad1.pos.y - s.pad1.pos.y, view.pad2.pos.y - s.pad2.pos.y };
+      for (int k = 0; k < 4; k++)
+         if (fabsf(errs[k]) > worst)
+            worst = fabsf(errs[k]);
+   }
+   printf("  largest position error %.3f units\n", worst);
+}
+
+// The predictive AI: its intercept against the stepped simulation, what a
+// decision costs next to the tracking bot, and how it fares against the
+// tracking bot by reaction delay and aim error.
+static void benchAI()
+{
+   const float dt = 1.0f / 120.0f;
+
+   // Serve at random, move pad2 out of the way and step until the ball
+   // centre crosses the line where it would touch pad2's face.
+   float worst = 0.0f, total = 0.0f;
+   int serves = 0;
+   for (unsigned int seed = 1; seed <= 2000; seed++)
+   {
+      PongState s;
+      pongInit(s, seed);
+      pongServe(s);
+      float y, time;
+      if (!pongPredictIntercept(s, s.pad2, y, time))
+         continue;
+      float faceX = s.pad2.bound1.x - BALL_RADIUS;
+      s.pad2.pos.y = 1.0e5f;
+      s.pad2.setBoundingBox(PAD_HALF_WIDTH, PAD_HALF_HEIGHT);
+      PongInput none;
+      none.buttons = 0;
+      for (int t = 0; t < 120 * 60; t++)
+      {
+         PongState before = s;
+         pongStep(s, none, dt);
+         if (s.ball.pos.x >= faceX && before.ball.pos.x < faceX)
+         {
+            float k = (faceX - before.ball.pos.x) / (s.ball.pos.x - before.ball.pos.x);
+            float err = fabsf(before.ball.pos.y + (s.ball.pos.y - before.ball.pos.y) * k - y);
+            worst = err > worst ? err : worst;
+            total += err;
+            serves++;
+            break;
+         }
+      }
+   }
+   printf("  intercept: %d serves, mean error %.3f, worst %.3f units\n", serves, total / serves, worst);
+
+   // Decision cost over a recorded match.
+   const int states = 120 * 60;
+   PongState* recorded = new PongState[states];
+   PongState s;
+   pongInit(s, 3);
+   s.rallyTimeout = 30.0f;
+   for (int t = 0; t < states; t++)
+   {
+      pongStep(s, pongTrackingInput(s, 300.0f, 90.0f), dt);
+      recorded[t] = s;
+   }
+   PongAI ai;
+   pongAIInit(ai, 0.15f, 30.0f, 1);
+   unsigned int sink = 0;
+   int rounds = 0;
+   double start = nowSeconds();
+   do
+   {
+      for (int t = 0; t < states; t++)
+         sink += pongAIInput(ai, recorded[t], 2, dt);
+      rounds++;
+   } while (nowSeconds() - start < 0.2);
+   double aiNs = 1e9 * (nowSeconds() - start) / ((double)rounds * states);
+   rounds = 0;
+   start = nowSeconds();
+   do
+   {
+      for (int t = 0; t < states; t++)
+         sink += pongTrackingInput(recorded[t], 300.0f, 90.0f).buttons;
+      rounds++;
+   } while (nowSeconds() - start < 0.2);
+   double trackNs = 1e9 * (nowSeconds() - start) / ((double)rounds * states);
+   delete[] recorded;
+   printf("  decision: predictive %.1f ns, tracking %.1f ns%s\n", aiNs, trackNs, sink == 1 ? " " : "");
+
+   const int   matches     = 100;
+   const float reactions[] = { 0.0f, 0.5f, 1.5f };
+   const float errors[]    = { 30.0f, 60.0f, 75.0f };
+   MatchConfig config;
+   config.pointsToWin = 11;
+   config.dt          = dt;
+   config.maxTicks    = 120 * 60 * 60;
+   printf("  %9s %9s %12s %12s %12s\n", "reaction", "aim err", "AI wins", "pad hits/pt", "ticks/sec");
+   for (int r = 0; r < 3; r++)
+   {
+      for (int e = 0; e < 3; e++)
+      {
+         config.pad2Reaction = reactions[r];
+         config.pad2AimError = errors[e];
+         int wins = 0;
+         unsigned long long ticks = 0, hits = 0, points = 0;
+         start = nowSeconds();
+         for (int m = 0; m < matches; m++)
+         {
+            config.seed = 1 + m;
+            MatchResult result = pongPlayMatch(config);
+            wins   += result.player2Score > result.player1Score;
+            ticks  += result.ticks;
+            hits   += result.padHits;
+            points += result.rallies;
+         }
+         double seconds = nowSeconds() - start;
+         printf("  %8.2fs %9.0f %8d/%-3d %12.2f %12.0f\n", reactions[r], errors[e], wins, matches,
+                points ? (double)hits / points : 0.0, ticks / seconds);
+      }
+   }
+}
+
+//===============================================================
+// vecenv: the training environment, steps/sec by batch size and threads.
+// Every thread count must leave the environments in the same place.
+
+static void benchVecEnv()
+{
+   const int batches[] = { 1, 64, 1024, 16384 };
+   int maxThreads = (int)std::thread::hardware_concurrency();
+   if (maxThreads < 1)
+      maxThreads = 1;
+   if (maxThreads > 16)
+      maxThreads = 16;
+
+   PongEnvConfig config = pongEnvDefaultConfig();
+   printf("  %8s %8s %14s %14s %10s %12s\n", "envs", "threads", "steps/sec", "ticks/sec", "episodes",
+          "checksum");
+   for (int b = 0; b < 4; b++)
+   {
+      const int n = batches[b];
+      std::vector<float>         observations(n * PONG_ENV_OBS_SIZE), rewards(n);
+      std::vector<unsigned char> dones(n), actions(n);
+      for (int threads = 1; threads <= maxThreads; threads *= 2)
+      {
+         PongVecEnv env(n, config, threads);
+         env.setBuffers(&observations[0], &rewards[0], &dones[0]);
+         env.reset(0);
+
+         // A fixed number of calls so every thread count does the same work
+         // and the checksums can be compared.
+         const int calls = 2000000 / n > 20 ? 2000000 / n : 20;
+         unsigned int rng = 7;
+         unsigned long long episodes = 0;
+         double start = nowSeconds();
+         for (int c = 0; c < calls; c++)
+         {
+            for (int i = 0; i < n; i++)
+               actions[i] = (unsigned char)(simRandom(rng) % 3);
+            env.step(&actions[0]);
+            for (int i = 0; i < n; i++)
+               episodes += dones[i];
+         }
+         double seconds = nowSeconds() - start;
+
+         unsigned int sum = 0;
+         for (int i = 0; i < n; i++)
+            sum = sum * 31 + pongChecksum(env.state(i));
+         double steps = (double)calls * n;
+         printf("  %8d %8d %14.0f %14.0f %10llu %12x\n", n, threads, steps / seconds,
+                steps * config.frameSkip / seconds, episodes, sum);
+      }
+   }
+}
+
+//===============================================================
+// renderqueue: sort-keyed sprite submission.  The game's own frame, then
+// a scene of many sprites recorded in random order.
+
+class CountingBackend : public RenderBackend
+{
+public:
+   CountingBackend() : calls(0), draws(0), flushes(0), sum(0) {}
+
+   void setBlend(RenderBlend blend)        { calls++; sum = sum * 31 + blend; }
+   void setTexRepeat(float repeat)         { calls++; sum = sum * 31 + (unsigned int)repeat; }
+   void draw(int texture, const RenderCommand& c) { draws++; sum = sum * 31 + texture * 7 + c.sprite; }
+   void flush()                            { flushes++; }
+
+   int          calls;
+   int          draws;
+   int          flushes;
+   unsigned int sum;
+};
+
+static bool entryLess(const RenderSortEntry& a, const RenderSortEntry& b)
+{
+   return a.key < b.key;
+}
+
+static void benchRenderQueue()
+{
+   // What D3DRenderer records: the tiled background, two pads and the ball.
+   {
+      RenderQueue queue;
+      CountingBackend backend;
+      RenderCommand c;
+      memset(&c, 0, sizeof(c));
+      c.texRepeat = 10.0f;
+      queue.add(RENDER_LAYER_BACKGROUND, RENDER_BLEND_OPAQUE, 0, c);
+      c.texRepeat = 1.0f;
+      for (int i = 0; i < 3; i++)
+         queue.add(RENDER_LAYER_SPRITES, RENDER_BLEND_ALPHA_TEST_ALPHA, 1, c);
+      queue.submit(backend);
+      const RenderQueueStats& st = queue.stats();
+      printf("  game frame: %d sprites, %d state changes (%d one at a time), %d batches (%d)\n",
+             st.commands, st.stateChanges, st.naiveStateChanges, st.batches, st.naiveBatches);
+   }
+
+   // Sprites over 3 layers, 4 blend modes and 16 textures.
+   const int counts[] = { 64, 1024, 16384 };
+   printf("  %8s %14s %14s %10s %10s %12s %12s\n", "sprites", "state changes", "one at a time",
+          "batches", "one/time", "radix ns/cmd", "std ns/cmd");
+   for (int k = 0; k < 3; k++)
+   {
+      const int n = counts[k];
+      RenderQueue queue;
+      CountingBackend backend;
+      unsigned int rng = 9;
+      RenderCommand c;
+      memset(&c, 0, sizeof(c));
+      for (int i = 0; i < n; i++)
+      {
+         int layer   = (int)(simRandom(rng) % 3);
+         int blend   = (int)(simRandom(rng) % 4);
+         int texture = (int)(simRandom(rng) % 16);
+         c.sprite    = (int)(simRandom(rng) % 8);
+         c.texRepeat = texture == 0 ? 4.0f : 1.0f;  // one tiled texture
+         queue.add(layer, (RenderBlend)blend, texture, c);
+      }
+      queue.submit(backend);
+      RenderQueueStats st = queue.stats();
+
+      // The sort on its own, against std::stable_sort on the same keys.
+      std::vector<RenderSortEntry> keys(n), work(n), scratch(n);
+      for (int i = 0; i < n; i++)
+      {
+         unsigned int layer = simRandom(rng) % 3, blend = simRandom(rng) % 4, tex = simRandom(rng) % 16;
+         keys[i].key   = renderKey((int)layer, (RenderBlend)blend, (int)tex, (unsigned int)i);
+         keys[i].index = (unsigned int)i;
+      }
+      int rounds = 0;
+      RenderSortEntry* sorted = 0;
+      double start = nowSeconds();
+      do
+      {
+         work = keys;
+         sorted = renderRadixSort(&work[0], &scratch[0], n);
+         rounds++;
+      } while (nowSeconds() - start < 0.1);
+      double radixNs = 1e9 * (nowSeconds() - start) / ((double)rounds * n);
+      std::vector<RenderSortEntry> radix(sorted, sorted + n);
+
+      rounds = 0;
+      start = nowSeconds();
+      do
+      {
+         work = keys;
+         std::stable_sort(work.begin(), work.end(), entryLess);
+         rounds++;
+      } while (nowSeconds() - start < 0.1);
+      double stdNs = 1e9 * (nowSeconds() - start) / ((double)rounds * n);
+
+      bool same = true;
+      for (int i = 0; i < n; i++)
+         same = same && radix[i].index == work[i].index;
+      printf("  %8d %14d %14d %10d %10d %12.2f %12.2f%s\n", n, st.stateChanges, st.naiveStateChanges,
+             st.batches, st.naiveBatches, radixNs, stdNs, same ? "" : "  ORDER DIFFERS");
+   }
+}
+
+//===============================================================
+// statecache: redundant device state filtering on a mock device.  The
+// game's calls (D3DRenderer and PongDemo, with the D3D9 enum values) go
+// through a cache to one MockRenderDevice and straight to another; after
+// every frame both must hold the same state.
+
+// D3D9 values for the states the game sets.
+enum
+{
+   D3DRS_ALPHATESTENABLE_ = 15, D3DRS_SRCBLEND_ = 19, D3DRS_DESTBLEND_ = 20, D3DRS_CULLMODE_ = 22,
+   D3DRS_ALPHAREF_ = 24, D3DRS_ALPHAFUNC_ = 25, D3DRS_ALPHABLENDENABLE_ = 27, D3DRS_LIGHTING_ = 137,
+   D3DSAMP_MAGFILTER_ = 5, D3DSAMP_MINFILTER_ = 6, D3DSAMP_MIPFILTER_ = 7,
+   D3DTSS_ALPHAOP_ = 4, D3DTSS_ALPHAARG1_ = 5, D3DTSS_TEXTURETRANSFORMFLAGS_ = 24
+};
+
+// Every call goes to both devices, once through the cache.
+class GameStateCalls : public RenderBackend
+{
+public:
+   GameStateCalls(RenderStateCache& cache, MockRenderDevice& direct) : mCache(cache), mDirect(direct) {}
+
+   void renderState(unsigned int state, unsigned int value)
+   {
+      mCache.setRenderState(state, value);
+      mDirect.setRenderState(state, value);
+   }
+   void transform(unsigned int which, const float* m)
+   {
+      mCache.setTransform(which, m);
+      mDirect.setTransform(which, m);
+   }
+
+   // D3DRenderer::onResetDevice and PongDemo's projection.
+   void resetDevice()
+   {
+      for (unsigned int type = D3DSAMP_MAGFILTER_; type <= D3DSAMP_MIPFILTER_; type++)
+      {
+         mCache.setSamplerState(0, type, 2);
+         mDirect.setSamplerState(0, type, 2);
+      }
+      renderState(D3DRS_LIGHTING_, 0);
+      renderState(D3DRS_ALPHAREF_, 10);
+      renderState(D3DRS_ALPHAFUNC_, 5);
+      mCache.setTextureStageState(0, D3DTSS_ALPHAARG1_, 2);
+      mDirect.setTextureStageState(0, D3DTSS_ALPHAARG1_, 2);
+      mCache.setTextureStageState(0, D3DTSS_ALPHAOP_, 2);
+      mDirect.setTextureStageState(0, D3DTSS_ALPHAOP_, 2);
+      renderState(D3DRS_SRCBLEND_, 5);
+      renderState(D3DRS_DESTBLEND_, 6);
+      renderState(D3DRS_CULLMODE_, 1);
+      mCache.setTextureStageState(0, D3DTSS_TEXTURETRANSFORMFLAGS_, 2);
+      mDirect.setTextureStageState(0, D3DTSS_TEXTURETRANSFORMFLAGS_, 2);
+      float p[16];
+      matrix(p, 1.8f, 2.4f);
+      transform(RS_TRANSFORM_PROJECTION, p);
+   }
+
+   // D3DRenderer::setCameraZ, every frame.
+   void camera(float z)
+   {
+      float v[16];
+      matrix(v, 1.0f, 1.0f);
+      v[14] = -z;
+      transform(RS_TRANSFORM_VIEW, v);
+   }
+
+   // D3DRenderer's RenderBackend half.
+   void setBlend(RenderBlend blend)
+   {
+      renderState(D3DRS_ALPHATESTENABLE_, blend == RENDER_BLEND_ALPHA_TEST || blend == RENDER_BLEND_ALPHA_TEST_ALPHA);
+      renderState(D3DRS_ALPHABLENDENABLE_, blend == RENDER_BLEND_ALPHA || blend == RENDER_BLEND_ALPHA_TEST_ALPHA);
+   }
+   void setTexRepeat(float repeat)
+   {
+      float t[16];
+      matrix(t, repeat, repeat);
+      transform(RS_TRANSFORM_TEXTURE0, t);
+   }
+   void draw(int, const RenderCommand&) {}
+   void flush() {}
+
+private:
+   static void matrix(float* m, float sx, float sy)
+   {
+      memset(m, 0, 16 * sizeof(float));
+      m[0] = sx; m[5] = sy; m[10] = 1.0f; m[15] = 1.0f;
+   }
+
+   RenderStateCache& mCache;
+   MockRenderDevice& mDirect;
+};
+
+static void benchStateCache()
+{
+   static const char* const kinds[RS_KIND_COUNT] = { "render", "sampler", "stage", "transform" };
+
+   // 1000 frames of the game with the camera wheeled now and then and the
+   // device lost and reset every 250 frames.
+   {
+      MockRenderDevice cached, direct;
+      RenderStateCache cache(cached);
+      GameStateCalls game(cache, direct);
+      RenderQueue queue;
+      RenderCommand c;
+      memset(&c, 0, sizeof(c));
+
+      bool same = true;
+      float cameraZ = -1000.0f;
+      const int frames = 1000;
+      for (int f = 0; f < frames; f++)
+      {
+         if (f % 250 == 0)
+         {
+            cache.onLostDevice();
+            cached.reset();
+            direct.reset();
+            game.resetDevice();
+            game.camera(cameraZ);
+         }
+         if (f % 100 == 50)
+            cameraZ += 20.0f;
+         game.camera(cameraZ);
+
+         c.texRepeat = 10.0f;
+         queue.add(RENDER_LAYER_BACKGROUND, RENDER_BLEND_OPAQUE, 0, c);
+         c.texRepeat = 1.0f;
+         for (int i = 0; i < 3; i++)
+            queue.add(RENDER_LAYER_SPRITES, RENDER_BLEND_ALPHA_TEST_ALPHA, 1, c);
+         queue.submit(game);
+         same = same && cached.sameState(direct);
+      }
+
+      const RenderStateStats& st = cache.stats();
+      printf("  game, %d frames, 4 device resets: device state %s\n", frames, same ? "matches" : "DIFFERS");
+      printf("  %10s %10s %10s %10s %12s\n", "kind", "calls", "forwarded", "filtered", "filtered/frame");
+      for (int k = 0; k < RS_KIND_COUNT; k++)
+         printf("  %10s %10u %10u %10u %12.2f\n", kinds[k], st.calls[k], st.forwarded[k],
+                st.calls[k] - st.forwarded[k], (double)(st.calls[k] - st.forwarded[k]) / frames);
+   }
+
+   // Random calls over a few states and values, out of range ones and
+   // invalidations included.
+   {
+      MockRenderDevice cached, direct;
+      RenderStateCache cache(cached);
+      unsigned int rng = 17;
+      bool same = true;
+      const int calls = 1000000;
+      for (int i = 0; i < calls; i++)
+      {
+         unsigned int r = simRandom(rng);
+         unsigned int value = (r >> 8) % 3;
+         switch (r % 5)
+         {
+         case 0:
+         {
+            unsigned int state = (r >> 12) % 8 == 0 ? 300 : (r >> 12) % 4;
+            cache.setRenderState(state, value);
+            direct.setRenderState(state, value);
+            break;
+         }
+         case 1:
+            cache.setSamplerState((r >> 12) % 2, 5 + (r >> 14) % 3, value);
+            direct.setSamplerState((r >> 12) % 2, 5 + (r >> 14) % 3, value);
+            break;
+         case 2:
+            cache.setTextureStageState(0, (r >> 12) % 40, value);
+            direct.setTextureStageState(0, (r >> 12) % 40, value);
+            break;
+         case 3:
+         {
+            float m[16];
+            memset(m, 0, sizeof(m));
+            m[0] = m[5] = m[10] = m[15] = 1.0f + value;
+            unsigned int which = (r >> 12) % 2 ? RS_TRANSFORM_VIEW : RS_TRANSFORM_TEXTURE0 + (r >> 13) % 2;
+            cache.setTransform(which, m);
+            direct.setTransform(which, m);
+            break;
+         }
+         case 4:
+            if ((r >> 8) % 64 == 0)
+               cache.invalidate();
+            break;
+         }
+         if (i % 1000 == 0)
+            same = same && cached.sameState(direct);
+      }
+      same = same && cached.sameState(direct);
+      unsigned int total = 0, forwarded = 0;
+      for (int k = 0; k < RS_KIND_COUNT; k++)
+      {
+         total     += cache.stats().calls[k];
+         forwarded += cache.stats().forwarded[k];
+      }
+      printf("  random, %u calls: %u forwarded, device state %s\n", total, forwarded,
+             same ? "matches" : "DIFFERS");
+   }
+
+   // What a filtered call costs next to one the device gets.
+   {
+      MockRenderDevice device;
+      RenderStateCache cache(device);
+      const int n = 10000000;
+      double start = nowSeconds();
+      for (int i = 0; i < n; i++)
+         cache.setRenderState(i & 7, 1);
+      double filteredNs = 1e9 * (nowSeconds() - start) / n;
+      start = nowSeconds();
+      for (int i = 0; i < n; i++)
+         cache.setRenderState(i & 7, i & 8);
+      double forwardedNs = 1e9 * (nowSeconds() - start) / n;
+      printf("  cost: %.2f ns filtered, %.2f ns forwarded to the mock\n", filteredNs, forwardedNs);
+   }
+}
+
+//===============================================================
+// simthread: tick timing and input latency when the ticks are run by a
+// frame loop that blocks in Present(), against ticks on a SimThread
+// while the same loop draws.  Present() is a 16 ms sleep, 50 ms every
+// 40th frame; a key is pressed for 30 ms every 97 ms.
+
+// Steps the match and keeps every tick's checksum, so a snapshot that
+// mixed two ticks would show.
+class BenchSimClient : public SimThreadClient
+{
+public:
+   explicit BenchSimClient(int maxTicks) : mChecksums(maxTicks + 1), mTicks(0)
+   {
+      pongInit(mState, 29);
+      mPrev = mState;
+      mChecksums[0] = pongChecksum(mState);
+   }
+
+   void simTick(const PongTimedInput& in, float dt)
+   {
+      mPrev = mState;
+      pongStepTimed(mState, in, dt);
+      mTicks++;
+      if (mTicks < mChecksums.size())
+         mChecksums[mTicks] = pongChecksum(mState);
+   }
+
+   void simSnapshot(SimSnapshot& out)
+   {
+      out.prev  = mPrev;
+      out.state = mState;
+   }
+
+   bool intact(const SimSnapshot& s) const
+   {
+      return s.ticks < mChecksums.size() && pongChecksum(s.state) == mChecksums[s.ticks];
+   }
+
+   unsigned int ticks() const { return mTicks; }
+
+private:
+   PongState                 mState;
+   PongState                 mPrev;
+   std::vector<unsigned int> mChecksums;
+   unsigned int              mTicks;
+};
+
+static const long long SIM_BENCH_US = 3000000;
+
+static void simBenchKeys(ScriptedInputSource& keys, long long from)
+{
+   for (long long t = from + 50000; t < from + SIM_BENCH_US; t += 97000)
+      keys.press(t, 30000, BTN_PAD1_UP);
+}
+
+static void simBenchPresent(int frame)
+{
+   std::this_thread::sleep_for(std::chrono::milliseconds(frame % 40 == 39 ? 50 : 16));
+}
+
+static void simBenchRow(const char* mode, unsigned int ticks, const FrameTimeStats& interval,
+                        const FrameTimeStats& latency, unsigned int dropped)
+{
+   printf("  %-14s %6u %8.2f %6.2f %6.2f %10.2f %6.2f %6.2f %8u\n", mode, ticks,
+          interval.p50, interval.p99, interval.max, latency.p50, latency.p99, latency.max, dropped);
+}
+
+static void benchSimThread()
+{
+   const float tickRate = 120.0f;
+   printf("  %-14s %6s %8s %6s %6s %10s %6s %6s %8s\n", "ticks run by", "ticks",
+          "tick p50", "p99", "max", "input p50", "p99", "max", "dropped");
+
+   // The game's single-threaded loop: every tick due runs at the start
+   // of the frame, then the frame draws and presents.
+   {
+      BenchSimClient client(4 * (int)tickRate * (int)(SIM_BENCH_US / 1000000));
+      ScriptedInputSource keys;
+      InputQueue queue;
+      FixedTimestep timestep(tickRate, 12);
+      FrameTimeHistogram intervals(1.5f * 1000.0f / tickRate), latency(1000.0f / tickRate);
+      double epoch = nowSeconds();
+      simBenchKeys(keys, 0);
+
+      long long prevFrame = 0, lastStart = -1;
+      for (int frame = 0; prevFrame < SIM_BENCH_US; frame++)
+      {
+         long long frameStart = (long long)((nowSeconds() - epoch) * 1e6);
+         keys.pump(queue, frameStart);
+         int ticks = timestep.advance((frameStart - prevFrame) * 1e-6);
+         double tickUs = 1e6 / tickRate;
+         double lastTickEnd = frameStart - timestep.alpha() * tickUs;
+         for (int i = 0; i < ticks; i++)
+         {
+            long long tickEnd = (long long)(lastTickEnd - (ticks - 1 - i) * tickUs);
+            long long started = (long long)((nowSeconds() - epoch) * 1e6);
+            if (lastStart >= 0)
+               intervals.record((float)(started - lastStart) * 1e-6f);
+            lastStart = started;
+
+            long long eventTimes[INPUT_QUEUE_SIZE];
+            int events = 0;
+            while (events < queue.size() && queue.event(events).time < tickEnd)
+            {
+               eventTimes[events] = queue.event(events).time;
+               events++;
+            }
+            client.simTick(queue.consume(tickEnd - (long long)tickUs, tickEnd, 1.0f / tickRate), 1.0f / tickRate);
+            long long done = (long long)((nowSeconds() - epoch) * 1e6);
+            for (int e = 0; e < events; e++)
+               latency.record((float)(done - eventTimes[e]) * 1e-6f);
+         }
+         prevFrame = frameStart;
+         simBenchPresent(frame);
+      }
+      simBenchRow("frame loop", client.ticks(), intervals.window(10), latency.window(10),
+                  timestep.droppedTicks());
+   }
+
+   // A SimThread, with the same loop only drawing the newest snapshot.
+   {
+      BenchSimClient client(4 * (int)tickRate * (int)(SIM_BENCH_US / 1000000));
+      ScriptedInputSource keys;
+      SimThread sim(client, &keys, tickRate, 12);
+      simBenchKeys(keys, sim.nowUs());
+      sim.start();
+
+      int frames = 0, fresh = 0, torn = 0, backwards = 0;
+      unsigned int lastTicks = 0;
+      long long end = sim.nowUs() + SIM_BENCH_US;
+      while (sim.nowUs() < end)
+      {
+         const SimSnapshot& s = sim.latest();
+         torn      += !client.intact(s);
+         backwards += s.ticks < lastTicks;
+         fresh     += s.ticks != lastTicks;
+         lastTicks  = s.ticks;
+         PongState draw = pongLerp(s.prev, s.state, sim.alpha(s));
+         (void)draw;
+         simBenchPresent(frames++);
+      }
+      sim.stop();
+
+      // The timing goes out once a second of ticks; the last full one.
+      const SimSnapshot& s = sim.latest();
+      simBenchRow("SimThread", s.ticks, s.timing.tickIntervals, s.timing.inputLatency,
+                  s.timing.droppedTicks);
+      printf("  %d frames drew %d new snapshots: %d torn, %d older than the one before\n",
+             frames, fresh, torn, backwards);
+   }
+
+   // The triple buffer alone, hammered: a writer publishing as fast as it
+   // can and a reader checking every value it sees is whole.
+   {
+      struct Block { unsigned int words[64]; };
+      TripleBuffer<Block> buffer;
+      std::atomic<bool> done(false);
+      const unsigned int writes = 2000000;
+      std::thread writer([&]()
+      {
+         for (unsigned int i = 1; i <= writes; i++)
+         {
+            Block& b = buffer.back();
+            for (int w = 0; w < 64; w++)
+               b.words[w] = i;
+            buffer.publish();
+         }
+         done.store(true, std::memory_order_release);
+      });
+
+      long long reads = 0, updates = 0, torn = 0, backwards = 0;
+      unsigned int last = 0;
+      for (;;)
+      {
+         bool finished = done.load(std::memory_order_acquire);
+         if (buffer.update())
+         {
+            const Block& b = buffer.front();
+            for (int w = 1; w < 64; w++)
+               torn += b.words[w] != b.words[0];
+            backwards += b.words[0] < last;
+            last = b.words[0];
+            updates++;
+         }
+         reads++;
+         if (finished && !buffer.update())
+            break;
+      }
+      writer.join();
+      printf("  triple buffer: %u writes, %lld reads saw %lld new values (last %u): %lld torn, %lld backwards\n",
+             writes, reads, updates, last, torn, backwards);
+   }
+}
+
+//===============================================================
+
+struct BenchCase
+{
+   const char* name;
+   void      (*run)();
+   const char* description;
+};
+
+static const BenchCase gCases[] =
+{
+   { "ballbatch", benchBallBatch, "SoA ball stepping, balls/sec per kernel and batch size" },
+   { "sweep",     benchSweep,     "swept ball collision, ns/tick and tunnelling by speed" },
+   { "fastforward", benchFastForward, "tracking bot matches per tick vs event to event" },
+   { "render",    benchRender,    "software renderer frames/sec and span kernels" },
+   { "bmpload",   benchBmpLoad,   "texture startup: stdio decode vs mapped BMP vs mapped cache" },
+   { "frametimes", benchFrameTimes, "frame time histogram record/query cost and percentiles" },
+   { "telemetry", benchTelemetry, "binary telemetry vs text per tick, size and decode speed" },
+   { "replayseek", benchReplaySeek, "replay seek latency vs length, keyframe index vs from start" },
+   { "rollback",  benchRollback,  "rollback re-simulation frames/ms and two-peer netplay" },
+   { "snapshot",  benchSnapshot,  "spectator snapshot encode cost and bytes per tick" },
+   { "ai",        benchAI,        "predictive AI intercept accuracy, decision cost and win rate" },
+   { "vecenv",    benchVecEnv,    "vectorized training environments, steps/sec by batch and threads" },
+   { "renderqueue", benchRenderQueue, "sort-keyed sprite submission, state changes saved and sort cost" },
+   { "statecache", benchStateCache, "redundant device state filtering on a mock device" },
+   { "simthread", benchSimThread, "tick jitter and input latency, frame loop vs simulation thread" },
+};
+
+int main(int argc, char* argv[])
+{
+   const int numCases = sizeof(gCases) / sizeof(gCases[0]);
+   int ran = 0;
+
+   for (int c = 0; c < numCases; c++)
+   {
+      bool selected = argc < 2;
+      for (int i = 1; i < argc; i++)
+         if (strcmp(argv[i], gCases[c].name) == 0)
+            selected = true;
+      if (!selected)
+         continue;
+
+      printf("%s: %s\n", gCases[c].name, gCases[c].description);
+      gCases[c].run();
+      ran++;
+   }
+
+   if (ran == 0)
+   {
+      printf("usage: PongBench [case ...]\ncases:\n");
+      for (int c = 0; c < numCases; c++)
+         printf("  %-12s %s\n", gCases[c].name, gCases[c].description);
+      return 1;
+   }
+   return 0;
+}
@@ -0,0 +1,263 @@
+//=============================================================================
+// PongCollision.cpp
+//=============================================================================
+
+#include "PongCollision.h"
+#include <math.h>
+
+// A ball moving within about 0.06 degrees of a surface slides along it
+// rather than bouncing: the float rotation cannot represent a smaller
+// bounce, so it would touch the same surface again at time 0 forever.
+static const float GRAZING = 1.0e-3f;
+
+static float clampf(float v, float lo, float hi)
+{
+   return v < lo ? lo : (v > hi ? hi : v);
+}
+
+SimVec2 pongBallVelocity(const BallInfo& ball)
+{
+   SimVec2 vel;
+   vel.x = -sinf(ball.rotation) * ball.speed;
+   vel.y =  cosf(ball.rotation) * ball.speed;
+   return vel;
+}
+
+bool sweepCircleBox(const SimVec2& pos, const SimVec2& vel, float radius,
+                    const SimVec2& boxMin, const SimVec2& boxMax, float maxTime,
+                    float& toi, SimVec2& normal)
+{
+   // Already overlapping: only a hit if the ball keeps moving inwards.
+   float dx = pos.x - clampf(pos.x, boxMin.x, boxMax.x);
+   float dy = pos.y - clampf(pos.y, boxMin.y, boxMax.y);
+   float d2 = dx * dx + dy * dy;
+   if (d2 < radius * radius)
+   {
+      SimVec2 n;
+      if (d2 > 0.0f)
+      {
+         float d = sqrtf(d2);
+         n.x = dx / d;
+         n.y = dy / d;
+      }
+      else
+      {
+         // Centre inside the box: leave through the nearest face.
+         float left   = pos.x - boxMin.x, right = boxMax.x - pos.x;
+         float bottom = pos.y - boxMin.y, top   = boxMax.y - pos.y;
+         float m = left;          n.x = -1.0f; n.y =  0.0f;
+         if (right  < m) { m = right;  n.x =  1.0f; n.y =  0.0f; }
+         if (bottom < m) { m = bottom; n.x =  0.0f; n.y = -1.0f; }
+         if (top    < m) {             n.x =  0.0f; n.y =  1.0f; }
+      }
+      if (vel.x * n.x + vel.y * n.y >= 0.0f)
+         return false;
+      toi    = 0.0f;
+      normal = n;
+      return true;
+   }
+
+   // Slab test against the box grown by the radius on every side.
+   float tEnter = 0.0f, tExit = maxTime;
+   int   enterAxis = -1;
+   const float* p    = &pos.x;
+   const float* v    = &vel.x;
+   const float* bmin = &boxMin.x;
+   const float* bmax = &boxMax.x;
+   for (int axis = 0; axis < 2; axis++)
+   {
+      float lo = bmin[axis] - radius, hi = bmax[axis] + radius;
+      if (v[axis] == 0.0f)
+      {
+         if (p[axis] < lo || p[axis] > hi)
+            return false;
+         continue;
+      }
+      float t1 = (lo - p[axis]) / v[axis];
+      float t2 = (hi - p[axis]) / v[axis];
+      if (t1 > t2) { float tmp = t1; t1 = t2; t2 = tmp; }
+      if (t1 > tEnter) { tEnter = t1; enterAxis = axis; }
+      if (t2 < tExit)  tExit = t2;
+      if (tEnter > tExit)
+         return false;
+   }
+
+   // Entering through a face of the grown box is a hit on that face.
+   SimVec2 hit;
+   hit.x = pos.x + vel.x * tEnter;
+   hit.y = pos.y + vel.y * tEnter;
+   bool inX = hit.x >= boxMin.x && hit.x <= boxMax.x;
+   bool inY = hit.y >= boxMin.y && hit.y <= boxMax.y;
+   if ((inX || inY) && enterAxis >= 0)
+   {
+      normal.x = normal.y = 0.0f;
+      if (enterAxis == 0) normal.x = vel.x > 0.0f ? -1.0f : 1.0f;
+      else                normal.y = vel.y > 0.0f ? -1.0f : 1.0f;
+      toi = tEnter;
+      return true;
+   }
+
+   // Otherwise it entered a corner square; the rounded corner is the
+   // circle of the radius around the box corner.
+   SimVec2 corner;
+   corner.x = hit.x < boxMin.x ? boxMin.x : boxMax.x;
+   corner.y = hit.y < boxMin.y ? boxMin.y : boxMax.y;
+   float mx = pos.x - corner.x, my = pos.y - corner.y;
+   float a = vel.x * vel.x + vel.y * vel.y;
+   float b = mx * vel.x + my * vel.y;
+   float c = mx * mx + my * my - radius * radius;
+   float disc = b * b - a * c;
+   if (b >= 0.0f || disc < 0.0f)
+      return false;
+   float t = (-b - sqrtf(disc)) / a;
+   if (t > maxTime)
+      return false;
+   if (t < 0.0f)
+      t = 0.0f;
+
+   normal.x = pos.x + vel.x * t - corner.x;
+   normal.y = pos.y + vel.y * t - corner.y;
+   float len = sqrtf(normal.x * normal.x + normal.y * normal.y);
+   normal.x /= len;
+   normal.y /= len;
+   toi = t;
+   return true;
+}
+
+// Records a contact if it is no later than the best one so far.  Later
+// candidates win ties, so pads (tested last) beat walls and goals.
+static void consider(SimContact& best, ContactKind kind, float t, float nx, float ny)
+{
+   if (t < 0.0f)
+      t = 0.0f;
+   if (t <= best.time)
+   {
+      best.kind     = kind;
+      best.time     = t;
+      best.normal.x = nx;
+      best.normal.y = ny;
+   }
+}
+
+// A moving pad is swept in its own frame: the ball moves at vel minus
+// the pad's velocity against a box that stands still.
+static void considerPad(SimContact& best, ContactKind kind, const PadInfo& pad, float padVy,
+                        const SimRect& field, const SimVec2& pos, const SimVec2& vel)
+{
+   SimVec2 boxMin, boxMax, relVel, normal;
+   boxMin.x = pad.bound1.x; boxMin.y = pad.bound2.y;
+   boxMax.x = pad.bound2.x; boxMax.y = pad.bound1.y;
+   relVel.x = vel.x;
+   relVel.y = vel.y - padVy;
+
+   float toi;
+   if (!sweepCircleBox(pos, relVel, BALL_RADIUS, boxMin, boxMax, best.time, toi, normal))
+      return;
+
+   // Only a ball heading into the pad bounces off it.  A moving pad that
+   // catches up with a ball already on its way out slides over it, as it
+   // does when stepped per tick, instead of bouncing it back into itself;
+   // and one that pins the ball against a wall does the same rather than
+   // bouncing it between the two at the same instant.
+   float speed = sqrtf(vel.x * vel.x + vel.y * vel.y);
+   if (vel.x * normal.x + vel.y * normal.y >= -GRAZING * speed)
+      return;
+   if (toi == 0.0f)
+   {
+      if (normal.y > 0.0f && pos.y >= field.top - BALL_RADIUS)
+         return;
+      if (normal.y < 0.0f && pos.y <= field.bottom + BALL_RADIUS)
+         return;
+   }
+   consider(best, kind, toi, normal.x, normal.y);
+}
+
+SimContact pongFindContact(const PongState& s, const SimVec2& vel, float maxTime)
+{
+   return pongFindContact(s, vel, maxTime, 0.0f, 0.0f);
+}
+
+SimContact pongFindContact(const PongState& s, const SimVec2& vel, float maxTime,
+                           float pad1Vy, float pad2Vy)
+{
+   const SimVec2& pos = s.ball.pos;
+   const SimRect& field = s.field;
+
+   SimContact best;
+   best.kind = CONTACT_NONE;
+   best.time = maxTime;
+   best.normal.x = best.normal.y = 0.0f;
+
+   // Goals: the centre crossing the pad line.
+   if (vel.x < 0.0f)
+      consider(best, CONTACT_GOAL_LEFT, (field.left - pos.x) / vel.x, 1.0f, 0.0f);
+   else if (vel.x > 0.0f)
+      consider(best, CONTACT_GOAL_RIGHT, (field.right - pos.x) / vel.x, -1.0f, 0.0f);
+
+   // Walls: the edge of the ball touching the field boundary.
+   float grazing = GRAZING * (fabsf(vel.x) + fabsf(vel.y));
+   if (vel.y > grazing)
+      consider(best, CONTACT_WALL_TOP, (field.top - BALL_RADIUS - pos.y) / vel.y, 0.0f, -1.0f);
+   else if (vel.y < -grazing)
+      consider(best, CONTACT_WALL_BOTTOM, (field.bottom + BALL_RADIUS - pos.y) / vel.y, 0.0f, 1.0f);
+
+   considerPad(best, CONTACT_PAD1, s.pad1, pad1Vy, field, pos, vel);
+   considerPad(best, CONTACT_PAD2, s.pad2, pad2Vy, field, pos, vel);
+   return best;
+}
+
+unsigned int pongResolveContact(PongState& s, const SimContact& c, const SimVec2& vel)
+{
+   BallInfo& ball = s.ball;
+   unsigned int events = 0;
+
+   switch (c.kind)
+   {
+   case CONTACT_NONE:
+      break;
+
+   case CONTACT_WALL_TOP:
+   case CONTACT_WALL_BOTTOM:
+      ball.rotation = SIM_PI - ball.rotation;
+      events |= EVT_WALL;
+      break;
+
+   case CONTACT_PAD1:
+   case CONTACT_PAD2:
+      if (c.normal.y == 0.0f)
+      {
+         // Flat face: mirror the direction in x.
+         ball.rotation = (2 * SIM_PI) - ball.rotation;
+      }
+      else
+      {
+         // Rounded corner: reflect about the contact normal.
+         float along = vel.x * c.normal.x + vel.y * c.normal.y;
+         SimVec2 out;
+         out.x = vel.x - 2.0f * along * c.normal.x;
+         out.y = vel.y - 2.0f * along * c.normal.y;
+         ball.rotation = atan2f(-out.x, out.y);
+      }
+      events |= c.kind == CONTACT_PAD1 ? EVT_PAD1_HIT : EVT_PAD2_HIT;
+      break;
+
+   case CONTACT_GOAL_LEFT:
+      s.player2Score++;
+      pongServe(s);
+      events |= EVT_GOAL_P2;
+      break;
+
+   case CONTACT_GOAL_RIGHT:
+      s.player1Score++;
+      pongServe(s);
+      events |= EVT_GOAL_P1;
+      break;
+   }
+
+   // Keep the angle in [0, 2pi) however often it is mirrored.
+   ball.rotation = fmodf(ball.rotation, 2 * SIM_PI);
+   if (ball.rotation < 0.0f)
+      ball.rotation += 2 * SIM_PI;
+
+   return events;
+}
@@ -0,0 +1,57 @@
+//=============================================================================
+// PongCollision.h
+//
+// Continuous (swept) collision for the ball.  The ball is a circle of
+// BALL_RADIUS moving in a straight line; walls and pads are found by their
+// exact time of impact along that line instead of by testing the ball centre
+// after it has already moved, so no speed or frame time lets it tunnel.
+//=============================================================================
+
+#ifndef PONG_COLLISION_H
+#define PONG_COLLISION_H
+
+#include "PongSim.h"
+
+enum ContactKind
+{
+   CONTACT_NONE,
+   CONTACT_WALL_TOP,
+   CONTACT_WALL_BOTTOM,
+   CONTACT_PAD1,
+   CONTACT_PAD2,
+   CONTACT_GOAL_LEFT,   // ball centre crossed field.left, player 2 scores
+   CONTACT_GOAL_RIGHT   // ball centre crossed field.right, player 1 scores
+};
+
+struct SimContact
+{
+   ContactKind kind;
+   float       time;    // seconds from now, 0 if already touching
+   SimVec2     normal;  // surface normal pointing at the ball
+};
+
+// Sweeps a circle from pos along vel against the box [boxMin, boxMax].
+// Returns true and the first time of impact in [0, maxTime] and the
+// contact normal.  A circle that already overlaps the box and moves
+// further in reports time 0.
+bool sweepCircleBox(const SimVec2& pos, const SimVec2& vel, float radius,
+                    const SimVec2& boxMin, const SimVec2& boxMax, float maxTime,
+                    float& toi, SimVec2& normal);
+
+// The first thing the ball in s touches within maxTime seconds when it
+// travels with velocity vel and the pads stand still.
+SimContact pongFindContact(const PongState& s, const SimVec2& vel, float maxTime);
+
+// As above, but pad1 and pad2 move vertically at pad1Vy and pad2Vy units
+// per second for the whole of maxTime.
+SimContact pongFindContact(const PongState& s, const SimVec2& vel, float maxTime,
+                           float pad1Vy, float pad2Vy);
+
+// Bounces or serves the ball in s for contact c, which it has just been
+// moved to with velocity vel.  Returns the PongEvent mask for it.
+unsigned int pongResolveContact(PongState& s, const SimContact& c, const SimVec2& vel);
+
+// Velocity of the ball along dir(-sin(rotation), cos(rotation)).
+SimVec2 pongBallVelocity(const BallInfo& ball);
+
+#endif // PONG_COLLISION_H
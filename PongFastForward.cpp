@@ -0,0 +1,153 @@
+//=============================================================================
+// PongFastForward.cpp
+//=============================================================================
+
+#include "PongFastForward.h"
+#include "PongCollision.h"
+#include <float.h>
+
+// A policy that keeps asking for a zero hold would never let time pass,
+// and one that chases a target at the edge of its dead zone would change
+// its mind ever more often; every sample is held for at least one tick
+// of the game's 120 Hz.  Contacts still happen at their exact times.
+static const float MIN_HOLD = 1.0f / 120.0f;
+
+// Vertical speed of a pad with up and/or down held, 0 at the field edge
+// it is pushing against (the same clamp movePad() applies per tick).
+static float padVelocity(const PadInfo& pad, bool up, bool down, const SimRect& field)
+{
+   float vy = 0.0f;
+   if (up && pad.pos.y < field.top)      vy += PAD_SPEED;
+   if (down && pad.pos.y > field.bottom) vy -= PAD_SPEED;
+   return vy;
+}
+
+// Seconds until a pad moving at vy reaches the edge of the field.
+static float padStopTime(const PadInfo& pad, float vy, const SimRect& field)
+{
+   if (vy > 0.0f) return (field.top - pad.pos.y) / vy;
+   if (vy < 0.0f) return (field.bottom - pad.pos.y) / vy;
+   return FLT_MAX;
+}
+
+static void movePadFor(PadInfo& pad, float vy, float t, float stopTime, const SimRect& field)
+{
+   float old = pad.pos.y;
+   if (t >= stopTime)
+      pad.pos.y = vy > 0.0f ? field.top : field.bottom;  // exact, so it stays stopped
+   else
+      pad.pos.y += vy * t;
+   pad.updateBoundingBox(pad.pos.y - old);
+}
+
+FastForwardResult pongFastForward(PongState& s, float duration, PongPolicy policy,
+                                  void* user, unsigned int stopEvents)
+{
+   FastForwardResult result;
+   result.time     = 0.0f;
+   result.events   = 0;
+   result.contacts = 0;
+   result.samples  = 0;
+
+   while (result.time < duration)
+   {
+      float horizon = duration - result.time;
+      float hold    = horizon;
+      unsigned int buttons = policy(s, user, hold);
+      result.samples++;
+      if (hold < MIN_HOLD) hold = MIN_HOLD;
+      if (hold < horizon)  horizon = hold;
+
+      // Pads move at a constant speed until they hit the edge of the field.
+      float vy1 = padVelocity(s.pad1, (buttons & BTN_PAD1_UP) != 0, (buttons & BTN_PAD1_DOWN) != 0, s.field);
+      float vy2 = padVelocity(s.pad2, (buttons & BTN_PAD2_UP) != 0, (buttons & BTN_PAD2_DOWN) != 0, s.field);
+      float stop1 = padStopTime(s.pad1, vy1, s.field);
+      float stop2 = padStopTime(s.pad2, vy2, s.field);
+      if (stop1 < horizon) horizon = stop1;
+      if (stop2 < horizon) horizon = stop2;
+
+      bool timeout = false;
+      if (s.rallyTimeout > 0.0f && s.rallyTimeout - s.ball.life <= horizon)
+      {
+         horizon = s.rallyTimeout - s.ball.life;
+         if (horizon < 0.0f) horizon = 0.0f;
+         timeout = true;
+      }
+
+      // Jump straight to whichever comes first.
+      SimVec2 vel = pongBallVelocity(s.ball);
+      SimContact c = pongFindContact(s, vel, horizon, vy1, vy2);
+      float t = c.kind == CONTACT_NONE ? horizon : c.time;
+
+      s.ball.pos.x += vel.x * t;
+      s.ball.pos.y += vel.y * t;
+      s.ball.life  += t;
+      movePadFor(s.pad1, vy1, t, stop1, s.field);
+      movePadFor(s.pad2, vy2, t, stop2, s.field);
+      result.time += t;
+
+      unsigned int events = 0;
+      if (c.kind != CONTACT_NONE)
+      {
+         events = pongResolveContact(s, c, vel);
+         result.contacts++;
+      }
+      else if (timeout)
+      {
+         pongServe(s);
+         events = EVT_BALL_RESET;
+         result.contacts++;
+      }
+
+      result.events |= events;
+      if (events & stopEvents)
+         break;
+   }
+   return result;
+}
+
+// Lowers hold to the time value (changing at rate) takes to reach level.
+// A value sitting right on the level expires at once, since the bot may
+// be about to cross it.
+static void expireAt(float& hold, float value, float rate, float level)
+{
+   if (rate == 0.0f)
+      return;
+   float t = (level - value) / rate;
+   if (t >= 0.0f && t < hold)
+      hold = t;
+}
+
+unsigned int pongTrackingPolicy(const PongState& s, void* user, float& hold)
+{
+   const TrackingPolicy& policy = *(const TrackingPolicy*)user;
+   PongInput in = pongTrackingInput(s, policy.reactionDistance, policy.aimError);
+
+   // Until the next sample the aim stays a fixed distance from the ball,
+   // so it moves with the ball while each pad moves at its own speed.
+   // The bot changes its mind when the ball comes into or out of reach,
+   // or when the aim crosses into or out of a pad's dead zone.
+   SimVec2 vel  = pongBallVelocity(s.ball);
+   float   aimY = pongTrackingAim(s, policy.aimError);
+
+   float reach1 = s.ball.pos.x - s.pad1.pos.x;
+   float reach2 = s.pad2.pos.x - s.ball.pos.x;
+   expireAt(hold, reach1, vel.x, policy.reactionDistance);
+   expireAt(hold, reach2, -vel.x, policy.reactionDistance);
+
+   if (reach1 < policy.reactionDistance)
+   {
+      float vy  = padVelocity(s.pad1, (in.buttons & BTN_PAD1_UP) != 0, (in.buttons & BTN_PAD1_DOWN) != 0, s.field);
+      float gap = aimY - s.pad1.pos.y;
+      expireAt(hold, gap, vel.y - vy, TRACK_DEAD_ZONE);
+      expireAt(hold, gap, vel.y - vy, -TRACK_DEAD_ZONE);
+   }
+   if (reach2 < policy.reactionDistance)
+   {
+      float vy  = padVelocity(s.pad2, (in.buttons & BTN_PAD2_UP) != 0, (in.buttons & BTN_PAD2_DOWN) != 0, s.field);
+      float gap = aimY - s.pad2.pos.y;
+      expireAt(hold, gap, vel.y - vy, TRACK_DEAD_ZONE);
+      expireAt(hold, gap, vel.y - vy, -TRACK_DEAD_ZONE);
+   }
+   return in.buttons;
+}
@@ -0,0 +1,53 @@
+//=============================================================================
+// PongFastForward.h
+//
+// Event-driven simulation.  Between events the ball flies in a straight line
+// and each pad moves at a constant speed, so instead of stepping tick by
+// tick the next wall, pad, goal, pad stop or rally timeout is solved for in
+// closed form and the match jumps straight to it.  Pad input is only asked
+// for at those event boundaries (or when the policy says its answer expires),
+// so replays and AI rollouts cost O(events) rather than O(frames).
+//
+// Time is continuous here: the pads and the ball move together instead of
+// ball-then-pads per tick, so a fast-forwarded match is a close model of
+// pongStep() rather than a bit exact copy of it.  BTN_BALL_RESET and the
+// rotation keys are ignored; only pad buttons are used.
+//=============================================================================
+
+#ifndef PONG_FAST_FORWARD_H
+#define PONG_FAST_FORWARD_H
+
+#include "PongSim.h"
+
+// Returns the buttons to hold from now on.  hold comes in as the time left
+// to simulate; lower it if the answer is only good for that many seconds
+// (for example until the ball comes within reach), and the policy is asked
+// again then even if nothing has happened.
+typedef unsigned int (*PongPolicy)(const PongState& s, void* user, float& hold);
+
+struct FastForwardResult
+{
+   float        time;      // seconds simulated
+   unsigned int events;    // PongEvent mask of everything that happened
+   unsigned int contacts;  // walls, pads, goals and timeouts resolved
+   unsigned int samples;   // policy calls
+};
+
+// Advances s by up to duration seconds, asking policy for pad input at
+// every event.  Stops early right after an event in stopEvents, e.g.
+// EVT_GOAL_P1 | EVT_GOAL_P2 to play out a single rally.  s.tick is left
+// alone; ball.life advances by the time simulated.
+FastForwardResult pongFastForward(PongState& s, float duration, PongPolicy policy,
+                                  void* user, unsigned int stopEvents);
+
+// pongTrackingInput() as a PongPolicy.  It also works out when the bot
+// would change its mind, so a rally of it costs a handful of samples.
+struct TrackingPolicy
+{
+   float reactionDistance;
+   float aimError;
+};
+
+unsigned int pongTrackingPolicy(const PongState& s, void* user, float& hold);
+
+#endif // PONG_FAST_FORWARD_H
@@ -0,0 +1,505 @@
+//=============================================================================
+// PongLoadGen.cpp
+//
+// Load generator for PongServer.  Plays -matches matches at once, two
+// pongTrackingInput() bots a match, each steering from the last state the
+// server sent it, and measures what a player would feel: the time from
+// sending an input to receiving the first state that applied it.  A bot
+// whose match ends joins another, so the load stays steady.  With
+// -spectators, each match is also watched by that many spectators, each on
+// a socket of its own, decoding the snapshots it is sent; run the server
+// with -watches at least -matches times -spectators, since all of them
+// come from this one address.  Each socket answers the server's cookie
+// challenge before its joins and watches are taken.  Linux only,
+// like the server; the clients are spread over -sockets sockets and use the
+// same epoll, recvmmsg() and sendmmsg() batching.
+//
+//    g++ -O2 -std=c++11 PongLoadGen.cpp PongNet.cpp PongSnapshot.cpp PongSim.cpp
+//        PongCollision.cpp FrameTimeHistogram.cpp -o PongLoadGen
+//
+// usage: PongLoadGen [-host a.b.c.d] [-port n] [-matches n] [-sockets n]
+//                    [-spectators n] [-seconds n] [-tickrate hz]
+//
+// The report has the input latency percentiles, states lost, and the time
+// the server says its ticks take.  From that, matches per core is the
+// number of matches that would fill one core's tick budget, assuming the
+// cost grows linearly with the match count.  On loopback this process
+// competes with the server for the CPU, so give the two separate cores.
+//=============================================================================
+
+#ifndef __linux__
+#error PongLoadGen uses epoll and recvmmsg/sendmmsg and builds on Linux only
+#endif
+
+#include "PongNet.h"
+#include "FrameTimeHistogram.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <chrono>
+#include <unordered_map>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+const int NET_BATCH = 64;  // datagrams per recvmmsg()/sendmmsg()
+
+struct Client
+{
+   int          sock;          // index into the sockets
+   unsigned int nonce;
+   bool         seated;
+   unsigned int match;
+   unsigned int token;
+   int          player;
+   double       joinSent;      // seconds, to resend a lost join
+   unsigned long long lastEcho;
+   unsigned int lastTick;      // of the last state, to count lost ones
+   PongState    view;          // the server's state as last received
+};
+
+// Watches the match client 2 * n plays in, following it from match to
+// match.
+struct Watcher
+{
+   int             sock;
+   int             client;
+   bool            watching;
+   unsigned int    match;
+   unsigned int    ackTick;
+   SnapshotHistory history;
+};
+
+// Input latencies in microseconds, bucketed like frame times.
+struct Latency
+{
+   unsigned int       counts[FRAME_TIME_BUCKETS];
+   unsigned long long samples;
+   unsigned int       max;
+
+   void reset() { memset(this, 0, sizeof(*this)); }
+
+   void record(unsigned int us)
+   {
+      counts[FrameTimeHistogram::bucketOf(us)]++;
+      samples++;
+      if (us > max)
+         max = us;
+   }
+
+   // Upper edge of the bucket the quantile falls in, in milliseconds.
+   float quantile(double q) const
+   {
+      unsigned long long rank = (unsigned long long)(q * samples), seen = 0;
+      for (int b = 0; b < FRAME_TIME_BUCKETS; b++)
+      {
+         seen += counts[b];
+         if (seen > rank)
+            return FrameTimeHistogram::bucketHigh(b) / 1000.0f;
+      }
+      return max / 1000.0f;
+   }
+};
+
+// One socket's send batch.
+struct Batch
+{
+   unsigned char out[NET_BATCH][NET_MAX_MESSAGE];
+   iovec         iov[NET_BATCH];
+   mmsghdr       msg[NET_BATCH];
+   int           queued;
+};
+
+static std::vector<int>      gSockets;
+static std::vector<Batch*>   gBatches;
+static unsigned long long    gSent, gSendFailed;
+
+static unsigned long long nowMicros()
+{
+   return std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void flush(int s)
+{
+   Batch& b = *gBatches[s];
+   int done = 0;
+   while (done < b.queued)
+   {
+      int n = sendmmsg(gSockets[s], b.msg + done, b.queued - done, MSG_DONTWAIT);
+      if (n < 0)
+      {
+         if (errno == EINTR)
+            continue;
+         break;
+      }
+      done += n;
+   }
+   gSent       += done;
+   gSendFailed += b.queued - done;
+   b.queued = 0;
+}
+
+static unsigned char* queue(int s)
+{
+   if (gBatches[s]->queued == NET_BATCH)
+      flush(s);
+   return gBatches[s]->out[gBatches[s]->queued];
+}
+
+static void queued(int s, int length)
+{
+   Batch& b = *gBatches[s];
+   b.iov[b.queued].iov_len = length;
+   b.queued++;
+}
+
+static unsigned long long seatKey(unsigned int match, int player)
+{
+   return ((unsigned long long)match << 1) | (unsigned int)player;
+}
+
+int main(int argc, char* argv[])
+{
+   const char* host       = "127.0.0.1";
+   int         port       = NET_DEFAULT_PORT;
+   int         numMatches = 1000;
+   int         numSockets = 16;
+   int         perMatch   = 0;
+   int         runSeconds = 10;
+   float       tickRate   = 120.0f;
+
+   for (int i = 1; i + 1 < argc; i += 2)
+   {
+      if      (strcmp(argv[i], "-host")     == 0) host       = argv[i + 1];
+      else if (strcmp(argv[i], "-port")     == 0) port       = atoi(argv[i + 1]);
+      else if (strcmp(argv[i], "-matches")  == 0) numMatches = atoi(argv[i + 1]);
+      else if (strcmp(argv[i], "-sockets")  == 0) numSockets = atoi(argv[i + 1]);
+      else if (strcmp(argv[i], "-spectators") == 0) perMatch = atoi(argv[i + 1]);
+      else if (strcmp(argv[i], "-seconds")  == 0) runSeconds = atoi(argv[i + 1]);
+      else if (strcmp(argv[i], "-tickrate") == 0) tickRate   = (float)atof(argv[i + 1]);
+      else
+      {
+         fprintf(stderr, "unknown option %s\n", argv[i]);
+         return 1;
+      }
+   }
+   if (numMatches < 1 || numSockets < 1 || perMatch < 0 || tickRate <= 0.0f)
+   {
+      fprintf(stderr, "-matches, -sockets and -tickrate must be positive\n");
+      return 1;
+   }
+
+   sockaddr_in server;
+   memset(&server, 0, sizeof(server));
+   server.sin_family = AF_INET;
+   server.sin_port   = htons((unsigned short)port);
+   if (inet_pton(AF_INET, host, &server.sin_addr) != 1)
+   {
+      fprintf(stderr, "%s is not an IPv4 address\n", host);
+      return 1;
+   }
+
+   int ep = epoll_create1(0);
+   for (int s = 0; s < numSockets + perMatch; s++)
+   {
+      int sock = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+      int size = 4 * 1024 * 1024;
+      setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+      setsockopt(sock, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+      if (sock < 0 || connect(sock, (sockaddr*)&server, sizeof(server)) < 0)
+      {
+         fprintf(stderr, "cannot open a socket to %s:%d: %s\n", host, port, strerror(errno));
+         return 1;
+      }
+      epoll_event ev;
+      ev.events  = EPOLLIN;
+      ev.data.fd = s;
+      epoll_ctl(ep, EPOLL_CTL_ADD, sock, &ev);
+      gSockets.push_back(sock);
+
+      Batch* b = new Batch;
+      memset(b, 0, sizeof(Batch));
+      for (int i = 0; i < NET_BATCH; i++)
+      {
+         b->iov[i].iov_base = b->out[i];
+         b->msg[i].msg_hdr.msg_iov    = &b->iov[i];
+         b->msg[i].msg_hdr.msg_iovlen = 1;
+      }
+      gBatches.push_back(b);
+   }
+
+   int timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+   long long tickNs = (long long)(1e9 / tickRate);
+   itimerspec spec;
+   spec.it_interval.tv_sec  = tickNs / 1000000000;
+   spec.it_interval.tv_nsec = tickNs % 1000000000;
+   spec.it_value = spec.it_interval;
+   timerfd_settime(timer, 0, &spec, 0);
+   epoll_event ev;
+   ev.events  = EPOLLIN;
+   ev.data.fd = -1;
+   epoll_ctl(ep, EPOLL_CTL_ADD, timer, &ev);
+
+   PongState fresh;
+   pongInit(fresh, 1);
+   std::vector<Client> clients(2 * numMatches);
+   for (int c = 0; c < (int)clients.size(); c++)
+   {
+      Client& cl = clients[c];
+      cl.sock     = c % numSockets;
+      cl.nonce    = (unsigned int)c;
+      cl.seated   = false;
+      cl.joinSent = -1.0;
+      cl.view     = fresh;
+   }
+   std::unordered_map<unsigned long long, int> seats;
+
+   std::vector<Watcher*> watchers;
+   std::vector<std::unordered_map<unsigned int, int> > watching(perMatch);  // per socket, by match
+   for (int j = 0; j < perMatch; j++)
+   {
+      for (int m = 0; m < numMatches; m++)
+      {
+         Watcher* w  = new Watcher;
+         w->sock     = numSockets + j;
+         w->client   = 2 * m;
+         w->watching = false;
+         w->match    = 0;
+         w->ackTick  = 0;
+         watchers.push_back(w);
+      }
+   }
+   unsigned long long snapshots = 0, snapshotBytes = 0, undecodable = 0;
+   std::vector<unsigned int> cookies(numSockets + perMatch, 0);  // per socket, 0 until challenged
+
+   Latency* latency = new Latency;
+   latency->reset();
+   unsigned long long states = 0, lostStates = 0, finished = 0;
+   unsigned long long tickCostSum = 0, tickCostSamples = 0;
+   unsigned int tickCostMax = 0;
+
+   unsigned char in[NET_BATCH][NET_MAX_MESSAGE + 1];
+   iovec         inIov[NET_BATCH];
+   mmsghdr       inMsg[NET_BATCH];
+   memset(inMsg, 0, sizeof(inMsg));
+   for (int i = 0; i < NET_BATCH; i++)
+   {
+      inIov[i].iov_base = in[i];
+      inIov[i].iov_len  = sizeof(in[i]);
+      inMsg[i].msg_hdr.msg_iov    = &inIov[i];
+      inMsg[i].msg_hdr.msg_iovlen = 1;
+   }
+
+   unsigned long long start = nowMicros();
+   unsigned long long end = start + (unsigned long long)runSeconds * 1000000;
+   unsigned long long warmup = start + 1000000;  // latencies from the second second on
+   int seated = 0;
+   bool measuring = false;
+
+   while (nowMicros() < end)
+   {
+      epoll_event events[32];
+      int n = epoll_wait(ep, events, 32, 100);
+      for (int e = 0; e < n; e++)
+      {
+         int s = events[e].data.fd;
+         if (s < 0)
+         {
+            unsigned long long expirations;
+            if (read(timer, &expirations, sizeof(expirations)) != sizeof(expirations))
+               continue;
+
+            // One tick: every seated bot sends its buttons, the others
+            // (re)send their join.
+            unsigned long long now = nowMicros();
+            if (!measuring && now >= warmup)
+            {
+               measuring = true;
+               latency->reset();
+               states = lostStates = 0;
+               snapshots = snapshotBytes = undecodable = 0;
+               tickCostSum = tickCostSamples = 0;
+               tickCostMax = 0;
+            }
+            for (int c = 0; c < (int)clients.size(); c++)
+            {
+               Client& cl = clients[c];
+               if (cl.seated)
+               {
+                  NetInput m;
+                  m.match   = cl.match;
+                  m.token   = cl.token;
+                  m.player  = cl.player;
+                  m.buttons = pongTrackingInput(cl.view, 300.0f, 90.0f).buttons & NET_PLAYER_BUTTONS[cl.player];
+                  m.sentUs  = now;
+                  queued(cl.sock, netWrite(m, queue(cl.sock)));
+               }
+               else if (cl.joinSent < 0.0 || now - cl.joinSent > 500000.0)
+               {
+                  NetJoin m;
+                  m.nonce  = cl.nonce;
+                  m.cookie = cookies[cl.sock];
+                  queued(cl.sock, netWrite(m, queue(cl.sock)));
+                  cl.joinSent = (double)now;
+               }
+            }
+            for (int k = 0; k < (int)watchers.size(); k++)
+            {
+               Watcher& w = *watchers[k];
+               const Client& cl = clients[w.client];
+               std::unordered_map<unsigned int, int>& bySocket = watching[w.sock - numSockets];
+               if (w.watching && (!cl.seated || cl.match != w.match))
+               {
+                  bySocket.erase(w.match);
+                  w.watching = false;
+               }
+               if (!w.watching && cl.seated)
+               {
+                  w.watching = true;
+                  w.match    = cl.match;
+                  w.ackTick  = 0;
+                  w.history.clear();
+                  bySocket[w.match] = k;
+               }
+               if (w.watching)
+               {
+                  NetWatch m;
+                  m.match   = w.match;
+                  m.ackTick = w.ackTick;
+                  m.cookie  = cookies[w.sock];
+                  queued(w.sock, netWrite(m, queue(w.sock)));
+               }
+            }
+            for (int k = 0; k < numSockets + perMatch; k++)
+               flush(k);
+            continue;
+         }
+
+         for (;;)
+         {
+            int got = recvmmsg(gSockets[s], inMsg, NET_BATCH, MSG_DONTWAIT, 0);
+            if (got <= 0)
+               break;
+            unsigned long long now = nowMicros();
+            for (int i = 0; i < got; i++)
+            {
+               const unsigned char* data = in[i];
+               int length = (int)inMsg[i].msg_len;
+               NetWelcome w;
+               NetState st;
+               NetSnapshot snap;
+               NetChallenge ch;
+               if (netRead(data, length, ch))
+               {
+                  // The joins that drew it go again next tick.
+                  if (ch.cookie != cookies[s])
+                  {
+                     cookies[s] = ch.cookie;
+                     for (int c = s; s < numSockets && c < (int)clients.size(); c += numSockets)
+                        if (!clients[c].seated)
+                           clients[c].joinSent = -1.0;
+                  }
+               }
+               else if (s >= numSockets && netRead(data, length, snap))
+               {
+                  std::unordered_map<unsigned int, int>& bySocket = watching[s - numSockets];
+                  std::unordered_map<unsigned int, int>::iterator it = bySocket.find(snap.match);
+                  if (it == bySocket.end())
+                     continue;
+                  Watcher& watcher = *watchers[it->second];
+                  PongSnapshot q;
+                  if (!snapshotDecode(snap.data, snap.length, watcher.history, q))
+                  {
+                     undecodable++;
+                     continue;
+                  }
+                  if (q.tick > watcher.ackTick)
+                  {
+                     watcher.history.add(q);
+                     watcher.ackTick = q.tick;
+                  }
+                  snapshots++;
+                  snapshotBytes += snap.length;
+               }
+               else if (netRead(data, length, w))
+               {
+                  if (w.nonce >= clients.size() || clients[w.nonce].seated)
+                     continue;
+                  Client& cl = clients[w.nonce];
+                  cl.seated   = true;
+                  cl.match    = w.match;
+                  cl.token    = w.token;
+                  cl.player   = w.player;
+                  cl.lastEcho = 0;
+                  cl.lastTick = 0;
+                  cl.view     = fresh;
+                  seats[seatKey(w.match, w.player)] = w.nonce;
+                  seated++;
+               }
+               else if (netRead(data, length, st))
+               {
+                  std::unordered_map<unsigned long long, int>::iterator it =
+                     seats.find(seatKey(st.match, st.player));
+                  if (it == seats.end())
+                     continue;  // from a match this bot has left
+                  int c = it->second;
+                  Client& cl = clients[c];
+                  if (st.tick <= cl.lastTick)
+                     continue;  // late and out of order
+                  if (cl.lastTick != 0)
+                     lostStates += st.tick - cl.lastTick - 1;
+                  cl.lastTick = st.tick;
+                  netApplyState(st, cl.view);
+                  states++;
+                  if (st.echoUs > cl.lastEcho)
+                  {
+                     if (measuring && cl.lastEcho != 0)
+                        latency->record((unsigned int)(now - st.echoUs));
+                     cl.lastEcho = st.echoUs;
+                  }
+                  tickCostSum += st.tickCostUs;
+                  tickCostSamples++;
+                  if (st.tickCostUs > tickCostMax)
+                     tickCostMax = st.tickCostUs;
+                  if (st.over)
+                  {
+                     seats.erase(seatKey(cl.match, cl.player));
+                     cl.seated   = false;
+                     cl.joinSent = -1.0;
+                     seated--;
+                     finished++;
+                  }
+               }
+            }
+            if (got < NET_BATCH)
+               break;
+         }
+      }
+   }
+
+   double seconds = (nowMicros() - warmup) / 1e6;
+   double budgetUs = 1e6 / tickRate;
+   double tickCost = tickCostSamples ? (double)tickCostSum / tickCostSamples : 0.0;
+   printf("matches:        %d (%d of %d players seated at the end)\n", numMatches, seated, 2 * numMatches);
+   printf("finished:       %llu matches\n", finished / 2);
+   printf("states:         %.0f/s received, %.2f%% lost\n", states / seconds,
+          states ? 100.0 * lostStates / (states + lostStates) : 0.0);
+   if (perMatch > 0)
+      printf("snapshots:      %.0f/s received, %.2f bytes each, %llu undecodable\n",
+             snapshots / seconds, snapshots ? (double)snapshotBytes / snapshots : 0.0, undecodable);
+   printf("sent:           %llu datagrams, %llu failed\n", gSent, gSendFailed);
+   printf("input latency:  p50 %.2f ms, p90 %.2f ms, p99 %.2f ms, max %.2f ms (%llu samples)\n",
+          latency->quantile(0.5), latency->quantile(0.9), latency->quantile(0.99),
+          latency->max / 1000.0f, latency->samples);
+   printf("server tick:    %.0f us avg, %u us max of %.0f us budget (%.1f%%)\n",
+          tickCost, tickCostMax, budgetUs, 100.0 * tickCost / budgetUs);
+   if (tickCost > 0.0)
+      printf("matches/core:   %.0f\n", numMatches * budgetUs / tickCost);
+   return 0;
+}
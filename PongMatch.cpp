@@ -0,0 +1,53 @@
+//=============================================================================
+// PongMatch.cpp
+//=============================================================================
+
+#include "PongMatch.h"
+#include "PongAI.h"
+#include <string.h>
+
+MatchResult pongPlayMatch(const MatchConfig& config)
+{
+   MatchResult result;
+   memset(&result, 0, sizeof(result));
+
+   PongState s;
+   pongInit(s, config.seed);
+   s.rallyTimeout = 30.0f;
+
+   const float reactionDistance = 300.0f;
+   const float aimError         = 90.0f;
+   unsigned int rallyHits = 0;
+
+   bool predictive = config.pad2Reaction >= 0.0f;
+   PongAI ai;
+   pongAIInit(ai, config.pad2Reaction, config.pad2AimError, config.seed * 2654435761u);
+
+   while (s.player1Score < config.pointsToWin && s.player2Score < config.pointsToWin &&
+          result.ticks < config.maxTicks)
+   {
+      PongInput in = pongTrackingInput(s, reactionDistance, aimError);
+      if (predictive)
+         in.buttons = (in.buttons & ~(BTN_PAD2_UP | BTN_PAD2_DOWN)) | pongAIInput(ai, s, 2, config.dt);
+      unsigned int events = pongStep(s, in, config.dt);
+      result.ticks++;
+
+      if (events & (EVT_PAD1_HIT | EVT_PAD2_HIT))
+      {
+         result.padHits++;
+         rallyHits++;
+      }
+      if (events & (EVT_GOAL_P1 | EVT_GOAL_P2))
+      {
+         result.rallies++;
+         result.rallyLengths[rallyHits < RALLY_BUCKETS ? rallyHits : RALLY_BUCKETS - 1]++;
+         if (rallyHits > result.longestRally)
+            result.longestRally = rallyHits;
+         rallyHits = 0;
+      }
+   }
+
+   result.player1Score = s.player1Score;
+   result.player2Score = s.player2Score;
+   return result;
+}
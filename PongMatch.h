@@ -0,0 +1,39 @@
+//=============================================================================
+// PongMatch.h
+//
+// Plays a complete headless match between two pongTrackingInput() bots,
+// or the tracking bot on pad1 against the predictive PongAI on pad2.
+// Shared by HeadlessPong and MatchFarm so both measure the same thing.
+//=============================================================================
+
+#ifndef PONG_MATCH_H
+#define PONG_MATCH_H
+
+#include "PongSim.h"
+
+const int RALLY_BUCKETS = 16; // rallies of 0..14 pad hits, last bucket is 15+
+
+struct MatchConfig
+{
+   unsigned int seed;
+   int          pointsToWin;
+   float        dt;
+   unsigned int maxTicks;     // a match that runs this long is abandoned
+   float        pad2Reaction; // PongAI reaction delay for pad2, < 0 for the tracking bot
+   float        pad2AimError; // PongAI aim error
+};
+
+struct MatchResult
+{
+   int          player1Score;
+   int          player2Score;
+   unsigned int ticks;
+   unsigned int rallies;      // points played
+   unsigned int padHits;
+   unsigned int longestRally; // in pad hits
+   unsigned int rallyLengths[RALLY_BUCKETS];
+};
+
+MatchResult pongPlayMatch(const MatchConfig& config);
+
+#endif // PONG_MATCH_H
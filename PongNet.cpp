@@ -0,0 +1,329 @@
+//=============================================================================
+// PongNet.cpp
+//=============================================================================
+
+#include "PongNet.h"
+#include <string.h>
+
+static unsigned char* put32(unsigned char* p, unsigned int v)
+{
+   p[0] = (unsigned char)v;
+   p[1] = (unsigned char)(v >> 8);
+   p[2] = (unsigned char)(v >> 16);
+   p[3] = (unsigned char)(v >> 24);
+   return p + 4;
+}
+
+static unsigned char* put64(unsigned char* p, unsigned long long v)
+{
+   p = put32(p, (unsigned int)v);
+   return put32(p, (unsigned int)(v >> 32));
+}
+
+static unsigned char* putFloat(unsigned char* p, float f)
+{
+   unsigned int bits;
+   memcpy(&bits, &f, 4);
+   return put32(p, bits);
+}
+
+static const unsigned char* get32(const unsigned char* p, unsigned int& v)
+{
+   v = p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+   return p + 4;
+}
+
+static const unsigned char* get64(const unsigned char* p, unsigned long long& v)
+{
+   unsigned int lo, hi;
+   p = get32(p, lo);
+   p = get32(p, hi);
+   v = ((unsigned long long)hi << 32) | lo;
+   return p;
+}
+
+static const unsigned char* getFloat(const unsigned char* p, float& f)
+{
+   unsigned int bits;
+   p = get32(p, bits);
+   memcpy(&f, &bits, 4);
+   return p;
+}
+
+// Message lengths, type byte included.
+static const int JOIN_BYTES    = 1 + 4 + 4;
+static const int WELCOME_BYTES = 1 + 4 + 4 + 4 + 1;
+static const int INPUT_BYTES   = 1 + 4 + 4 + 1 + 1 + 8;
+static const int STATE_BYTES   = 1 + 4 + 1 + 4 + 6 * 4 + 1 + 1 + 1 + 8 + 4;
+static const int WATCH_BYTES   = 1 + 4 + 4 + 4;
+static const int SNAPSHOT_HEAD = 1 + 4;
+static const int CHALLENGE_BYTES = 1 + 4;
+
+int netMessageType(const unsigned char* data, int length)
+{
+   if (length < 1)
+      return 0;
+   switch (data[0])
+   {
+   case NET_JOIN:    return length == JOIN_BYTES    ? NET_JOIN    : 0;
+   case NET_WELCOME: return length == WELCOME_BYTES ? NET_WELCOME : 0;
+   case NET_INPUT:   return length == INPUT_BYTES   ? NET_INPUT   : 0;
+   case NET_STATE:   return length == STATE_BYTES   ? NET_STATE   : 0;
+   case NET_WATCH:   return length == WATCH_BYTES   ? NET_WATCH   : 0;
+   case NET_SNAPSHOT:
+      return length > SNAPSHOT_HEAD && length <= SNAPSHOT_HEAD + SNAPSHOT_MAX_BYTES ? NET_SNAPSHOT : 0;
+   case NET_CHALLENGE: return length == CHALLENGE_BYTES ? NET_CHALLENGE : 0;
+   }
+   return 0;
+}
+
+//===============================================================
+// Encoding
+
+int netWrite(const NetJoin& m, unsigned char* out)
+{
+   unsigned char* p = out;
+   *p++ = NET_JOIN;
+   p = put32(p, m.nonce);
+   p = put32(p, m.cookie);
+   return (int)(p - out);
+}
+
+int netWrite(const NetWelcome& m, unsigned char* out)
+{
+   unsigned char* p = out;
+   *p++ = NET_WELCOME;
+   p = put32(p, m.nonce);
+   p = put32(p, m.match);
+   p = put32(p, m.token);
+   *p++ = (unsigned char)m.player;
+   return (int)(p - out);
+}
+
+int netWrite(const NetInput& m, unsigned char* out)
+{
+   unsigned char* p = out;
+   *p++ = NET_INPUT;
+   p = put32(p, m.match);
+   p = put32(p, m.token);
+   *p++ = (unsigned char)m.player;
+   *p++ = (unsigned char)m.buttons;
+   p = put64(p, m.sentUs);
+   return (int)(p - out);
+}
+
+int netWrite(const NetState& m, unsigned char* out)
+{
+   unsigned char* p = out;
+   *p++ = NET_STATE;
+   p = put32(p, m.match);
+   *p++ = (unsigned char)m.player;
+   p = put32(p, m.tick);
+   p = putFloat(p, m.ballX);
+   p = putFloat(p, m.ballY);
+   p = putFloat(p, m.ballSpeed);
+   p = putFloat(p, m.ballRotation);
+   p = putFloat(p, m.pad1Y);
+   p = putFloat(p, m.pad2Y);
+   *p++ = (unsigned char)m.player1Score;
+   *p++ = (unsigned char)m.player2Score;
+   *p++ = m.over ? 1 : 0;
+   p = put64(p, m.echoUs);
+   p = put32(p, m.tickCostUs);
+   return (int)(p - out);
+}
+
+int netWrite(const NetWatch& m, unsigned char* out)
+{
+   unsigned char* p = out;
+   *p++ = NET_WATCH;
+   p = put32(p, m.match);
+   p = put32(p, m.ackTick);
+   p = put32(p, m.cookie);
+   return (int)(p - out);
+}
+
+int netWrite(const NetSnapshot& m, unsigned char* out)
+{
+   unsigned char* p = out;
+   *p++ = NET_SNAPSHOT;
+   p = put32(p, m.match);
+   memcpy(p, m.data, m.length);
+   return SNAPSHOT_HEAD + m.length;
+}
+
+int netWrite(const NetChallenge& m, unsigned char* out)
+{
+   out[0] = NET_CHALLENGE;
+   put32(out + 1, m.cookie);
+   return CHALLENGE_BYTES;
+}
+
+//===============================================================
+// Decoding
+
+bool netRead(const unsigned char* data, int length, NetJoin& m)
+{
+   if (netMessageType(data, length) != NET_JOIN)
+      return false;
+   const unsigned char* p = data + 1;
+   p = get32(p, m.nonce);
+   get32(p, m.cookie);
+   return true;
+}
+
+bool netRead(const unsigned char* data, int length, NetWelcome& m)
+{
+   if (netMessageType(data, length) != NET_WELCOME)
+      return false;
+   const unsigned char* p = data + 1;
+   p = get32(p, m.nonce);
+   p = get32(p, m.match);
+   p = get32(p, m.token);
+   m.player = *p;
+   return m.player <= 1;
+}
+
+bool netRead(const unsigned char* data, int length, NetInput& m)
+{
+   if (netMessageType(data, length) != NET_INPUT)
+      return false;
+   const unsigned char* p = data + 1;
+   p = get32(p, m.match);
+   p = get32(p, m.token);
+   m.player  = *p++;
+   m.buttons = *p++;
+   get64(p, m.sentUs);
+   return m.player <= 1;
+}
+
+bool netRead(const unsigned char* data, int length, NetState& m)
+{
+   if (netMessageType(data, length) != NET_STATE)
+      return false;
+   const unsigned char* p = data + 1;
+   p = get32(p, m.match);
+   m.player = *p++;
+   p = get32(p, m.tick);
+   p = getFloat(p, m.ballX);
+   p = getFloat(p, m.ballY);
+   p = getFloat(p, m.ballSpeed);
+   p = getFloat(p, m.ballRotation);
+   p = getFloat(p, m.pad1Y);
+   p = getFloat(p, m.pad2Y);
+   m.player1Score = *p++;
+   m.player2Score = *p++;
+   m.over         = *p++ != 0;
+   p = get64(p, m.echoUs);
+   get32(p, m.tickCostUs);
+   return m.player <= 1;
+}
+
+bool netRead(const unsigned char* data, int length, NetWatch& m)
+{
+   if (netMessageType(data, length) != NET_WATCH)
+      return false;
+   const unsigned char* p = data + 1;
+   p = get32(p, m.match);
+   p = get32(p, m.ackTick);
+   get32(p, m.cookie);
+   return true;
+}
+
+bool netRead(const unsigned char* data, int length, NetSnapshot& m)
+{
+   if (netMessageType(data, length) != NET_SNAPSHOT)
+      return false;
+   get32(data + 1, m.match);
+   m.data   = data + SNAPSHOT_HEAD;
+   m.length = length - SNAPSHOT_HEAD;
+   return true;
+}
+
+bool netRead(const unsigned char* data, int length, NetChallenge& m)
+{
+   if (netMessageType(data, length) != NET_CHALLENGE)
+      return false;
+   get32(data + 1, m.cookie);
+   return true;
+}
+
+//===============================================================
+// Cookies
+
+static unsigned long long rotl(unsigned long long x, int b)
+{
+   return (x << b) | (x >> (64 - b));
+}
+
+static void sipRound(unsigned long long v[4])
+{
+   v[0] += v[1]; v[1] = rotl(v[1], 13); v[1] ^= v[0]; v[0] = rotl(v[0], 32);
+   v[2] += v[3]; v[3] = rotl(v[3], 16); v[3] ^= v[2];
+   v[0] += v[3]; v[3] = rotl(v[3], 21); v[3] ^= v[0];
+   v[2] += v[1]; v[1] = rotl(v[1], 17); v[1] ^= v[2]; v[2] = rotl(v[2], 32);
+}
+
+unsigned int netCookie(const unsigned long long key[2], unsigned int addr, unsigned short port)
+{
+   unsigned long long v[4] =
+   {
+      key[0] ^ 0x736f6d6570736575ull, key[1] ^ 0x646f72616e646f6dull,
+      key[0] ^ 0x6c7967656e657261ull, key[1] ^ 0x7465646279746573ull
+   };
+
+   // The six bytes fit one final block, with the length in its top byte.
+   unsigned char bytes[6];
+   memcpy(bytes, &addr, 4);
+   memcpy(bytes + 4, &port, 2);
+   unsigned long long b = 6ull << 56;
+   for (int i = 0; i < 6; i++)
+      b |= (unsigned long long)bytes[i] << (8 * i);
+
+   v[3] ^= b;
+   sipRound(v);
+   sipRound(v);
+   v[0] ^= b;
+   v[2] ^= 0xff;
+   for (int i = 0; i < 4; i++)
+      sipRound(v);
+   unsigned long long h = v[0] ^ v[1] ^ v[2] ^ v[3];
+   return (unsigned int)(h ^ (h >> 32));
+}
+
+//===============================================================
+
+NetState netStateOf(unsigned int match, const PongState& s, bool over)
+{
+   NetState m;
+   m.match        = match;
+   m.player       = 0;
+   m.tick         = s.tick;
+   m.ballX        = s.ball.pos.x;
+   m.ballY        = s.ball.pos.y;
+   m.ballSpeed    = s.ball.speed;
+   m.ballRotation = s.ball.rotation;
+   m.pad1Y        = s.pad1.pos.y;
+   m.pad2Y        = s.pad2.pos.y;
+   m.player1Score = s.player1Score;
+   m.player2Score = s.player2Score;
+   m.over         = over;
+   m.echoUs       = 0;
+   m.tickCostUs   = 0;
+   return m;
+}
+
+void netApplyState(const NetState& m, PongState& s)
+{
+   s.tick          = m.tick;
+   s.ball.pos.x    = m.ballX;
+   s.ball.pos.y    = m.ballY;
+   s.ball.speed    = m.ballSpeed;
+   s.ball.rotation = m.ballRotation;
+   s.pad1.pos.y    = m.pad1Y;
+   s.pad2.pos.y    = m.pad2Y;
+   s.pad1.setBoundingBox(PAD_HALF_WIDTH, PAD_HALF_HEIGHT);
+   s.pad2.setBoundingBox(PAD_HALF_WIDTH, PAD_HALF_HEIGHT);
+   s.player1Score  = m.player1Score;
+   s.player2Score  = m.player2Score;
+}
@@ -0,0 +1,162 @@
+//=============================================================================
+// PongNet.h
+//
+// The UDP protocol between PongServer and its clients.  The server owns the
+// simulation: clients only send the buttons they hold and draw the states
+// they are sent back.
+//
+//    NET_JOIN     client -> server  nonce, cookie
+//    NET_WELCOME  server -> client  nonce, match, token, player
+//    NET_INPUT    client -> server  match, token, player, buttons, send time
+//    NET_STATE    server -> client  match, player, tick, ball x y speed
+//                                   rotation, pad1 y, pad2 y, scores, over,
+//                                   the send time of the player's newest
+//                                   input applied, the server's tick cost
+//    NET_WATCH    client -> server  match, newest snapshot tick received,
+//                                   cookie
+//    NET_SNAPSHOT server -> client  match, PongSnapshot bytes
+//    NET_CHALLENGE server -> client cookie
+//
+// UDP source addresses are easily forged, so the server starts nothing for
+// an address until it has shown it receives what is sent there.  A join or
+// watch without the right cookie is answered only with a challenge naming
+// it, smaller than the request, and the client repeats the request with
+// the cookie.  The cookie is a keyed hash of the client's address and port
+// (netCookie()), so the server keeps nothing per challenge.
+//
+// A join is answered once a match has a free seat; the second join fills
+// it and the match starts.  Each seat gets its own token, which proves an
+// input comes from the player in that seat.  A join repeated because its
+// welcome was lost is sent the same welcome again.  Each player is sent a
+// state every tick, carrying the send time of that player's newest input,
+// so a client can time the round trip from pressing a button to seeing it
+// simulated.  A state with over set is the last one of its match.
+//
+// Spectators send a watch every tick or so, naming the newest snapshot
+// they have; the server answers each tick with a snapshot coded against it
+// (see PongSnapshot.h) until the match ends or they go quiet.
+//
+// Every message starts with its type byte; multi-byte values are little
+// endian whatever the machine, floats raw.  A state is 49 bytes, scores
+// are sent as one byte each.
+//=============================================================================
+
+#ifndef PONG_NET_H
+#define PONG_NET_H
+
+#include "PongSim.h"
+#include "PongSnapshot.h"
+
+const unsigned short NET_DEFAULT_PORT = 27960;
+const int            NET_MAX_MESSAGE  = 64;   // bytes, the largest message
+
+enum NetMessage
+{
+   NET_JOIN      = 1,
+   NET_WELCOME   = 2,
+   NET_INPUT     = 3,
+   NET_STATE     = 4,
+   NET_WATCH     = 5,
+   NET_SNAPSHOT  = 6,
+   NET_CHALLENGE = 7
+};
+
+// The buttons a seated player may press; the ball debugging buttons are
+// not honoured over the network.
+const unsigned int NET_PLAYER_BUTTONS[2] =
+{
+   BTN_PAD1_UP | BTN_PAD1_DOWN,
+   BTN_PAD2_UP | BTN_PAD2_DOWN
+};
+
+struct NetJoin
+{
+   unsigned int nonce;         // echoed in the welcome
+   unsigned int cookie;        // from the server's challenge, 0 before one
+};
+
+struct NetWelcome
+{
+   unsigned int nonce;
+   unsigned int match;
+   unsigned int token;
+   int          player;        // 0 plays pad1, 1 plays pad2
+};
+
+struct NetInput
+{
+   unsigned int       match;
+   unsigned int       token;
+   int                player;
+   unsigned int       buttons;
+   unsigned long long sentUs;  // client clock, only ever echoed
+};
+
+struct NetState
+{
+   unsigned int       match;
+   int                player;     // the seat it is addressed to
+   unsigned int       tick;
+   float              ballX, ballY, ballSpeed, ballRotation;
+   float              pad1Y, pad2Y;
+   int                player1Score, player2Score;
+   bool               over;
+   unsigned long long echoUs;     // sentUs of the newest input applied, 0 if none yet
+   unsigned int       tickCostUs; // server time to step and send all its matches
+};
+
+struct NetWatch
+{
+   unsigned int match;
+   unsigned int ackTick;       // 0 for none yet
+   unsigned int cookie;        // as for a join
+};
+
+// The snapshot bytes are not copied: data points into the datagram or
+// the broadcaster that coded them.
+struct NetSnapshot
+{
+   unsigned int         match;
+   const unsigned char* data;
+   int                  length;
+};
+
+struct NetChallenge
+{
+   unsigned int cookie;        // to send with joins and watches from now on
+};
+
+// The message type of a datagram, 0 if it is not one.
+int netMessageType(const unsigned char* data, int length);
+
+// Encoders return the message length; out needs NET_MAX_MESSAGE bytes.
+int netWrite(const NetJoin& m, unsigned char* out);
+int netWrite(const NetWelcome& m, unsigned char* out);
+int netWrite(const NetInput& m, unsigned char* out);
+int netWrite(const NetState& m, unsigned char* out);
+int netWrite(const NetWatch& m, unsigned char* out);
+int netWrite(const NetSnapshot& m, unsigned char* out);
+int netWrite(const NetChallenge& m, unsigned char* out);
+
+// Decoders return false if the datagram is not that message.
+bool netRead(const unsigned char* data, int length, NetJoin& m);
+bool netRead(const unsigned char* data, int length, NetWelcome& m);
+bool netRead(const unsigned char* data, int length, NetInput& m);
+bool netRead(const unsigned char* data, int length, NetState& m);
+bool netRead(const unsigned char* data, int length, NetWatch& m);
+bool netRead(const unsigned char* data, int length, NetSnapshot& m);
+bool netRead(const unsigned char* data, int length, NetChallenge& m);
+
+// The cookie for an IPv4 address and port, both in network byte order:
+// SipHash-2-4 of the six bytes under key, cut to 32 bits.  Without the key
+// it cannot be worked out from other addresses' cookies.
+unsigned int netCookie(const unsigned long long key[2], unsigned int addr, unsigned short port);
+
+// The state message for s; player, echoUs and tickCostUs are left 0.
+NetState netStateOf(unsigned int match, const PongState& s, bool over);
+
+// Copies what a state carries into s, which should start from pongInit()
+// so the field and pad sizes are right.  Enough for pongTrackingInput().
+void netApplyState(const NetState& m, PongState& s);
+
+#endif // PONG_NET_H
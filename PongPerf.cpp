@@ -0,0 +1,501 @@
+//=============================================================================
+// PongPerf.cpp
+//
+// Regression benchmarks: a fixed set of micro benchmarks (single calls into
+// the simulation) and macro benchmarks (a match, a texture load, a frame),
+// each measured the same way every run so that results from two commits can
+// be compared.  PongBench is for exploring; this is for tracking.
+//
+// Each benchmark is calibrated once to a batch of operations that takes at
+// least -sampletime milliseconds, warmed up, then timed for -samples batches.
+// Reported per operation: the median, its 95% confidence interval (from
+// order statistics, so no assumption that timings are normal), the median
+// absolute deviation, mean, standard deviation, min and max.
+//
+// -json writes the results; -baseline compares against an earlier -json.  A
+// benchmark regressed when its median is more than -threshold percent slower
+// than the baseline's AND its confidence interval lies wholly above the
+// baseline's, so noise alone rarely flags one.  The exit code is 2 if any
+// benchmark regressed.  Builds on any platform:
+//
+//    g++ -O2 -std=c++11 PongPerf.cpp PongSim.cpp PongCollision.cpp PongMatch.cpp PongAI.cpp
+//        SoftwareRenderer.cpp BmpImage.cpp -o PongPerf
+//
+// The bmpload and render benchmarks load the game's .bmp files from the
+// current directory and are skipped if they are not there.
+//
+// usage: PongPerf [-samples n] [-sampletime ms] [-json out.json]
+//                 [-baseline in.json] [-threshold percent] [-label text]
+//                 [-filter substring]
+//=============================================================================
+
+#include "PongSim.h"
+#include "PongMatch.h"
+#include "SoftwareRenderer.h"
+#include "BmpImage.h"
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+static double nowSeconds()
+{
+   using namespace std::chrono;
+   return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+// Everything a benchmark computes ends up here, so none of it is dead code.
+static volatile unsigned int gSink;
+
+static const float TICK = 1.0f / 120.0f;
+
+static const char* const gTextureFiles[] = { "bkgd1.bmp", "ball.bmp", "pad.bmp" };
+
+//===============================================================
+// Micro benchmarks
+
+static const int POINTS = 1024;
+static const int PADS   = 256;
+
+static SimVec2   gPoints[POINTS];
+static PadInfo   gPads[PADS];
+static float     gIncrements[PADS];
+static PongState gStates[4096];
+
+static bool setupPads()
+{
+   unsigned int rng = 11;
+   for (int i = 0; i < POINTS; i++)
+   {
+      gPoints[i].x = -600.0f + (simRandom(rng) % 1200);
+      gPoints[i].y = -450.0f + (simRandom(rng) % 900);
+   }
+   for (int i = 0; i < PADS; i++)
+   {
+      gPads[i].pos.x = -550.0f + (simRandom(rng) % 1100);
+      gPads[i].pos.y = -350.0f + (simRandom(rng) % 700);
+      gPads[i].setBoundingBox(PAD_HALF_WIDTH, PAD_HALF_HEIGHT);
+      gIncrements[i] = (simRandom(rng) & 1) ? 2.5f : -2.5f;
+   }
+   return true;
+}
+
+// The states of a match in play, so updateBall sees rallies, bounces and
+// goals in their usual proportions rather than one ball in flight.
+static bool setupStates()
+{
+   const int n = sizeof(gStates) / sizeof(gStates[0]);
+   PongState s;
+   pongInit(s, 3);
+   s.rallyTimeout = 30.0f;
+   for (int t = 0; t < n * 4; t++)
+   {
+      pongStep(s, pongTrackingInput(s, 300.0f, 90.0f), TICK);
+      if (t % 4 == 0)
+         gStates[t / 4] = s;
+   }
+   return true;
+}
+
+// One op: one point against one pad.
+static unsigned int runCheckCollision(long long ops)
+{
+   unsigned int hits = 0;
+   for (long long i = 0; i < ops; i++)
+      hits += gPads[i & (PADS - 1)].checkCollision(gPoints[i & (POINTS - 1)]);
+   return hits;
+}
+
+// One op: one pad's box rebuilt from its position.
+static unsigned int runSetBoundingBox(long long ops)
+{
+   for (long long i = 0; i < ops; i++)
+   {
+      PadInfo& pad = gPads[i & (PADS - 1)];
+      pad.pos.y += gIncrements[i & (PADS - 1)];
+      pad.setBoundingBox(PAD_HALF_WIDTH, PAD_HALF_HEIGHT);
+      gIncrements[i & (PADS - 1)] = -gIncrements[i & (PADS - 1)];
+   }
+   return (unsigned int)gPads[0].bound1.y;
+}
+
+// One op: one pad's box moved by an increment.
+static unsigned int runUpdateBoundingBox(long long ops)
+{
+   for (long long i = 0; i < ops; i++)
+   {
+      gPads[i & (PADS - 1)].updateBoundingBox(gIncrements[i & (PADS - 1)]);
+      gIncrements[i & (PADS - 1)] = -gIncrements[i & (PADS - 1)];
+   }
+   return (unsigned int)gPads[0].bound2.y;
+}
+
+// One op: one tick of the ball from a recorded state (the copy of the
+// ~100 byte state is included).
+static unsigned int runUpdateBall(long long ops)
+{
+   const int n = sizeof(gStates) / sizeof(gStates[0]);
+   PongInput none;
+   none.buttons = 0;
+   unsigned int events = 0;
+   for (long long i = 0; i < ops; i++)
+   {
+      PongState s = gStates[i % n];
+      events += pongUpdateBall(s, none, TICK);
+   }
+   return events;
+}
+
+//===============================================================
+// Macro benchmarks
+
+// One op: a match to 11 between the tracking bots.  Batches always play
+// the same seeds, so every sample does the same work.
+static unsigned int runMatch(long long ops)
+{
+   MatchConfig config;
+   config.pointsToWin  = 11;
+   config.dt           = TICK;
+   config.maxTicks     = 120 * 60 * 60;
+   config.pad2Reaction = -1.0f;
+   config.pad2AimError = 0.0f;
+   unsigned int ticks = 0;
+   for (long long i = 0; i < ops; i++)
+   {
+      config.seed = 1 + (unsigned int)(i % 64);
+      ticks += pongPlayMatch(config).ticks;
+   }
+   return ticks;
+}
+
+static bool setupTextures()
+{
+   for (int i = 0; i < 3; i++)
+   {
+      FILE* f = fopen(gTextureFiles[i], "rb");
+      if (!f)
+         return false;
+      fclose(f);
+   }
+   // Leaves the caches in place for bmpload_cached.
+   for (int i = 0; i < 3; i++)
+   {
+      BmpImage image;
+      if (!image.load(gTextureFiles[i], true))
+         return false;
+   }
+   return true;
+}
+
+// One op: all three textures.  Reads every 16th texel, which touches every
+// page, so a mapped cache pays for its page faults.
+static unsigned int loadTextures(long long ops, bool useCache)
+{
+   unsigned int sum = 0;
+   for (long long i = 0; i < ops; i++)
+   {
+      for (int t = 0; t < 3; t++)
+      {
+         BmpImage image;
+         image.load(gTextureFiles[t], useCache);
+         for (int p = 0; p < image.width() * image.height(); p += 16)
+            sum += image.texels()[p];
+      }
+   }
+   return sum;
+}
+
+static unsigned int runBmpConvert(long long ops) { return loadTextures(ops, false); }
+static unsigned int runBmpCached(long long ops)  { return loadTextures(ops, true); }
+
+static SoftwareRenderer* gRenderer;
+
+static bool setupRender()
+{
+   if (!setupTextures() || !setupStates())
+      return false;
+   delete gRenderer;
+   gRenderer = new SoftwareRenderer(800, 600);
+   return gRenderer->loadTextures("");
+}
+
+// One op: one 800x600 frame of a match in progress.
+static unsigned int runRender(long long ops)
+{
+   const int n = sizeof(gStates) / sizeof(gStates[0]);
+   for (long long i = 0; i < ops; i++)
+      gRenderer->drawScene(gStates[i % n]);
+   return gRenderer->pixels()[gRenderer->pitch() * 300 + 400];
+}
+
+//===============================================================
+
+struct PerfCase
+{
+   const char*   name;
+   bool        (*setup)();
+   unsigned int (*run)(long long ops);
+   const char*   op;
+};
+
+static const PerfCase gCases[] =
+{
+   { "checkCollision",    setupPads,     runCheckCollision,    "call" },
+   { "setBoundingBox",    setupPads,     runSetBoundingBox,    "call" },
+   { "updateBoundingBox", setupPads,     runUpdateBoundingBox, "call" },
+   { "updateBall",        setupStates,   runUpdateBall,        "tick" },
+   { "match",             0,             runMatch,             "match" },
+   { "bmpload_convert",   setupTextures, runBmpConvert,        "3 textures" },
+   { "bmpload_cached",    setupTextures, runBmpCached,         "3 textures" },
+   { "render",            setupRender,   runRender,            "frame" },
+};
+
+struct PerfResult
+{
+   char      name[64];
+   long long ops;        // per sample
+   int       samples;
+   double    median;     // ns per op, as are the rest
+   double    ciLow;
+   double    ciHigh;
+   double    mad;
+   double    mean;
+   double    stddev;
+   double    min;
+   double    max;
+};
+
+static double timeBatch(const PerfCase& c, long long ops)
+{
+   double start = nowSeconds();
+   gSink += c.run(ops);
+   return nowSeconds() - start;
+}
+
+static void measure(const PerfCase& c, int samples, double sampleTime, PerfResult& r)
+{
+   // Doubles the batch until it fills a sample; that also warms the caches.
+   long long ops = 1;
+   while (timeBatch(c, ops) < sampleTime && ops < (1ll << 40))
+      ops *= 2;
+   timeBatch(c, ops);
+
+   std::vector<double> ns(samples);
+   for (int i = 0; i < samples; i++)
+      ns[i] = 1e9 * timeBatch(c, ops) / ops;
+   std::sort(ns.begin(), ns.end());
+
+   strncpy(r.name, c.name, sizeof(r.name) - 1);
+   r.name[sizeof(r.name) - 1] = 0;
+   r.ops     = ops;
+   r.samples = samples;
+   r.min     = ns.front();
+   r.max     = ns.back();
+   r.median  = samples & 1 ? ns[samples / 2] : 0.5 * (ns[samples / 2 - 1] + ns[samples / 2]);
+
+   // The ranks either side of the median that bound it 95% of the time:
+   // n/2 -+ 1.96 sqrt(n)/2, by the normal approximation to the binomial.
+   double half = 0.98 * sqrt((double)samples);
+   int lo = (int)floor(samples / 2.0 - half);
+   int hi = (int)ceil(samples / 2.0 + half) - 1;
+   r.ciLow  = ns[std::max(lo, 0)];
+   r.ciHigh = ns[std::min(hi, samples - 1)];
+
+   double sum = 0.0, sq = 0.0;
+   std::vector<double> dev(samples);
+   for (int i = 0; i < samples; i++)
+   {
+      sum += ns[i];
+      dev[i] = fabs(ns[i] - r.median);
+   }
+   r.mean = sum / samples;
+   for (int i = 0; i < samples; i++)
+      sq += (ns[i] - r.mean) * (ns[i] - r.mean);
+   r.stddev = samples > 1 ? sqrt(sq / (samples - 1)) : 0.0;
+   std::sort(dev.begin(), dev.end());
+   r.mad = dev[samples / 2];
+}
+
+//===============================================================
+// JSON.  Only what writeJson writes needs to be read back.
+
+static bool writeJson(const char* path, const char* label, const std::vector<PerfResult>& results)
+{
+   FILE* f = fopen(path, "w");
+   if (!f)
+      return false;
+   fprintf(f, "{\n  \"format\": \"pongperf-1\",\n  \"label\": \"");
+   for (const char* p = label; *p; p++)
+   {
+      if (*p == '"' || *p == '\\')
+         fputc('\\', f);
+      if ((unsigned char)*p >= 0x20)
+         fputc(*p, f);
+   }
+   fprintf(f, "\",\n  \"unit\": \"ns/op\",\n  \"benchmarks\": [\n");
+   for (size_t i = 0; i < results.size(); i++)
+   {
+      const PerfResult& r = results[i];
+      fprintf(f, "    { \"name\": \"%s\", \"ops_per_sample\": %lld, \"samples\": %d, "
+                 "\"median\": %.6g, \"ci_low\": %.6g, \"ci_high\": %.6g, \"mad\": %.6g, "
+                 "\"mean\": %.6g, \"stddev\": %.6g, \"min\": %.6g, \"max\": %.6g }%s\n",
+              r.name, r.ops, r.samples, r.median, r.ciLow, r.ciHigh, r.mad,
+              r.mean, r.stddev, r.min, r.max, i + 1 < results.size() ? "," : "");
+   }
+   fprintf(f, "  ]\n}\n");
+   return fclose(f) == 0;
+}
+
+// The number after "key": within [p, end), or false.
+static bool jsonNumber(const char* p, const char* end, const char* key, double& value)
+{
+   char quoted[64];
+   sprintf(quoted, "\"%s\"", key);
+   const char* k = strstr(p, quoted);
+   if (!k || k >= end)
+      return false;
+   k = strchr(k + strlen(quoted), ':');
+   if (!k || k >= end)
+      return false;
+   char* after;
+   value = strtod(k + 1, &after);
+   return after != k + 1;
+}
+
+static bool readJson(const char* path, std::vector<PerfResult>& results)
+{
+   FILE* f = fopen(path, "rb");
+   if (!f)
+      return false;
+   std::string text;
+   char buffer[4096];
+   size_t n;
+   while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0)
+      text.append(buffer, n);
+   fclose(f);
+   if (text.find("\"pongperf-1\"") == std::string::npos)
+      return false;
+
+   // One object per benchmark, each starting at its "name".
+   const char* p = text.c_str();
+   while ((p = strstr(p, "\"name\"")) != 0)
+   {
+      const char* end = strchr(p, '}');
+      const char* open = strchr(p + 6, '"');
+      const char* close = open ? strchr(open + 1, '"') : 0;
+      if (!end || !close || close > end || close - open - 1 >= 64)
+         return false;
+
+      PerfResult r;
+      memset(&r, 0, sizeof(r));
+      memcpy(r.name, open + 1, close - open - 1);
+      if (!jsonNumber(p, end, "median", r.median) ||
+          !jsonNumber(p, end, "ci_low", r.ciLow) ||
+          !jsonNumber(p, end, "ci_high", r.ciHigh))
+         return false;
+      results.push_back(r);
+      p = end;
+   }
+   return true;
+}
+
+//===============================================================
+
+int main(int argc, char* argv[])
+{
+   int         samples      = 30;
+   double      sampleMs     = 10.0;
+   const char* jsonPath     = 0;
+   const char* baselinePath = 0;
+   double      threshold    = 5.0;
+   const char* label        = "";
+   const char* filter       = 0;
+
+   for (int i = 1; i + 1 < argc; i += 2)
+   {
+      if      (strcmp(argv[i], "-samples")    == 0) samples      = atoi(argv[i + 1]);
+      else if (strcmp(argv[i], "-sampletime") == 0) sampleMs     = atof(argv[i + 1]);
+      else if (strcmp(argv[i], "-json")       == 0) jsonPath     = argv[i + 1];
+      else if (strcmp(argv[i], "-baseline")   == 0) baselinePath = argv[i + 1];
+      else if (strcmp(argv[i], "-threshold")  == 0) threshold    = atof(argv[i + 1]);
+      else if (strcmp(argv[i], "-label")      == 0) label        = argv[i + 1];
+      else if (strcmp(argv[i], "-filter")     == 0) filter       = argv[i + 1];
+      else
+      {
+         fprintf(stderr, "unknown option %s\n", argv[i]);
+         return 1;
+      }
+   }
+   if (samples < 5)
+      samples = 5;
+
+   std::vector<PerfResult> baseline;
+   if (baselinePath && !readJson(baselinePath, baseline))
+   {
+      fprintf(stderr, "cannot read baseline %s\n", baselinePath);
+      return 1;
+   }
+
+   printf("%-18s %12s %12s %12s %8s %10s %10s\n", "benchmark", "median ns", "95% ci low",
+          "95% ci high", "mad %", "ops/sample", "op");
+   std::vector<PerfResult> results;
+   const int numCases = sizeof(gCases) / sizeof(gCases[0]);
+   for (int c = 0; c < numCases; c++)
+   {
+      if (filter && !strstr(gCases[c].name, filter))
+         continue;
+      if (gCases[c].setup && !gCases[c].setup())
+      {
+         printf("%-18s skipped, setup failed (textures not in the current directory?)\n", gCases[c].name);
+         continue;
+      }
+      PerfResult r;
+      measure(gCases[c], samples, sampleMs / 1e3, r);
+      results.push_back(r);
+      printf("%-18s %12.2f %12.2f %12.2f %8.2f %10lld %10s\n", r.name, r.median, r.ciLow, r.ciHigh,
+             100.0 * r.mad / r.median, r.ops, gCases[c].op);
+      fflush(stdout);
+   }
+   delete gRenderer;
+
+   if (jsonPath && !writeJson(jsonPath, label, results))
+   {
+      fprintf(stderr, "cannot write %s\n", jsonPath);
+      return 1;
+   }
+
+   int regressions = 0;
+   if (baselinePath)
+   {
+      printf("\nagainst %s, threshold %.1f%%:\n", baselinePath, threshold);
+      for (size_t i = 0; i < results.size(); i++)
+      {
+         const PerfResult& r = results[i];
+         const PerfResult* b = 0;
+         for (size_t j = 0; j < baseline.size() && !b; j++)
+            if (strcmp(baseline[j].name, r.name) == 0)
+               b = &baseline[j];
+         if (!b)
+         {
+            printf("%-18s not in baseline\n", r.name);
+            continue;
+         }
+
+         double change = 100.0 * (r.median / b->median - 1.0);
+         const char* verdict = "same";
+         if (change > threshold && r.ciLow > b->ciHigh)
+         {
+            verdict = "REGRESSED";
+            regressions++;
+         }
+         else if (change < -threshold && r.ciHigh < b->ciLow)
+            verdict = "improved";
+         printf("%-18s %12.2f -> %12.2f %+8.1f%%  %s\n", r.name, b->median, r.median, change, verdict);
+      }
+   }
+   return regressions ? 2 : 0;
+}
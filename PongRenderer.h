@@ -0,0 +1,27 @@
+//=============================================================================
+// PongRenderer.h
+//
+// What PongDemo needs from a renderer: draw one PongState the way the game
+// shows it (tiled background, pads, ball and score).  D3DRenderer does it
+// with ID3DXSprite on a Direct3D device; SoftwareRenderer does it on the CPU
+// into a BGRA framebuffer, so frames can be produced without a GPU.
+//=============================================================================
+
+#ifndef PONG_RENDERER_H
+#define PONG_RENDERER_H
+
+#include "PongSim.h"
+
+class PongRenderer
+{
+public:
+   virtual ~PongRenderer() {}
+
+   // Draws the background, both pads, the ball and the score text.
+   virtual void drawScene(const PongState& s) = 0;
+
+   // Camera distance from the field along -Z, as set by the mouse wheel.
+   virtual void setCameraZ(float z) = 0;
+};
+
+#endif // PONG_RENDERER_H
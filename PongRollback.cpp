@@ -0,0 +1,162 @@
+//=============================================================================
+// PongRollback.cpp
+//=============================================================================
+
+#include "PongRollback.h"
+#include <string.h>
+
+PongTimedInput pongMergeInputs(const PongTimedInput& a, const PongTimedInput& b)
+{
+   PongTimedInput out;
+   out.input.buttons = (a.input.buttons & PLAYER_BUTTONS[0]) | (b.input.buttons & PLAYER_BUTTONS[1]);
+   for (int i = 0; i < PONG_BUTTON_COUNT; i++)
+      out.held[i] = (PLAYER_BUTTONS[1] & (1u << i)) ? b.held[i] : a.held[i];
+   return out;
+}
+
+// Only the buttons one player owns count: pongMergeInputs() drops the rest.
+static bool sameInput(const PongTimedInput& a, const PongTimedInput& b, unsigned int buttons)
+{
+   if ((a.input.buttons & buttons) != (b.input.buttons & buttons))
+      return false;
+   for (int i = 0; i < PONG_BUTTON_COUNT; i++)
+      if ((buttons & (1u << i)) && a.held[i] != b.held[i])
+         return false;
+   return true;
+}
+
+PongRollback::PongRollback()
+{
+   PongState s;
+   pongInit(s, 1);
+   reset(s, 1.0f / 120.0f, 0);
+}
+
+void PongRollback::reset(const PongState& s, float dt, int localPlayer)
+{
+   mState       = s;
+   mDt          = dt;
+   mLocalPlayer = localPlayer;
+   mStart       = s.tick;
+   mConfirmed   = s.tick;
+   memset(&mLastRemote, 0, sizeof(mLastRemote));
+   mLastRemoteTick = s.tick;
+
+   memset(mFrames, 0, sizeof(mFrames));
+   for (int i = 0; i < ROLLBACK_FRAMES; i++)
+   {
+      mFrames[i].tick = s.tick - 1;  // matches no tick that can be asked for
+      mEarlyValid[i]  = false;
+   }
+   mRollbacks = mResimulated = 0;
+}
+
+PongTimedInput PongRollback::step(Frame& f)
+{
+   return mLocalPlayer == 0 ? pongMergeInputs(f.local, f.remote) : pongMergeInputs(f.remote, f.local);
+}
+
+void PongRollback::updateConfirmed()
+{
+   // A slot holding a later tick means mConfirmed's input never came.
+   while (mConfirmed < mState.tick && frame(mConfirmed).tick == mConfirmed &&
+          frame(mConfirmed).confirmed)
+      mConfirmed++;
+}
+
+unsigned int PongRollback::advance(const PongTimedInput& local)
+{
+   if (!canAdvance())
+      return 0;
+
+   unsigned int t = mState.tick;
+   Frame& f = frame(t);
+   f.before    = mState;
+   f.local     = local;
+   f.tick      = t;
+   f.confirmed = false;
+
+   int slot = t % ROLLBACK_FRAMES;
+   if (mEarlyValid[slot] && mEarlyTick[slot] == t)
+   {
+      f.remote    = mEarly[slot];
+      f.confirmed = true;
+      mEarlyValid[slot] = false;
+   }
+   else
+      f.remote = mLastRemote;
+
+   unsigned int events = pongStepTimed(mState, step(f), mDt);
+   updateConfirmed();
+   return events;
+}
+
+bool PongRollback::confirmRemote(unsigned int tick, const PongTimedInput& remote)
+{
+   if (tick < mStart)
+      return false;
+   // Refused before it can become the prediction.
+   if (tick >= mState.tick && tick - mState.tick >= (unsigned int)ROLLBACK_FRAMES)
+      return false;
+
+   if (tick >= mLastRemoteTick)
+   {
+      mLastRemote     = remote;
+      mLastRemoteTick = tick;
+   }
+
+   if (tick >= mState.tick)
+   {
+      int slot = tick % ROLLBACK_FRAMES;
+      mEarly[slot]      = remote;
+      mEarlyTick[slot]  = tick;
+      mEarlyValid[slot] = true;
+      return true;
+   }
+
+   Frame& f = frame(tick);
+   if (f.tick != tick)
+      return false;  // overwritten: more than ROLLBACK_FRAMES ago
+   if (f.confirmed)
+      return true;
+
+   bool mispredicted = !sameInput(f.remote, remote, PLAYER_BUTTONS[1 - mLocalPlayer]);
+   f.remote    = remote;
+   f.confirmed = true;
+
+   if (mispredicted)
+   {
+      // Ticks after this one that are still guesses guess again from
+      // the newest input.
+      for (unsigned int t = tick + 1; t < mState.tick; t++)
+      {
+         Frame& later = frame(t);
+         if (!later.confirmed)
+            later.remote = mLastRemote;
+      }
+      rollback(tick);
+   }
+
+   updateConfirmed();
+   return true;
+}
+
+bool PongRollback::rollback(unsigned int tick)
+{
+   if (tick > mState.tick || (tick < mState.tick && frame(tick).tick != tick))
+      return false;
+   if (tick == mState.tick)
+      return true;  // nothing simulated since
+
+   unsigned int now = mState.tick;
+   mState = frame(tick).before;
+   for (unsigned int t = tick; t < now; t++)
+   {
+      Frame& f = frame(t);
+      f.before = mState;
+      pongStepTimed(mState, step(f), mDt);
+      mResimulated++;
+   }
+   mRollbacks++;
+   return true;
+}
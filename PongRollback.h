@@ -0,0 +1,107 @@
+//=============================================================================
+// PongRollback.h
+//
+// Rollback for latency-hiding netplay.  Each side simulates every tick as
+// soon as its own input is known, predicting that the remote player still
+// holds what they last sent.  When the remote input for a tick arrives and
+// differs from the prediction, the match is rolled back to the snapshot
+// taken before that tick and re-simulated to the present with the real
+// input.
+//
+// The whole match is one PongState, which is POD, so a snapshot is a plain
+// copy.  The last ROLLBACK_FRAMES ticks keep their snapshot and both
+// players' inputs in a ring; input that arrives later than that can no
+// longer be applied and is refused.  So the local side never gets more
+// than ROLLBACK_FRAMES ticks ahead of the oldest tick still waiting for
+// remote input: advance() stalls there until that input arrives.
+//
+// Player 0 owns pad1 and the ball debugging buttons, player 1 owns pad2.
+//=============================================================================
+
+#ifndef PONG_ROLLBACK_H
+#define PONG_ROLLBACK_H
+
+#include "PongSim.h"
+
+const int ROLLBACK_FRAMES = 64;  // ticks that can still be corrected
+
+// The buttons each player's input may carry.
+const unsigned int PLAYER_BUTTONS[2] =
+{
+   BTN_PAD1_UP | BTN_PAD1_DOWN | BTN_BALL_RESET | BTN_BALL_ROT_CCW | BTN_BALL_ROT_CW,
+   BTN_PAD2_UP | BTN_PAD2_DOWN
+};
+
+// Player 0's buttons from a and player 1's from b.
+PongTimedInput pongMergeInputs(const PongTimedInput& a, const PongTimedInput& b);
+
+class PongRollback
+{
+public:
+   PongRollback();
+
+   // Starts from s; localPlayer is 0 or 1.
+   void reset(const PongState& s, float dt, int localPlayer);
+
+   // Simulates the next tick with the local player's input and the remote
+   // player's, confirmed or predicted.  Returns the tick's PongEvent mask.
+   // Does nothing, and returns 0, while canAdvance() is false.
+   unsigned int advance(const PongTimedInput& local);
+
+   // false when the next tick would overwrite the oldest tick still
+   // waiting for remote input.
+   bool canAdvance() const { return mState.tick - mConfirmed < (unsigned int)ROLLBACK_FRAMES; }
+
+   // The remote player's input for tick (a PongState::tick value, i.e.
+   // the state the tick started from).  A tick not simulated yet is kept
+   // for when it is; an earlier one that was mispredicted rolls back.
+   // false if it is too old to apply, which means the two sides diverged.
+   bool confirmRemote(unsigned int tick, const PongTimedInput& remote);
+
+   // Restores the snapshot taken before tick and re-simulates up to the
+   // current tick with the stored inputs.  false if tick is older than
+   // ROLLBACK_FRAMES or in the future.
+   bool rollback(unsigned int tick);
+
+   const PongState& state() const { return mState; }
+   unsigned int     tick() const  { return mState.tick; }
+
+   // Every tick before this has confirmed remote input.
+   unsigned int confirmedTick() const { return mConfirmed; }
+
+   unsigned int rollbacks() const     { return mRollbacks; }
+   unsigned int resimulated() const   { return mResimulated; }
+
+private:
+   struct Frame
+   {
+      PongState      before;      // state the tick started from
+      PongTimedInput local;
+      PongTimedInput remote;      // confirmed, or the prediction used
+      unsigned int   tick;        // which tick the slot holds
+      bool           confirmed;
+   };
+
+   Frame& frame(unsigned int tick) { return mFrames[tick % ROLLBACK_FRAMES]; }
+   PongTimedInput step(Frame& f);
+   void updateConfirmed();
+
+   Frame          mFrames[ROLLBACK_FRAMES];
+   PongState      mState;
+   float          mDt;
+   int            mLocalPlayer;
+   unsigned int   mStart;         // tick reset() began at
+   unsigned int   mConfirmed;
+   PongTimedInput mLastRemote;    // newest confirmed, the prediction
+   unsigned int   mLastRemoteTick;
+
+   // Remote input that arrived before its tick was simulated.
+   PongTimedInput mEarly[ROLLBACK_FRAMES];
+   unsigned int   mEarlyTick[ROLLBACK_FRAMES];
+   bool           mEarlyValid[ROLLBACK_FRAMES];
+
+   unsigned int   mRollbacks;
+   unsigned int   mResimulated;
+};
+
+#endif // PONG_ROLLBACK_H
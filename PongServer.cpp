@@ -0,0 +1,743 @@
+//=============================================================================
+// PongServer.cpp
+//
+// Dedicated, authoritative Pong server: runs many matches in one process and
+// plays them with clients over UDP, see PongNet.h.  Linux only.  The socket
+// and a timerfd ticking at the tick rate share one epoll set; datagrams are
+// read with recvmmsg() and answered with sendmmsg(), NET_BATCH at a time,
+// so a tick costs a few system calls however many players are connected.
+//
+// Matches are kept in two arrays indexed by match id.  MatchSim is what a
+// tick touches: the PongState (BallInfo, PadInfo, scores) and the buttons
+// each player holds.  MatchSeats has the players' tokens, addresses and
+// echo times, read only to address the states and when a packet arrives.
+// A tick steps the running matches half a batch at a time, then writes
+// their states, two per match, into one sendmmsg() batch.
+//
+// Spectators of a match share one SnapshotBroadcaster, so a tick codes
+// the match's snapshot once per distinct acknowledged tick rather than once
+// per spectator.  A match takes at most MAX_SPECTATORS of them, and one
+// IP address may watch at most -watches streams across all matches.
+//
+// Joins and watches must carry the cookie for their source address (see
+// PongNet.h); any other is answered with a challenge and nothing else, so
+// a forged source address is never sent a welcome or a stream.
+//
+// One process runs on one thread; for more cores run more servers on
+// different ports.  PongLoadGen plays many matches against it and reports
+// how many one core can carry.
+//
+//    g++ -O2 -std=c++11 PongServer.cpp PongNet.cpp PongSnapshot.cpp PongSim.cpp
+//        PongCollision.cpp -o PongServer
+//
+// usage: PongServer [-port n] [-tickrate hz] [-points n] [-timeout seconds]
+//                   [-watches n] [-seconds n] [-seed n]
+//
+// A match ends when a player reaches -points, or is dropped once a player
+// has not been heard from for -timeout seconds.  -watches (default 32)
+// limits the streams one IP address may watch.  -seconds stops the server
+// after that long; otherwise it runs until interrupted.  Once a second it
+// prints the matches, packet rates and the time its ticks took.
+//=============================================================================
+
+#ifndef __linux__
+#error PongServer uses epoll, timerfd and recvmmsg/sendmmsg and builds on Linux only
+#endif
+
+#include "PongNet.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <chrono>
+#include <unordered_map>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+const int NET_BATCH = 64;  // datagrams per recvmmsg()/sendmmsg()
+const int MAX_SPECTATORS = 64;  // per match
+
+// Stepped every tick.
+struct MatchSim
+{
+   PongState    state;
+   unsigned int buttons[2];
+   int          seated;       // players seated, 0 for a free slot
+};
+
+// Who plays a match; touched when packets come and go.
+struct MatchSeats
+{
+   unsigned int       token[2];  // one per seat, so neither can pass for the other
+   bool               heardInput[2];  // so the seat's welcome arrived
+   unsigned int       nonce[2];
+   sockaddr_in        addr[2];
+   unsigned long long echoUs[2];
+   double             heard[2];  // server seconds
+};
+
+struct Spectator
+{
+   sockaddr_in  addr;
+   unsigned int ackTick;
+   double       heard;
+};
+
+// Only matches someone watches have one.
+struct MatchWatch
+{
+   SnapshotBroadcaster    broadcaster;
+   std::vector<Spectator> spectators;
+};
+
+struct Server
+{
+   int    sock;
+   float  dt;
+   int    pointsToWin;
+   double timeout;
+   unsigned int seed;
+   unsigned int rng;
+   unsigned long long cookieKey[2];  // for netCookie(), new every run
+   int    maxWatches;                // streams per source address
+
+   std::vector<MatchSim>   sims;
+   std::vector<MatchSeats> seats;
+   std::vector<MatchWatch*> watches;
+   std::vector<int>        freeSlots;
+   int                     waiting;   // the match with one seat taken, or -1
+   int                     running;   // matches with both seats taken
+   std::vector<int>        unheard;   // filled matches a seat has sent no input to yet
+   std::unordered_map<unsigned int, int> watchesFrom;  // streams by source address
+
+   // Outgoing batch.
+   unsigned char out[NET_BATCH][NET_MAX_MESSAGE];
+   sockaddr_in   outAddr[NET_BATCH];
+   iovec         outIov[NET_BATCH];
+   mmsghdr       outMsg[NET_BATCH];
+   int           queued;
+
+   // Incoming batch.
+   unsigned char in[NET_BATCH][NET_MAX_MESSAGE + 1];
+   sockaddr_in   inAddr[NET_BATCH];
+   iovec         inIov[NET_BATCH];
+   mmsghdr       inMsg[NET_BATCH];
+
+   // Counted over the current second.
+   unsigned int received, sent, dropped, ticks, lateTicks;
+   double       tickSeconds, maxTickSeconds;
+   unsigned int lastTickCostUs;
+   unsigned int matchesStarted, matchesFinished, matchesTimedOut;
+   unsigned int snapshots, snapshotEncodes;
+   unsigned long long snapshotBytes;
+};
+
+static volatile sig_atomic_t gStop = 0;
+
+static void onSignal(int)
+{
+   gStop = 1;
+}
+
+static double nowSeconds()
+{
+   return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//===============================================================
+// Sending
+
+static void flush(Server& sv)
+{
+   int done = 0;
+   while (done < sv.queued)
+   {
+      int n = sendmmsg(sv.sock, sv.outMsg + done, sv.queued - done, MSG_DONTWAIT);
+      if (n < 0)
+      {
+         if (errno == EINTR)
+            continue;
+         break;  // socket buffer full: the rest is lost, as UDP may
+      }
+      done += n;
+   }
+   sv.sent    += done;
+   sv.dropped += sv.queued - done;
+   sv.queued   = 0;
+}
+
+// Room for one message to addr; it goes out with the batch.
+static unsigned char* queue(Server& sv, const sockaddr_in& addr)
+{
+   if (sv.queued == NET_BATCH)
+      flush(sv);
+   sv.outAddr[sv.queued] = addr;
+   return sv.out[sv.queued];
+}
+
+static void queued(Server& sv, int length)
+{
+   sv.outIov[sv.queued].iov_len = length;
+   sv.queued++;
+}
+
+//===============================================================
+// Matches
+
+static int allocateMatch(Server& sv)
+{
+   int slot;
+   if (!sv.freeSlots.empty())
+   {
+      slot = sv.freeSlots.back();
+      sv.freeSlots.pop_back();
+   }
+   else
+   {
+      slot = (int)sv.sims.size();
+      sv.sims.push_back(MatchSim());
+      sv.seats.push_back(MatchSeats());
+      sv.watches.push_back(0);
+   }
+
+   MatchSim& m = sv.sims[slot];
+   pongInit(m.state, sv.seed + sv.matchesStarted++);
+   m.state.rallyTimeout = 30.0f;
+   m.buttons[0] = m.buttons[1] = 0;
+   m.seated = 0;
+
+   MatchSeats& seats = sv.seats[slot];
+   memset(&seats, 0, sizeof(seats));
+   seats.token[0] = simRandom(sv.rng);
+   seats.token[1] = simRandom(sv.rng);
+   return slot;
+}
+
+static void forgetSpectator(Server& sv, const Spectator& sp)
+{
+   std::unordered_map<unsigned int, int>::iterator it = sv.watchesFrom.find(sp.addr.sin_addr.s_addr);
+   if (it != sv.watchesFrom.end() && --it->second == 0)
+      sv.watchesFrom.erase(it);
+}
+
+static void releaseMatch(Server& sv, int slot)
+{
+   if (sv.sims[slot].seated == 2)
+      sv.running--;
+   if (sv.waiting == slot)
+      sv.waiting = -1;
+   sv.sims[slot].seated = 0;
+   if (sv.watches[slot])
+   {
+      const std::vector<Spectator>& spectators = sv.watches[slot]->spectators;
+      for (size_t i = 0; i < spectators.size(); i++)
+         forgetSpectator(sv, spectators[i]);
+   }
+   delete sv.watches[slot];
+   sv.watches[slot] = 0;
+   sv.freeSlots.push_back(slot);
+}
+
+static void sendWelcome(Server& sv, int slot, int player)
+{
+   const MatchSeats& seats = sv.seats[slot];
+   NetWelcome w;
+   w.nonce  = seats.nonce[player];
+   w.match  = (unsigned int)slot;
+   w.token  = seats.token[player];
+   w.player = player;
+   queued(sv, netWrite(w, queue(sv, seats.addr[player])));
+}
+
+static bool sameAddr(const sockaddr_in& a, const sockaddr_in& b)
+{
+   return a.sin_addr.s_addr == b.sin_addr.s_addr && a.sin_port == b.sin_port;
+}
+
+// False, and from is challenged, unless cookie is the one for from.
+static bool checkCookie(Server& sv, unsigned int cookie, const sockaddr_in& from)
+{
+   NetChallenge c;
+   c.cookie = netCookie(sv.cookieKey, from.sin_addr.s_addr, from.sin_port);
+   if (cookie == c.cookie)
+      return true;
+   queued(sv, netWrite(c, queue(sv, from)));
+   return false;
+}
+
+static void onJoin(Server& sv, const NetJoin& m, const sockaddr_in& from, double now)
+{
+   if (!checkCookie(sv, m.cookie, from))
+      return;
+
+   int slot = sv.waiting;
+   if (slot >= 0 && sv.seats[slot].nonce[0] == m.nonce && sameAddr(sv.seats[slot].addr[0], from))
+   {
+      sendWelcome(sv, slot, 0);  // the first welcome was lost
+      return;
+   }
+
+   // Or lost after the match filled.  Matches every seat of which has
+   // sent input, or that have ended, leave the list here.
+   for (size_t i = 0; i < sv.unheard.size(); )
+   {
+      int filled = sv.unheard[i];
+      MatchSeats& seats = sv.seats[filled];
+      if (sv.sims[filled].seated != 2 || (seats.heardInput[0] && seats.heardInput[1]))
+      {
+         sv.unheard[i] = sv.unheard.back();
+         sv.unheard.pop_back();
+         continue;
+      }
+      for (int p = 0; p < 2; p++)
+      {
+         if (!seats.heardInput[p] && seats.nonce[p] == m.nonce && sameAddr(seats.addr[p], from))
+         {
+            sendWelcome(sv, filled, p);
+            return;
+         }
+      }
+      i++;
+   }
+
+   int player = 1;
+   if (slot < 0)
+   {
+      slot = sv.waiting = allocateMatch(sv);
+      player = 0;
+   }
+
+   MatchSeats& seats = sv.seats[slot];
+   seats.nonce[player] = m.nonce;
+   seats.addr[player]  = from;
+   seats.heard[player] = now;
+   if (++sv.sims[slot].seated == 2)
+   {
+      sv.waiting = -1;
+      sv.running++;
+      sv.unheard.push_back(slot);
+   }
+   sendWelcome(sv, slot, player);
+}
+
+static void onInput(Server& sv, const NetInput& m, const sockaddr_in& from, double now)
+{
+   if (m.match >= sv.sims.size() || sv.sims[m.match].seated == 0)
+      return;
+   MatchSeats& seats = sv.seats[m.match];
+   int p = m.player;
+   if (seats.token[p] != m.token)
+      return;
+   seats.heardInput[p] = true;
+
+   // Inputs can arrive out of order; the newest wins.
+   if (m.sentUs < seats.echoUs[p])
+      return;
+   seats.echoUs[p] = m.sentUs;
+   seats.addr[p]   = from;
+   seats.heard[p]  = now;
+   sv.sims[m.match].buttons[p] = m.buttons & NET_PLAYER_BUTTONS[p];
+}
+
+static void onWatch(Server& sv, const NetWatch& m, const sockaddr_in& from, double now)
+{
+   if (m.match >= sv.sims.size() || sv.sims[m.match].seated == 0)
+      return;
+   if (!checkCookie(sv, m.cookie, from))
+      return;
+   MatchWatch*& watch = sv.watches[m.match];
+   if (!watch)
+      watch = new MatchWatch;
+
+   std::vector<Spectator>& spectators = watch->spectators;
+   for (size_t i = 0; i < spectators.size(); i++)
+   {
+      if (sameAddr(spectators[i].addr, from))
+      {
+         if (m.ackTick > spectators[i].ackTick)
+            spectators[i].ackTick = m.ackTick;
+         spectators[i].heard = now;
+         return;
+      }
+   }
+   if ((int)spectators.size() >= MAX_SPECTATORS)
+      return;
+   int& fromSource = sv.watchesFrom[from.sin_addr.s_addr];
+   if (fromSource >= sv.maxWatches)
+      return;
+   fromSource++;
+
+   Spectator sp;
+   sp.addr    = from;
+   sp.ackTick = m.ackTick;
+   sp.heard   = now;
+   spectators.push_back(sp);
+}
+
+static void receive(Server& sv, double now)
+{
+   for (;;)
+   {
+      for (int i = 0; i < NET_BATCH; i++)
+         sv.inMsg[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+      int n = recvmmsg(sv.sock, sv.inMsg, NET_BATCH, MSG_DONTWAIT, 0);
+      if (n <= 0)
+         break;
+      sv.received += n;
+
+      for (int i = 0; i < n; i++)
+      {
+         const unsigned char* data = sv.in[i];
+         int length = (int)sv.inMsg[i].msg_len;
+         switch (netMessageType(data, length))
+         {
+         case NET_JOIN:
+         {
+            NetJoin m;
+            if (netRead(data, length, m))
+               onJoin(sv, m, sv.inAddr[i], now);
+            break;
+         }
+         case NET_INPUT:
+         {
+            NetInput m;
+            if (netRead(data, length, m))
+               onInput(sv, m, sv.inAddr[i], now);
+            break;
+         }
+         case NET_WATCH:
+         {
+            NetWatch m;
+            if (netRead(data, length, m))
+               onWatch(sv, m, sv.inAddr[i], now);
+            break;
+         }
+         }
+      }
+      if (n < NET_BATCH)
+         break;
+   }
+   flush(sv);
+}
+
+static void sendSnapshots(Server& sv, int slot, const PongState& s)
+{
+   MatchWatch& watch = *sv.watches[slot];
+   SnapshotBroadcaster& broadcaster = watch.broadcaster;
+   unsigned int encodes = broadcaster.encodes();
+   broadcaster.push(s);
+
+   NetSnapshot m;
+   m.match = (unsigned int)slot;
+   for (size_t i = 0; i < watch.spectators.size(); i++)
+   {
+      const Spectator& sp = watch.spectators[i];
+      m.data = broadcaster.packet(sp.ackTick, m.length);
+      queued(sv, netWrite(m, queue(sv, sp.addr)));
+      sv.snapshotBytes += m.length;
+   }
+   sv.snapshots       += (unsigned int)watch.spectators.size();
+   sv.snapshotEncodes += broadcaster.encodes() - encodes;
+}
+
+// Steps every running match and sends both players its state.
+static void tick(Server& sv)
+{
+   double start = nowSeconds();
+   const int matchesPerBatch = NET_BATCH / 2;
+   int count = (int)sv.sims.size();
+   int batch[NET_BATCH / 2];
+
+   for (int first = 0; first < count; first += matchesPerBatch)
+   {
+      int last = first + matchesPerBatch < count ? first + matchesPerBatch : count;
+      int stepped = 0;
+      for (int i = first; i < last; i++)
+      {
+         MatchSim& m = sv.sims[i];
+         if (m.seated != 2)
+            continue;
+         PongInput in;
+         in.buttons = m.buttons[0] | m.buttons[1];
+         pongStep(m.state, in, sv.dt);
+         batch[stepped++] = i;
+      }
+
+      for (int b = 0; b < stepped; b++)
+      {
+         int i = batch[b];
+         const PongState& s = sv.sims[i].state;
+         const MatchSeats& seats = sv.seats[i];
+         bool over = s.player1Score >= sv.pointsToWin || s.player2Score >= sv.pointsToWin;
+         NetState state = netStateOf((unsigned int)i, s, over);
+         state.tickCostUs = sv.lastTickCostUs;
+         for (int p = 0; p < 2; p++)
+         {
+            state.player = p;
+            state.echoUs = seats.echoUs[p];
+            queued(sv, netWrite(state, queue(sv, seats.addr[p])));
+         }
+         if (sv.watches[i])
+            sendSnapshots(sv, i, s);
+         if (over)
+         {
+            releaseMatch(sv, i);
+            sv.matchesFinished++;
+         }
+      }
+   }
+   flush(sv);
+
+   double seconds = nowSeconds() - start;
+   sv.ticks++;
+   sv.tickSeconds += seconds;
+   if (seconds > sv.maxTickSeconds)
+      sv.maxTickSeconds = seconds;
+   sv.lastTickCostUs = (unsigned int)(seconds * 1e6);
+}
+
+static void dropSilent(Server& sv, double now)
+{
+   for (int i = 0; i < (int)sv.sims.size(); i++)
+   {
+      int seated = sv.sims[i].seated;
+      if (seated == 0)
+         continue;
+
+      if (sv.watches[i])
+      {
+         std::vector<Spectator>& spectators = sv.watches[i]->spectators;
+         for (size_t k = 0; k < spectators.size(); )
+         {
+            if (now - spectators[k].heard > sv.timeout)
+            {
+               forgetSpectator(sv, spectators[k]);
+               spectators[k] = spectators.back();
+               spectators.pop_back();
+            }
+            else
+               k++;
+         }
+      }
+
+      const MatchSeats& seats = sv.seats[i];
+      for (int p = 0; p < seated; p++)
+      {
+         if (now - seats.heard[p] > sv.timeout)
+         {
+            releaseMatch(sv, i);
+            sv.matchesTimedOut++;
+            break;
+         }
+      }
+   }
+}
+
+static void report(Server& sv, int second, double elapsed)
+{
+   double budgetUs = sv.dt * 1e6;
+   double avgUs = sv.ticks ? sv.tickSeconds * 1e6 / sv.ticks : 0.0;
+   printf("%5d s  matches %6d (+%d waiting)  in %7.0f/s  out %7.0f/s  dropped %u  "
+          "tick %6.0f us avg %6.0f max (%3.0f%% of %.0f)  late %u  finished %u  timed out %u\n",
+          second, sv.running, sv.waiting >= 0 ? 1 : 0, sv.received / elapsed, sv.sent / elapsed,
+          sv.dropped, avgUs, sv.maxTickSeconds * 1e6, 100.0 * avgUs / budgetUs, budgetUs,
+          sv.lateTicks, sv.matchesFinished, sv.matchesTimedOut);
+   if (sv.snapshots)
+      printf("         snapshots %7.0f/s  %.2f bytes each  %.2f per encode\n",
+             sv.snapshots / elapsed, (double)sv.snapshotBytes / sv.snapshots,
+             sv.snapshotEncodes ? (double)sv.snapshots / sv.snapshotEncodes : 0.0);
+   fflush(stdout);
+   sv.received = sv.sent = sv.dropped = sv.ticks = sv.lateTicks = 0;
+   sv.matchesFinished = sv.matchesTimedOut = 0;
+   sv.snapshots = sv.snapshotEncodes = 0;
+   sv.snapshotBytes = 0;
+   sv.tickSeconds = sv.maxTickSeconds = 0.0;
+}
+
+//===============================================================
+
+// The cookie key must not be guessable, so unlike the match seeds it does
+// not come from -seed.
+static void randomKey(unsigned long long key[2])
+{
+   int fd = open("/dev/urandom", O_RDONLY);
+   if (fd >= 0 && read(fd, key, 2 * sizeof(key[0])) == (ssize_t)(2 * sizeof(key[0])))
+   {
+      close(fd);
+      return;
+   }
+   if (fd >= 0)
+      close(fd);
+   key[0] = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+   key[1] = key[0] * 0x9e3779b97f4a7c15ull ^ (unsigned long long)getpid();
+}
+
+static int openSocket(unsigned short port)
+{
+   int sock = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+   if (sock < 0)
+      return -1;
+   int size = 8 * 1024 * 1024;
+   setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+   setsockopt(sock, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+
+   sockaddr_in addr;
+   memset(&addr, 0, sizeof(addr));
+   addr.sin_family      = AF_INET;
+   addr.sin_addr.s_addr = htonl(INADDR_ANY);
+   addr.sin_port        = htons(port);
+   if (bind(sock, (sockaddr*)&addr, sizeof(addr)) < 0)
+   {
+      close(sock);
+      return -1;
+   }
+   return sock;
+}
+
+int main(int argc, char* argv[])
+{
+   int          port        = NET_DEFAULT_PORT;
+   float        tickRate    = 120.0f;
+   int          pointsToWin = 11;
+   float        timeout     = 5.0f;
+   int          runSeconds  = 0;
+   int          maxWatches  = 32;
+   unsigned int seed        = 1;
+
+   for (int i = 1; i + 1 < argc; i += 2)
+   {
+      if      (strcmp(argv[i], "-port")     == 0) port        = atoi(argv[i + 1]);
+      else if (strcmp(argv[i], "-tickrate") == 0) tickRate    = (float)atof(argv[i + 1]);
+      else if (strcmp(argv[i], "-points")   == 0) pointsToWin = atoi(argv[i + 1]);
+      else if (strcmp(argv[i], "-timeout")  == 0) timeout     = (float)atof(argv[i + 1]);
+      else if (strcmp(argv[i], "-watches")  == 0) maxWatches  = atoi(argv[i + 1]);
+      else if (strcmp(argv[i], "-seconds")  == 0) runSeconds  = atoi(argv[i + 1]);
+      else if (strcmp(argv[i], "-seed")     == 0) seed        = (unsigned int)strtoul(argv[i + 1], 0, 10);
+      else
+      {
+         fprintf(stderr, "unknown option %s\n", argv[i]);
+         return 1;
+      }
+   }
+   if (tickRate <= 0.0f || pointsToWin < 1 || pointsToWin > 255 || maxWatches < 0)
+   {
+      fprintf(stderr, "-tickrate must be positive, -points 1 to 255 and -watches not negative\n");
+      return 1;
+   }
+
+   Server* sv = new Server;
+   sv->dt          = 1.0f / tickRate;
+   sv->pointsToWin = pointsToWin;
+   sv->timeout     = timeout;
+   sv->seed        = seed;
+   sv->rng         = seed * 2654435761u | 1;
+   sv->maxWatches  = maxWatches;
+   randomKey(sv->cookieKey);
+   sv->waiting     = -1;
+   sv->running     = 0;
+   sv->queued      = 0;
+   sv->received = sv->sent = sv->dropped = sv->ticks = sv->lateTicks = 0;
+   sv->tickSeconds = sv->maxTickSeconds = 0.0;
+   sv->lastTickCostUs = 0;
+   sv->matchesStarted = sv->matchesFinished = sv->matchesTimedOut = 0;
+   sv->snapshots = sv->snapshotEncodes = 0;
+   sv->snapshotBytes = 0;
+
+   for (int i = 0; i < NET_BATCH; i++)
+   {
+      sv->outIov[i].iov_base = sv->out[i];
+      memset(&sv->outMsg[i], 0, sizeof(mmsghdr));
+      sv->outMsg[i].msg_hdr.msg_name    = &sv->outAddr[i];
+      sv->outMsg[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+      sv->outMsg[i].msg_hdr.msg_iov     = &sv->outIov[i];
+      sv->outMsg[i].msg_hdr.msg_iovlen  = 1;
+
+      sv->inIov[i].iov_base = sv->in[i];
+      sv->inIov[i].iov_len  = sizeof(sv->in[i]);
+      memset(&sv->inMsg[i], 0, sizeof(mmsghdr));
+      sv->inMsg[i].msg_hdr.msg_name    = &sv->inAddr[i];
+      sv->inMsg[i].msg_hdr.msg_iov     = &sv->inIov[i];
+      sv->inMsg[i].msg_hdr.msg_iovlen  = 1;
+   }
+
+   sv->sock = openSocket((unsigned short)port);
+   if (sv->sock < 0)
+   {
+      fprintf(stderr, "cannot bind UDP port %d: %s\n", port, strerror(errno));
+      return 1;
+   }
+
+   int timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+   long long tickNs = (long long)(1e9 / tickRate);
+   itimerspec spec;
+   spec.it_interval.tv_sec  = tickNs / 1000000000;
+   spec.it_interval.tv_nsec = tickNs % 1000000000;
+   spec.it_value = spec.it_interval;
+   timerfd_settime(timer, 0, &spec, 0);
+
+   int ep = epoll_create1(0);
+   epoll_event ev;
+   ev.events  = EPOLLIN;
+   ev.data.fd = sv->sock;
+   epoll_ctl(ep, EPOLL_CTL_ADD, sv->sock, &ev);
+   ev.data.fd = timer;
+   epoll_ctl(ep, EPOLL_CTL_ADD, timer, &ev);
+
+   signal(SIGINT, onSignal);
+   signal(SIGTERM, onSignal);
+   printf("serving on UDP port %d at %.0f Hz\n", port, tickRate);
+   fflush(stdout);
+
+   double start = nowSeconds(), lastReport = start;
+   int second = 0;
+   while (!gStop)
+   {
+      epoll_event events[2];
+      int n = epoll_wait(ep, events, 2, -1);
+      if (n < 0 && errno != EINTR)
+         break;
+
+      double now = nowSeconds();
+      for (int e = 0; e < n; e++)
+      {
+         if (events[e].data.fd == sv->sock)
+            receive(*sv, now);
+         else
+         {
+            unsigned long long expirations = 0;
+            if (read(timer, &expirations, sizeof(expirations)) != sizeof(expirations))
+               continue;
+            // Catch up a little after a stall, but never spiral: ticks
+            // missed beyond that are skipped and counted.
+            unsigned long long run = expirations < 4 ? expirations : 4;
+            sv->lateTicks += (unsigned int)(expirations - 1);
+            for (unsigned long long t = 0; t < run; t++)
+               tick(*sv);
+         }
+      }
+
+      if (now - lastReport >= 1.0)
+      {
+         dropSilent(*sv, now);
+         report(*sv, ++second, now - lastReport);
+         lastReport = now;
+         if (runSeconds > 0 && second >= runSeconds)
+            break;
+      }
+   }
+
+   close(ep);
+   close(timer);
+   close(sv->sock);
+   for (size_t i = 0; i < sv->watches.size(); i++)
+      delete sv->watches[i];
+   delete sv;
+   return 0;
+}
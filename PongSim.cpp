@@ -0,0 +1,254 @@
+//=============================================================================
+// PongSim.cpp
+//=============================================================================
+
+#include "PongSim.h"
+#include "PongCollision.h"
+#include "FrameProfiler.h"
+#include <math.h>
+#include <stddef.h>
+
+// A ball wedged between a pad and a wall can touch both over and over in
+// one tick; past this many contacts it waits for the next tick instead.
+static const int MAX_CONTACTS_PER_TICK = 8;
+
+unsigned int simRandom(unsigned int& state)
+{
+   unsigned int x = state;
+   x ^= x << 13;
+   x ^= x >> 17;
+   x ^= x << 5;
+   state = x;
+   return x;
+}
+
+unsigned int pongChecksum(const PongState& s)
+{
+   const unsigned char* bytes = (const unsigned char*)&s;
+   unsigned int hash = 2166136261u;
+   for (size_t i = 0; i < sizeof(PongState); i++)
+      hash = (hash ^ bytes[i]) * 16777619u;
+   return hash;
+}
+
+void pongInit(PongState& s, unsigned int seed)
+{
+   // set field dimensions:
+   s.field.top    =  400.0f;
+   s.field.bottom = -400.0f;
+   s.field.right  =  550.0f;
+   s.field.left   = -550.0f;
+
+   // initialize player scores:
+   s.player1Score = 0;
+   s.player2Score = 0;
+
+   // xorshift must never be seeded with zero.
+   s.rngState = seed ? seed : 0x9E3779B9u;
+   s.tick     = 0;
+
+   // set ball data:
+   s.ball.pos.x    = 0.0f;
+   s.ball.pos.y    = 0.0f;
+   s.ball.speed    = BALL_SPEED;
+   s.ball.rotation = BALL_START_ROT;
+   s.ball.life     = 0.0f;
+   s.resetRotation = s.ball.rotation;
+   s.rallyTimeout  = 0.0f;
+
+   // set pads data:
+   s.pad1.pos.x = s.field.left;  s.pad1.pos.y = 0.0f;
+   s.pad2.pos.x = s.field.right; s.pad2.pos.y = 0.0f;
+   s.pad1.setBoundingBox(PAD_HALF_WIDTH, PAD_HALF_HEIGHT);
+   s.pad2.setBoundingBox(PAD_HALF_WIDTH, PAD_HALF_HEIGHT);
+}
+
+void pongServe(PongState& s)
+{
+   s.ball.pos.x = s.ball.pos.y = 0.0f;
+   s.ball.life  = 0.0f;
+   int angleDegree = (int)(simRandom(s.rngState) % 360);
+   s.ball.rotation = angleDegree * (SIM_PI / 180.0f);
+}
+
+int pongButtonIndex(unsigned int button)
+{
+   int i = 0;
+   while (i < PONG_BUTTON_COUNT - 1 && !(button & (1u << i)))
+      i++;
+   return i;
+}
+
+// The ball turns for rotCcw and rotCw of the dt seconds it moves.
+static unsigned int updateBall(PongState& s, unsigned int buttons, float rotCcw, float rotCw, float dt)
+{
+   PROFILE_SCOPE("updateBall");
+   BallInfo& ball = s.ball;
+   unsigned int events = 0;
+
+   if (buttons & BTN_BALL_RESET)
+   {
+      ball.rotation = s.resetRotation;
+      ball.pos.x = ball.pos.y = 0.0f;
+      ball.life = 0.0f;
+      events |= EVT_BALL_RESET;
+   }
+   // Some serves are (nearly) vertical and would bounce between the walls
+   // forever; unattended matches set rallyTimeout to serve again.
+   if (s.rallyTimeout > 0.0f && ball.life > s.rallyTimeout)
+   {
+      pongServe(s);
+      events |= EVT_BALL_RESET;
+   }
+   if (buttons & BTN_BALL_ROT_CCW)
+      ball.rotation -= SIM_PI * rotCcw;
+   if (buttons & BTN_BALL_ROT_CW)
+      ball.rotation += SIM_PI * rotCw;
+
+   // Move the ball through the tick one contact at a time: find the
+   // exact time of the first thing it touches, move there, bounce and
+   // carry on with whatever is left of dt.
+   float remaining = dt;
+   for (int contacts = 0; contacts < MAX_CONTACTS_PER_TICK && remaining > 0.0f; contacts++)
+   {
+      SimVec2 vel = pongBallVelocity(ball);
+      SimContact c = pongFindContact(s, vel, remaining);
+      float t = c.kind == CONTACT_NONE ? remaining : c.time;
+      ball.pos.x += vel.x * t;
+      ball.pos.y += vel.y * t;
+      remaining  -= t;
+
+      events |= pongResolveContact(s, c, vel);
+      if (c.kind == CONTACT_NONE)
+         break;
+   }
+   ball.life += dt;
+
+   return events;
+}
+
+unsigned int pongUpdateBall(PongState& s, const PongInput& in, float dt)
+{
+   return updateBall(s, in.buttons, dt, dt, dt);
+}
+
+// Moves pad at PAD_SPEED while up or down is held, clamped to the field.
+static void movePad(PadInfo& pad, bool up, bool down, const SimRect& field, float dt)
+{
+   if (up && pad.pos.y < field.top)
+   {
+      float old = pad.pos.y;                       // store old value
+      pad.pos.y += PAD_SPEED * dt;                 // increment pad
+      if (pad.pos.y > field.top) pad.pos.y = field.top;
+      pad.updateBoundingBox(pad.pos.y - old);      // update bounding box
+   }
+   if (down && pad.pos.y > field.bottom)
+   {
+      float old = pad.pos.y;                       // store old value
+      pad.pos.y -= PAD_SPEED * dt;                 // decrement pad
+      if (pad.pos.y < field.bottom) pad.pos.y = field.bottom;
+      pad.updateBoundingBox(pad.pos.y - old);      // update bounding box
+   }
+}
+
+void pongUpdatePads(PongState& s, const PongInput& in, float dt)
+{
+   PROFILE_SCOPE("updatePads");
+   movePad(s.pad1, (in.buttons & BTN_PAD1_UP) != 0, (in.buttons & BTN_PAD1_DOWN) != 0, s.field, dt);
+   movePad(s.pad2, (in.buttons & BTN_PAD2_UP) != 0, (in.buttons & BTN_PAD2_DOWN) != 0, s.field, dt);
+}
+
+unsigned int pongStep(PongState& s, const PongInput& in, float dt)
+{
+   unsigned int events = pongUpdateBall(s, in, dt);
+   pongUpdatePads(s, in, dt);
+   s.tick++;
+   return events;
+}
+
+unsigned int pongStepTimed(PongState& s, const PongTimedInput& in, float dt)
+{
+   const float* held = in.held;
+   unsigned int buttons = in.input.buttons;
+   unsigned int events = updateBall(s, buttons, held[pongButtonIndex(BTN_BALL_ROT_CCW)],
+                                    held[pongButtonIndex(BTN_BALL_ROT_CW)], dt);
+
+   // Up then down, each for as long as it was held, as pongUpdatePads
+   // does for a whole tick.
+   PROFILE_SCOPE("updatePads");
+   movePad(s.pad1, (buttons & BTN_PAD1_UP) != 0, false, s.field, held[pongButtonIndex(BTN_PAD1_UP)]);
+   movePad(s.pad1, false, (buttons & BTN_PAD1_DOWN) != 0, s.field, held[pongButtonIndex(BTN_PAD1_DOWN)]);
+   movePad(s.pad2, (buttons & BTN_PAD2_UP) != 0, false, s.field, held[pongButtonIndex(BTN_PAD2_UP)]);
+   movePad(s.pad2, false, (buttons & BTN_PAD2_DOWN) != 0, s.field, held[pongButtonIndex(BTN_PAD2_DOWN)]);
+   s.tick++;
+   return events;
+}
+
+PongTimedInput pongTimedInput(const PongInput& in, float dt)
+{
+   PongTimedInput t;
+   t.input = in;
+   for (int i = 0; i < PONG_BUTTON_COUNT; i++)
+      t.held[i] = (in.buttons & (1u << i)) ? dt : 0.0f;
+   return t;
+}
+
+static float lerp(float a, float b, float t)
+{
+   return a + (b - a) * t;
+}
+
+static void lerpPad(PadInfo& out, const PadInfo& prev, const PadInfo& next, float t)
+{
+   float y = lerp(prev.pos.y, next.pos.y, t);
+   out.updateBoundingBox(y - out.pos.y);
+   out.pos.y = y;
+}
+
+PongState pongLerp(const PongState& prev, const PongState& next, float t)
+{
+   PongState out = next;
+
+   // life only goes down when the ball was put back in the middle.
+   if (next.ball.life >= prev.ball.life)
+   {
+      out.ball.pos.x = lerp(prev.ball.pos.x, next.ball.pos.x, t);
+      out.ball.pos.y = lerp(prev.ball.pos.y, next.ball.pos.y, t);
+   }
+   lerpPad(out.pad1, prev.pad1, next.pad1, t);
+   lerpPad(out.pad2, prev.pad2, next.pad2, t);
+   return out;
+}
+
+// Holds the pad's button while the ball is above/below the aim point by
+// more than a small dead zone, so the pad does not jitter around the ball.
+static unsigned int trackButtons(const PadInfo& pad, float aimY,
+                                 unsigned int upButton, unsigned int downButton)
+{
+   if (aimY > pad.pos.y + TRACK_DEAD_ZONE) return upButton;
+   if (aimY < pad.pos.y - TRACK_DEAD_ZONE) return downButton;
+   return 0;
+}
+
+float pongTrackingAim(const PongState& s, float aimError)
+{
+   // Derive a repeatable aim offset in [-aimError, aimError] from the line
+   // the ball travels on (its distance from the origin is constant between
+   // bounces) and the serve RNG, so the bot misses some of its shots.
+   float lineDist = s.ball.pos.x * cosf(s.ball.rotation) + s.ball.pos.y * sinf(s.ball.rotation);
+   unsigned int bits = ((unsigned int)(int)lineDist ^ s.rngState) * 2654435761u;
+   return s.ball.pos.y + ((bits >> 8) * (1.0f / 16777216.0f) * 2.0f - 1.0f) * aimError;
+}
+
+PongInput pongTrackingInput(const PongState& s, float reactionDistance, float aimError)
+{
+   float aimY = pongTrackingAim(s, aimError);
+
+   PongInput in;
+   in.buttons = 0;
+   if (s.ball.pos.x - s.pad1.pos.x < reactionDistance)
+      in.buttons |= trackButtons(s.pad1, aimY, BTN_PAD1_UP, BTN_PAD1_DOWN);
+   if (s.pad2.pos.x - s.ball.pos.x < reactionDistance)
+      in.buttons |= trackButtons(s.pad2, aimY, BTN_PAD2_UP, BTN_PAD2_DOWN);
+   return in;
+}
@@ -0,0 +1,199 @@
+//=============================================================================
+// PongSim.h
+//
+// Headless, deterministic Pong simulation.  All of the game state lives in
+// plain structs with no Direct3D or DirectInput dependencies, so a match can
+// be stepped on any platform.  PongDemo only samples input into a PongInput,
+// calls pongStep() and renders the resulting PongState.
+//
+//    Y
+// -X z X   Same coordinate system as the game: origin in the middle of the
+//   -Y     field, +Y up, pad1 on the left and pad2 on the right.
+//=============================================================================
+
+#ifndef PONG_SIM_H
+#define PONG_SIM_H
+
+//===============================================================
+// Gameplay constants (formerly const members of BallInfo/PadInfo).
+
+const float SIM_PI          = 3.141592654f;
+
+const float BALL_SPEED      = 300.0f;
+const float BALL_MAX_SPEED  = 1000.0f;
+const float BALL_ACCEL      = 200.0f;
+const float BALL_DRAG       = 100.0f;
+const float BALL_START_ROT  = 200.0f * (SIM_PI / 180.0f);
+const float BALL_RADIUS     = 28.0f;  // visible part of ball.bmp
+
+const float PAD_SPEED       = 300.0f;
+const float PAD_HALF_WIDTH  = 20.0f;  // bounding box increment in x, visible part of pad.bmp
+const float PAD_HALF_HEIGHT = 40.0f;  // bounding box increment in y
+
+const float TRACK_DEAD_ZONE = 10.0f;  // pongTrackingInput() holds still this close to its aim
+
+//===============================================================
+// State.  Every struct here is POD so a whole match can be copied,
+// hashed or written to disk with memcpy.
+
+struct SimVec2
+{
+   float x;
+   float y;
+};
+
+// Y grows up, so top > bottom.
+struct SimRect
+{
+   float left;
+   float top;
+   float right;
+   float bottom;
+};
+
+struct BallInfo
+{
+   SimVec2 pos;
+   float   speed;     // units per second along dir(-sin(rotation), cos(rotation))
+   float   rotation;  // radians
+   float   life;      // seconds since the last serve
+};
+
+struct PadInfo
+{
+   SimVec2 pos;
+   SimVec2 bound1; // upper-left rectangle corner
+   SimVec2 bound2; // lower-right rectangle corner
+
+   // input: bounding increment.
+   //        increment must be positive value.
+   // pre:   pos.x and pos.y must be set to valid 2d position.
+   // post:  bound1 and bound2 are set to rectangle enclosing pad object.
+   void setBoundingBox(float incX, float incY)
+   {
+      bound1.x = pos.x - incX; bound1.y = pos.y + incY;
+      bound2.x = pos.x + incX; bound2.y = pos.y - incY;
+   }
+
+   bool checkCollision(const SimVec2& object) const
+   {
+      return object.x > bound1.x && object.y < bound1.y &&
+             object.x < bound2.x && object.y > bound2.y;
+   }
+
+   void updateBoundingBox(float incr)
+   {
+      bound1.y += incr;
+      bound2.y += incr;
+   }
+};
+
+struct PongState
+{
+   BallInfo     ball;
+   PadInfo      pad1;
+   PadInfo      pad2;
+   SimRect      field;
+   int          player1Score;
+   int          player2Score;
+   float        resetRotation; // serve angle restored by BTN_BALL_RESET
+   float        rallyTimeout;  // re-serve without a point after this many seconds, 0 = never
+   unsigned int rngState;      // serve RNG, see simRandom()
+   unsigned int tick;          // number of pongStep() calls so far
+};
+
+//===============================================================
+// Input.  One PongInput is consumed per tick; buttons is a mask
+// of PongButton values that are held down for that tick.
+
+enum PongButton
+{
+   BTN_PAD1_UP      = 1 << 0, // W
+   BTN_PAD1_DOWN    = 1 << 1, // S
+   BTN_PAD2_UP      = 1 << 2, // NUMPAD8
+   BTN_PAD2_DOWN    = 1 << 3, // NUMPAD5
+   BTN_BALL_RESET   = 1 << 4, // R
+   BTN_BALL_ROT_CCW = 1 << 5, // T
+   BTN_BALL_ROT_CW  = 1 << 6  // G
+};
+
+struct PongInput
+{
+   unsigned int buttons;
+};
+
+const int PONG_BUTTON_COUNT = 7;
+
+// Input with sub-tick timing, built from timestamped press and release
+// events (see InputQueue.h).  input has every button that was down at any
+// point in the tick, so a tap shorter than a tick is not lost; held[i] is
+// how many seconds button 1 << i was down within the tick.
+struct PongTimedInput
+{
+   PongInput input;
+   float     held[PONG_BUTTON_COUNT];
+};
+
+// Index of a single PongButton bit in PongTimedInput::held.
+int pongButtonIndex(unsigned int button);
+
+// Returned by pongStep() as a mask of what happened during the tick.
+enum PongEvent
+{
+   EVT_WALL       = 1 << 0,
+   EVT_PAD1_HIT   = 1 << 1,
+   EVT_PAD2_HIT   = 1 << 2,
+   EVT_GOAL_P1    = 1 << 3, // player 1 scored (ball left through the right side)
+   EVT_GOAL_P2    = 1 << 4, // player 2 scored (ball left through the left side)
+   EVT_BALL_RESET = 1 << 5  // BTN_BALL_RESET or rallyTimeout
+};
+
+//===============================================================
+// Simulation
+
+// Puts s into the state PongDemo starts a match with.  seed drives
+// every random serve, so equal seeds and inputs give equal matches.
+void pongInit(PongState& s, unsigned int seed);
+
+// Advances the match by dt seconds: the ball first, then the pads,
+// exactly like PongDemo::updateScene used to.  The ball is swept against
+// walls, pads and goal lines (see PongCollision.h), so it bounces at the
+// exact time of impact and never tunnels.  Returns PongEvent mask.
+unsigned int pongStep(PongState& s, const PongInput& in, float dt);
+
+unsigned int pongUpdateBall(PongState& s, const PongInput& in, float dt);
+void         pongUpdatePads(PongState& s, const PongInput& in, float dt);
+
+// pongStep() for input that changed during the tick: the pads move and the
+// ball turns only for as long as their buttons were held, and a reset
+// pressed at any point in the tick applies.  With every button held for
+// the whole tick or not at all it is exactly pongStep().
+unsigned int pongStepTimed(PongState& s, const PongTimedInput& in, float dt);
+
+// Timed input with each button in in held for the whole of dt.
+PongTimedInput pongTimedInput(const PongInput& in, float dt);
+
+// Puts the ball back in the middle with a random direction.
+void pongServe(PongState& s);
+
+// Blends two consecutive states for rendering: positions are lerped by
+// t in [0, 1], everything else comes from next.  A ball that was served
+// or reset between the two is not lerped, so it never streaks across.
+PongState pongLerp(const PongState& prev, const PongState& next, float t);
+
+// FNV-1a over every byte of s: equal states, equal checksums.  Replays
+// store it to find the tick at which a re-simulation diverges.
+unsigned int pongChecksum(const PongState& s);
+
+// xorshift32; never returns 0 for a non-zero state.
+unsigned int simRandom(unsigned int& state);
+
+// Simple opponent for unattended runs: follows the ball once it is
+// within reactionDistance of the pad on the x axis, aiming up to
+// aimError units off so that rallies end.  Drives both pads.
+PongInput pongTrackingInput(const PongState& s, float reactionDistance, float aimError);
+
+// The height pongTrackingInput() steers the pads towards.
+float pongTrackingAim(const PongState& s, float aimError);
+
+#endif // PONG_SIM_H
@@ -0,0 +1,324 @@
+//=============================================================================
+// PongSnapshot.cpp
+//=============================================================================
+
+#include "PongSnapshot.h"
+#include <math.h>
+#include <string.h>
+
+static const int FIELD_BITS[SNAP_FIELD_COUNT] =
+{
+   SNAPSHOT_POSITION_BITS, SNAPSHOT_POSITION_BITS,
+   SNAPSHOT_ROTATION_BITS, SNAPSHOT_SPEED_BITS,
+   SNAPSHOT_POSITION_BITS, SNAPSHOT_POSITION_BITS,
+   SNAPSHOT_SCORE_BITS,    SNAPSHOT_SCORE_BITS
+};
+
+static const int DELTA_BITS[3] = { 4, 8, 12 };  // size classes 0-2; 3 is full width
+
+static const float BALL_X_MARGIN = 2.0f * BALL_RADIUS;
+
+//===============================================================
+// Bit packing, least significant bit first.
+
+class BitWriter
+{
+public:
+   explicit BitWriter(unsigned char* out) : mOut(out), mBits(0), mCount(0), mBytes(0) {}
+
+   void put(unsigned int value, int bits)
+   {
+      mBits  |= (unsigned long long)value << mCount;
+      mCount += bits;
+      while (mCount >= 8)
+      {
+         mOut[mBytes++] = (unsigned char)mBits;
+         mBits >>= 8;
+         mCount -= 8;
+      }
+   }
+
+   int finish()
+   {
+      if (mCount > 0)
+         mOut[mBytes++] = (unsigned char)mBits;
+      mBits = 0;
+      mCount = 0;
+      return mBytes;
+   }
+
+private:
+   unsigned char*     mOut;
+   unsigned long long mBits;
+   int                mCount;
+   int                mBytes;
+};
+
+class BitReader
+{
+public:
+   BitReader(const unsigned char* data, int length)
+   : mData(data), mLength(length), mBits(0), mCount(0), mNext(0), mOverrun(false) {}
+
+   unsigned int get(int bits)
+   {
+      while (mCount < bits)
+      {
+         if (mNext < mLength)
+            mBits |= (unsigned long long)mData[mNext++] << mCount;
+         else
+            mOverrun = true;
+         mCount += 8;
+      }
+      unsigned int value = (unsigned int)(mBits & ((1ull << bits) - 1));
+      mBits  >>= bits;
+      mCount -= bits;
+      return value;
+   }
+
+   bool overrun() const { return mOverrun; }
+
+private:
+   const unsigned char* mData;
+   int                  mLength;
+   unsigned long long   mBits;
+   int                  mCount;
+   int                  mNext;
+   bool                 mOverrun;
+};
+
+//===============================================================
+// Quantization
+
+static unsigned int quantize(float v, float lo, float hi, int bits)
+{
+   float steps = (float)((1u << bits) - 1);
+   float t = (v - lo) / (hi - lo) * steps + 0.5f;
+   if (t < 0.0f)  return 0;
+   if (t > steps) return (unsigned int)steps;
+   return (unsigned int)t;
+}
+
+static float dequantize(unsigned int q, float lo, float hi, int bits)
+{
+   return lo + q * ((hi - lo) / (float)((1u << bits) - 1));
+}
+
+void snapshotQuantize(const PongState& s, PongSnapshot& q)
+{
+   const SimRect& f = s.field;
+   q.tick = s.tick;
+   q.value[SNAP_BALL_X] = quantize(s.ball.pos.x, f.left - BALL_X_MARGIN, f.right + BALL_X_MARGIN,
+                                   SNAPSHOT_POSITION_BITS);
+   q.value[SNAP_BALL_Y] = quantize(s.ball.pos.y, f.bottom, f.top, SNAPSHOT_POSITION_BITS);
+   q.value[SNAP_PAD1_Y] = quantize(s.pad1.pos.y, f.bottom, f.top, SNAPSHOT_POSITION_BITS);
+   q.value[SNAP_PAD2_Y] = quantize(s.pad2.pos.y, f.bottom, f.top, SNAPSHOT_POSITION_BITS);
+   q.value[SNAP_BALL_SPEED] = quantize(s.ball.speed, 0.0f, BALL_MAX_SPEED, SNAPSHOT_SPEED_BITS);
+
+   // The direction wraps, so a whole turn is 1 << bits steps.
+   float turns = s.ball.rotation * (1.0f / (2.0f * SIM_PI));
+   turns -= floorf(turns);
+   q.value[SNAP_BALL_ROTATION] =
+      (unsigned int)(turns * (1 << SNAPSHOT_ROTATION_BITS) + 0.5f) & ((1 << SNAPSHOT_ROTATION_BITS) - 1);
+
+   q.value[SNAP_SCORE1] = s.player1Score < 255 ? s.player1Score : 255;
+   q.value[SNAP_SCORE2] = s.player2Score < 255 ? s.player2Score : 255;
+}
+
+void snapshotApply(const PongSnapshot& q, PongState& s)
+{
+   const SimRect& f = s.field;
+   s.tick = q.tick;
+   s.ball.pos.x = dequantize(q.value[SNAP_BALL_X], f.left - BALL_X_MARGIN, f.right + BALL_X_MARGIN,
+                             SNAPSHOT_POSITION_BITS);
+   s.ball.pos.y = dequantize(q.value[SNAP_BALL_Y], f.bottom, f.top, SNAPSHOT_POSITION_BITS);
+   s.pad1.pos.y = dequantize(q.value[SNAP_PAD1_Y], f.bottom, f.top, SNAPSHOT_POSITION_BITS);
+   s.pad2.pos.y = dequantize(q.value[SNAP_PAD2_Y], f.bottom, f.top, SNAPSHOT_POSITION_BITS);
+   s.pad1.setBoundingBox(PAD_HALF_WIDTH, PAD_HALF_HEIGHT);
+   s.pad2.setBoundingBox(PAD_HALF_WIDTH, PAD_HALF_HEIGHT);
+   s.ball.speed    = dequantize(q.value[SNAP_BALL_SPEED], 0.0f, BALL_MAX_SPEED, SNAPSHOT_SPEED_BITS);
+   s.ball.rotation = q.value[SNAP_BALL_ROTATION] * (2.0f * SIM_PI / (1 << SNAPSHOT_ROTATION_BITS));
+   s.player1Score  = (int)q.value[SNAP_SCORE1];
+   s.player2Score  = (int)q.value[SNAP_SCORE2];
+}
+
+//===============================================================
+// Coding
+
+// The change from a to b, wrapped for the direction.
+static int difference(int field, unsigned int a, unsigned int b)
+{
+   int d = (int)b - (int)a;
+   if (field == SNAP_BALL_ROTATION)
+   {
+      const int turn = 1 << SNAPSHOT_ROTATION_BITS;
+      if (d >= turn / 2)  d -= turn;
+      if (d < -turn / 2)  d += turn;
+   }
+   return d;
+}
+
+int snapshotEncode(const PongSnapshot& q, const PongSnapshot* base, unsigned char* out)
+{
+   BitWriter w(out);
+   if (!base || q.tick <= base->tick || q.tick - base->tick >= (unsigned int)SNAPSHOT_HISTORY)
+   {
+      w.put(0, 1);
+      w.put(q.tick, 32);
+      for (int f = 0; f < SNAP_FIELD_COUNT; f++)
+         w.put(q.value[f], FIELD_BITS[f]);
+      return w.finish();
+   }
+
+   w.put(1, 1);
+   w.put(q.tick & SNAPSHOT_TICK_MASK, SNAPSHOT_TICK_BITS);
+   w.put(q.tick - base->tick, 6);
+   for (int f = 0; f < SNAP_FIELD_COUNT; f++)
+   {
+      if (q.value[f] == base->value[f])
+      {
+         w.put(0, 1);
+         continue;
+      }
+      w.put(1, 1);
+      int d = difference(f, base->value[f], q.value[f]);
+      unsigned int zz = ((unsigned int)d << 1) ^ (unsigned int)(d >> 31);
+      int size = 0;
+      while (size < 3 && (DELTA_BITS[size] >= FIELD_BITS[f] || zz >= (1u << DELTA_BITS[size])))
+         size++;
+      w.put(size, 2);
+      if (size < 3)
+         w.put(zz, DELTA_BITS[size]);
+      else
+         w.put(q.value[f], FIELD_BITS[f]);
+   }
+   return w.finish();
+}
+
+bool snapshotDecode(const unsigned char* data, int length, const SnapshotHistory& history,
+                    PongSnapshot& q)
+{
+   BitReader r(data, length);
+   if (r.get(1) == 0)
+   {
+      q.tick = r.get(32);
+      for (int f = 0; f < SNAP_FIELD_COUNT; f++)
+         q.value[f] = r.get(FIELD_BITS[f]);
+      return !r.overrun();
+   }
+
+   unsigned int tick = r.get(SNAPSHOT_TICK_BITS);
+   unsigned int age  = r.get(6);
+   if (age == 0)
+      return false;
+   // The slot may since hold a tick SNAPSHOT_HISTORY or more later.
+   const PongSnapshot* base = history.slot((int)((tick - age) % SNAPSHOT_HISTORY));
+   if (!base || ((base->tick + age) & SNAPSHOT_TICK_MASK) != tick)
+      return false;
+   q.tick = base->tick + age;
+   for (int f = 0; f < SNAP_FIELD_COUNT; f++)
+   {
+      q.value[f] = base->value[f];
+      if (r.get(1) == 0)
+         continue;
+      int size = (int)r.get(2);
+      if (size == 3)
+      {
+         q.value[f] = r.get(FIELD_BITS[f]);
+         continue;
+      }
+      unsigned int zz = r.get(DELTA_BITS[size]);
+      int d = (int)(zz >> 1) ^ -(int)(zz & 1);
+      unsigned int mask = (1u << FIELD_BITS[f]) - 1;
+      q.value[f] = (unsigned int)((int)base->value[f] + d) & mask;
+   }
+   return !r.overrun();
+}
+
+//===============================================================
+// SnapshotHistory
+
+SnapshotHistory::SnapshotHistory()
+{
+   clear();
+}
+
+void SnapshotHistory::clear()
+{
+   memset(mValid, 0, sizeof(mValid));
+   mNewest = 0;
+   mCount  = 0;
+}
+
+void SnapshotHistory::add(const PongSnapshot& q)
+{
+   int i = q.tick % SNAPSHOT_HISTORY;
+   mRing[i]  = q;
+   mValid[i] = true;
+   if (mCount == 0 || q.tick > mNewest)
+      mNewest = q.tick;
+   mCount++;
+}
+
+const PongSnapshot* SnapshotHistory::find(unsigned int tick) const
+{
+   const PongSnapshot* q = slot(tick % SNAPSHOT_HISTORY);
+   return q && q->tick == tick ? q : 0;
+}
+
+const PongSnapshot* SnapshotHistory::slot(int index) const
+{
+   return index >= 0 && index < SNAPSHOT_HISTORY && mValid[index] ? &mRing[index] : 0;
+}
+
+//===============================================================
+// SnapshotBroadcaster
+
+SnapshotBroadcaster::SnapshotBroadcaster()
+{
+   reset();
+}
+
+void SnapshotBroadcaster::reset()
+{
+   memset(&mCurrent, 0, sizeof(mCurrent));
+   mHistory.clear();
+   mCoded.clear();
+   // Room for every baseline there can be, so packet() never moves the
+   // bytes it has already handed out.
+   mCoded.reserve(SNAPSHOT_HISTORY + 1);
+   mEncodes = mPackets = 0;
+}
+
+void SnapshotBroadcaster::push(const PongState& s)
+{
+   snapshotQuantize(s, mCurrent);
+   mHistory.add(mCurrent);
+   mCoded.clear();
+}
+
+const unsigned char* SnapshotBroadcaster::packet(unsigned int ackTick, int& length)
+{
+   const PongSnapshot* base = ackTick ? mHistory.find(ackTick) : 0;
+   if (base && base->tick >= mCurrent.tick)
+      base = 0;
+   unsigned int key = base ? base->tick : 0;
+
+   mPackets++;
+   for (size_t i = 0; i < mCoded.size(); i++)
+   {
+      if (mCoded[i].base == key)
+      {
+         length = mCoded[i].length;
+         return mCoded[i].bytes;
+      }
+   }
+
+   mCoded.push_back(Coded());
+   Coded& c = mCoded.back();
+   c.base   = key;
+   c.length = snapshotEncode(mCurrent, base, c.bytes);
+   mEncodes++;
+   length = c.length;
+   return c.bytes;
+}
@@ -0,0 +1,142 @@
+//=============================================================================
+// PongSnapshot.h
+//
+// Small state snapshots for spectators.  A spectator only draws the match,
+// so instead of the full floats of a NetState it gets positions quantized
+// to the field: SNAPSHOT_POSITION_BITS across the field (ball x with a
+// margin of two ball radii either side, for a ball leaving through a goal),
+// the ball's direction in SNAPSHOT_ROTATION_BITS of a turn and its speed in
+// SNAPSHOT_SPEED_BITS up to BALL_MAX_SPEED.
+//
+// Each snapshot is then coded against one the spectator has acknowledged,
+// bit packed:
+//
+//    1 bit        1 for a delta, 0 for a full snapshot
+//    full         32-bit tick, then every field at its full width
+//    delta        16 bits: the snapshot's tick mod 2^16
+//                 6 bits: ticks since the baseline, whose tick mod
+//                 SNAPSHOT_HISTORY names it; a baseline whose slot now
+//                 holds a different tick is refused
+//                 per field, 1 bit "changed"; if changed a 2-bit size class
+//                 and the zigzagged difference in 4, 8 or 12 bits, or the
+//                 new value at full width
+//
+// A moving ball and pads come to about 8 bytes a tick, an idle match to 4,
+// against 49 for a NetState.  Both sides keep their last SNAPSHOT_HISTORY
+// snapshots; a spectator whose acknowledged tick is older than that, or who
+// has none, gets a full snapshot (16 bytes).
+//
+// SnapshotBroadcaster codes each snapshot once per distinct baseline, not
+// once per spectator: spectators acknowledging the same tick share the
+// same bytes.
+//=============================================================================
+
+#ifndef PONG_SNAPSHOT_H
+#define PONG_SNAPSHOT_H
+
+#include "PongSim.h"
+#include <vector>
+
+const int SNAPSHOT_POSITION_BITS = 14;
+const int SNAPSHOT_ROTATION_BITS = 12;
+const int SNAPSHOT_SPEED_BITS    = 10;
+const int SNAPSHOT_SCORE_BITS    = 8;
+const int SNAPSHOT_HISTORY       = 64;   // ticks a baseline stays usable
+const int SNAPSHOT_MAX_BYTES     = 24;   // a full snapshot is 16
+const int SNAPSHOT_TICK_BITS     = 16;   // of a delta's own tick
+const unsigned int SNAPSHOT_TICK_MASK = (1u << SNAPSHOT_TICK_BITS) - 1;
+
+enum SnapshotField
+{
+   SNAP_BALL_X,
+   SNAP_BALL_Y,
+   SNAP_BALL_ROTATION,
+   SNAP_BALL_SPEED,
+   SNAP_PAD1_Y,
+   SNAP_PAD2_Y,
+   SNAP_SCORE1,
+   SNAP_SCORE2,
+   SNAP_FIELD_COUNT
+};
+
+// A quantized PongState: value[f] is SnapshotField f at its width.
+struct PongSnapshot
+{
+   unsigned int tick;
+   unsigned int value[SNAP_FIELD_COUNT];
+};
+
+void snapshotQuantize(const PongState& s, PongSnapshot& q);
+
+// Fills in what a snapshot carries; s should start from pongInit() so the
+// field and the pads' x are right.
+void snapshotApply(const PongSnapshot& q, PongState& s);
+
+// Codes q against base, or in full if base is 0.  out needs
+// SNAPSHOT_MAX_BYTES; returns the bytes used.
+int snapshotEncode(const PongSnapshot& q, const PongSnapshot* base, unsigned char* out);
+
+// The last SNAPSHOT_HISTORY snapshots, by tick.
+class SnapshotHistory
+{
+public:
+   SnapshotHistory();
+
+   void clear();
+   void add(const PongSnapshot& q);
+   const PongSnapshot* find(unsigned int tick) const;
+   const PongSnapshot* newest() const { return mCount ? &mRing[mNewest % SNAPSHOT_HISTORY] : 0; }
+
+   // By tick mod SNAPSHOT_HISTORY, as a delta names its baseline.
+   const PongSnapshot* slot(int index) const;
+
+private:
+   PongSnapshot mRing[SNAPSHOT_HISTORY];
+   bool         mValid[SNAPSHOT_HISTORY];
+   unsigned int mNewest;
+   int          mCount;
+};
+
+// Decodes into q using the baselines in history.  false if the bytes are
+// malformed or the baseline is no longer there.
+bool snapshotDecode(const unsigned char* data, int length, const SnapshotHistory& history,
+                    PongSnapshot& q);
+
+// One match's snapshots for all its spectators.
+class SnapshotBroadcaster
+{
+public:
+   SnapshotBroadcaster();
+
+   void reset();
+
+   // Takes the state the match is in after a tick.
+   void push(const PongState& s);
+
+   // The current snapshot coded against ackTick, the newest snapshot the
+   // spectator has (0 for none).  Coded on the first request for each
+   // baseline after push(); the bytes stay valid until the next push().
+   const unsigned char* packet(unsigned int ackTick, int& length);
+
+   const PongSnapshot& current() const { return mCurrent; }
+
+   // Encodes done so far; fewer than packets when baselines are shared.
+   unsigned int encodes() const { return mEncodes; }
+   unsigned int packets() const { return mPackets; }
+
+private:
+   struct Coded
+   {
+      unsigned int  base;   // 0 for full
+      int           length;
+      unsigned char bytes[SNAPSHOT_MAX_BYTES];
+   };
+
+   PongSnapshot       mCurrent;
+   SnapshotHistory    mHistory;
+   std::vector<Coded> mCoded;   // this tick's, one per baseline asked for
+   unsigned int       mEncodes;
+   unsigned int       mPackets;
+};
+
+#endif // PONG_SNAPSHOT_H
@@ -0,0 +1,235 @@
+//=============================================================================
+// PongVecEnv.cpp
+//=============================================================================
+
+#include "PongVecEnv.h"
+#include "PongCollision.h"
+
+PongEnvConfig pongEnvDefaultConfig(void)
+{
+   PongEnvConfig c;
+   c.dt               = 1.0f / 120.0f;
+   c.frameSkip        = 4;
+   c.opponent         = PONG_OPPONENT_TRACKING;
+   c.opponentReaction = 0.15f;
+   c.opponentError    = 60.0f;
+   c.maxEpisodeTicks  = 120 * 30;
+   c.seed             = 1;
+   return c;
+}
+
+static const unsigned int ACTION_BUTTONS[3] = { 0, BTN_PAD1_UP, BTN_PAD1_DOWN };
+
+// Polls before a waiting thread sleeps: long enough to catch a learner
+// that steps again at once, short against a step of many environments.
+static const int VEC_ENV_SPINS = 4000;
+
+PongVecEnv::PongVecEnv(int numEnvs, const PongEnvConfig& config, int threads)
+: mConfig(config), mStates(numEnvs), mOpponents(numEnvs), mEpisodeTicks(numEnvs, 0),
+  mObservations(0), mRewards(0), mDones(0), mActions(0),
+  mGeneration(0), mFinished(0), mQuit(false), mSleepers(0), mStepWaiting(false)
+{
+   if (mConfig.frameSkip < 1)
+      mConfig.frameSkip = 1;
+   for (int i = 0; i < numEnvs; i++)
+      resetEnv(i, config.seed + (unsigned int)i);
+
+   // Worker w steps range w; the calling thread takes range 0.
+   if (threads > numEnvs)
+      threads = numEnvs;
+   for (int t = 1; t < threads; t++)
+      mThreads.push_back(std::thread(&PongVecEnv::workerMain, this, t));
+}
+
+PongVecEnv::~PongVecEnv()
+{
+   mQuit.store(true, std::memory_order_release);
+   mGeneration.fetch_add(1);
+   {
+      std::lock_guard<std::mutex> lock(mLock);
+   }
+   mWake.notify_all();
+   for (size_t i = 0; i < mThreads.size(); i++)
+      mThreads[i].join();
+}
+
+void PongVecEnv::setBuffers(float* observations, float* rewards, unsigned char* dones)
+{
+   mObservations = observations;
+   mRewards      = rewards;
+   mDones        = dones;
+}
+
+void PongVecEnv::resetEnv(int i, unsigned int seed)
+{
+   PongState& s = mStates[i];
+   pongInit(s, seed);
+   pongServe(s);  // not always the same opening angle
+   pongAIInit(mOpponents[i], mConfig.opponentReaction, mConfig.opponentError, seed * 2654435761u);
+   mEpisodeTicks[i] = 0;
+}
+
+void PongVecEnv::writeObservation(int i)
+{
+   const PongState& s = mStates[i];
+   SimVec2 dir = pongBallVelocity(s.ball);
+   float inv = s.ball.speed > 0.0f ? 1.0f / s.ball.speed : 0.0f;
+   float* o = mObservations + i * PONG_ENV_OBS_SIZE;
+   o[0] = s.ball.pos.x;
+   o[1] = s.ball.pos.y;
+   o[2] = dir.x * inv;
+   o[3] = dir.y * inv;
+   o[4] = s.pad1.pos.y;
+   o[5] = s.pad2.pos.y;
+}
+
+void PongVecEnv::reset(const unsigned char* mask)
+{
+   for (int i = 0; i < size(); i++)
+   {
+      if (mask && !mask[i])
+         continue;
+      // Continue from the environment's own RNG so resets stay repeatable.
+      resetEnv(i, simRandom(mStates[i].rngState));
+      writeObservation(i);
+      mRewards[i] = 0.0f;
+      mDones[i]   = 0;
+   }
+}
+
+void PongVecEnv::stepRange(int begin, int end)
+{
+   const float dt = mConfig.dt;
+   for (int i = begin; i < end; i++)
+   {
+      PongState& s = mStates[i];
+      unsigned int action = mActions[i] < 3 ? ACTION_BUTTONS[mActions[i]] : 0;
+      float reward = 0.0f;
+      bool  done   = false;
+
+      for (int k = 0; k < mConfig.frameSkip && !done; k++)
+      {
+         PongInput in;
+         if (mConfig.opponent == PONG_OPPONENT_PREDICTIVE)
+            in.buttons = pongAIInput(mOpponents[i], s, 2, dt);
+         else
+            in.buttons = pongTrackingInput(s, 300.0f, 90.0f).buttons & (BTN_PAD2_UP | BTN_PAD2_DOWN);
+         in.buttons |= action;
+
+         unsigned int events = pongStep(s, in, dt);
+         mEpisodeTicks[i]++;
+         if (events & EVT_GOAL_P1) { reward += 1.0f; done = true; }
+         if (events & EVT_GOAL_P2) { reward -= 1.0f; done = true; }
+         if (mConfig.maxEpisodeTicks && mEpisodeTicks[i] >= mConfig.maxEpisodeTicks)
+            done = true;
+      }
+
+      if (done)
+         resetEnv(i, simRandom(s.rngState));
+      writeObservation(i);
+      mRewards[i] = reward;
+      mDones[i]   = done ? 1 : 0;
+   }
+}
+
+void PongVecEnv::step(const unsigned char* actions)
+{
+   mActions = actions;
+   int workers = (int)mThreads.size() + 1;
+   if (workers == 1)
+   {
+      stepRange(0, size());
+      return;
+   }
+
+   // The generation moves before mSleepers is read and a sleeper counts
+   // itself before reading the generation, both sequentially consistent,
+   // so either the worker sees the new generation or it is notified.
+   // Taking the lock puts the notify after its wait has begun.
+   mFinished.store(0, std::memory_order_relaxed);
+   mGeneration.fetch_add(1);
+   if (mSleepers.load() > 0)
+   {
+      {
+         std::lock_guard<std::mutex> lock(mLock);
+      }
+      mWake.notify_all();
+   }
+   stepRange(0, size() / workers);
+
+   for (int spins = 0; spins < VEC_ENV_SPINS; spins++)
+   {
+      if (mFinished.load(std::memory_order_acquire) == workers - 1)
+         return;
+   }
+   std::unique_lock<std::mutex> lock(mLock);
+   mStepWaiting.store(true);
+   while (mFinished.load() < workers - 1)
+      mAllDone.wait(lock);
+   mStepWaiting.store(false);
+}
+
+void PongVecEnv::workerMain(int index)
+{
+   unsigned int seen = 0;
+   for (;;)
+   {
+      // Spin a little for back-to-back steps, then sleep.
+      unsigned int generation = seen;
+      for (int spins = 0; spins < VEC_ENV_SPINS && generation == seen; spins++)
+         generation = mGeneration.load(std::memory_order_acquire);
+      if (generation == seen)
+      {
+         std::unique_lock<std::mutex> lock(mLock);
+         mSleepers.fetch_add(1);
+         while ((generation = mGeneration.load()) == seen)
+            mWake.wait(lock);
+         mSleepers.fetch_sub(1);
+      }
+      seen = generation;
+      if (mQuit.load(std::memory_order_acquire))
+         return;
+
+      int workers = (int)mThreads.size() + 1;
+      int n = size();
+      stepRange((int)((long long)n * index / workers), (int)((long long)n * (index + 1) / workers));
+      if (mFinished.fetch_add(1) == workers - 2 && mStepWaiting.load())
+      {
+         {
+            std::lock_guard<std::mutex> lock(mLock);
+         }
+         mAllDone.notify_one();
+      }
+   }
+}
+
+//===============================================================
+// C interface
+
+PongVecEnvHandle* pongEnvCreate(int numEnvs, const PongEnvConfig* config, int threads)
+{
+   if (numEnvs < 1)
+      return 0;
+   PongEnvConfig c = config ? *config : pongEnvDefaultConfig();
+   return (PongVecEnvHandle*)new PongVecEnv(numEnvs, c, threads);
+}
+
+void pongEnvDestroy(PongVecEnvHandle* env)
+{
+   delete (PongVecEnv*)env;
+}
+
+void pongEnvSetBuffers(PongVecEnvHandle* env, float* observations, float* rewards, unsigned char* dones)
+{
+   ((PongVecEnv*)env)->setBuffers(observations, rewards, dones);
+}
+
+void pongEnvReset(PongVecEnvHandle* env, const unsigned char* mask)
+{
+   ((PongVecEnv*)env)->reset(mask);
+}
+
+void pongEnvStep(PongVecEnvHandle* env, const unsigned char* actions)
+{
+   ((PongVecEnv*)env)->step(actions);
+}
@@ -0,0 +1,147 @@
+//=============================================================================
+// PongVecEnv.h
+//
+// Many Pong environments stepped together, for training pad controllers.
+// The learner plays pad1; pad2 is the tracking bot or the predictive PongAI.
+// Each environment is a PongState advanced by pongStep(), so it plays
+// exactly like the game and the headless tools.
+//
+// The caller owns the output buffers and hands them over once; reset() and
+// step() write into them directly, environment i at
+//
+//    observations[i * PONG_ENV_OBS_SIZE]   ball x, ball y, ball direction
+//                                          x and y (the rotation as a unit
+//                                          vector), pad1 y, pad2 y; in
+//                                          field units
+//    rewards[i]                            +1 when pad1's side scored during
+//                                          the step, -1 when pad2's did
+//    dones[i]                              1 when the episode ended
+//
+// An episode is one point.  When a goal ends it (or it runs maxEpisodeTicks
+// without one, with reward 0), the environment is reset at once and the
+// observation written is the first of its next episode, as vectorized
+// environments usually do.  Environment i is seeded with seed + i and then
+// reseeds itself from its own serve RNG, so a run is repeatable whatever
+// the thread count.
+//
+// With threads > 1, step() splits the environments into equal ranges over
+// persistent worker threads.  Workers, and step() waiting for them, spin
+// briefly for back-to-back steps and then sleep on a condition variable, so
+// an idle environment costs no CPU.
+//
+// The C functions at the bottom wrap the class for ctypes and the like.
+//=============================================================================
+
+#ifndef PONG_VEC_ENV_H
+#define PONG_VEC_ENV_H
+
+#define PONG_ENV_OBS_SIZE 6
+
+// Actions: what pad1 does for the step.
+#define PONG_ACTION_STAY 0
+#define PONG_ACTION_UP   1
+#define PONG_ACTION_DOWN 2
+
+// Opponents for pad2.
+#define PONG_OPPONENT_TRACKING   0
+#define PONG_OPPONENT_PREDICTIVE 1
+
+typedef struct PongEnvConfig
+{
+   float        dt;              // seconds per tick
+   int          frameSkip;       // ticks per step, the action held for all of them
+   int          opponent;        // PONG_OPPONENT_*
+   float        opponentReaction;// PongAI reaction delay, seconds
+   float        opponentError;   // aim error, units
+   unsigned int maxEpisodeTicks; // 0 for no limit
+   unsigned int seed;
+} PongEnvConfig;
+
+#ifdef __cplusplus
+
+#include "PongSim.h"
+#include "PongAI.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class PongVecEnv
+{
+public:
+   PongVecEnv(int numEnvs, const PongEnvConfig& config, int threads = 1);
+   ~PongVecEnv();
+
+   int size() const { return (int)mStates.size(); }
+
+   // observations holds size() * PONG_ENV_OBS_SIZE floats, rewards size()
+   // floats and dones size() bytes.  Must be called before reset()/step().
+   void setBuffers(float* observations, float* rewards, unsigned char* dones);
+
+   // Starts a new episode in every environment whose mask byte is set, or
+   // in all of them if mask is 0, and writes their observations.
+   void reset(const unsigned char* mask);
+
+   // Advances every environment by one step with actions[i], a
+   // PONG_ACTION_* value, and writes observations, rewards and dones.
+   void step(const unsigned char* actions);
+
+   const PongState& state(int i) const { return mStates[i]; }
+
+private:
+   // Prevent copying
+   PongVecEnv(const PongVecEnv& rhs);
+   PongVecEnv& operator=(const PongVecEnv& rhs);
+
+   void resetEnv(int i, unsigned int seed);
+   void writeObservation(int i);
+   void stepRange(int begin, int end);
+   void workerMain(int index);
+
+   PongEnvConfig             mConfig;
+   std::vector<PongState>    mStates;
+   std::vector<PongAI>       mOpponents;
+   std::vector<unsigned int> mEpisodeTicks;
+
+   float*               mObservations;
+   float*               mRewards;
+   unsigned char*       mDones;
+   const unsigned char* mActions;
+
+   // Workers wait for mGeneration to move, step their range and count
+   // themselves into mFinished.  A side that has spun out counts itself
+   // into mSleepers or sets mStepWaiting before sleeping, and the other
+   // side notifies only when it sees that.
+   std::vector<std::thread> mThreads;
+   std::atomic<unsigned int> mGeneration;
+   std::atomic<int>          mFinished;
+   std::atomic<bool>         mQuit;
+   std::atomic<int>          mSleepers;
+   std::atomic<bool>         mStepWaiting;
+   std::mutex                mLock;
+   std::condition_variable   mWake;      // workers, for a new generation
+   std::condition_variable   mAllDone;   // step(), for the last worker
+};
+
+extern "C" {
+#endif
+
+// C interface.  Buffers are laid out as described above.
+typedef struct PongVecEnvHandle PongVecEnvHandle;
+
+// 120 Hz, frame skip 4, tracking opponent, 30 second episodes, seed 1.
+PongEnvConfig     pongEnvDefaultConfig(void);
+
+PongVecEnvHandle* pongEnvCreate(int numEnvs, const PongEnvConfig* config, int threads);
+void              pongEnvDestroy(PongVecEnvHandle* env);
+void              pongEnvSetBuffers(PongVecEnvHandle* env, float* observations, float* rewards,
+                                    unsigned char* dones);
+void              pongEnvReset(PongVecEnvHandle* env, const unsigned char* mask);
+void              pongEnvStep(PongVecEnvHandle* env, const unsigned char* actions);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PONG_VEC_ENV_H
@@ -17,34 +17,27 @@ PrintUtils::~PrintUtils()
 }
 
 
+// Starts the log writer, which opens the files once for the whole process.
 int PrintUtils::initPrintUtils()
 {
-   g_errorFile = ofstream ("error.txt", std::ios_base::app);
-   if (! g_errorFile.is_open ())
+   if (! asyncLogChannelOpen (LOG_CHANNEL_ERROR))
       return -1;
 
-   g_logFile = ofstream ("log.txt", std::ios_base::app);
-   if (! g_logFile.is_open ())
+   if (! asyncLogChannelOpen (LOG_CHANNEL_LOG))
       return -2;
 
-   g_outputFile = ofstream ("output.txt", std::ios_base::trunc);
-   if (! g_outputFile.is_open ())
+   if (! asyncLogChannelOpen (LOG_CHANNEL_OUTPUT))
       return -3;
 
    return 1;
 }
 
 
+// The files belong to the writer; this only makes sure everything queued
+// so far has reached them.
 int PrintUtils::closePrintUtils()
 {
-   if (g_errorFile.is_open ())
-      g_errorFile.close ();
-
-   if (g_logFile.is_open ())
-      g_logFile.close ();
-
-   if (g_outputFile.is_open ())
-      g_outputFile.close ();
+   asyncLogFlush ();
 
    return 1;
 }
@@ -52,66 +45,42 @@ int PrintUtils::closePrintUtils()
 
 void PrintUtils::printError (char* errorName)
 {
-	// print error to log.txt
-   //ofstream errorFile = ofstream ("error.txt", std::ios_base::app);
-	if (g_errorFile.is_open ())
-	{
-		g_errorFile << errorName << endl;
-	}
-	//errorFile.close ();
+   asyncLog (LOG_CHANNEL_ERROR, errorName);
 }
 
 
 void PrintUtils::printError (const char* errorName)
 {
-	// print error to log.txt
-	if (g_errorFile.is_open ())
-	{
-		g_errorFile << errorName << endl;
-	}
+   asyncLog (LOG_CHANNEL_ERROR, errorName);
 }
 
 
 void PrintUtils::printLog (char* logText)
 {
-	if (g_logFile.is_open ())
-	{
-		g_logFile << logText << endl;
-	}
-   else
-   {
-      ofstream logFile = ofstream ("log.txt", std::ios_base::app);
-      logFile << "warning: log file was not open." << endl;
-      logFile << logText << endl;
-      logFile.close ();
-   }
+   asyncLog (LOG_CHANNEL_LOG, logText);
 }
 
 
-// uses: printLog function.
+// One number per line, as one message.
 void PrintUtils::printNumbers (int numargs, ...) // long type only
 {
    va_list listPointer;
    va_start (listPointer, numargs);
 
-   long lng_1 = 0;
-
-   memset (buffer, ' ', _countof (buffer));
+   char buffer[LOG_LINE_MAX];
+   int  used = 0;
    buffer[0] = '\0';
-   memset (smallBuffer, ' ', _countof (smallBuffer));
-   smallBuffer[0] = '\0';
 
-   for (int i = 0; i < numargs; i++)
+   for (int i = 0; i < numargs && used < LOG_LINE_MAX - 1; i++)
    {
-      lng_1 = va_arg (listPointer, long);
-      _ltoa_s (lng_1, smallBuffer, _countof (smallBuffer), 10);
-      strcat_s (smallBuffer, _countof (smallBuffer), "\n");
-      strcat_s (buffer, _countof (buffer), smallBuffer);
-      memset (smallBuffer, ' ', _countof (smallBuffer));
-      smallBuffer[0] = '\0';
+      long lng_1 = va_arg (listPointer, long);
+      int n = _snprintf_s (buffer + used, LOG_LINE_MAX - used, _TRUNCATE, "%ld\n", lng_1);
+      if (n < 0)
+         break;
+      used += n;
    }
 
-   printOutput (buffer);
+   asyncLog (LOG_CHANNEL_OUTPUT, buffer);
 
    va_end (listPointer);
 }
@@ -119,38 +88,29 @@ void PrintUtils::printNumbers (int numargs, ...) // long type only
 
 void PrintUtils::printFloat(const float& number)
 {
-	if (g_outputFile.is_open ())
-	{
-		g_outputFile << number << endl;
-	}
-   else
-   {
-      ofstream outputFile = ofstream ("output.txt", std::ios_base::trunc);
-      outputFile << "warning: output file was not open." << endl;
-      outputFile << number << endl;
-      outputFile.close ();
-   }
+   asyncLogf (LOG_CHANNEL_OUTPUT, "%g", number);
 }
 
 
+// The first five numbers share a line; each one after that gets its own.
 void PrintUtils::printFloatArray(const float floatArray[], const int& length)
 {
-	if (g_outputFile.is_open())
-	{
-      for (int i = 0; i < length; i++)
+   char line[LOG_LINE_MAX];
+   int  used = 0;
+   line[0] = '\0';
+
+   for (int i = 0; i < length; i++)
+   {
+      if (i > 4)
       {
-         if (i > 4) g_outputFile << endl;
-		   g_outputFile << floatArray[i];
-         g_outputFile << " ";
+         asyncLog (LOG_CHANNEL_OUTPUT, line);
+         used = 0;
+         line[0] = '\0';
       }
-      g_outputFile << endl;
-	}
-   else
-   {
-      ofstream outputFile = ofstream ("output.txt", std::ios_base::trunc);
-      outputFile << "warning: output file was not open." << endl;
-      outputFile.close();
+      int n = _snprintf_s (line + used, LOG_LINE_MAX - used, _TRUNCATE, "%g ", floatArray[i]);
+      used = n < 0 ? LOG_LINE_MAX - 1 : used + n;
    }
+   asyncLog (LOG_CHANNEL_OUTPUT, line);
 }
 
 
@@ -180,17 +140,7 @@ int PrintUtils::printRect (RECT rect)
 
 int PrintUtils::printOutput (const string& output)
 {
-	if (g_outputFile.is_open ())
-	{
-		g_outputFile << output.c_str() << endl;
-	}
-   else
-   {
-      ofstream outputFile = ofstream ("output.txt", std::ios_base::trunc);
-      outputFile << "warning: output file was not open." << endl;
-      outputFile << output.c_str() << endl;
-      outputFile.close ();
-   }
+   asyncLog (LOG_CHANNEL_OUTPUT, output.c_str());
 
    return 1;
 }
@@ -198,54 +148,24 @@ int PrintUtils::printOutput (const string& output)
 
 int PrintUtils::printOutput (TCHAR output[])
 {
-   /*wostringstream wss;
-   wss << output << endl;
-   string str (wss.str().c_str());*/
-#ifdef UNICODE
-   wstring wstr_1(output);
-   string str_1(wstr_1.begin(), wstr_1.end());
-#else
-   string str_1(output);
-#endif
-
-	if (g_outputFile.is_open ())
-	{
-      g_outputFile << str_1 << endl;
-	}
-   else
-   {
-      ofstream outputFile = ofstream ("output.txt", std::ios_base::app);
-      outputFile << "function: PrintUtils::printOutput (TCHAR output[])" << endl;
-      outputFile << "warning: output file was not open." << endl;
-      outputFile << str_1 << endl;
-      outputFile.close ();
-   }
-
-   return 1;
+   return printOutput ((const TCHAR*) output);
 }
 
 
+// Narrowed a character at a time into a stack buffer rather than through
+// a temporary std::string.
 int PrintUtils::printOutput (const TCHAR output[])
 {
 #ifdef UNICODE
-   wstring wstr_1(output);
-   string str_1(wstr_1.begin(), wstr_1.end());
+   char narrow[LOG_LINE_MAX];
+   int i = 0;
+   for (; output[i] != 0 && i < LOG_LINE_MAX - 1; i++)
+      narrow[i] = (char) output[i];
+   narrow[i] = '\0';
+   asyncLog (LOG_CHANNEL_OUTPUT, narrow);
 #else
-   string str_1(output);
+   asyncLog (LOG_CHANNEL_OUTPUT, output);
 #endif
 
-	if (g_outputFile.is_open ())
-	{
-      g_outputFile << str_1 << endl;
-	}
-   else
-   {
-      ofstream outputFile = ofstream ("output.txt", std::ios_base::app);
-      outputFile << "function: PrintUtils::printOutput (const TCHAR output[])" << endl;
-      outputFile << "warning: output file was not open." << endl;
-      outputFile << str_1 << endl;
-      outputFile.close ();
-   }
-
    return 1;
-}
\ No newline at end of file
+}
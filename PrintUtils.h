@@ -11,6 +11,8 @@
 #include <stdio.h>   // va_arg
 #include <stdarg.h>  // va_arg
 
+#include "AsyncLog.h"
+
 using namespace std;
 
 
@@ -45,13 +47,9 @@ private:
    PrintUtils(const PrintUtils& printUtils);
    PrintUtils& operator=(const PrintUtils& printUtils);
 
+   // Output goes through AsyncLog: the calls below only queue their
+   // lines, and the files are written on its thread.
    int       g_flagOnce;    // checker
-   ofstream  g_errorFile;
-   ofstream  g_logFile;
-   ofstream  g_outputFile;
-
-   char buffer[256];        // general printing buffer   
-   char smallBuffer[20];
 };
 
 static PrintUtils ptt;
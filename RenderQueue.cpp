@@ -0,0 +1,132 @@
+//=============================================================================
+// RenderQueue.cpp
+//=============================================================================
+
+#include "RenderQueue.h"
+#include <string.h>
+
+RenderSortEntry* renderRadixSort(RenderSortEntry* entries, RenderSortEntry* scratch, int n)
+{
+   if (n < 2)
+      return entries;
+
+   RenderSortEntry* src = entries;
+   RenderSortEntry* dst = scratch;
+   for (int shift = 0; shift < 64; shift += 8)
+   {
+      int count[256];
+      memset(count, 0, sizeof(count));
+      for (int i = 0; i < n; i++)
+         count[(src[i].key >> shift) & 0xff]++;
+
+      // Every key has the same byte here: the pass would copy in order.
+      if (count[(src[0].key >> shift) & 0xff] == n)
+         continue;
+
+      int offset = 0;
+      for (int b = 0; b < 256; b++)
+      {
+         int c = count[b];
+         count[b] = offset;
+         offset += c;
+      }
+      for (int i = 0; i < n; i++)
+         dst[count[(src[i].key >> shift) & 0xff]++] = src[i];
+
+      RenderSortEntry* t = src;
+      src = dst;
+      dst = t;
+   }
+   return src;
+}
+
+RenderQueue::RenderQueue()
+{
+   memset(&mStats, 0, sizeof(mStats));
+}
+
+void RenderQueue::clear()
+{
+   mCommands.clear();
+}
+
+void RenderQueue::add(int layer, RenderBlend blend, int texture, const RenderCommand& c)
+{
+   mCommands.push_back(c);
+   mCommands.back().key = renderKey(layer, blend, texture, (unsigned int)mCommands.size() - 1);
+}
+
+void RenderQueue::submit(RenderBackend& backend)
+{
+   int n = (int)mCommands.size();
+   mEntries.resize(n);
+   mScratch.resize(n);
+   for (int i = 0; i < n; i++)
+   {
+      mEntries[i].key   = mCommands[i].key;
+      mEntries[i].index = (unsigned int)i;
+   }
+   const RenderSortEntry* sorted = n ? renderRadixSort(&mEntries[0], &mScratch[0], n) : 0;
+
+   RenderQueueStats& st = mStats;
+   memset(&st, 0, sizeof(st));
+   st.commands = n;
+
+   RenderBlend blend   = RENDER_BLEND_OPAQUE;
+   float       repeat  = 1.0f;
+   int         texture = -1;
+   bool        pending = false;
+   for (int i = 0; i < n; i++)
+   {
+      const RenderCommand& c = mCommands[sorted[i].index];
+      RenderBlend b = renderKeyBlend(c.key);
+      int         t = renderKeyTexture(c.key);
+
+      // One at a time: bind, set and later restore what differs from the
+      // default, draw, flush.
+      st.naiveStateChanges += 1 + (b != RENDER_BLEND_OPAQUE ? 2 : 0) + (c.texRepeat != 1.0f ? 2 : 0);
+      st.naiveBatches++;
+
+      if (b != blend || c.texRepeat != repeat)
+      {
+         if (pending)
+            backend.flush();
+         pending = false;
+         if (b != blend)
+         {
+            backend.setBlend(b);
+            blend = b;
+            st.stateChanges++;
+         }
+         if (c.texRepeat != repeat)
+         {
+            backend.setTexRepeat(c.texRepeat);
+            repeat = c.texRepeat;
+            st.stateChanges++;
+         }
+      }
+      if (t != texture || !pending)
+      {
+         // A texture switch ends the batch too, inside the backend.
+         st.stateChanges += t != texture;
+         st.batches++;
+         texture = t;
+      }
+      backend.draw(t, c);
+      pending = true;
+   }
+
+   if (pending)
+      backend.flush();
+   if (repeat != 1.0f)
+   {
+      backend.setTexRepeat(1.0f);
+      st.stateChanges++;
+   }
+   if (blend != RENDER_BLEND_OPAQUE)
+   {
+      backend.setBlend(RENDER_BLEND_OPAQUE);
+      st.stateChanges++;
+   }
+   mCommands.clear();
+}
@@ -0,0 +1,126 @@
+//=============================================================================
+// RenderQueue.h
+//
+// Draws are recorded as commands instead of being issued as they are made,
+// then sorted and submitted in one go.  Each command carries a 64-bit key:
+//
+//    63..56  layer     drawn in increasing order (background, sprites, ...)
+//    55..52  blend     RenderBlend
+//    51..32  texture   the backend's texture number
+//    31..0   sequence  order of recording, so equal keys keep their order
+//
+// so after the sort every run of commands with the same blend and texture
+// is adjacent, and the backend only changes state or flushes its batch
+// where the key actually changes.  Order only matters between layers; two
+// draws in one layer must not depend on which goes on top.
+//
+// The sort is an LSD radix sort on the keys, 8 bits a pass, skipping the
+// passes whose byte is the same in every key (usually most of them).
+//
+// submit() counts what it did against what the same draws cost issued
+// one at a time by helpers that set their own state, draw, flush and put
+// the state back (RenderQueueStats).
+//=============================================================================
+
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <vector>
+
+enum RenderLayer
+{
+   RENDER_LAYER_BACKGROUND,
+   RENDER_LAYER_SPRITES,
+   RENDER_LAYER_OVERLAY
+};
+
+enum RenderBlend
+{
+   RENDER_BLEND_OPAQUE,
+   RENDER_BLEND_ALPHA_TEST,     // cut-out edges
+   RENDER_BLEND_ALPHA,          // soft edges
+   RENDER_BLEND_ALPHA_TEST_ALPHA
+};
+
+struct RenderCommand
+{
+   unsigned long long key;
+   int   sprite;     // the backend's image within the texture
+   float x, y;       // where the sprite's centre goes
+   float rotation;   // radians about z
+   float scaleX;
+   float scaleY;
+   float texRepeat;  // texture coordinates scaled by this, 1 for none;
+                     // goes with the texture, so not in the key
+};
+
+inline unsigned long long renderKey(int layer, RenderBlend blend, int texture, unsigned int sequence)
+{
+   return (unsigned long long)(layer & 0xff) << 56 |
+          (unsigned long long)(blend & 0xf) << 52 |
+          (unsigned long long)(texture & 0xfffff) << 32 |
+          sequence;
+}
+
+inline int         renderKeyLayer(unsigned long long key)   { return (int)(key >> 56); }
+inline RenderBlend renderKeyBlend(unsigned long long key)   { return (RenderBlend)((key >> 52) & 0xf); }
+inline int         renderKeyTexture(unsigned long long key) { return (int)((key >> 32) & 0xfffff); }
+
+// What submit() drives.  Commands arrive sorted; state calls only come
+// between batches, after flush().
+class RenderBackend
+{
+public:
+   virtual ~RenderBackend() {}
+
+   virtual void setBlend(RenderBlend blend) = 0;
+   virtual void setTexRepeat(float repeat) = 0;
+   virtual void draw(int texture, const RenderCommand& c) = 0;
+   virtual void flush() = 0;
+};
+
+struct RenderQueueStats
+{
+   int commands;
+   int stateChanges;      // blend, texture repeat and texture switches made
+   int batches;           // runs of draws between state changes
+   int naiveStateChanges; // the same draws one at a time
+   int naiveBatches;
+};
+
+struct RenderSortEntry
+{
+   unsigned long long key;
+   unsigned int       index;
+};
+
+// Sorts n entries by key, stably; scratch holds n entries.  Returns the
+// array the result ended up in, entries or scratch.
+RenderSortEntry* renderRadixSort(RenderSortEntry* entries, RenderSortEntry* scratch, int n);
+
+class RenderQueue
+{
+public:
+   RenderQueue();
+
+   void clear();
+
+   void add(int layer, RenderBlend blend, int texture, const RenderCommand& c);
+
+   // Sorts, then issues every command.  The backend is expected in the
+   // opaque, unrepeated state and is left in it.
+   void submit(RenderBackend& backend);
+
+   int size() const { return (int)mCommands.size(); }
+
+   // From the last submit().
+   const RenderQueueStats& stats() const { return mStats; }
+
+private:
+   std::vector<RenderCommand>   mCommands;
+   std::vector<RenderSortEntry> mEntries;
+   std::vector<RenderSortEntry> mScratch;
+   RenderQueueStats             mStats;
+};
+
+#endif // RENDER_QUEUE_H
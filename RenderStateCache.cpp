@@ -0,0 +1,182 @@
+//=============================================================================
+// RenderStateCache.cpp
+//=============================================================================
+
+#include "RenderStateCache.h"
+#include <string.h>
+
+static const long RS_OK           = 0;           // S_OK
+static const long RS_INVALID_CALL = -2005530516; // D3DERR_INVALIDCALL
+
+int renderTransformSlot(unsigned int transform)
+{
+   if (transform == RS_TRANSFORM_VIEW)       return 0;
+   if (transform == RS_TRANSFORM_PROJECTION) return 1;
+   if (transform >= RS_TRANSFORM_TEXTURE0 && transform < RS_TRANSFORM_TEXTURE0 + 8)
+      return 2 + (int)(transform - RS_TRANSFORM_TEXTURE0);
+   if (transform == RS_TRANSFORM_WORLD)      return 10;
+   return -1;
+}
+
+RenderStateCache::RenderStateCache(RenderDevice& device)
+: mDevice(device)
+{
+   memset(mRender, 0, sizeof(mRender));
+   memset(mSampler, 0, sizeof(mSampler));
+   memset(mStage, 0, sizeof(mStage));
+   memset(mTransform, 0, sizeof(mTransform));
+   invalidate();
+   resetStats();
+}
+
+void RenderStateCache::invalidate()
+{
+   memset(mRenderKnown, 0, sizeof(mRenderKnown));
+   memset(mSamplerKnown, 0, sizeof(mSamplerKnown));
+   memset(mStageKnown, 0, sizeof(mStageKnown));
+   memset(mTransformKnown, 0, sizeof(mTransformKnown));
+}
+
+void RenderStateCache::resetStats()
+{
+   memset(&mStats, 0, sizeof(mStats));
+}
+
+// A value is only remembered once the device has taken it.
+
+long RenderStateCache::setRenderState(unsigned int state, unsigned int value)
+{
+   mStats.calls[RS_KIND_RENDER]++;
+   if (state >= (unsigned int)RS_MAX_RENDER_STATES)
+   {
+      mStats.forwarded[RS_KIND_RENDER]++;
+      return mDevice.setRenderState(state, value);
+   }
+   if (mRenderKnown[state] && mRender[state] == value)
+      return RS_OK;
+
+   mStats.forwarded[RS_KIND_RENDER]++;
+   long hr = mDevice.setRenderState(state, value);
+   mRenderKnown[state] = hr >= 0;
+   mRender[state]      = value;
+   return hr;
+}
+
+long RenderStateCache::setSamplerState(unsigned int sampler, unsigned int type, unsigned int value)
+{
+   mStats.calls[RS_KIND_SAMPLER]++;
+   if (sampler >= (unsigned int)RS_MAX_SAMPLERS || type >= (unsigned int)RS_MAX_SAMPLER_TYPES)
+   {
+      mStats.forwarded[RS_KIND_SAMPLER]++;
+      return mDevice.setSamplerState(sampler, type, value);
+   }
+   if (mSamplerKnown[sampler][type] && mSampler[sampler][type] == value)
+      return RS_OK;
+
+   mStats.forwarded[RS_KIND_SAMPLER]++;
+   long hr = mDevice.setSamplerState(sampler, type, value);
+   mSamplerKnown[sampler][type] = hr >= 0;
+   mSampler[sampler][type]      = value;
+   return hr;
+}
+
+long RenderStateCache::setTextureStageState(unsigned int stage, unsigned int type, unsigned int value)
+{
+   mStats.calls[RS_KIND_STAGE]++;
+   if (stage >= (unsigned int)RS_MAX_STAGES || type >= (unsigned int)RS_MAX_STAGE_TYPES)
+   {
+      mStats.forwarded[RS_KIND_STAGE]++;
+      return mDevice.setTextureStageState(stage, type, value);
+   }
+   if (mStageKnown[stage][type] && mStage[stage][type] == value)
+      return RS_OK;
+
+   mStats.forwarded[RS_KIND_STAGE]++;
+   long hr = mDevice.setTextureStageState(stage, type, value);
+   mStageKnown[stage][type] = hr >= 0;
+   mStage[stage][type]      = value;
+   return hr;
+}
+
+long RenderStateCache::setTransform(unsigned int transform, const float* matrix)
+{
+   mStats.calls[RS_KIND_TRANSFORM]++;
+   int slot = renderTransformSlot(transform);
+   // Bitwise, so -0 and 0 differ; that only ever forwards one call too many.
+   if (slot >= 0 && mTransformKnown[slot] && memcmp(mTransform[slot], matrix, sizeof(mTransform[slot])) == 0)
+      return RS_OK;
+
+   mStats.forwarded[RS_KIND_TRANSFORM]++;
+   long hr = mDevice.setTransform(transform, matrix);
+   if (slot >= 0)
+   {
+      mTransformKnown[slot] = hr >= 0;
+      memcpy(mTransform[slot], matrix, sizeof(mTransform[slot]));
+   }
+   return hr;
+}
+
+//===============================================================
+// MockRenderDevice
+
+MockRenderDevice::MockRenderDevice()
+{
+   memset(calls, 0, sizeof(calls));
+   reset();
+}
+
+void MockRenderDevice::reset()
+{
+   memset(mRender, 0, sizeof(mRender));
+   memset(mSampler, 0, sizeof(mSampler));
+   memset(mStage, 0, sizeof(mStage));
+   memset(mTransform, 0, sizeof(mTransform));
+   for (int t = 0; t < RS_TRANSFORM_SLOTS; t++)
+      for (int i = 0; i < 4; i++)
+         mTransform[t][i * 5] = 1.0f;
+}
+
+long MockRenderDevice::setRenderState(unsigned int state, unsigned int value)
+{
+   calls[RS_KIND_RENDER]++;
+   if (state >= (unsigned int)RS_MAX_RENDER_STATES)
+      return RS_INVALID_CALL;
+   mRender[state] = value;
+   return RS_OK;
+}
+
+long MockRenderDevice::setSamplerState(unsigned int sampler, unsigned int type, unsigned int value)
+{
+   calls[RS_KIND_SAMPLER]++;
+   if (sampler >= (unsigned int)RS_MAX_SAMPLERS || type >= (unsigned int)RS_MAX_SAMPLER_TYPES)
+      return RS_INVALID_CALL;
+   mSampler[sampler][type] = value;
+   return RS_OK;
+}
+
+long MockRenderDevice::setTextureStageState(unsigned int stage, unsigned int type, unsigned int value)
+{
+   calls[RS_KIND_STAGE]++;
+   if (stage >= (unsigned int)RS_MAX_STAGES || type >= (unsigned int)RS_MAX_STAGE_TYPES)
+      return RS_INVALID_CALL;
+   mStage[stage][type] = value;
+   return RS_OK;
+}
+
+long MockRenderDevice::setTransform(unsigned int transform, const float* matrix)
+{
+   calls[RS_KIND_TRANSFORM]++;
+   int slot = renderTransformSlot(transform);
+   if (slot < 0)
+      return RS_INVALID_CALL;
+   memcpy(mTransform[slot], matrix, sizeof(mTransform[slot]));
+   return RS_OK;
+}
+
+bool MockRenderDevice::sameState(const MockRenderDevice& other) const
+{
+   return memcmp(mRender, other.mRender, sizeof(mRender)) == 0 &&
+          memcmp(mSampler, other.mSampler, sizeof(mSampler)) == 0 &&
+          memcmp(mStage, other.mStage, sizeof(mStage)) == 0 &&
+          memcmp(mTransform, other.mTransform, sizeof(mTransform)) == 0;
+}
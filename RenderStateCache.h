@@ -0,0 +1,132 @@
+//=============================================================================
+// RenderStateCache.h
+//
+// A shadow copy of the device's fixed-function state.  Render states,
+// sampler states, texture stage states and transforms are set through the
+// cache, which forwards a call only when the value differs from the one it
+// last forwarded; setting what already holds costs a compare instead of a
+// driver call.  A state the cache has not seen since the last invalidate()
+// is always forwarded, so the cache never assumes a device default.
+//
+// Device Reset() puts every state back to its default, so onLostDevice()
+// invalidates the whole cache.  Anything that changes state behind the
+// cache's back and does not put it back (applying a state block, an
+// ID3DXSprite begun with D3DXSPRITE_DONOTSAVESTATE) must invalidate too.
+//
+// The cache talks to a RenderDevice, not to Direct3D: D3DRenderDevice
+// forwards to an IDirect3DDevice9, MockRenderDevice just records, so the
+// filtering can be checked without a device.  States and transforms are
+// the D3D9 enum values; transforms are 16 floats, row major like
+// D3DMATRIX.
+//=============================================================================
+
+#ifndef RENDER_STATE_CACHE_H
+#define RENDER_STATE_CACHE_H
+
+const int RS_MAX_RENDER_STATES = 256;  // D3DRS_* are below this
+const int RS_MAX_SAMPLERS      = 16;
+const int RS_MAX_SAMPLER_TYPES = 16;   // D3DSAMP_*
+const int RS_MAX_STAGES        = 8;
+const int RS_MAX_STAGE_TYPES   = 33;   // D3DTSS_*
+
+// Transforms with a slot in the cache; others are always forwarded.
+const unsigned int RS_TRANSFORM_VIEW       = 2;    // D3DTS_VIEW
+const unsigned int RS_TRANSFORM_PROJECTION = 3;    // D3DTS_PROJECTION
+const unsigned int RS_TRANSFORM_TEXTURE0   = 16;   // D3DTS_TEXTURE0..7
+const unsigned int RS_TRANSFORM_WORLD      = 256;  // D3DTS_WORLD
+const int          RS_TRANSFORM_SLOTS      = 11;
+
+// The slot a transform is cached in, or -1 for none.
+int renderTransformSlot(unsigned int transform);
+
+enum RenderStateKind
+{
+   RS_KIND_RENDER,
+   RS_KIND_SAMPLER,
+   RS_KIND_STAGE,
+   RS_KIND_TRANSFORM,
+   RS_KIND_COUNT
+};
+
+// What the cache forwards to.  Results are HRESULTs: negative is failure.
+class RenderDevice
+{
+public:
+   virtual ~RenderDevice() {}
+
+   virtual long setRenderState(unsigned int state, unsigned int value) = 0;
+   virtual long setSamplerState(unsigned int sampler, unsigned int type, unsigned int value) = 0;
+   virtual long setTextureStageState(unsigned int stage, unsigned int type, unsigned int value) = 0;
+   virtual long setTransform(unsigned int transform, const float* matrix) = 0;
+};
+
+struct RenderStateStats
+{
+   unsigned int calls[RS_KIND_COUNT];      // made to the cache
+   unsigned int forwarded[RS_KIND_COUNT];  // passed on to the device
+};
+
+class RenderStateCache
+{
+public:
+   explicit RenderStateCache(RenderDevice& device);
+
+   long setRenderState(unsigned int state, unsigned int value);
+   long setSamplerState(unsigned int sampler, unsigned int type, unsigned int value);
+   long setTextureStageState(unsigned int stage, unsigned int type, unsigned int value);
+   long setTransform(unsigned int transform, const float* matrix);
+
+   // Forgets every value, so each next set goes to the device.
+   void invalidate();
+   void onLostDevice() { invalidate(); }
+
+   const RenderStateStats& stats() const { return mStats; }
+   void resetStats();
+
+private:
+   // Prevent copying
+   RenderStateCache(const RenderStateCache& rhs);
+   RenderStateCache& operator=(const RenderStateCache& rhs);
+
+   RenderDevice&    mDevice;
+   RenderStateStats mStats;
+
+   unsigned int mRender[RS_MAX_RENDER_STATES];
+   unsigned int mSampler[RS_MAX_SAMPLERS][RS_MAX_SAMPLER_TYPES];
+   unsigned int mStage[RS_MAX_STAGES][RS_MAX_STAGE_TYPES];
+   float        mTransform[RS_TRANSFORM_SLOTS][16];
+
+   bool mRenderKnown[RS_MAX_RENDER_STATES];
+   bool mSamplerKnown[RS_MAX_SAMPLERS][RS_MAX_SAMPLER_TYPES];
+   bool mStageKnown[RS_MAX_STAGES][RS_MAX_STAGE_TYPES];
+   bool mTransformKnown[RS_TRANSFORM_SLOTS];
+};
+
+// A device that only remembers what it was told, for checking the cache
+// headlessly: the same calls made through a cache and straight to a
+// second MockRenderDevice must leave both in the same state.
+class MockRenderDevice : public RenderDevice
+{
+public:
+   MockRenderDevice();
+
+   long setRenderState(unsigned int state, unsigned int value);
+   long setSamplerState(unsigned int sampler, unsigned int type, unsigned int value);
+   long setTextureStageState(unsigned int stage, unsigned int type, unsigned int value);
+   long setTransform(unsigned int transform, const float* matrix);
+
+   // Back to the defaults (all zero, identity transforms), as Reset() does.
+   void reset();
+
+   bool sameState(const MockRenderDevice& other) const;
+
+   unsigned int calls[RS_KIND_COUNT];
+
+private:
+   unsigned int mRender[RS_MAX_RENDER_STATES];
+   unsigned int mSampler[RS_MAX_SAMPLERS][RS_MAX_SAMPLER_TYPES];
+   unsigned int mStage[RS_MAX_STAGES][RS_MAX_STAGE_TYPES];
+   float        mTransform[RS_TRANSFORM_SLOTS][16];
+};
+
+#endif // RENDER_STATE_CACHE_H
@@ -0,0 +1,414 @@
+//=============================================================================
+// Replay.cpp
+//=============================================================================
+
+#include "Replay.h"
+#include <string.h>
+
+static const char          REPLAY_MAGIC[4] = { 'P', 'R', 'P', 'L' };
+static const char          INDEX_MAGIC[4]  = { 'P', 'I', 'D', 'X' };
+static const unsigned int  REPLAY_VERSION  = 2;
+static const long          TICKS_OFFSET    = 24;  // of ReplayHeader::ticks in the file
+static const int           HEADER_BYTES    = 32;
+static const int           V1_HEADER_BYTES = 28;  // no keyframe interval
+static const int           STATE_WORDS     = sizeof(PongState) / 4;
+static const unsigned char REPEAT_INPUT    = 0xFF;
+static const unsigned char ESCAPED_INPUT   = 0xFE;  // buttons and mask bytes follow
+static const unsigned char PARTIAL_FOLLOWS = 0x80;
+
+static unsigned int floatBits(float f)
+{
+   unsigned int bits;
+   memcpy(&bits, &f, 4);
+   return bits;
+}
+
+static float bitsFloat(unsigned int bits)
+{
+   float f;
+   memcpy(&f, &bits, 4);
+   return f;
+}
+
+static void store32(unsigned char* p, unsigned int v)
+{
+   p[0] = (unsigned char)v;
+   p[1] = (unsigned char)(v >> 8);
+   p[2] = (unsigned char)(v >> 16);
+   p[3] = (unsigned char)(v >> 24);
+}
+
+static unsigned int load32(const unsigned char* p)
+{
+   return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+static_assert(sizeof(PongState) % 4 == 0, "keyframes store PongState as 32-bit words");
+
+static bool sameInput(const PongTimedInput& a, const PongTimedInput& b)
+{
+   if (a.input.buttons != b.input.buttons)
+      return false;
+   for (int i = 0; i < PONG_BUTTON_COUNT; i++)
+      if (floatBits(a.held[i]) != floatBits(b.held[i]))
+         return false;
+   return true;
+}
+
+//===============================================================
+// ReplayWriter
+
+ReplayWriter::ReplayWriter()
+: mFile(0), mUsed(0), mWritten(0), mTicks(0), mHavePrevious(false)
+{
+   memset(&mHeader, 0, sizeof(mHeader));
+}
+
+ReplayWriter::~ReplayWriter()
+{
+   close();
+}
+
+bool ReplayWriter::open(const char* path, unsigned int seed, float dt, float rallyTimeout,
+                        unsigned int checksumInterval, unsigned int keyframeInterval)
+{
+   close();
+   mFile = fopen(path, "wb");
+   if (!mFile)
+      return false;
+
+   mHeader.seed             = seed;
+   mHeader.dt               = dt;
+   mHeader.rallyTimeout     = rallyTimeout;
+   mHeader.checksumInterval = checksumInterval;
+   mHeader.ticks            = 0;
+   mHeader.keyframeInterval = keyframeInterval;
+   mTicks        = 0;
+   mHavePrevious = false;
+   mWritten      = 0;
+   mKeyframes.clear();
+
+   unsigned char h[HEADER_BYTES];
+   memcpy(h, REPLAY_MAGIC, 4);
+   store32(h + 4,  REPLAY_VERSION);
+   store32(h + 8,  seed);
+   store32(h + 12, floatBits(dt));
+   store32(h + 16, floatBits(rallyTimeout));
+   store32(h + 20, checksumInterval);
+   store32(h + 24, 0);
+   store32(h + 28, keyframeInterval);
+   memcpy(mBuffer, h, HEADER_BYTES);
+   mUsed = HEADER_BYTES;
+   return true;
+}
+
+void ReplayWriter::close()
+{
+   if (!mFile)
+      return;
+
+   writeOut();
+   for (size_t i = 0; i < mKeyframes.size(); i++)
+   {
+      unsigned long long offset = (unsigned long long)mKeyframes[i];
+      put32((unsigned int)offset);
+      put32((unsigned int)(offset >> 32));
+      if (mUsed + 8 > BUFFER_BYTES)
+         writeOut();
+   }
+   put32((unsigned int)mKeyframes.size());
+   memcpy(mBuffer + mUsed, INDEX_MAGIC, 4);
+   mUsed += 4;
+   writeOut();
+
+   unsigned char count[4];
+   store32(count, mTicks);
+   if (fseek(mFile, TICKS_OFFSET, SEEK_SET) == 0)
+      fwrite(count, 1, 4, mFile);
+   fclose(mFile);
+   mFile = 0;
+}
+
+void ReplayWriter::writeOut()
+{
+   fwrite(mBuffer, 1, mUsed, mFile);
+   mWritten += mUsed;
+   mUsed = 0;
+}
+
+void ReplayWriter::put32(unsigned int v)
+{
+   store32(mBuffer + mUsed, v);
+   mUsed += 4;
+}
+
+void ReplayWriter::tick(const PongTimedInput& in, const PongState& after)
+{
+   if (!mFile)
+      return;
+
+   // Worst case: escape, buttons, mask, every held time, a checksum and
+   // a keyframe.
+   if (mUsed + 3 + 4 * PONG_BUTTON_COUNT + 4 + (int)sizeof(PongState) > BUFFER_BYTES)
+      writeOut();
+
+   if (mHavePrevious && sameInput(in, mPrevious))
+      put(REPEAT_INPUT);
+   else
+   {
+      unsigned int buttons = in.input.buttons & 0x7f;
+      unsigned char partial = 0;
+      for (int i = 0; i < PONG_BUTTON_COUNT; i++)
+      {
+         float whole = (buttons & (1u << i)) ? mHeader.dt : 0.0f;
+         if (floatBits(in.held[i]) != floatBits(whole))
+            partial |= (unsigned char)(1u << i);
+      }
+
+      // The two codes that would read as markers are written escaped.
+      unsigned char code = (unsigned char)(buttons | (partial ? PARTIAL_FOLLOWS : 0));
+      if (code >= ESCAPED_INPUT)
+      {
+         put(ESCAPED_INPUT);
+         put((unsigned char)buttons);
+      }
+      else
+         put(code);
+      if (partial)
+      {
+         put(partial);
+         for (int i = 0; i < PONG_BUTTON_COUNT; i++)
+            if (partial & (1u << i))
+               put32(floatBits(in.held[i]));
+      }
+      mPrevious     = in;
+      mHavePrevious = true;
+   }
+
+   mTicks++;
+   if (mHeader.checksumInterval && mTicks % mHeader.checksumInterval == 0)
+      put32(pongChecksum(after));
+
+   if (mHeader.keyframeInterval && mTicks % mHeader.keyframeInterval == 0)
+   {
+      mKeyframes.push_back(mWritten + mUsed);
+      unsigned int words[STATE_WORDS];
+      memcpy(words, &after, sizeof(words));
+      for (int i = 0; i < STATE_WORDS; i++)
+         put32(words[i]);
+      // A reader that starts here has no previous input to repeat.
+      mHavePrevious = false;
+   }
+}
+
+//===============================================================
+// ReplayReader
+
+ReplayReader::ReplayReader()
+: mFile(0), mFirstTick(0), mTick(0), mError(false)
+{
+   memset(&mHeader, 0, sizeof(mHeader));
+   memset(&mPrevious, 0, sizeof(mPrevious));
+}
+
+ReplayReader::~ReplayReader()
+{
+   close();
+}
+
+bool ReplayReader::open(const char* path)
+{
+   close();
+   mFile = fopen(path, "rb");
+   if (!mFile)
+      return false;
+
+   unsigned char h[HEADER_BYTES];
+   unsigned int version = 0;
+   if (fread(h, 1, V1_HEADER_BYTES, mFile) == (size_t)V1_HEADER_BYTES &&
+       memcmp(h, REPLAY_MAGIC, 4) == 0)
+      version = load32(h + 4);
+   if (version == REPLAY_VERSION)
+   {
+      if (fread(h + V1_HEADER_BYTES, 1, 4, mFile) != 4)
+         version = 0;
+   }
+   else if (version != 1)
+      version = 0;
+   if (!version)
+   {
+      close();
+      return false;
+   }
+
+   mHeader.seed             = load32(h + 8);
+   mHeader.dt               = bitsFloat(load32(h + 12));
+   mHeader.rallyTimeout     = bitsFloat(load32(h + 16));
+   mHeader.checksumInterval = load32(h + 20);
+   mHeader.ticks            = load32(h + 24);
+   mHeader.keyframeInterval = version >= 2 ? load32(h + 28) : 0;
+   mFirstTick = ftell(mFile);
+   mTick  = 0;
+   mError = false;
+   memset(&mPrevious, 0, sizeof(mPrevious));
+
+   readIndex();
+   return true;
+}
+
+// The index is only there if the writer closed the file; without it,
+// seek() falls back to simulating from the start.
+void ReplayReader::readIndex()
+{
+   mKeyframes.clear();
+   if (!mHeader.keyframeInterval || !mHeader.ticks || fseek(mFile, -8, SEEK_END) != 0)
+   {
+      fseek(mFile, mFirstTick, SEEK_SET);
+      return;
+   }
+
+   unsigned char trailer[8];
+   unsigned int count = 0;
+   if (fread(trailer, 1, 8, mFile) == 8 && memcmp(trailer + 4, INDEX_MAGIC, 4) == 0)
+      count = load32(trailer);
+   if (count > 0 && count == mHeader.ticks / mHeader.keyframeInterval &&
+       fseek(mFile, -8 - 8 * (long)count, SEEK_END) == 0)
+   {
+      mKeyframes.resize(count);
+      for (unsigned int i = 0; i < count; i++)
+      {
+         unsigned int lo, hi;
+         if (!get32(lo) || !get32(hi))
+         {
+            mKeyframes.clear();
+            break;
+         }
+         mKeyframes[i] = (long long)(((unsigned long long)hi << 32) | lo);
+      }
+   }
+   fseek(mFile, mFirstTick, SEEK_SET);
+}
+
+bool ReplayReader::readKeyframe(PongState& s)
+{
+   unsigned int words[STATE_WORDS];
+   for (int i = 0; i < STATE_WORDS; i++)
+      if (!get32(words[i]))
+         return false;
+   memcpy(&s, words, sizeof(words));
+   return true;
+}
+
+bool ReplayReader::seek(unsigned int tick, PongState& s)
+{
+   if (!mFile || (mHeader.ticks && tick > mHeader.ticks))
+      return false;
+
+   size_t k = mHeader.keyframeInterval ? tick / mHeader.keyframeInterval : 0;
+   if (k > mKeyframes.size())
+      k = mKeyframes.size();
+   mError = false;
+   if (k > 0 && fseek(mFile, (long)mKeyframes[k - 1], SEEK_SET) == 0 && readKeyframe(s))
+      mTick = (unsigned int)k * mHeader.keyframeInterval;
+   else
+   {
+      fseek(mFile, mFirstTick, SEEK_SET);
+      initState(s);
+      mTick = 0;
+   }
+
+   PongTimedInput in;
+   bool hasChecksum;
+   unsigned int checksum;
+   while (mTick < tick)
+   {
+      if (!next(in, hasChecksum, checksum))
+         return false;
+      pongStepTimed(s, in, mHeader.dt);
+   }
+   return true;
+}
+
+void ReplayReader::close()
+{
+   if (mFile)
+      fclose(mFile);
+   mFile = 0;
+}
+
+void ReplayReader::initState(PongState& s) const
+{
+   pongInit(s, mHeader.seed);
+   s.rallyTimeout = mHeader.rallyTimeout;
+}
+
+bool ReplayReader::get32(unsigned int& v)
+{
+   unsigned char b[4];
+   if (fread(b, 1, 4, mFile) != 4)
+      return false;
+   v = load32(b);
+   return true;
+}
+
+bool ReplayReader::next(PongTimedInput& in, bool& hasChecksum, unsigned int& checksum)
+{
+   if (!mFile || mError || (mHeader.ticks && mTick >= mHeader.ticks))
+      return false;
+
+   int first = getc(mFile);
+   if (first == EOF)
+   {
+      // A cut-short recording ends between ticks; one closed with more
+      // ticks than this has lost its end.
+      if (mHeader.ticks && mTick < mHeader.ticks)
+         mError = true;
+      return false;
+   }
+
+   bool ok = true;
+   if (first == REPEAT_INPUT)
+   {
+      ok = mTick > 0;
+      in = mPrevious;
+   }
+   else
+   {
+      int code = first;
+      if (first == ESCAPED_INPUT)
+      {
+         int escaped = getc(mFile);
+         code = escaped == EOF ? EOF : escaped | PARTIAL_FOLLOWS;
+      }
+      unsigned int buttons = code & 0x7f;
+      int partial = code == EOF ? EOF : (code & PARTIAL_FOLLOWS) ? getc(mFile) : 0;
+      ok = partial != EOF;
+
+      in.input.buttons = buttons;
+      for (int i = 0; ok && i < PONG_BUTTON_COUNT; i++)
+      {
+         unsigned int bits;
+         if (partial & (1 << i))
+         {
+            ok = get32(bits);
+            in.held[i] = bitsFloat(bits);
+         }
+         else
+            in.held[i] = (buttons & (1u << i)) ? mHeader.dt : 0.0f;
+      }
+      mPrevious = in;
+   }
+
+   mTick++;
+   hasChecksum = mHeader.checksumInterval && mTick % mHeader.checksumInterval == 0;
+   if (ok && hasChecksum)
+      ok = get32(checksum);
+
+   // Sequential play recomputes the state; step over the keyframe.
+   if (ok && mHeader.keyframeInterval && mTick % mHeader.keyframeInterval == 0)
+      ok = fseek(mFile, (long)sizeof(PongState), SEEK_CUR) == 0;
+
+   if (!ok)
+      mError = true;
+   return ok;
+}
@@ -0,0 +1,150 @@
+//=============================================================================
+// Replay.h
+//
+// Records a match as what it takes to play it again: the serve seed, the
+// tick length and the input of every tick.  The simulation is deterministic
+// (see PongSim.h), so stepping a fresh pongInit() state through the same
+// inputs reproduces the match exactly, at whatever speed the CPU allows.
+//
+// After each tick's input the file also holds pongChecksum() of the state
+// the tick produced, every checksumInterval ticks (every tick by default),
+// so a player can name the exact tick a re-simulation first differs at.
+//
+// Every keyframeInterval ticks (ten seconds at 120 Hz by default) the whole
+// PongState follows as well, and a closed file ends with an index of where
+// each keyframe is.  seek() restores the keyframe at or before the wanted
+// tick and re-simulates only the rest, so a seek costs at most one
+// interval of simulation however long the match is.
+//
+// Layout, little endian:
+//
+//    header    "PRPL", version, seed, dt and rallyTimeout (raw floats),
+//              checksum interval, tick count (0 if never closed),
+//              keyframe interval (0 for none)
+//    ticks     0xFF when the input is the previous tick's; otherwise the
+//              button mask, with bit 7 set if a mask of buttons held for
+//              part of the tick follows, then their held seconds as raw
+//              floats (0xFE escapes the two masks that would collide with
+//              the markers).  Buttons not in that mask were held for all
+//              of dt.  Then the 32-bit checksum on checksum ticks, and the
+//              PongState as 32-bit words on keyframe ticks.  The tick
+//              after a keyframe never repeats the previous input, so
+//              reading can start there.
+//    index     the file offset of each keyframe (64-bit), their count and
+//              "PIDX"; only in files that were closed
+//
+// Steady input costs one byte a tick plus the checksums; a keyframe is
+// sizeof(PongState), 108 bytes.  Version 1 files, without keyframes, still
+// play.
+//=============================================================================
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include "PongSim.h"
+#include <stdio.h>
+#include <vector>
+
+const unsigned int REPLAY_KEYFRAME_INTERVAL = 1200;
+
+struct ReplayHeader
+{
+   unsigned int seed;
+   float        dt;
+   float        rallyTimeout;
+   unsigned int checksumInterval;
+   unsigned int ticks;          // 0 when the recording was cut short
+   unsigned int keyframeInterval;
+};
+
+class ReplayWriter
+{
+public:
+   ReplayWriter();
+   ~ReplayWriter();
+
+   // The match must start from pongInit(seed) with s.rallyTimeout set to
+   // rallyTimeout.
+   bool open(const char* path, unsigned int seed, float dt, float rallyTimeout,
+             unsigned int checksumInterval = 1,
+             unsigned int keyframeInterval = REPLAY_KEYFRAME_INTERVAL);
+   // Writes the index and the tick count, which marks the replay complete.
+   void close();
+   bool isOpen() const { return mFile != 0; }
+
+   // One tick: the input pongStepTimed() was given and the state it left.
+   void tick(const PongTimedInput& in, const PongState& after);
+
+   unsigned int ticks() const { return mTicks; }
+
+private:
+   // Prevent copying
+   ReplayWriter(const ReplayWriter& rhs);
+   ReplayWriter& operator=(const ReplayWriter& rhs);
+
+   static const int BUFFER_BYTES = 64 * 1024;
+
+   void put(unsigned char b) { mBuffer[mUsed++] = b; }
+   void put32(unsigned int v);
+   void writeOut();
+
+   FILE*          mFile;
+   unsigned char  mBuffer[BUFFER_BYTES];
+   int            mUsed;
+   long long      mWritten;    // bytes before mBuffer
+   std::vector<long long> mKeyframes;  // file offsets
+   ReplayHeader   mHeader;
+   unsigned int   mTicks;
+   bool           mHavePrevious;
+   PongTimedInput mPrevious;
+};
+
+class ReplayReader
+{
+public:
+   ReplayReader();
+   ~ReplayReader();
+
+   bool open(const char* path);
+   void close();
+
+   const ReplayHeader& header() const { return mHeader; }
+
+   // The next tick's input, and whether a checksum came with it.  false at
+   // the end of the file or at a malformed tick; error() tells them apart.
+   bool next(PongTimedInput& in, bool& hasChecksum, unsigned int& checksum);
+   bool error() const { return mError; }
+
+   // A fresh state to play the replay from.
+   void initState(PongState& s) const;
+
+   // Puts s in the state after the first tick ticks and the reader before
+   // the tick after it, from the nearest keyframe.  Without an index (a
+   // cut-short or version 1 file) it re-simulates from the start.  false
+   // if the replay is shorter or breaks off before then.
+   bool seek(unsigned int tick, PongState& s);
+
+   // Ticks read so far, or the tick seek() went to.
+   unsigned int tick() const { return mTick; }
+
+   int keyframeCount() const { return (int)mKeyframes.size(); }
+
+private:
+   // Prevent copying
+   ReplayReader(const ReplayReader& rhs);
+   ReplayReader& operator=(const ReplayReader& rhs);
+
+   bool get32(unsigned int& v);
+   bool readKeyframe(PongState& s);
+   void readIndex();
+
+   FILE*          mFile;
+   ReplayHeader   mHeader;
+   long           mFirstTick;  // file offset of tick 1
+   unsigned int   mTick;
+   bool           mError;
+   PongTimedInput mPrevious;
+   std::vector<long long> mKeyframes;
+};
+
+#endif // REPLAY_H
@@ -0,0 +1,146 @@
+//=============================================================================
+// ReplayPlayer.cpp
+//
+// Re-simulates a replay (see Replay.h) headlessly, as fast as the CPU
+// allows, and checks every recorded checksum against the state it gets.
+// The first mismatch is reported with its tick, and the player stops
+// there: everything after it would differ too.  Builds on any platform:
+//
+//    g++ -O2 -std=c++11 ReplayPlayer.cpp Replay.cpp PongSim.cpp PongCollision.cpp -o ReplayPlayer
+//
+// usage: ReplayPlayer [-repeat n] [-seek tick] file.replay
+//
+// -repeat plays the replay n times over, for a steadier speed figure.
+// -seek starts at a tick instead, from the nearest keyframe, and shows the
+// state there and how long getting there took.
+// Exit status: 0 if the replay matched, 1 if it could not be read, 2 if
+// it diverged.
+//=============================================================================
+
+#include "Replay.h"
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Plays the replay once, from seekTick on.  Returns the tick it diverged
+// at, 0 if it did not.
+static unsigned int play(const char* path, unsigned int seekTick, PongState& s,
+                         unsigned int& ticks, unsigned int& checked, bool& readError)
+{
+   ReplayReader reader;
+   readError = !reader.open(path);
+   if (readError)
+      return 0;
+
+   float dt = reader.header().dt;
+   ticks = checked = 0;
+   if (seekTick > 0)
+   {
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      readError = !reader.seek(seekTick, s);
+      double us = std::chrono::duration<double, std::micro>(
+         std::chrono::steady_clock::now() - start).count();
+      if (readError)
+      {
+         printf("the replay ends before tick %u\n", seekTick);
+         return 0;
+      }
+      printf("seek:           tick %u in %.1f us (%d keyframes)\n", seekTick, us, reader.keyframeCount());
+      printf("                ball %.3f %.3f, pads %.3f %.3f, score %d - %d\n",
+             s.ball.pos.x, s.ball.pos.y, s.pad1.pos.y, s.pad2.pos.y, s.player1Score, s.player2Score);
+   }
+   else
+      reader.initState(s);
+
+   PongTimedInput in;
+   bool hasChecksum;
+   unsigned int expected = 0;
+   while (reader.next(in, hasChecksum, expected))
+   {
+      pongStepTimed(s, in, dt);
+      ticks++;
+      if (hasChecksum)
+      {
+         unsigned int actual = pongChecksum(s);
+         if (actual != expected)
+         {
+            printf("diverged at tick %u: checksum %08x, recorded %08x\n", reader.tick(), actual, expected);
+            return reader.tick();
+         }
+         checked++;
+      }
+   }
+   readError = reader.error();
+   if (readError && reader.header().ticks && reader.tick() < reader.header().ticks)
+      printf("file ends after tick %u of the %u recorded\n", reader.tick(), reader.header().ticks);
+   else if (readError)
+      printf("malformed tick after tick %u\n", reader.tick());
+   else if (reader.header().ticks == 0)
+      printf("recording was cut short; played the %u ticks it has\n", ticks);
+   return 0;
+}
+
+int main(int argc, char* argv[])
+{
+   const char*  path     = 0;
+   int          repeat   = 1;
+   unsigned int seekTick = 0;
+
+   for (int i = 1; i < argc; i++)
+   {
+      if (strcmp(argv[i], "-repeat") == 0 && i + 1 < argc)
+         repeat = atoi(argv[++i]);
+      else if (strcmp(argv[i], "-seek") == 0 && i + 1 < argc)
+         seekTick = (unsigned int)strtoul(argv[++i], 0, 10);
+      else if (argv[i][0] == '-' || path)
+      {
+         fprintf(stderr, "unexpected argument %s\n", argv[i]);
+         return 1;
+      }
+      else
+         path = argv[i];
+   }
+   if (!path || repeat < 1)
+   {
+      fprintf(stderr, "usage: ReplayPlayer [-repeat n] [-seek tick] file.replay\n");
+      return 1;
+   }
+
+   ReplayReader reader;
+   if (!reader.open(path))
+   {
+      fprintf(stderr, "%s is not a replay\n", path);
+      return 1;
+   }
+   ReplayHeader h = reader.header();
+   reader.close();
+
+   PongState s;
+   unsigned int ticks = 0, checked = 0, diverged = 0;
+   bool readError = false;
+   std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+   for (int r = 0; r < repeat && !diverged && !readError; r++)
+      diverged = play(path, seekTick, s, ticks, checked, readError);
+   double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+   if (diverged)
+   {
+      printf("state:          ball %.3f %.3f, pads %.3f %.3f, score %d - %d\n",
+             s.ball.pos.x, s.ball.pos.y, s.pad1.pos.y, s.pad2.pos.y, s.player1Score, s.player2Score);
+      return 2;
+   }
+   if (readError)
+      return 1;
+
+   double played = (double)ticks * repeat;
+   double simSeconds = played * h.dt;
+   printf("seed:           %u\n", h.seed);
+   printf("ticks:          %u played (%.1f Hz, %.1f s), %u checksums matched\n",
+          ticks, 1.0 / h.dt, ticks * h.dt, checked);
+   printf("score:          %d - %d\n", s.player1Score, s.player2Score);
+   printf("wall time:      %.3f s for %d play%s\n", seconds, repeat, repeat == 1 ? "" : "s");
+   printf("speed:          %.0f ticks/sec, %.0fx real time\n",
+          seconds > 0.0 ? played / seconds : 0.0, seconds > 0.0 ? simSeconds / seconds : 0.0);
+   return 0;
+}
@@ -0,0 +1,167 @@
+//=============================================================================
+// SimThread.cpp
+//=============================================================================
+
+#include "SimThread.h"
+#include "FrameProfiler.h"
+
+// Sleeping is only trusted to within this much; the rest is yielded away.
+static const long long SIM_SPIN_US = 2000;
+
+SimThread::SimThread(SimThreadClient& client, InputSource* source, float tickRate, int maxTicksBehind)
+: mClient(client), mSource(source), mTickDt(1.0f / tickRate), mPeriodUs(1e6 / tickRate),
+  mMaxTicksBehind(maxTicksBehind), mEpoch(std::chrono::steady_clock::now()),
+  mQuit(false), mPaused(false), mTicks(0), mLastStart(-1),
+  mIntervals(1.5f * 1000.0f / tickRate), mLatency(1000.0f / tickRate)
+{
+   mTiming.tickIntervals = mIntervals.window(10);
+   mTiming.inputLatency  = mLatency.window(10);
+   mTiming.droppedTicks  = 0;
+}
+
+SimThread::~SimThread()
+{
+   stop();
+}
+
+void SimThread::start()
+{
+   if (running())
+      return;
+
+   // Something to draw before the first tick.
+   SimSnapshot& s = mSnapshots.back();
+   mClient.simSnapshot(s);
+   s.ticks     = mTicks;
+   s.tickEndUs = nowUs();
+   s.timing    = mTiming;
+   mSnapshots.publish();
+
+   mQuit.store(false, std::memory_order_release);
+   mThread = std::thread(&SimThread::run, this);
+}
+
+void SimThread::stop()
+{
+   if (!running())
+      return;
+   mQuit.store(true, std::memory_order_release);
+   mThread.join();
+}
+
+const SimSnapshot& SimThread::latest()
+{
+   mSnapshots.update();
+   return mSnapshots.front();
+}
+
+float SimThread::alpha(const SimSnapshot& s) const
+{
+   float a = (float)((nowUs() - s.tickEndUs) / mPeriodUs);
+   return a < 0.0f ? 0.0f : a > 1.0f ? 1.0f : a;
+}
+
+long long SimThread::nowUs() const
+{
+   return std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - mEpoch).count();
+}
+
+long long SimThread::tickEndUs(long long tick) const
+{
+   // From the tick number rather than summed, so 8333.3 us periods
+   // do not drift.
+   return (long long)((tick + 1) * mPeriodUs);
+}
+
+void SimThread::waitUntil(long long us)
+{
+   for (;;)
+   {
+      long long left = us - nowUs();
+      if (left <= 0)
+         return;
+      if (left > SIM_SPIN_US)
+         std::this_thread::sleep_for(std::chrono::microseconds(left - SIM_SPIN_US));
+      else
+         std::this_thread::yield();
+   }
+}
+
+void SimThread::run()
+{
+   profileSetThreadName("simulation");
+
+   long long base   = 0;  // when tick 0 started
+   long long next   = 0;  // tick number since base
+   bool      resync = true;
+   while (!mQuit.load(std::memory_order_acquire))
+   {
+      if (mPaused.load(std::memory_order_acquire))
+      {
+         std::this_thread::sleep_for(std::chrono::milliseconds(10));
+         resync = true;
+         continue;
+      }
+      if (resync)
+      {
+         base       = nowUs();
+         next       = 0;
+         mLastStart = -1;
+         resync     = false;
+      }
+
+      waitUntil(base + tickEndUs(next));
+      long long started = nowUs();
+
+      long long behind = (long long)((started - base - tickEndUs(next)) / mPeriodUs);
+      if (behind > mMaxTicksBehind)
+      {
+         next += behind - mMaxTicksBehind;
+         mTiming.droppedTicks += (unsigned int)(behind - mMaxTicksBehind);
+      }
+
+      tick(base + tickEndUs(next - 1), base + tickEndUs(next), started);
+      next++;
+   }
+}
+
+void SimThread::tick(long long tickStart, long long tickEnd, long long started)
+{
+   PROFILE_SCOPE("simTick");
+   if (mLastStart >= 0)
+      mIntervals.record((float)(started - mLastStart) * 1e-6f);
+   mLastStart = started;
+
+   if (mSource)
+      mSource->pump(mQueue, started);
+
+   // When each event this tick takes happened.
+   long long eventTimes[INPUT_QUEUE_SIZE];
+   int events = 0;
+   while (events < mQueue.size() && mQueue.event(events).time < tickEnd)
+   {
+      eventTimes[events] = mQueue.event(events).time;
+      events++;
+   }
+
+   PongTimedInput in = mQueue.consume(tickStart, tickEnd, mTickDt);
+   mClient.simTick(in, mTickDt);
+   mTicks++;
+
+   SimSnapshot& s = mSnapshots.back();
+   mClient.simSnapshot(s);
+   s.ticks     = mTicks;
+   s.tickEndUs = tickEnd;
+   if (mTicks % (unsigned int)(1e6 / mPeriodUs + 0.5) == 0)
+   {
+      mTiming.tickIntervals = mIntervals.window(10);
+      mTiming.inputLatency  = mLatency.window(10);
+   }
+   s.timing = mTiming;
+   mSnapshots.publish();
+
+   long long published = nowUs();
+   for (int i = 0; i < events; i++)
+      mLatency.record((float)(published - eventTimes[i]) * 1e-6f);
+}
@@ -0,0 +1,126 @@
+//=============================================================================
+// SimThread.h
+//
+// Runs the simulation on its own thread at a fixed tick rate, so a frame
+// blocked in Present() no longer holds up ticks or input.  Tick k covers
+// [k, k + 1) periods of the thread's clock and runs as soon as that
+// interval has passed: the thread sleeps until just before, then yields
+// until it is due.  If the thread falls more than maxTicksBehind ticks
+// behind, the excess ticks are dropped rather than caught up.
+//
+// Each tick pumps the InputSource, consumes the input for the tick from
+// the thread's InputQueue, has the client step, then publishes a
+// SimSnapshot through a TripleBuffer.  The render thread draws whatever
+// latest() returns; it never waits for the simulation, nor it for it.
+//
+// The thread measures itself: the interval between tick starts (ideally
+// the period exactly) and, for every input event, the time from when it
+// happened to when the tick that consumed it was published.  Percentiles
+// of both go out with the snapshots, refreshed once a second.
+//
+// Times are microseconds on the thread's clock, which starts at zero when
+// the SimThread is made.  Input sources are pumped on it too.
+//=============================================================================
+
+#ifndef SIM_THREAD_H
+#define SIM_THREAD_H
+
+#include "PongSim.h"
+#include "InputQueue.h"
+#include "FrameTimeHistogram.h"
+#include "TripleBuffer.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+struct SimTiming
+{
+   FrameTimeStats tickIntervals;  // ms between tick starts, last 10 s
+   FrameTimeStats inputLatency;   // ms from an event to its tick's publish,
+                                  // over the last 10 s of summed latency
+   unsigned int   droppedTicks;   // ever, for falling behind
+};
+
+// What the simulation shows the render thread after a tick.
+struct SimSnapshot
+{
+   PongState    prev;       // before the last tick, for interpolation
+   PongState    state;
+   unsigned int ticks;      // run so far
+   long long    tickEndUs;  // the time state is at
+   SimTiming    timing;
+};
+
+// The game side of the thread.  Both calls are made on the simulation
+// thread, except for one simSnapshot() from start().
+class SimThreadClient
+{
+public:
+   virtual ~SimThreadClient() {}
+
+   // Steps one tick of dt seconds.
+   virtual void simTick(const PongTimedInput& in, float dt) = 0;
+
+   // Fills in prev and state; SimThread fills in the rest.
+   virtual void simSnapshot(SimSnapshot& out) = 0;
+};
+
+class SimThread
+{
+public:
+   // source may be 0 for none; neither is owned.
+   SimThread(SimThreadClient& client, InputSource* source, float tickRate, int maxTicksBehind);
+   ~SimThread();
+
+   void start();
+   void stop();
+
+   // Any thread.  A paused thread runs no ticks and, when resumed, starts
+   // again from the current time instead of catching up.
+   void setPaused(bool paused) { mPaused.store(paused, std::memory_order_release); }
+
+   // Render thread only.  The newest snapshot, valid until the next call.
+   const SimSnapshot& latest();
+
+   // How far (0..1) the clock is past s.tickEndUs, in ticks; blend s.prev
+   // and s.state by this, as with FixedTimestep::alpha().
+   float alpha(const SimSnapshot& s) const;
+
+   long long nowUs() const;
+   float     tickDt() const { return mTickDt; }
+   bool      running() const { return mThread.joinable(); }
+
+private:
+   // Prevent copying
+   SimThread(const SimThread& rhs);
+   SimThread& operator=(const SimThread& rhs);
+
+   void run();
+   void waitUntil(long long us);
+   void tick(long long tickStart, long long tickEnd, long long started);
+   long long tickEndUs(long long tick) const;
+
+   SimThreadClient& mClient;
+   InputSource*     mSource;
+   float            mTickDt;
+   double           mPeriodUs;
+   int              mMaxTicksBehind;
+
+   std::chrono::steady_clock::time_point mEpoch;
+
+   std::thread       mThread;
+   std::atomic<bool> mQuit;
+   std::atomic<bool> mPaused;
+
+   // Simulation thread only.
+   InputQueue         mQueue;
+   unsigned int       mTicks;
+   long long          mLastStart;   // -1 after start or a pause
+   FrameTimeHistogram mIntervals;
+   FrameTimeHistogram mLatency;
+   SimTiming          mTiming;
+
+   TripleBuffer<SimSnapshot> mSnapshots;
+};
+
+#endif // SIM_THREAD_H
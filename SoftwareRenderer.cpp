@@ -0,0 +1,396 @@
+//=============================================================================
+// SoftwareRenderer.cpp
+//=============================================================================
+
+#include "SoftwareRenderer.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define SOFTWARE_RENDERER_X86
+#include <emmintrin.h>
+#endif
+
+static const int          PIXEL_ALIGN    = 16;  // bytes, one SSE2 register
+static const unsigned int CLEAR_COLOR    = 0xffffffff;
+static const unsigned int TEXT_COLOR     = 0xff000000;
+static const int          ALPHA_REF      = 10;
+static const float        NEAR_PLANE     = 1.0f;
+static const float        FAR_PLANE      = 5000.0f;
+
+static unsigned int* allocPixels(int n)
+{
+#if defined(_MSC_VER)
+   return (unsigned int*)_aligned_malloc(n * sizeof(unsigned int), PIXEL_ALIGN);
+#else
+   void* p = 0;
+   if (posix_memalign(&p, PIXEL_ALIGN, n * sizeof(unsigned int)) != 0)
+      return 0;
+   return (unsigned int*)p;
+#endif
+}
+
+static void freePixels(unsigned int* p)
+{
+#if defined(_MSC_VER)
+   _aligned_free(p);
+#else
+   free(p);
+#endif
+}
+
+//===============================================================
+// BMP files
+
+bool SoftwareRenderer::saveBmp(const char* path) const
+{
+   return writeBmp(path, mPixels, mWidth, mHeight, mPitch);
+}
+
+//===============================================================
+// Span kernels
+
+static void blendScalar(unsigned int* dst, const unsigned int* src, int n)
+{
+   for (int i = 0; i < n; i++)
+   {
+      unsigned int s = src[i], d = dst[i];
+      unsigned int a = s >> 24, out = 0;
+      for (int shift = 0; shift < 32; shift += 8)
+      {
+         unsigned int c = ((s >> shift) & 255) * a + ((d >> shift) & 255) * (255 - a) + 128;
+         out |= ((c + (c >> 8)) >> 8) << shift;
+      }
+      dst[i] = out;
+   }
+}
+
+static void alphaTestScalar(unsigned int* dst, const unsigned int* src, int n, int ref)
+{
+   for (int i = 0; i < n; i++)
+      if ((int)(src[i] >> 24) > ref)
+         dst[i] = src[i];
+}
+
+#if defined(SOFTWARE_RENDERER_X86)
+
+// Blends two pixels held as 16-bit channels: (s*a + d*(255-a)) / 255,
+// rounded, with the divide done as (x + 128 + ((x + 128) >> 8)) >> 8.
+static inline __m128i blend2(__m128i s, __m128i d, __m128i c255, __m128i c128)
+{
+   __m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+   __m128i x = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(s, a),
+                                           _mm_mullo_epi16(d, _mm_sub_epi16(c255, a))), c128);
+   return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+static void blendSSE2(unsigned int* dst, const unsigned int* src, int n)
+{
+   const __m128i zero = _mm_setzero_si128();
+   const __m128i c255 = _mm_set1_epi16(255);
+   const __m128i c128 = _mm_set1_epi16(128);
+   int i = 0;
+   for (; i + 4 <= n; i += 4)
+   {
+      __m128i s = _mm_loadu_si128((const __m128i*)(src + i));
+      __m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+      __m128i lo = blend2(_mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(d, zero), c255, c128);
+      __m128i hi = blend2(_mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(d, zero), c255, c128);
+      _mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(lo, hi));
+   }
+   blendScalar(dst + i, src + i, n - i);
+}
+
+static void alphaTestSSE2(unsigned int* dst, const unsigned int* src, int n, int ref)
+{
+   const __m128i vref = _mm_set1_epi32(ref);
+   int i = 0;
+   for (; i + 4 <= n; i += 4)
+   {
+      __m128i s    = _mm_loadu_si128((const __m128i*)(src + i));
+      __m128i d    = _mm_loadu_si128((const __m128i*)(dst + i));
+      __m128i pass = _mm_cmpgt_epi32(_mm_srli_epi32(s, 24), vref);
+      _mm_storeu_si128((__m128i*)(dst + i), _mm_or_si128(_mm_and_si128(pass, s), _mm_andnot_si128(pass, d)));
+   }
+   alphaTestScalar(dst + i, src + i, n - i, ref);
+}
+
+#endif // SOFTWARE_RENDERER_X86
+
+void SoftwareRenderer::blendSpan(RasterKernel kernel, unsigned int* dst, const unsigned int* src, int n)
+{
+#if defined(SOFTWARE_RENDERER_X86)
+   if (kernel == RASTER_KERNEL_SSE2)
+   {
+      blendSSE2(dst, src, n);
+      return;
+   }
+#endif
+   blendScalar(dst, src, n);
+}
+
+void SoftwareRenderer::alphaTestSpan(RasterKernel kernel, unsigned int* dst, const unsigned int* src, int n, int ref)
+{
+#if defined(SOFTWARE_RENDERER_X86)
+   if (kernel == RASTER_KERNEL_SSE2)
+   {
+      alphaTestSSE2(dst, src, n, ref);
+      return;
+   }
+#endif
+   alphaTestScalar(dst, src, n, ref);
+}
+
+bool SoftwareRenderer::isKernelSupported(RasterKernel kernel)
+{
+   switch (kernel)
+   {
+   case RASTER_KERNEL_SCALAR: return true;
+#if defined(SOFTWARE_RENDERER_X86)
+   case RASTER_KERNEL_SSE2:   return true;  // part of every x86-64 CPU
+#endif
+   default:                   return false;
+   }
+}
+
+RasterKernel SoftwareRenderer::bestKernel()
+{
+   if (isKernelSupported(RASTER_KERNEL_SSE2)) return RASTER_KERNEL_SSE2;
+   return RASTER_KERNEL_SCALAR;
+}
+
+const char* SoftwareRenderer::kernelName(RasterKernel kernel)
+{
+   switch (kernel)
+   {
+   case RASTER_KERNEL_SCALAR: return "scalar";
+   case RASTER_KERNEL_SSE2:   return "sse2";
+   }
+   return "?";
+}
+
+//===============================================================
+// Texture sampling
+
+// Lerps all four 8-bit channels of a and b at once by f/256.
+static inline unsigned int lerpTexel(unsigned int a, unsigned int b, unsigned int f)
+{
+   unsigned int rb = (((a & 0x00ff00ff) * (256 - f) + (b & 0x00ff00ff) * f) >> 8) & 0x00ff00ff;
+   unsigned int ag = ((((a >> 8) & 0x00ff00ff) * (256 - f) + ((b >> 8) & 0x00ff00ff) * f) >> 8) & 0x00ff00ff;
+   return rb | (ag << 8);
+}
+
+// Bilinear sample at 16.16 texel coordinates (texel centres on whole
+// numbers), wrapping at the edges.  Textures are powers of two.
+static inline unsigned int sampleBilinear(const BmpImage& tex, int fx, int fy)
+{
+   int maskX = tex.width() - 1, maskY = tex.height() - 1;
+   int x0 = (fx >> 16) & maskX, x1 = (x0 + 1) & maskX;
+   int y0 = (fy >> 16) & maskY, y1 = (y0 + 1) & maskY;
+   unsigned int wx = (fx >> 8) & 255, wy = (fy >> 8) & 255;
+   const unsigned int* row0 = tex.texels() + y0 * tex.width();
+   const unsigned int* row1 = tex.texels() + y1 * tex.width();
+   return lerpTexel(lerpTexel(row0[x0], row0[x1], wx), lerpTexel(row1[x0], row1[x1], wx), wy);
+}
+
+static bool isPowerOfTwo(int n)
+{
+   return n > 0 && (n & (n - 1)) == 0;
+}
+
+//===============================================================
+// Renderer
+
+SoftwareRenderer::SoftwareRenderer(int width, int height)
+: mWidth(width), mHeight(height), mCameraZ(-1000.0f), mKernel(bestKernel())
+{
+   mPitch  = (width + 3) & ~3;
+   mPixels = allocPixels(mPitch * height);
+   mSpan   = allocPixels(mPitch);
+
+   clear(CLEAR_COLOR);
+}
+
+SoftwareRenderer::~SoftwareRenderer()
+{
+   freePixels(mPixels);
+   freePixels(mSpan);
+}
+
+bool SoftwareRenderer::loadTextures(const char* dir)
+{
+   const char* names[3]    = { "bkgd1.bmp", "ball.bmp", "pad.bmp" };
+   BmpImage* targets[3] = { &mBkgdTex, &mBallTex, &mPadTex };
+
+   for (int i = 0; i < 3; i++)
+   {
+      char path[1024];
+      sprintf(path, "%.1000s%s%s", dir, *dir ? "/" : "", names[i]);
+      if (!targets[i]->load(path))
+      {
+         fprintf(stderr, "SoftwareRenderer: cannot load %s\n", path);
+         return false;
+      }
+      // Wrapping is done with masks, as on D3D9 hardware without NONPOW2.
+      if (!isPowerOfTwo(targets[i]->width()) || !isPowerOfTwo(targets[i]->height()))
+      {
+         fprintf(stderr, "SoftwareRenderer: %s is not a power of two\n", path);
+         return false;
+      }
+   }
+   return true;
+}
+
+void SoftwareRenderer::clear(unsigned int color)
+{
+   for (int i = 0; i < mPitch * mHeight; i++)
+      mPixels[i] = color;
+}
+
+void SoftwareRenderer::drawScene(const PongState& s)
+{
+   clear(CLEAR_COLOR);
+
+   // The field is the only thing in view; outside the clip planes the
+   // frame is just the clear colour.
+   float distance = -mCameraZ;
+   if (distance >= NEAR_PLANE && distance <= FAR_PLANE && mBkgdTex.texels())
+   {
+      drawSprite(mBkgdTex, 0.0f, 0.0f, 256.0f, 256.0f, 20.0f, 10.0f, false, false, SPRITE_OPAQUE);
+      drawSprite(mPadTex, s.pad1.pos.x, s.pad1.pos.y, 64.0f, 64.0f, 1.0f, 1.0f, false, true, SPRITE_ALPHA_TEST);
+      drawSprite(mPadTex, s.pad2.pos.x, s.pad2.pos.y, 64.0f, 64.0f, 1.0f, 1.0f, true, true, SPRITE_ALPHA_TEST);
+      drawSprite(mBallTex, s.ball.pos.x, s.ball.pos.y, 32.0f, 32.0f, 1.0f, 1.0f, false, true, SPRITE_ALPHA_BLEND);
+   }
+
+   char line[64];
+   sprintf(line, "Player 1 score:  %d", s.player1Score);
+   drawText(5, 5, line, TEXT_COLOR);
+   sprintf(line, "Player 2 score:  %d", s.player2Score);
+   drawText(5, 5 + 18, line, TEXT_COLOR);
+}
+
+// Draws tex the way ID3DXSprite does in object space: texel (cx, cy) at
+// world (x, y), scaled by scale and optionally turned through 180 degrees.
+// texRepeat is the texture transform's scale; flipV is the game's default
+// (1, -1) texture transform, which turns the image upright.
+void SoftwareRenderer::drawSprite(const BmpImage& tex, float x, float y, float cx, float cy,
+                                  float scale, float texRepeat, bool rotated, bool flipV, SpriteMode mode)
+{
+   float pixelsPerUnit = (mHeight * 0.5f) / (-mCameraZ * tanf(SIM_PI / 8.0f));
+   float dir = rotated ? -1.0f : 1.0f;
+
+   // World extent of the quad, then the pixels whose centres it covers.
+   float wx0 = x + dir * scale * -cx, wx1 = x + dir * scale * (tex.width() - cx);
+   float wy0 = y + dir * scale * -cy, wy1 = y + dir * scale * (tex.height() - cy);
+   if (wx0 > wx1) { float t = wx0; wx0 = wx1; wx1 = t; }
+   if (wy0 > wy1) { float t = wy0; wy0 = wy1; wy1 = t; }
+
+   int left   = (int)ceilf(mWidth  * 0.5f + wx0 * pixelsPerUnit - 0.5f);
+   int right  = (int)ceilf(mWidth  * 0.5f + wx1 * pixelsPerUnit - 0.5f);
+   int top    = (int)ceilf(mHeight * 0.5f - wy1 * pixelsPerUnit - 0.5f);
+   int bottom = (int)ceilf(mHeight * 0.5f - wy0 * pixelsPerUnit - 0.5f);
+   if (left < 0)         left = 0;
+   if (right > mWidth)   right = mWidth;
+   if (top < 0)          top = 0;
+   if (bottom > mHeight) bottom = mHeight;
+   if (left >= right || top >= bottom)
+      return;
+
+   // Texel coordinates are linear in the pixel position: sprite-space
+   // p = (world - pos) * dir / scale + centre, sampled at p * texRepeat,
+   // or at height - p with the upright flip, and less half a texel so
+   // that bilinear weights are relative to texel centres.
+   float dPx = dir / (scale * pixelsPerUnit);   // sprite-space p per pixel right
+   float dPy = -dPx;                            // and per row down
+   float du  = texRepeat * dPx;
+   float dv  = flipV ? -dPy : texRepeat * dPy;
+   float u0 = texRepeat * (((left + 0.5f - mWidth * 0.5f) / pixelsPerUnit - x) * dir / scale + cx) - 0.5f;
+   float py = ((mHeight * 0.5f - (top + 0.5f)) / pixelsPerUnit - y) * dir / scale + cy;
+   float v0 = (flipV ? tex.height() - py : texRepeat * py) - 0.5f;
+
+   int fdu = (int)(du * 65536.0f);
+   int n   = right - left;
+   for (int row = top; row < bottom; row++)
+   {
+      int fv = (int)floorf((v0 + dv * (row - top)) * 65536.0f);
+      int fu = (int)floorf(u0 * 65536.0f);
+      unsigned int* dst  = mPixels + row * mPitch + left;
+      unsigned int* span = mode == SPRITE_OPAQUE ? dst : mSpan;
+      for (int i = 0; i < n; i++, fu += fdu)
+         span[i] = sampleBilinear(tex, fu, fv);
+
+      if (mode == SPRITE_ALPHA_TEST)
+         alphaTestSpan(mKernel, dst, span, n, ALPHA_REF);
+      else if (mode == SPRITE_ALPHA_BLEND)
+         blendSpan(mKernel, dst, span, n);
+   }
+}
+
+//===============================================================
+// Text
+
+struct Glyph
+{
+   char          c;
+   unsigned char rows[7];  // 5 pixels each, bit 4 on the left
+};
+
+// Just what the score needs.
+static const Glyph gGlyphs[] =
+{
+   { '0', { 0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E } },
+   { '1', { 0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E } },
+   { '2', { 0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F } },
+   { '3', { 0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E } },
+   { '4', { 0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02 } },
+   { '5', { 0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E } },
+   { '6', { 0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E } },
+   { '7', { 0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08 } },
+   { '8', { 0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E } },
+   { '9', { 0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C } },
+   { 'P', { 0x1E, 0x11, 0x11, 0x1E, 0x10, 0x10, 0x10 } },
+   { 'a', { 0x00, 0x00, 0x0E, 0x01, 0x0F, 0x11, 0x0F } },
+   { 'c', { 0x00, 0x00, 0x0E, 0x10, 0x10, 0x11, 0x0E } },
+   { 'e', { 0x00, 0x00, 0x0E, 0x11, 0x1F, 0x10, 0x0E } },
+   { 'l', { 0x0C, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E } },
+   { 'o', { 0x00, 0x00, 0x0E, 0x11, 0x11, 0x11, 0x0E } },
+   { 'r', { 0x00, 0x00, 0x16, 0x19, 0x10, 0x10, 0x10 } },
+   { 's', { 0x00, 0x00, 0x0E, 0x10, 0x0E, 0x01, 0x1E } },
+   { 'y', { 0x00, 0x00, 0x11, 0x11, 0x0F, 0x01, 0x0E } },
+   { ':', { 0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x0C, 0x00 } },
+   { '-', { 0x00, 0x00, 0x00, 0x1F, 0x00, 0x00, 0x00 } },
+};
+
+// Glyphs are drawn at twice their size, which is close to the game's
+// 18 pixel font; anything not in the table is a space.
+void SoftwareRenderer::drawText(int x, int y, const char* text, unsigned int color)
+{
+   const int zoom = 2, advance = 6 * zoom;
+   const int numGlyphs = sizeof(gGlyphs) / sizeof(gGlyphs[0]);
+
+   for (; *text; text++, x += advance)
+   {
+      const Glyph* glyph = 0;
+      for (int g = 0; g < numGlyphs && !glyph; g++)
+         if (gGlyphs[g].c == *text)
+            glyph = &gGlyphs[g];
+      if (!glyph)
+         continue;
+
+      for (int gy = 0; gy < 7 * zoom; gy++)
+      {
+         int py = y + 2 + gy;
+         if (py < 0 || py >= mHeight)
+            continue;
+         unsigned int bits = glyph->rows[gy / zoom];
+         for (int gx = 0; gx < 5 * zoom; gx++)
+         {
+            int px = x + gx;
+            if (px >= 0 && px < mWidth && (bits & (0x10 >> (gx / zoom))))
+               mPixels[py * mPitch + px] = color;
+         }
+      }
+   }
+}
@@ -0,0 +1,96 @@
+//=============================================================================
+// SoftwareRenderer.h
+//
+// PongRenderer on the CPU, for machines without a GPU.  Draws the same scene
+// as D3DRenderer into a BGRA framebuffer in memory:
+//
+//    background  bkgd1.bmp on a sprite scaled 20x, its texture tiled 10x
+//    pads        pad.bmp alpha tested (ALPHAREF 10, D3DCMP_GREATER),
+//                pad2 turned through 180 degrees
+//    ball        ball.bmp alpha blended (SRCALPHA, INVSRCALPHA)
+//    score       two lines of black text at (5, 5)
+//
+// seen through PongDemo's camera: 45 degree perspective from cameraZ, so one
+// field unit is (height / 2) / (-cameraZ * tan(22.5)) pixels.  Textures are
+// sampled bilinearly with wrapping, like the game's D3DTEXF_LINEAR samplers.
+// Each sprite row is fetched into a span first, then the alpha test or
+// blend runs over the whole span with SSE2 (or a scalar fallback).  The
+// score uses a small built-in bitmap font instead of Times New Roman.
+//=============================================================================
+
+#ifndef SOFTWARE_RENDERER_H
+#define SOFTWARE_RENDERER_H
+
+#include "PongRenderer.h"
+#include "BmpImage.h"
+
+enum RasterKernel
+{
+   RASTER_KERNEL_SCALAR,
+   RASTER_KERNEL_SSE2
+};
+
+class SoftwareRenderer : public PongRenderer
+{
+public:
+   SoftwareRenderer(int width, int height);
+   ~SoftwareRenderer();
+
+   // Loads bkgd1.bmp, ball.bmp and pad.bmp from dir, which may be "" for
+   // the current directory, through their BmpImage caches.  Returns false
+   // if any is missing or unusable.
+   bool loadTextures(const char* dir);
+
+   void drawScene(const PongState& s);
+   void setCameraZ(float z) { mCameraZ = z; }
+
+   void setKernel(RasterKernel kernel) { mKernel = kernel; }
+   RasterKernel kernel() const         { return mKernel; }
+
+   static bool        isKernelSupported(RasterKernel kernel);
+   static RasterKernel bestKernel();
+   static const char* kernelName(RasterKernel kernel);
+
+   // The framebuffer: height rows of pitch pixels, the first width of
+   // which are visible, 0xAARRGGBB each.
+   const unsigned int* pixels() const { return mPixels; }
+   int width()  const { return mWidth; }
+   int height() const { return mHeight; }
+   int pitch()  const { return mPitch; }
+
+   // Writes the framebuffer as a 32-bit BMP.
+   bool saveBmp(const char* path) const;
+
+   // The span kernels on their own, for benchmarks: blend src over dst,
+   // or copy the src pixels whose alpha is greater than ref.
+   static void blendSpan(RasterKernel kernel, unsigned int* dst, const unsigned int* src, int n);
+   static void alphaTestSpan(RasterKernel kernel, unsigned int* dst, const unsigned int* src, int n, int ref);
+
+private:
+   // Prevent copying
+   SoftwareRenderer(const SoftwareRenderer& rhs);
+   SoftwareRenderer& operator=(const SoftwareRenderer& rhs);
+
+   enum SpriteMode { SPRITE_OPAQUE, SPRITE_ALPHA_TEST, SPRITE_ALPHA_BLEND };
+
+   void clear(unsigned int color);
+   void drawSprite(const BmpImage& tex, float x, float y, float cx, float cy,
+                   float scale, float texRepeat, bool rotated, bool flipV, SpriteMode mode);
+   void drawText(int x, int y, const char* text, unsigned int color);
+
+private:
+   int           mWidth;
+   int           mHeight;
+   int           mPitch;
+   unsigned int* mPixels;
+   unsigned int* mSpan;     // one sprite row before it is composited
+
+   float         mCameraZ;
+   RasterKernel  mKernel;
+
+   BmpImage      mBkgdTex;
+   BmpImage      mBallTex;
+   BmpImage      mPadTex;
+};
+
+#endif // SOFTWARE_RENDERER_H
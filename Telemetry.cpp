@@ -0,0 +1,360 @@
+//=============================================================================
+// Telemetry.cpp
+//=============================================================================
+
+#include "Telemetry.h"
+#include <chrono>
+#include <string.h>
+
+static const char          TELEMETRY_MAGIC[4] = { 'P', 'T', 'E', 'L' };
+static const unsigned char TELEMETRY_VERSION  = 1;
+
+static long long steadyMicros()
+{
+   return std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Small signed values to small unsigned ones: 0, -1, 1, -2, 2 ...
+static unsigned long long zigzag(long long v)
+{
+   return ((unsigned long long)v << 1) ^ (unsigned long long)(v >> 63);
+}
+
+static long long unzigzag(unsigned long long v)
+{
+   return (long long)(v >> 1) ^ -(long long)(v & 1);
+}
+
+static void frameOf(const PongState& s, unsigned int events, TelemetryFrame& f)
+{
+   f.tick         = s.tick;
+   f.ballX        = s.ball.pos.x;
+   f.ballY        = s.ball.pos.y;
+   f.ballSpeed    = s.ball.speed;
+   f.ballRotation = s.ball.rotation;
+   f.pad1Y        = s.pad1.pos.y;
+   f.pad2Y        = s.pad2.pos.y;
+   f.player1Score = s.player1Score;
+   f.player2Score = s.player2Score;
+   f.events       = events;
+}
+
+//===============================================================
+// TelemetryWriter
+
+TelemetryWriter::TelemetryWriter()
+: mFile(0), mUsed(0), mWritten(0), mManualTime(false), mTime(0), mStart(0), mLastTime(0)
+{
+   memset(mCounters, 0, sizeof(mCounters));
+   memset(&mLastFrame, 0, sizeof(mLastFrame));
+}
+
+TelemetryWriter::~TelemetryWriter()
+{
+   close();
+}
+
+bool TelemetryWriter::open(const char* path)
+{
+   close();
+   mFile = fopen(path, "wb");
+   if (!mFile)
+      return false;
+
+   mUsed = mWritten = 0;
+   mTime = mLastTime = 0;
+   mStart = steadyMicros();
+   memset(mCounters, 0, sizeof(mCounters));
+   memset(&mLastFrame, 0, sizeof(mLastFrame));
+
+   memcpy(mBuffer, TELEMETRY_MAGIC, 4);
+   mBuffer[4] = TELEMETRY_VERSION;
+   mUsed = 5;
+   return true;
+}
+
+void TelemetryWriter::close()
+{
+   if (!mFile)
+      return;
+   flush();
+   fclose(mFile);
+   mFile = 0;
+}
+
+void TelemetryWriter::flush()
+{
+   if (mFile && mUsed > 0)
+   {
+      fwrite(mBuffer, 1, mUsed, mFile);
+      fflush(mFile);
+   }
+   mWritten += mUsed;
+   mUsed = 0;
+}
+
+// Makes room for one record and writes its type and time.
+void TelemetryWriter::begin(int type)
+{
+   if (mUsed + RECORD_MAX > BUFFER_BYTES)
+   {
+      fwrite(mBuffer, 1, mUsed, mFile);
+      mWritten += mUsed;
+      mUsed = 0;
+   }
+
+   long long now = mManualTime ? mTime : steadyMicros() - mStart;
+   long long delta = now - mLastTime;
+   mLastTime = now;
+
+   mBuffer[mUsed++] = (unsigned char)type;
+   putVarint(delta < 0 ? 0 : (unsigned long long)delta);
+}
+
+void TelemetryWriter::putVarint(unsigned long long v)
+{
+   while (v >= 0x80)
+   {
+      mBuffer[mUsed++] = (unsigned char)(v | 0x80);
+      v >>= 7;
+   }
+   mBuffer[mUsed++] = (unsigned char)v;
+}
+
+void TelemetryWriter::putFloat(float f)
+{
+   unsigned int bits;
+   memcpy(&bits, &f, 4);
+   mBuffer[mUsed++] = (unsigned char)(bits);
+   mBuffer[mUsed++] = (unsigned char)(bits >> 8);
+   mBuffer[mUsed++] = (unsigned char)(bits >> 16);
+   mBuffer[mUsed++] = (unsigned char)(bits >> 24);
+}
+
+void TelemetryWriter::name(int channel, const char* text)
+{
+   if (!mFile || channel < 0 || channel >= TELEMETRY_CHANNELS)
+      return;
+
+   int length = (int)strlen(text);
+   if (length > TELEMETRY_NAME_MAX - 1)
+      length = TELEMETRY_NAME_MAX - 1;
+
+   begin(TEL_NAME);
+   putVarint(channel);
+   putVarint(length);
+   memcpy(mBuffer + mUsed, text, length);
+   mUsed += length;
+}
+
+void TelemetryWriter::counter(int channel, long long value)
+{
+   if (!mFile || channel < 0 || channel >= TELEMETRY_CHANNELS)
+      return;
+
+   begin(TEL_COUNTER);
+   putVarint(channel);
+   putVarint(zigzag(value - mCounters[channel]));
+   mCounters[channel] = value;
+}
+
+void TelemetryWriter::floats(int channel, const float* values, int count)
+{
+   if (!mFile || channel < 0 || channel >= TELEMETRY_CHANNELS)
+      return;
+   if (count > TELEMETRY_MAX_FLOATS)
+      count = TELEMETRY_MAX_FLOATS;
+
+   begin(TEL_FLOATS);
+   putVarint(channel);
+   putVarint(count);
+   for (int i = 0; i < count; i++)
+      putFloat(values[i]);
+}
+
+void TelemetryWriter::frame(const PongState& s, unsigned int events)
+{
+   if (!mFile)
+      return;
+
+   TelemetryFrame f;
+   frameOf(s, events, f);
+
+   begin(TEL_FRAME);
+   putVarint(f.tick - mLastFrame.tick);
+   putFloat(f.ballX);
+   putFloat(f.ballY);
+   putFloat(f.ballSpeed);
+   putFloat(f.ballRotation);
+   putFloat(f.pad1Y);
+   putFloat(f.pad2Y);
+   putVarint(zigzag((long long)f.player1Score - mLastFrame.player1Score));
+   putVarint(zigzag((long long)f.player2Score - mLastFrame.player2Score));
+   putVarint(f.events);
+   mLastFrame = f;
+}
+
+//===============================================================
+// TelemetryReader
+
+TelemetryReader::TelemetryReader()
+: mFile(0), mError(false), mTime(0)
+{
+   memset(mCounters, 0, sizeof(mCounters));
+   memset(&mLastFrame, 0, sizeof(mLastFrame));
+   memset(mNames, 0, sizeof(mNames));
+}
+
+TelemetryReader::~TelemetryReader()
+{
+   close();
+}
+
+bool TelemetryReader::open(const char* path)
+{
+   close();
+   mFile = fopen(path, "rb");
+   if (!mFile)
+      return false;
+
+   mError = false;
+   mTime = 0;
+   memset(mCounters, 0, sizeof(mCounters));
+   memset(&mLastFrame, 0, sizeof(mLastFrame));
+   memset(mNames, 0, sizeof(mNames));
+
+   unsigned char header[5];
+   if (fread(header, 1, 5, mFile) != 5 || memcmp(header, TELEMETRY_MAGIC, 4) != 0 ||
+       header[4] != TELEMETRY_VERSION)
+   {
+      close();
+      return false;
+   }
+   return true;
+}
+
+void TelemetryReader::close()
+{
+   if (mFile)
+      fclose(mFile);
+   mFile = 0;
+}
+
+const char* TelemetryReader::channelName(int channel) const
+{
+   return channel >= 0 && channel < TELEMETRY_CHANNELS ? mNames[channel] : "";
+}
+
+bool TelemetryReader::getByte(unsigned char& b)
+{
+   int c = getc(mFile);
+   if (c == EOF)
+      return false;
+   b = (unsigned char)c;
+   return true;
+}
+
+bool TelemetryReader::getVarint(unsigned long long& v)
+{
+   v = 0;
+   for (int shift = 0; shift < 64; shift += 7)
+   {
+      unsigned char b;
+      if (!getByte(b))
+         return false;
+      v |= (unsigned long long)(b & 0x7f) << shift;
+      if (!(b & 0x80))
+         return true;
+   }
+   return false;
+}
+
+bool TelemetryReader::getFloat(float& f)
+{
+   unsigned char b[4];
+   if (fread(b, 1, 4, mFile) != 4)
+      return false;
+   unsigned int bits = b[0] | (b[1] << 8) | (b[2] << 16) | ((unsigned int)b[3] << 24);
+   memcpy(&f, &bits, 4);
+   return true;
+}
+
+bool TelemetryReader::next(Record& r)
+{
+   if (!mFile || mError)
+      return false;
+
+   unsigned char type;
+   if (!getByte(type))
+      return false;  // a clean end: between records
+
+   unsigned long long delta, channel = 0, n = 0;
+   bool ok = getVarint(delta);
+   mTime += (long long)delta;
+   r.type = type;
+   r.time = mTime;
+
+   switch (type)
+   {
+   case TEL_NAME:
+      ok = ok && getVarint(channel) && channel < (unsigned long long)TELEMETRY_CHANNELS &&
+           getVarint(n) && n < (unsigned long long)TELEMETRY_NAME_MAX &&
+           fread(mNames[channel], 1, (size_t)n, mFile) == n;
+      if (ok)
+      {
+         mNames[channel][n] = '\0';
+         r.channel = (int)channel;
+      }
+      break;
+
+   case TEL_COUNTER:
+      ok = ok && getVarint(channel) && channel < (unsigned long long)TELEMETRY_CHANNELS &&
+           getVarint(n);
+      if (ok)
+      {
+         mCounters[channel] += unzigzag(n);
+         r.channel = (int)channel;
+         r.value   = mCounters[channel];
+      }
+      break;
+
+   case TEL_FLOATS:
+      ok = ok && getVarint(channel) && channel < (unsigned long long)TELEMETRY_CHANNELS &&
+           getVarint(n) && n <= (unsigned long long)TELEMETRY_MAX_FLOATS;
+      for (unsigned long long i = 0; ok && i < n; i++)
+         ok = getFloat(r.values[i]);
+      if (ok)
+      {
+         r.channel = (int)channel;
+         r.count   = (int)n;
+      }
+      break;
+
+   case TEL_FRAME:
+   {
+      TelemetryFrame& f = r.frame;
+      unsigned long long tick, s1, s2, events;
+      ok = ok && getVarint(tick) &&
+           getFloat(f.ballX) && getFloat(f.ballY) && getFloat(f.ballSpeed) &&
+           getFloat(f.ballRotation) && getFloat(f.pad1Y) && getFloat(f.pad2Y) &&
+           getVarint(s1) && getVarint(s2) && getVarint(events);
+      if (ok)
+      {
+         f.tick         = mLastFrame.tick + (unsigned int)tick;
+         f.player1Score = mLastFrame.player1Score + (int)unzigzag(s1);
+         f.player2Score = mLastFrame.player2Score + (int)unzigzag(s2);
+         f.events       = (unsigned int)events;
+         mLastFrame = f;
+      }
+      break;
+   }
+
+   default:
+      ok = false;
+   }
+
+   if (!ok)
+      mError = true;
+   return ok;
+}
@@ -0,0 +1,148 @@
+//=============================================================================
+// Telemetry.h
+//
+// A compact binary stream of typed, timestamped records, so per-frame state
+// can be logged at full rate instead of formatted as text.  Every record is
+// a type byte and the time since the previous record (varint, microseconds),
+// then its payload:
+//
+//    TEL_NAME     channel, length, bytes       names a channel for the decoder
+//    TEL_COUNTER  channel, zigzag varint of the change since its last value
+//    TEL_FLOATS   channel, count, raw 32-bit floats
+//    TEL_FRAME    tick delta, ball x y speed rotation, pad1 y, pad2 y (raw
+//                 floats), score deltas (zigzag), PongEvent mask
+//
+// The file starts with "PTEL" and a version byte.  Multi-byte values are
+// little endian whatever the machine, so a file can be decoded anywhere;
+// TelemetryDump turns one into CSV.  A frame record is about 32 bytes and
+// a counter that moves a little each time 3 or 4.
+//
+// The writer appends to a 64 KB buffer and only calls fwrite when it is
+// full.  A writer belongs to one thread.
+//=============================================================================
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include "PongSim.h"
+#include <stdio.h>
+
+enum TelemetryRecord
+{
+   TEL_NAME    = 1,
+   TEL_COUNTER = 2,
+   TEL_FLOATS  = 3,
+   TEL_FRAME   = 4
+};
+
+const int TELEMETRY_CHANNELS   = 64;   // channel ids are 0..63
+const int TELEMETRY_MAX_FLOATS = 64;   // per TEL_FLOATS record
+const int TELEMETRY_NAME_MAX   = 32;   // bytes, terminator included
+
+// The slice of PongState a TEL_FRAME carries.
+struct TelemetryFrame
+{
+   unsigned int tick;
+   float        ballX, ballY, ballSpeed, ballRotation;
+   float        pad1Y, pad2Y;
+   int          player1Score, player2Score;
+   unsigned int events;
+};
+
+class TelemetryWriter
+{
+public:
+   TelemetryWriter();
+   ~TelemetryWriter();
+
+   bool open(const char* path);
+   void close();
+   bool isOpen() const { return mFile != 0; }
+
+   // Record times come from the steady clock, in microseconds since open(),
+   // unless setTime() is called: from then on every record gets the time it
+   // was last given, so headless runs can log simulated time instead.
+   void setTime(long long us) { mManualTime = true; mTime = us; }
+
+   void name(int channel, const char* text);
+   void counter(int channel, long long value);
+   void floats(int channel, const float* values, int count);
+   void frame(const PongState& s, unsigned int events);
+
+   void flush();
+
+   // Encoded so far, flushed or not.
+   long long bytes() const { return mWritten + mUsed; }
+
+private:
+   // Prevent copying
+   TelemetryWriter(const TelemetryWriter& rhs);
+   TelemetryWriter& operator=(const TelemetryWriter& rhs);
+
+   static const int BUFFER_BYTES = 64 * 1024;
+   static const int RECORD_MAX   = 32 + 4 * TELEMETRY_MAX_FLOATS;
+
+   void begin(int type);
+   void putVarint(unsigned long long v);
+   void putFloat(float f);
+
+   FILE*          mFile;
+   unsigned char  mBuffer[BUFFER_BYTES];
+   int            mUsed;
+   long long      mWritten;
+
+   bool           mManualTime;
+   long long      mTime;
+   long long      mStart;      // steady clock at open()
+   long long      mLastTime;   // of the previous record
+   long long      mCounters[TELEMETRY_CHANNELS];
+   TelemetryFrame mLastFrame;
+};
+
+// Reads back what TelemetryWriter wrote, one record at a time.
+class TelemetryReader
+{
+public:
+   struct Record
+   {
+      int            type;
+      long long      time;      // microseconds
+      int            channel;   // TEL_NAME, TEL_COUNTER, TEL_FLOATS
+      long long      value;     // TEL_COUNTER
+      int            count;     // TEL_FLOATS
+      float          values[TELEMETRY_MAX_FLOATS];
+      TelemetryFrame frame;     // TEL_FRAME
+   };
+
+   TelemetryReader();
+   ~TelemetryReader();
+
+   bool open(const char* path);
+   void close();
+
+   // false at the end of the file or at a malformed record; error() tells
+   // the two apart.
+   bool next(Record& r);
+   bool error() const { return mError; }
+
+   // "" for channels that were never named.
+   const char* channelName(int channel) const;
+
+private:
+   // Prevent copying
+   TelemetryReader(const TelemetryReader& rhs);
+   TelemetryReader& operator=(const TelemetryReader& rhs);
+
+   bool getByte(unsigned char& b);
+   bool getVarint(unsigned long long& v);
+   bool getFloat(float& f);
+
+   FILE*          mFile;
+   bool           mError;
+   long long      mTime;
+   long long      mCounters[TELEMETRY_CHANNELS];
+   TelemetryFrame mLastFrame;
+   char           mNames[TELEMETRY_CHANNELS][TELEMETRY_NAME_MAX];
+};
+
+#endif // TELEMETRY_H
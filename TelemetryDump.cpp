@@ -0,0 +1,126 @@
+//=============================================================================
+// TelemetryDump.cpp
+//
+// Converts a telemetry file written by TelemetryWriter (see Telemetry.h) to
+// CSV on stdout.  With -kind only one record type is written, with a header
+// row and one column per field; without it every record is written as
+// time, kind, channel, then its values.  Floats are printed with enough
+// digits to read back exactly.  Builds on any platform:
+//
+//    g++ -O2 -std=c++11 TelemetryDump.cpp Telemetry.cpp -o TelemetryDump
+//
+// usage: TelemetryDump [-kind frame|counter|floats] file.tel > out.csv
+//=============================================================================
+
+#include "Telemetry.h"
+#include <stdio.h>
+#include <string.h>
+
+static void printFrame(const TelemetryReader::Record& r, bool tagged)
+{
+   const TelemetryFrame& f = r.frame;
+   printf(tagged ? "%lld,frame,," : "%lld,", r.time);
+   printf("%u,%.9g,%.9g,%.9g,%.9g,%.9g,%.9g,%d,%d,%u\n",
+          f.tick, f.ballX, f.ballY, f.ballSpeed, f.ballRotation,
+          f.pad1Y, f.pad2Y, f.player1Score, f.player2Score, f.events);
+}
+
+static void printChannel(const TelemetryReader& reader, int channel)
+{
+   const char* name = reader.channelName(channel);
+   if (name[0])
+      printf("%s", name);
+   else
+      printf("%d", channel);
+}
+
+int main(int argc, char* argv[])
+{
+   const char* path = 0;
+   int         kind = 0;  // 0 = everything
+
+   for (int i = 1; i < argc; i++)
+   {
+      if (strcmp(argv[i], "-kind") == 0 && i + 1 < argc)
+      {
+         i++;
+         if      (strcmp(argv[i], "frame")   == 0) kind = TEL_FRAME;
+         else if (strcmp(argv[i], "counter") == 0) kind = TEL_COUNTER;
+         else if (strcmp(argv[i], "floats")  == 0) kind = TEL_FLOATS;
+         else
+         {
+            fprintf(stderr, "unknown kind %s\n", argv[i]);
+            return 1;
+         }
+      }
+      else if (argv[i][0] == '-' || path)
+      {
+         fprintf(stderr, "unexpected argument %s\n", argv[i]);
+         return 1;
+      }
+      else
+         path = argv[i];
+   }
+   if (!path)
+   {
+      fprintf(stderr, "usage: TelemetryDump [-kind frame|counter|floats] file.tel > out.csv\n");
+      return 1;
+   }
+
+   TelemetryReader reader;
+   if (!reader.open(path))
+   {
+      fprintf(stderr, "%s is not a telemetry file\n", path);
+      return 1;
+   }
+
+   if (kind == TEL_FRAME)
+      printf("time_us,tick,ball_x,ball_y,ball_speed,ball_rotation,pad1_y,pad2_y,score1,score2,events\n");
+   else if (kind == TEL_COUNTER)
+      printf("time_us,channel,value\n");
+   else if (kind == TEL_FLOATS)
+      printf("time_us,channel,values...\n");
+   else
+      printf("time_us,kind,channel,values...\n");
+
+   TelemetryReader::Record r;
+   long long records = 0;
+   while (reader.next(r))
+   {
+      records++;
+      if (kind != 0 && r.type != kind)
+         continue;
+
+      switch (r.type)
+      {
+      case TEL_NAME:
+         printf("%lld,name,%d,%s\n", r.time, r.channel, reader.channelName(r.channel));
+         break;
+
+      case TEL_COUNTER:
+         printf(kind ? "%lld," : "%lld,counter,", r.time);
+         printChannel(reader, r.channel);
+         printf(",%lld\n", r.value);
+         break;
+
+      case TEL_FLOATS:
+         printf(kind ? "%lld," : "%lld,floats,", r.time);
+         printChannel(reader, r.channel);
+         for (int i = 0; i < r.count; i++)
+            printf(",%.9g", r.values[i]);
+         printf("\n");
+         break;
+
+      case TEL_FRAME:
+         printFrame(r, kind == 0);
+         break;
+      }
+   }
+
+   if (reader.error())
+   {
+      fprintf(stderr, "%s: malformed record after %lld records\n", path, records);
+      return 1;
+   }
+   return 0;
+}
@@ -0,0 +1,333 @@
+//=============================================================================
+// TextureAtlas.cpp
+//=============================================================================
+
+#include "TextureAtlas.h"
+#include "BmpImage.h"
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+
+static const int ATLAS_MIN_SIZE = 16;
+
+static int alignUp(int n) { return (n + ATLAS_GUTTER - 1) / ATLAS_GUTTER * ATLAS_GUTTER; }
+
+//===============================================================
+// SkylinePacker
+
+SkylinePacker::SkylinePacker(int width, int height)
+: mWidth(width), mHeight(height)
+{
+   Node floor = { 0, 0, width };
+   mSkyline.push_back(floor);
+}
+
+int SkylinePacker::restingY(size_t i, int width, int height) const
+{
+   if (mSkyline[i].x + width > mWidth)
+      return -1;
+
+   // The highest run the rectangle spans is what it rests on.
+   int y = 0, left = width;
+   for (size_t j = i; left > 0; j++)
+   {
+      y = std::max(y, mSkyline[j].y);
+      left -= mSkyline[j].width;
+   }
+   return y + height <= mHeight ? y : -1;
+}
+
+bool SkylinePacker::insert(int width, int height, int& x, int& y)
+{
+   int    bestTop   = mHeight + 1, bestWidth = 0;
+   size_t bestIndex = 0;
+   for (size_t i = 0; i < mSkyline.size(); i++)
+   {
+      int restY = restingY(i, width, height);
+      if (restY < 0)
+         continue;
+      // Lowest top edge wins; between equals, the narrower run wastes less.
+      int top = restY + height;
+      if (top < bestTop || (top == bestTop && mSkyline[i].width < bestWidth))
+      {
+         bestTop   = top;
+         bestWidth = mSkyline[i].width;
+         bestIndex = i;
+         y         = restY;
+      }
+   }
+   if (bestTop > mHeight)
+      return false;
+
+   x = mSkyline[bestIndex].x;
+   Node placed = { x, bestTop, width };
+   mSkyline.insert(mSkyline.begin() + bestIndex, placed);
+
+   // Cut the runs now under the new one.
+   for (size_t i = bestIndex + 1; i < mSkyline.size(); )
+   {
+      Node& n = mSkyline[i];
+      int shrink = placed.x + placed.width - n.x;
+      if (shrink <= 0)
+         break;
+      if (shrink < n.width)
+      {
+         n.x     += shrink;
+         n.width -= shrink;
+         break;
+      }
+      mSkyline.erase(mSkyline.begin() + i);
+   }
+
+   // Merge neighbours at the same height.
+   for (size_t i = 0; i + 1 < mSkyline.size(); )
+   {
+      if (mSkyline[i].y == mSkyline[i + 1].y)
+      {
+         mSkyline[i].width += mSkyline[i + 1].width;
+         mSkyline.erase(mSkyline.begin() + i + 1);
+      }
+      else
+         i++;
+   }
+   return true;
+}
+
+//===============================================================
+// TextureAtlas
+
+static bool regionLess(const AtlasRegion& a, const AtlasRegion& b)
+{
+   return strcmp(a.name, b.name) < 0;
+}
+
+TextureAtlas::TextureAtlas()
+: mWidth(0), mHeight(0)
+{
+}
+
+bool TextureAtlas::addImage(const char* name, const unsigned int* texels, int width, int height)
+{
+   if (width <= 0 || height <= 0 || strlen(name) >= sizeof(((Pending*)0)->name))
+      return false;
+   for (size_t i = 0; i < mPending.size(); i++)
+      if (strcmp(mPending[i].name, name) == 0)
+         return false;
+
+   Pending p;
+   strcpy(p.name, name);
+   p.width  = width;
+   p.height = height;
+   p.texels.assign(texels, texels + width * height);
+
+   unsigned int alphaSeen = 0;
+   for (size_t i = 0; i < p.texels.size(); i++)
+      alphaSeen |= p.texels[i];
+   if ((alphaSeen >> 24) == 0)
+   {
+      for (size_t i = 0; i < p.texels.size(); i++)
+         p.texels[i] |= 0xff000000;
+   }
+
+   mPending.push_back(p);
+   return true;
+}
+
+bool TextureAtlas::addFile(const char* path)
+{
+   BmpImage image;
+   if (!image.load(path))
+      return false;
+
+   // The region name is the file name without directory or extension.
+   const char* base = path;
+   for (const char* c = path; *c; c++)
+      if (*c == '/' || *c == '\\')
+         base = c + 1;
+   char name[32];
+   int  n = 0;
+   while (base[n] && base[n] != '.' && n < (int)sizeof(name) - 1)
+   {
+      name[n] = base[n];
+      n++;
+   }
+   name[n] = 0;
+
+   return addImage(name, image.texels(), image.width(), image.height());
+}
+
+struct TextureAtlas::TallerFirst
+{
+   const std::vector<Pending>& images;
+   TallerFirst(const std::vector<Pending>& images) : images(images) {}
+   bool operator()(int a, int b) const
+   {
+      if (images[a].height != images[b].height)
+         return images[a].height > images[b].height;
+      if (images[a].width != images[b].width)
+         return images[a].width > images[b].width;
+      return a < b;
+   }
+};
+
+bool TextureAtlas::tryPack(int width, int height, std::vector<AtlasRegion>& regions) const
+{
+   // Tallest first, which is what keeps a skyline flat.
+   std::vector<int> order(mPending.size());
+   for (size_t i = 0; i < order.size(); i++)
+      order[i] = (int)i;
+   std::sort(order.begin(), order.end(), TallerFirst(mPending));
+
+   SkylinePacker packer(width, height);
+   regions.resize(mPending.size());
+   for (size_t i = 0; i < order.size(); i++)
+   {
+      const Pending& p = mPending[order[i]];
+      int x, y;
+      if (!packer.insert(alignUp(p.width) + 2 * ATLAS_GUTTER, alignUp(p.height) + 2 * ATLAS_GUTTER, x, y))
+         return false;
+
+      AtlasRegion& r = regions[order[i]];
+      strcpy(r.name, p.name);
+      r.x      = x + ATLAS_GUTTER;
+      r.y      = y + ATLAS_GUTTER;
+      r.width  = p.width;
+      r.height = p.height;
+   }
+   return true;
+}
+
+// Copies the image into its region and smears its edge texels out through
+// the gutter.
+void TextureAtlas::blit(const Pending& image, const AtlasRegion& r)
+{
+   for (int y = -ATLAS_GUTTER; y < alignUp(r.height) + ATLAS_GUTTER; y++)
+   {
+      int sy = std::min(std::max(y, 0), r.height - 1);
+      unsigned int* dst = &mTexels[(r.y + y) * mWidth + r.x];
+      for (int x = -ATLAS_GUTTER; x < alignUp(r.width) + ATLAS_GUTTER; x++)
+      {
+         int sx = std::min(std::max(x, 0), r.width - 1);
+         dst[x] = image.texels[sy * r.width + sx];
+      }
+   }
+}
+
+// Fills in the texture coordinates and sorts the regions for find().
+void TextureAtlas::finish()
+{
+   for (size_t i = 0; i < mRegions.size(); i++)
+   {
+      AtlasRegion& r = mRegions[i];
+      r.u0 = (float)r.x / mWidth;
+      r.v0 = (float)r.y / mHeight;
+      r.u1 = (float)(r.x + r.width) / mWidth;
+      r.v1 = (float)(r.y + r.height) / mHeight;
+   }
+   std::sort(mRegions.begin(), mRegions.end(), regionLess);
+}
+
+bool TextureAtlas::pack(int maxSize)
+{
+   if (mPending.empty())
+      return false;
+
+   // 16x16, 32x16, 32x32, 64x32 ... until everything fits.
+   for (int w = ATLAS_MIN_SIZE, h = ATLAS_MIN_SIZE; w <= maxSize && h <= maxSize; )
+   {
+      std::vector<AtlasRegion> regions;
+      if (tryPack(w, h, regions))
+      {
+         mWidth   = w;
+         mHeight  = h;
+         mRegions = regions;
+         mTexels.assign((size_t)w * h, 0);
+         for (size_t i = 0; i < mPending.size(); i++)
+            blit(mPending[i], mRegions[i]);
+         mPending.clear();
+         finish();
+         return true;
+      }
+      if (w <= h) w *= 2;
+      else        h *= 2;
+   }
+   return false;
+}
+
+//===============================================================
+// Offline atlas files
+//
+// name.atlas is text: a "PongAtlas 1 <width> <height> <count>" line, then
+// "<name> <x> <y> <width> <height>" per region.
+
+bool TextureAtlas::save(const char* name) const
+{
+   if (mTexels.empty())
+      return false;
+
+   char path[1024];
+   sprintf(path, "%.1000s.bmp", name);
+   if (!writeBmp(path, &mTexels[0], mWidth, mHeight, mWidth))
+      return false;
+
+   sprintf(path, "%.1000s.atlas", name);
+   FILE* f = fopen(path, "w");
+   if (!f)
+      return false;
+   fprintf(f, "PongAtlas 1 %d %d %d\n", mWidth, mHeight, (int)mRegions.size());
+   for (size_t i = 0; i < mRegions.size(); i++)
+   {
+      const AtlasRegion& r = mRegions[i];
+      fprintf(f, "%s %d %d %d %d\n", r.name, r.x, r.y, r.width, r.height);
+   }
+   return fclose(f) == 0;
+}
+
+bool TextureAtlas::load(const char* name)
+{
+   char path[1024];
+   sprintf(path, "%.1000s.atlas", name);
+   FILE* f = fopen(path, "r");
+   if (!f)
+      return false;
+
+   int version = 0, width = 0, height = 0, count = 0;
+   bool ok = fscanf(f, "PongAtlas %d %d %d %d", &version, &width, &height, &count) == 4 &&
+             version == 1 && count > 0;
+   std::vector<AtlasRegion> regions(ok ? count : 0);
+   for (int i = 0; ok && i < count; i++)
+   {
+      AtlasRegion& r = regions[i];
+      ok = fscanf(f, "%31s %d %d %d %d", r.name, &r.x, &r.y, &r.width, &r.height) == 5 &&
+           r.x >= 0 && r.y >= 0 && r.width > 0 && r.height > 0 &&
+           r.x + r.width <= width && r.y + r.height <= height;
+   }
+   fclose(f);
+   if (!ok)
+      return false;
+
+   BmpImage image;
+   sprintf(path, "%.1000s.bmp", name);
+   if (!image.load(path) || image.width() != width || image.height() != height)
+      return false;
+
+   mWidth   = width;
+   mHeight  = height;
+   mRegions = regions;
+   mTexels.assign(image.texels(), image.texels() + (size_t)width * height);
+   mPending.clear();
+   finish();
+   return true;
+}
+
+const AtlasRegion* TextureAtlas::find(const char* name) const
+{
+   AtlasRegion key;
+   strncpy(key.name, name, sizeof(key.name) - 1);
+   key.name[sizeof(key.name) - 1] = 0;
+   std::vector<AtlasRegion>::const_iterator it =
+      std::lower_bound(mRegions.begin(), mRegions.end(), key, regionLess);
+   if (it == mRegions.end() || strcmp(it->name, key.name) != 0)
+      return 0;
+   return &*it;
+}
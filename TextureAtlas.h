@@ -0,0 +1,109 @@
+//=============================================================================
+// TextureAtlas.h
+//
+// Packs the game's sprite images (ball, pad, pad variants) into one texture
+// so they can be drawn from a single ID3DXSprite batch instead of one batch
+// per texture.  Images are placed with a skyline bottom-left packer into the
+// smallest power-of-two atlas they fit, each surrounded by a gutter of its
+// own edge texels so bilinear filtering and the first mip levels never pick
+// up a neighbour.  Regions are looked up by name (the file name without its
+// extension, "pad_0" for pad_0.bmp).
+//
+// An atlas is either packed at load time from the .bmp files, or packed
+// offline by AtlasPack into a .bmp plus a text index and loaded from those.
+//=============================================================================
+
+#ifndef TEXTURE_ATLAS_H
+#define TEXTURE_ATLAS_H
+
+#include <stddef.h>
+#include <vector>
+
+// Texels are gutter-aligned: every region starts on a multiple of this and
+// has at least this many texels of gutter on each side.
+const int ATLAS_GUTTER = 4;
+
+// Mip levels that stay clean with ATLAS_GUTTER (1, 1/2, 1/4).
+const int ATLAS_MIP_LEVELS = 3;
+
+struct AtlasRegion
+{
+   char  name[32];
+   int   x, y;            // top left texel, top row first
+   int   width, height;   // without the gutter
+   float u0, v0, u1, v1;  // the same rectangle in texture coordinates
+};
+
+// Skyline bottom-left rectangle packer.  The skyline is the top edge of
+// everything placed so far, as runs of equal height; a new rectangle goes
+// where it leaves that edge lowest.
+class SkylinePacker
+{
+public:
+   SkylinePacker(int width, int height);
+
+   // Finds room for a width x height rectangle; false if there is none.
+   bool insert(int width, int height, int& x, int& y);
+
+private:
+   struct Node { int x, y, width; };
+
+   // Where a rectangle of the given width would rest if placed at node i,
+   // or -1 if it would stick out of the atlas.
+   int restingY(size_t i, int width, int height) const;
+
+   int               mWidth;
+   int               mHeight;
+   std::vector<Node> mSkyline;
+};
+
+class TextureAtlas
+{
+public:
+   TextureAtlas();
+
+   // Queues an image for the next pack(); false if the name is taken.
+   // 32-bit images whose alpha is zero everywhere are XRGB files and are
+   // made opaque.
+   bool addImage(const char* name, const unsigned int* texels, int width, int height);
+   bool addFile(const char* path);
+
+   // Packs every queued image into the smallest power-of-two atlas up to
+   // maxSize on a side.
+   bool pack(int maxSize = 2048);
+
+   // The offline path: write the atlas as name.bmp and name.atlas, and
+   // read them back.
+   bool save(const char* name) const;
+   bool load(const char* name);
+
+   const AtlasRegion* find(const char* name) const;
+   int                regionCount() const { return (int)mRegions.size(); }
+   const AtlasRegion& region(int i) const { return mRegions[i]; }
+
+   const unsigned int* texels() const { return mTexels.empty() ? 0 : &mTexels[0]; }
+   int width()  const { return mWidth; }
+   int height() const { return mHeight; }
+
+private:
+   struct Pending
+   {
+      char                      name[32];
+      int                       width, height;
+      std::vector<unsigned int> texels;
+   };
+
+   struct TallerFirst;
+
+   bool tryPack(int width, int height, std::vector<AtlasRegion>& regions) const;
+   void blit(const Pending& image, const AtlasRegion& r);
+   void finish();
+
+   std::vector<Pending>      mPending;
+   std::vector<AtlasRegion>  mRegions;   // sorted by name
+   std::vector<unsigned int> mTexels;
+   int                       mWidth;
+   int                       mHeight;
+};
+
+#endif // TEXTURE_ATLAS_H
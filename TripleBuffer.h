@@ -0,0 +1,76 @@
+//=============================================================================
+// TripleBuffer.h
+//
+// Hands the latest value from one writer thread to one reader thread
+// without either ever waiting.  There are three slots: the writer fills
+// its back slot, then publish() swaps it with the middle one; the reader's
+// update() swaps its front slot with the middle one when something new
+// has been published there.  Each side only ever touches its own slot, so
+// the reader sees whole values, never one half-written, and a value it is
+// looking at is not overwritten until it calls update() again.  A value
+// published twice before the reader looks is simply replaced: the reader
+// gets the newest, not every one.
+//
+// The middle slot's index and a "fresh" bit share one atomic word; the
+// slots are padded apart so the two threads do not share cache lines.
+//=============================================================================
+
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <atomic>
+
+const int TRIPLE_BUFFER_PAD = 64;  // bytes, a cache line
+
+template <typename T>
+class TripleBuffer
+{
+public:
+   TripleBuffer() : mMiddle(1), mBack(2), mFront(0) {}
+
+   // Writer only.  The slot to fill; its contents are whatever was
+   // published there two publishes ago.
+   T& back() { return mSlots[mBack].value; }
+
+   // Writer only.  Makes back() the newest value.
+   void publish()
+   {
+      mBack = mMiddle.exchange(mBack | FRESH, std::memory_order_acq_rel) & INDEX;
+   }
+
+   // Reader only.  Moves to the newest published value; false if there
+   // was nothing new.
+   bool update()
+   {
+      if (!(mMiddle.load(std::memory_order_relaxed) & FRESH))
+         return false;
+      mFront = mMiddle.exchange(mFront, std::memory_order_acq_rel) & INDEX;
+      return true;
+   }
+
+   // Reader only.  Stays valid and unchanged until the next update().
+   const T& front() const { return mSlots[mFront].value; }
+
+private:
+   // Prevent copying
+   TripleBuffer(const TripleBuffer& rhs);
+   TripleBuffer& operator=(const TripleBuffer& rhs);
+
+   static const unsigned int INDEX = 3;
+   static const unsigned int FRESH = 4;
+
+   struct Slot
+   {
+      T    value;
+      char pad[TRIPLE_BUFFER_PAD];
+   };
+
+   Slot                      mSlots[3];
+   std::atomic<unsigned int> mMiddle;
+   char                      mPad0[TRIPLE_BUFFER_PAD];
+   unsigned int              mBack;   // the writer's
+   char                      mPad1[TRIPLE_BUFFER_PAD];
+   unsigned int              mFront;  // the reader's
+};
+
+#endif // TRIPLE_BUFFER_H
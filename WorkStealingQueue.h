@@ -0,0 +1,96 @@
+//=============================================================================
+// WorkStealingQueue.h
+//
+// Fixed-capacity Chase-Lev work-stealing deque (the C11 formulation of
+// Le, Pop, Cohen and Zappa Nardelli).  The owning thread pushes and pops at
+// the bottom without contention; any other thread may steal from the top.
+// T must be a type std::atomic<T> is lock-free for, typically a 64-bit job
+// descriptor.
+//=============================================================================
+
+#ifndef WORK_STEALING_QUEUE_H
+#define WORK_STEALING_QUEUE_H
+
+#include <atomic>
+
+template <typename T, int CAPACITY = 1024>
+class WorkStealingQueue
+{
+public:
+   WorkStealingQueue() : mTop(0), mBottom(0)
+   {
+      static_assert((CAPACITY & (CAPACITY - 1)) == 0, "CAPACITY must be a power of two");
+   }
+
+   // Owner only.  Returns false when the deque is full; the caller
+   // should then run the job itself.
+   bool push(T item)
+   {
+      long long b = mBottom.load(std::memory_order_relaxed);
+      long long t = mTop.load(std::memory_order_acquire);
+      if (b - t >= CAPACITY)
+         return false;
+
+      mItems[b & (CAPACITY - 1)].store(item, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+      mBottom.store(b + 1, std::memory_order_relaxed);
+      return true;
+   }
+
+   // Owner only.  Takes the most recently pushed job.
+   bool pop(T& item)
+   {
+      long long b = mBottom.load(std::memory_order_relaxed) - 1;
+      mBottom.store(b, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      long long t = mTop.load(std::memory_order_relaxed);
+
+      if (t > b)
+      {
+         // Empty.
+         mBottom.store(b + 1, std::memory_order_relaxed);
+         return false;
+      }
+
+      item = mItems[b & (CAPACITY - 1)].load(std::memory_order_relaxed);
+      if (t == b)
+      {
+         // Last job: race the thieves for it.
+         bool won = mTop.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                                 std::memory_order_relaxed);
+         mBottom.store(b + 1, std::memory_order_relaxed);
+         return won;
+      }
+      return true;
+   }
+
+   // Any thread.  Takes the oldest job; fails if empty or if another
+   // thread got there first.
+   bool steal(T& item)
+   {
+      long long t = mTop.load(std::memory_order_acquire);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      long long b = mBottom.load(std::memory_order_acquire);
+      if (t >= b)
+         return false;
+
+      item = mItems[t & (CAPACITY - 1)].load(std::memory_order_relaxed);
+      return mTop.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                          std::memory_order_relaxed);
+   }
+
+private:
+   // Prevent copying
+   WorkStealingQueue(const WorkStealingQueue& rhs);
+   WorkStealingQueue& operator=(const WorkStealingQueue& rhs);
+
+   // top and bottom are kept 64 bytes apart so thieves hammering top
+   // do not keep taking the owner's cache line away.
+   std::atomic<long long> mTop;
+   char                   mPadTop[64];
+   std::atomic<long long> mBottom;
+   char                   mPadBottom[64];
+   std::atomic<T>         mItems[CAPACITY];
+};
+
+#endif // WORK_STEALING_QUEUE_H
@@ -3,9 +3,12 @@
 //=============================================================================
 
 #include "d3dApp.h"
+#include "FrameProfiler.h"
+#include "SimThread.h"
 
 D3DApp* gd3dApp              = 0;
 IDirect3DDevice9* gd3dDevice = 0;
+RenderStateCache* gd3dStates = 0;
 
 LRESULT CALLBACK
    MainWndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
@@ -26,15 +29,25 @@ D3DApp::D3DApp(HINSTANCE hInstance, std::string winCaption, D3DDEVTYPE devType,
    mhAppInst   = hInstance;
    mhMainWnd   = 0;
    md3dObject  = 0;
+   md3dRenderDevice = 0;
    mAppPaused  = false;
    ZeroMemory(&md3dPP, sizeof(md3dPP));
 
+   mFixedTimestep = false;
+   mRenderAlpha   = 1.0f;
+   mSimThread     = 0;
+   mFrameTime     = 0.0;
+   mTickTime      = 0.0;
+
    initMainWindow();
    initDirect3D();
 }
 
 D3DApp::~D3DApp()
 {
+   delete gd3dStates;
+   gd3dStates = 0;
+   delete md3dRenderDevice;
    ReleaseCOM(md3dObject);
    ReleaseCOM(gd3dDevice);
 }
@@ -149,6 +162,9 @@ void D3DApp::initDirect3D()
       devBehaviorFlags,   // vertex processing
       &md3dPP,            // present parameters
       &gd3dDevice));      // return created device
+
+   md3dRenderDevice = new D3DRenderDevice(gd3dDevice);
+   gd3dStates       = new RenderStateCache(*md3dRenderDevice);
 }
 
 int D3DApp::run()
@@ -162,6 +178,17 @@ int D3DApp::run()
 
    __int64 prevTimeStamp = 0;
    QueryPerformanceCounter((LARGE_INTEGER*)&prevTimeStamp);
+   __int64 startTimeStamp = prevTimeStamp;
+
+   profileSetThreadName("main");
+
+   if( mSimThread )
+   {
+      // Sleep() is otherwise only good to the 15.6 ms system tick,
+      // nearly two simulation ticks.
+      timeBeginPeriod(1);
+      mSimThread->start();
+   }
 
    while(msg.message != WM_QUIT)
    {
@@ -174,6 +201,9 @@ int D3DApp::run()
       // Otherwise, do animation/game stuff.
       else
       {	
+         if( mSimThread )
+            mSimThread->setPaused(mAppPaused);
+
          // If the application is paused then free some CPU cycles to other 
          // applications and then continue on to the next frame.
          if( mAppPaused )
@@ -184,12 +214,40 @@ int D3DApp::run()
 
          if( !isDeviceLost() )
          {
+            PROFILE_SCOPE("frame");
             __int64 currTimeStamp = 0;
             QueryPerformanceCounter((LARGE_INTEGER*) &currTimeStamp);
             float dt = (currTimeStamp - prevTimeStamp) * secsPerCnt;
             //ptt.printNumbers(4, (long) dt, currTimeStamp, prevTimeStamp, secsPerCnt);
+            mFrameTime = (currTimeStamp - startTimeStamp) / (double)cntsPerSec;
 
-            updateScene(dt);
+            updateFrame(dt);
+            if( mSimThread )
+            {
+               // Ticks run on the simulation thread; drawScene draws
+               // its latest snapshot.
+               mRenderAlpha = 1.0f;
+            }
+            else if( mFixedTimestep )
+            {
+               // Simulate whole ticks only; the remainder carries over
+               // to the next frame and is covered by interpolation.
+               int ticks = mTimestep.advance(dt);
+               double tickDt = mTimestep.tickDt();
+               double lastTickEnd = mFrameTime - mTimestep.alpha() * tickDt;
+               for(int i = 0; i < ticks; ++i)
+               {
+                  mTickTime = lastTickEnd - (ticks - 1 - i) * tickDt;
+                  updateScene(mTimestep.tickDt());
+               }
+               mRenderAlpha = mTimestep.alpha();
+            }
+            else
+            {
+               mTickTime = mFrameTime;
+               updateScene(dt);
+               mRenderAlpha = 1.0f;
+            }
             drawScene();
 
             // Prepare for next iteration: The current time stamp becomes
@@ -198,6 +256,12 @@ int D3DApp::run()
          }
       }
    }
+
+   if( mSimThread )
+   {
+      mSimThread->stop();
+      timeEndPeriod(1);
+   }
    return (int)msg.wParam;
 }
 
@@ -309,6 +373,18 @@ LRESULT D3DApp::msgProc(UINT msg, WPARAM wParam, LPARAM lParam)
    return DefWindowProc(mhMainWnd, msg, wParam, lParam);
 }
 
+void D3DApp::enableFixedTimestep(bool enable, float tickRate, int maxTicksPerFrame)
+{
+   mFixedTimestep = enable;
+   mTimestep      = FixedTimestep(tickRate, maxTicksPerFrame);
+   mRenderAlpha   = 1.0f;
+}
+
+void D3DApp::enableThreadedSimulation(SimThread* sim)
+{
+   mSimThread = sim;
+}
+
 void D3DApp::enableFullScreenMode(bool enable)
 {
    // Switch to fullscreen mode.
@@ -15,8 +15,12 @@
 
 #include "d3dUtil.h"
 #include "PrintUtils.h"
+#include "FixedTimestep.h"
+#include "D3DRenderDevice.h"
 #include <string>
 
+class SimThread;
+
 class D3DApp
 {
 public:
@@ -31,7 +35,8 @@ public:
 	virtual bool checkDeviceCaps()     { return true; }
 	virtual void onLostDevice()        {}
 	virtual void onResetDevice()       {}
-	virtual void updateScene(float dt) {}
+	virtual void updateFrame(float dt) {} // once per rendered frame, before updateScene
+	virtual void updateScene(float dt) {} // once per frame, or once per tick if fixed
 	virtual void drawScene()           {}
 
 	// Override these methods only if you do not like the default window creation,
@@ -45,6 +50,16 @@ public:
 	void enableFullScreenMode(bool enable);
 	bool isDeviceLost();
 
+	// Runs updateScene at a fixed tickRate regardless of frame rate,
+	// catching up at most maxTicksPerFrame ticks in a single frame.
+	void enableFixedTimestep(bool enable, float tickRate, int maxTicksPerFrame);
+
+	// Leaves ticking to sim, on its own thread: run() then only calls
+	// updateFrame and drawScene, starts sim on entry, stops it before
+	// returning and pauses it while the app is paused.  0 to tick on
+	// the main thread again.  Not owned.
+	void enableThreadedSimulation(SimThread* sim);
+
 protected:
 	// Derived client class can modify these data members in the constructor to 
 	// customize the application.  
@@ -56,12 +71,31 @@ protected:
 	HINSTANCE             mhAppInst;
 	HWND                  mhMainWnd;
 	IDirect3D9*           md3dObject;
+	D3DRenderDevice*      md3dRenderDevice; // what gd3dStates forwards to
 	bool                  mAppPaused;
 	D3DPRESENT_PARAMETERS md3dPP;
+
+	// Fixed timestep mode.  mRenderAlpha is how far (0..1) real time is
+	// past the last tick; drawScene interpolates by it.  It is 1 when
+	// the timestep is variable.
+	bool                  mFixedTimestep;
+	FixedTimestep         mTimestep;
+	float                 mRenderAlpha;
+
+	// Threaded mode, or 0.
+	SimThread*            mSimThread;
+
+	// The app clock, in seconds since run() started: mFrameTime is when
+	// the current frame began, mTickTime the moment the current
+	// updateScene call simulates up to.  Timestamped input is consumed
+	// against these.
+	double                mFrameTime;
+	double                mTickTime;
 };
 
 // Globals for convenient access.
 extern D3DApp* gd3dApp;
 extern IDirect3DDevice9* gd3dDevice;
+extern RenderStateCache* gd3dStates;
 
 #endif // D3DAPP_H
\ No newline at end of file
@@ -29,6 +29,11 @@ class D3DApp;
 extern D3DApp* gd3dApp;
 extern IDirect3DDevice9* gd3dDevice;
 
+// Render, sampler and texture stage states and transforms go through
+// this, which drops the calls that would not change anything.
+class RenderStateCache;
+extern RenderStateCache* gd3dStates;
+
 static const float PI = 3.14159f;
 
 //===============================================================